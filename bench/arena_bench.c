@@ -0,0 +1,196 @@
+/* arena_bench.c - Request processing on an arena versus the heap
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * A request receives 'n' items and builds request-scoped data out of them with vectors.h,
+ * hash.h and sorting.h; at the end of the request the data is dropped. With the heap, every
+ * container is freed one by one; with the arena, everything is allocated from an arena_t that is
+ * reset when the request is done. The workloads:
+ *
+ *   vectors  the items are spread over 16 vectors grown one push at a time
+ *   hash     the items are counted in a hash map by key
+ *   mixed    a vector of the items, a hash map of the distinct ones and a merge sort of the
+ *            vector (s_merge, whose temporary buffer comes from s_set_allocator)
+ *
+ * Columns: time per item, then the time relative to the heap row of the same workload and n.
+ * Every repetition runs ARENA_BENCH_REQUESTS requests, so that the small requests are not dominated
+ * by the timer.
+ */
+
+#include "bench.h"
+#include "arena.h"
+#include "vectors.h"
+#include "hash.h"
+#include "sorting.h"
+
+/* Requests per repetition */
+#define ARENA_BENCH_REQUESTS 64
+
+/* Vectors of the 'vectors' workload */
+#define ARENA_BENCH_VECTORS 16
+
+typedef enum workload_t { WORK_VECTORS, WORK_HASH, WORK_MIXED, WORKLOADS } workload_t;
+
+static const char *workload_names[WORKLOADS] = {"vectors", "hash", "mixed"};
+static const uint64_t arena_dims[] = {16, 256, 4096, 65536, 1 << 20};
+
+#define ARENA_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static bool less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+// Runs a request over 'items'; 'allocator' is NULL for the heap. Returns a checksum
+static uint64_t run_request(workload_t work, const uint64_t *items, size_t n, const chibi_allocator_t *allocator) {
+  uint64_t check = 0;
+  switch (work) {
+    case WORK_VECTORS: {
+      uint64_t *vecs[ARENA_BENCH_VECTORS];
+      for (int v = 0; v < ARENA_BENCH_VECTORS; ++v) {
+        vecs[v] = NULL;
+        v_init_with(vecs[v], allocator);
+      }
+      for (size_t i = 0; i < n; ++i) {
+        v_push_back(vecs[items[i] % ARENA_BENCH_VECTORS], items[i]);
+      }
+      for (int v = 0; v < ARENA_BENCH_VECTORS; ++v) {
+        check += v_size(vecs[v]);
+        if (allocator == NULL) {
+          v_free(vecs[v]);
+        }
+      }
+      break;
+    }
+    case WORK_HASH: {
+      uint32_t *map = NULL;
+      hash_init_with(map, allocator);
+      for (size_t i = 0; i < n; ++i) {
+        uint32_t *count = (uint32_t *) hash_get(map, items[i]);
+        if (count != NULL) {
+          ++*count;
+        } else {
+          hash_put(map, items[i], 1);
+        }
+      }
+      check += hash_size(map);
+      if (allocator == NULL) {
+        hash_free(map);
+      }
+      break;
+    }
+    default: {
+      uint64_t *vec = NULL;
+      uint8_t *seen = NULL;
+      v_init_with(vec, allocator);
+      hash_init_with(seen, allocator);
+      for (size_t i = 0; i < n; ++i) {
+        v_push_back(vec, items[i]);
+        hash_put(seen, items[i], 1);
+      }
+      s_set_allocator(allocator);
+      s_merge(vec, v_size(vec), sizeof(uint64_t), less_u64);
+      s_set_allocator(NULL);
+      check += hash_size(seen) + ((n > 0) ? vec[0] : 0);
+      if (allocator == NULL) {
+        v_free(vec);
+        hash_free(seen);
+      }
+      break;
+    }
+  }
+  return check;
+}
+
+int main(int argc, char **argv) {
+  bench_init("arena_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-8s %-6s %10s", "workload", "alloc", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s", "vs heap");
+  bench_header(keys_header, extra_header);
+
+  arena_t arena;
+  arena_init(&arena, 0);
+  const chibi_allocator_t *allocator = arena_allocator(&arena);
+  uint64_t checksum = 0;
+  for (int w = 0; w < WORKLOADS; ++w) {
+    for (size_t ni = 0; ni < ARENA_COUNT(arena_dims); ++ni) {
+      size_t n = (size_t) arena_dims[ni];
+      // items, the containers of a request and their growth
+      if (!bench_fits(n, 8 * (uint64_t) n * sizeof(uint64_t))) {
+        continue;
+      }
+      uint64_t *items = (uint64_t *) malloc(n * sizeof(uint64_t));
+      if (items == NULL) {
+        fprintf(stderr, "arena_bench: out of memory at n = %zu\n", n);
+        return 1;
+      }
+      uint64_t state = 59 + n;
+      for (size_t i = 0; i < n; ++i) {
+        // about half of the items repeat
+        items[i] = bench_rand(&state) % (n / 2 + 1);
+      }
+      uint64_t ops = (uint64_t) n * ARENA_BENCH_REQUESTS;
+      double heap_ns = 0.0;
+      for (int use_arena = 0; use_arena < 2; ++use_arena) {
+        char row_keys[128];
+        snprintf(row_keys, sizeof(row_keys), "%-8s %-6s %10zu", workload_names[w], use_arena ? "arena" : "heap", n);
+        if (!bench_selected(row_keys)) {
+          continue;
+        }
+        bench_timer_t timer;
+        bench_timer_init(&timer);
+        while (bench_more(&timer, ops)) {
+          bench_start(&timer);
+          for (int r = 0; r < ARENA_BENCH_REQUESTS; ++r) {
+            checksum += run_request((workload_t) w, items, n, use_arena ? allocator : NULL);
+            if (use_arena) {
+              arena_reset(&arena);
+            }
+          }
+          bench_stop(&timer);
+        }
+        double ns = bench_ns_per(&timer, ops);
+        char extra[64];
+        if (use_arena && heap_ns > 0.0) {
+          snprintf(extra, sizeof(extra), "%10.2f", ns / heap_ns);
+        } else {
+          snprintf(extra, sizeof(extra), "%10.2f", 1.0);
+          heap_ns = ns;
+        }
+        bench_row(row_keys, &timer, ops, extra);
+      }
+      free(items);
+    }
+  }
+  arena_free(&arena);
+  // keeps the requests from being optimized away
+  fprintf(stderr, "# checksum %llu\n", (unsigned long long) checksum);
+  return 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,301 @@
+/* art_bench.c - Adaptive radix tree of art.h versus hash.h and btree.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Three key sets of n keys, each mapped to a uint64_t value:
+ *
+ *   id-dense   consecutive 64-bit IDs, shuffled
+ *   id-random  uniform 64-bit IDs
+ *   url        URLs of a few hundred hosts (Zipfian over the hosts), with paths and a query id
+ *
+ * The stores: the ART on the heap and on an arena (art_new_with), hash.h keyed by the ID or by a
+ * 64-bit hash of the URL (as for an index into a table of strings; the URL itself is not
+ * compared; the hash is computed by every operation), and btree.h for the IDs (its keys are integers, so it skips the URLs). The operations:
+ *
+ *   insert  n inserts in random order
+ *   lookup  n lookups of present keys in random order
+ *   scan    n / 64 ordered queries: the keys below a random 7-byte prefix for the IDs (btree.h
+ *           seeks the same numerical range), the URLs of a random host for the URLs; hash.h has
+ *           no order and is skipped
+ *
+ * Columns: time per key (per query for scan), the time relative to the art row of the same
+ * operation, keys and n, and the keys visited per query for scan.
+ */
+
+#include "bench.h"
+#include "art.h"
+#include "arena.h"
+#include "btree.h"
+#include "hash.h"
+
+/* Hosts of the URLs */
+#define ART_BENCH_HOSTS 300
+
+typedef enum keyset_t { KEYS_DENSE, KEYS_RANDOM, KEYS_URL, KEYSETS } keyset_t;
+typedef enum op_t { OP_INSERT, OP_LOOKUP, OP_SCAN, OPS } op_t;
+typedef enum store_t { STORE_ART, STORE_ART_ARENA, STORE_HASH, STORE_BTREE, STORES } store_t;
+
+static const char *keyset_names[KEYSETS] = {"id-dense", "id-random", "url"};
+static const char *op_names[OPS] = {"insert", "lookup", "scan"};
+static const char *store_names[STORES] = {"art", "art-arena", "hash", "btree"};
+static const uint64_t art_dims[] = {256, 4096, 65536, 1 << 20, 1 << 24};
+
+#define ART_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+// A key: the bytes given to the ART, and the integer given to hash.h and btree.h
+typedef struct bench_key_t {
+  const uint8_t *bytes;
+  size_t len;
+  uint64_t id;
+} bench_key_t;
+
+// FNV-1a
+static uint64_t hash_bytes(const uint8_t *bytes, size_t len) {
+  uint64_t h = 0xCBF29CE484222325ULL;
+  for (size_t i = 0; i < len; ++i) {
+    h = (h ^ bytes[i]) * 0x100000001B3ULL;
+  }
+  return h;
+}
+
+// Builds the keys of a key set; the bytes are stored in 'text'. Returns false on allocation failure
+static bool make_keys(keyset_t set, bench_key_t *keys, size_t n, char **text) {
+  uint64_t state = 103 + n + (uint64_t) set;
+  size_t stride = (set == KEYS_URL) ? 80 : 8;
+  *text = (char *) malloc(n * stride);
+  if (*text == NULL) {
+    return false;
+  }
+  double log_hosts = log((double) ART_BENCH_HOSTS + 1.0);
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t *bytes = (uint8_t *) *text + i * stride;
+    keys[i].bytes = bytes;
+    if (set == KEYS_URL) {
+      double u = (double)(bench_rand(&state) >> 11) * (1.0 / 9007199254740992.0);
+      unsigned host = (unsigned)(exp(u * log_hosts) - 1.0);
+      int len = snprintf((char *) bytes, stride, "https://www.host%u.example.com/section%u/item%u?id=%zu", host,
+                         (unsigned)(bench_rand(&state) % 20), (unsigned)(bench_rand(&state) % 1000), i);
+      keys[i].len = (size_t) len;
+      keys[i].id = hash_bytes(bytes, keys[i].len);
+    } else {
+      keys[i].id = (set == KEYS_DENSE) ? 1000000 + i : bench_rand(&state);
+      art_key_u64(keys[i].id, bytes);
+      keys[i].len = 8;
+    }
+  }
+  // random order
+  for (size_t i = n; i > 1; --i) {
+    size_t j = (size_t)(bench_rand(&state) % i);
+    bench_key_t tmp = keys[i - 1];
+    keys[i - 1] = keys[j];
+    keys[j] = tmp;
+  }
+  return true;
+}
+
+// Key of hash.h: the ID, or the hash of the URL
+static uint64_t hash_key(keyset_t set, const bench_key_t *key) {
+  return (set == KEYS_URL) ? hash_bytes(key->bytes, key->len) : key->id;
+}
+
+static bool applies(keyset_t set, op_t op, store_t store) {
+  if (store == STORE_ART_ARENA) {
+    return op == OP_INSERT;
+  }
+  if (store == STORE_HASH) {
+    return op != OP_SCAN;
+  }
+  return store != STORE_BTREE || set != KEYS_URL;
+}
+
+static bool count_visit(void *ctx, const uint8_t *key, size_t len, void *value) {
+  (void) key;
+  (void) len;
+  *(uint64_t *) ctx += *(const uint64_t *) value;
+  return true;
+}
+
+// Length of the host part of a URL ("https://www.hostN.example.com/")
+static size_t host_len(const bench_key_t *key) {
+  const uint8_t *slash = (const uint8_t *) memchr(key->bytes + 8, '/', key->len - 8);
+  return (slash != NULL) ? (size_t)(slash - key->bytes) + 1 : key->len;
+}
+
+int main(int argc, char **argv) {
+  bench_init("art_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-6s %-9s %-9s %10s", "op", "keys", "store", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s", "vs art", "keys/query");
+  bench_header(keys_header, extra_header);
+
+  arena_t arena;
+  arena_init(&arena, 0);
+  uint64_t checksum = 0;
+  for (int set = 0; set < KEYSETS; ++set) {
+    for (size_t ni = 0; ni < ART_COUNT(art_dims); ++ni) {
+      size_t n = (size_t) art_dims[ni];
+      // the keys, their text and the three stores
+      if (!bench_fits(n, (uint64_t) n * ((set == KEYS_URL) ? 320 : 160))) {
+        continue;
+      }
+      bench_key_t *keys = (bench_key_t *) malloc(n * sizeof(bench_key_t));
+      char *text = NULL;
+      if (keys == NULL || !make_keys((keyset_t) set, keys, n, &text)) {
+        fprintf(stderr, "art_bench: out of memory at n = %zu\n", n);
+        return 1;
+      }
+      size_t queries = (n + 63) / 64;
+
+      // the stores queried by lookup and scan
+      art_t *art = art_new_typed(uint64_t);
+      btree_t *tree = btree_new_typed(uint64_t);
+      uint64_t *map = NULL;
+      hash_init_with(map, NULL);
+      for (size_t i = 0; i < n; ++i) {
+        uint64_t value = i;
+        art_put(art, keys[i].bytes, keys[i].len, &value);
+        btree_put(tree, keys[i].id, &value);
+        hash_put(map, keys[i].id, value);
+      }
+
+      for (int op = 0; op < OPS; ++op) {
+        uint64_t ops = (op == OP_SCAN) ? queries : n;
+        double art_ns = 0.0;
+        for (int store = 0; store < STORES; ++store) {
+          if (!applies((keyset_t) set, (op_t) op, (store_t) store)) {
+            continue;
+          }
+          char row_keys[128];
+          snprintf(row_keys, sizeof(row_keys), "%-6s %-9s %-9s %10zu", op_names[op], keyset_names[set],
+                   store_names[store], n);
+          if (!bench_selected(row_keys)) {
+            continue;
+          }
+          bench_timer_t timer;
+          bench_timer_init(&timer);
+          uint64_t visited = 0;
+          while (bench_more(&timer, ops)) {
+            uint64_t sum = 0;
+            if (op == OP_INSERT) {
+              if (store == STORE_ART || store == STORE_ART_ARENA) {
+                art_t *fresh = art_new_with(sizeof(uint64_t), (store == STORE_ART) ? NULL : arena_allocator(&arena));
+                bench_start(&timer);
+                for (size_t i = 0; i < n; ++i) {
+                  art_put(fresh, keys[i].bytes, keys[i].len, &i);
+                }
+                bench_stop(&timer);
+                sum += art_size(fresh);
+                if (store == STORE_ART) {
+                  art_free(fresh);
+                } else {
+                  arena_reset(&arena);
+                }
+              } else if (store == STORE_HASH) {
+                uint64_t *fresh = NULL;
+                hash_init_with(fresh, NULL);
+                bench_start(&timer);
+                for (size_t i = 0; i < n; ++i) {
+                  hash_put(fresh, hash_key((keyset_t) set, &keys[i]), i);
+                }
+                bench_stop(&timer);
+                sum += hash_size(fresh);
+                hash_free(fresh);
+              } else {
+                btree_t *fresh = btree_new_typed(uint64_t);
+                bench_start(&timer);
+                for (size_t i = 0; i < n; ++i) {
+                  btree_put(fresh, keys[i].id, &i);
+                }
+                bench_stop(&timer);
+                sum += btree_size(fresh);
+                btree_free(fresh);
+              }
+            } else if (op == OP_LOOKUP) {
+              // the keys in reverse order of insertion
+              bench_start(&timer);
+              for (size_t i = n; i-- > 0;) {
+                if (store == STORE_ART) {
+                  sum += *(const uint64_t *) art_get(art, keys[i].bytes, keys[i].len);
+                } else if (store == STORE_HASH) {
+                  sum += *(const uint64_t *) hash_get(map, hash_key((keyset_t) set, &keys[i]));
+                } else {
+                  sum += *(const uint64_t *) btree_get(tree, keys[i].id);
+                }
+              }
+              bench_stop(&timer);
+            } else {
+              visited = 0;
+              bench_start(&timer);
+              for (size_t q = 0; q < queries; ++q) {
+                const bench_key_t *key = &keys[q];
+                if (store == STORE_ART) {
+                  size_t len = (set == KEYS_URL) ? host_len(key) : 7;
+                  visited += art_prefix(art, key->bytes, len, count_visit, &sum);
+                } else {
+                  uint64_t lo = key->id & ~(uint64_t) 0xFF;
+                  btree_iter_t it = btree_seek(tree, lo);
+                  uint64_t id;
+                  void *value;
+                  while (btree_next(&it, &id, &value) && id <= (lo | 0xFF)) {
+                    sum += *(const uint64_t *) value;
+                    ++visited;
+                  }
+                }
+              }
+              bench_stop(&timer);
+            }
+            checksum += sum;
+          }
+          double ns = bench_ns_per(&timer, ops);
+          if (store == STORE_ART) {
+            art_ns = ns;
+          }
+          char extra[64];
+          if (op == OP_SCAN) {
+            snprintf(extra, sizeof(extra), "%10.2f %10.1f", (art_ns > 0.0) ? ns / art_ns : 1.0,
+                     (double) visited / (double) queries);
+          } else {
+            snprintf(extra, sizeof(extra), "%10.2f %10s", (art_ns > 0.0) ? ns / art_ns : 1.0, "-");
+          }
+          bench_row(row_keys, &timer, ops, extra);
+        }
+      }
+      art_free(art);
+      btree_free(tree);
+      hash_free(map);
+      free(text);
+      free(keys);
+    }
+  }
+  arena_free(&arena);
+  // keeps the operations from being optimized away
+  fprintf(stderr, "# checksum %llu\n", (unsigned long long) checksum);
+  return 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,303 @@
+/* bench.h - Shared helpers of the chibilibs benchmarks
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Every benchmark prints a single table: a header line with the configuration, a line with the
+ * column names, then one row per measured case. The inputs come from fixed seeds and the set of
+ * rows depends only on the configuration, so the outputs of two commits can be compared row by
+ * row: the time columns change with the machine, the counted columns (comparisons, moves, memory)
+ * change only with the code.
+ *
+ * - bench_init parses the options shared by all the benchmarks:
+ *     --max-n N      largest input size (default BENCH_DEFAULT_MAX_N)
+ *     --max-bytes B  largest working set in bytes (default BENCH_DEFAULT_MAX_BYTES)
+ *     --full         the whole matrix: --max-n 100000000 --max-bytes 4294967296
+ *     --reps R       repetitions of every measure (default: as many as fit BENCH_REP_BUDGET
+ *                    and BENCH_TIME_BUDGET)
+ *     --filter S     only the rows whose key columns contain S
+ * - a timer keeps the best of the repetitions of a measure: the minimum is the least noisy
+ *   estimate of the cost of code that does not depend on the repetition.
+ * - the timer also reads the hardware counters of perfctr.h around every repetition: every row
+ *   ends with the instructions per cycle and the branch, L1d and LLC misses per operation,
+ *   averaged over the repetitions, or "-" where a counter is unavailable.
+ * - bench_fill_u64 generates the input distributions shared by the sorting benchmarks.
+ */
+
+#ifndef CHIBI_BENCH_H
+#define CHIBI_BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "perfctr.h"
+#include "prof.h"
+
+/* Largest input size of a default run */
+#define BENCH_DEFAULT_MAX_N ((uint64_t) 1 << 16)
+
+/* Largest working set of a default run, in bytes */
+#define BENCH_DEFAULT_MAX_BYTES ((uint64_t) 1 << 30)
+
+/* Elements processed by the repetitions of a measure, when --reps is not given */
+#define BENCH_REP_BUDGET ((uint64_t) 1 << 20)
+
+/* Bounds of the number of repetitions of a measure */
+#define BENCH_MIN_REPS 3
+#define BENCH_MAX_REPS 1000
+
+/* Time after which a measure stops repeating, once it has BENCH_MIN_REPS repetitions, in seconds */
+#define BENCH_TIME_BUDGET 0.1
+
+typedef struct bench_config_t {
+  uint64_t max_n;
+  uint64_t max_bytes;
+  int reps;            // 0 selects the repetitions from the size of the input
+  const char *filter;  // NULL for all the rows
+} bench_config_t;
+
+static bench_config_t bench_cfg = {BENCH_DEFAULT_MAX_N, BENCH_DEFAULT_MAX_BYTES, 0, NULL};
+
+// Hardware counters of the benchmark thread, opened by bench_init
+static perfctr_t bench_pc;
+
+/* Counters printed in every row, after the benchmark specific columns */
+static const perfctr_event_t bench_events[] = {PERFCTR_BRANCH_MISSES, PERFCTR_L1D_MISSES, PERFCTR_LLC_MISSES};
+#define BENCH_EVENTS 3
+
+/* Parses the command line and prints the header line of the table ("# name: configuration").
+ */
+static inline void bench_init(const char *name, int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (strcmp(arg, "--full") == 0) {
+      bench_cfg.max_n = 100000000;
+      bench_cfg.max_bytes = (uint64_t) 1 << 32;
+    } else if (strcmp(arg, "--max-n") == 0 && next != NULL) {
+      bench_cfg.max_n = strtoull(next, NULL, 10);
+      ++i;
+    } else if (strcmp(arg, "--max-bytes") == 0 && next != NULL) {
+      bench_cfg.max_bytes = strtoull(next, NULL, 10);
+      ++i;
+    } else if (strcmp(arg, "--reps") == 0 && next != NULL) {
+      bench_cfg.reps = atoi(next);
+      ++i;
+    } else if (strcmp(arg, "--filter") == 0 && next != NULL) {
+      bench_cfg.filter = next;
+      ++i;
+    } else {
+      fprintf(stderr, "usage: %s [--full] [--max-n N] [--max-bytes B] [--reps R] [--filter S]\n", argv[0]);
+      exit(2);
+    }
+  }
+  int counters = perfctr_open(&bench_pc);
+  printf("# %s: max-n %llu, max-bytes %llu, reps %d, hardware counters %d/%d\n", name,
+         (unsigned long long) bench_cfg.max_n, (unsigned long long) bench_cfg.max_bytes, bench_cfg.reps,
+         counters, (int) PERFCTR_EVENTS);
+}
+
+/* Returns true if a case of 'n' elements and 'bytes' bytes of working set fits the configuration.
+ */
+static inline bool bench_fits(uint64_t n, uint64_t bytes) {
+  return n <= bench_cfg.max_n && bytes <= bench_cfg.max_bytes;
+}
+
+/* Returns true if the row with the given key columns passes the filter.
+ */
+static inline bool bench_selected(const char *keys) {
+  return bench_cfg.filter == NULL || strstr(keys, bench_cfg.filter) != NULL;
+}
+
+/* Returns the number of repetitions of a measure over 'n' elements.
+ */
+static inline int bench_reps(uint64_t n) {
+  if (bench_cfg.reps > 0) {
+    return bench_cfg.reps;
+  }
+  uint64_t reps = BENCH_REP_BUDGET / (n > 0 ? n : 1);
+  if (reps < BENCH_MIN_REPS) {
+    reps = BENCH_MIN_REPS;
+  }
+  return (reps > BENCH_MAX_REPS) ? BENCH_MAX_REPS : (int) reps;
+}
+
+/* Timer: best time of the repetitions of a measure */
+typedef struct bench_timer_t {
+  prof_ticks_t start;
+  prof_ticks_t best;
+  prof_ticks_t total;                 // time of all the repetitions so far
+  int reps;                           // repetitions so far
+  uint64_t counts[PERFCTR_EVENTS];    // hardware counters of all the repetitions so far
+} bench_timer_t;
+
+static inline void bench_timer_init(bench_timer_t *t) {
+  t->best = UINT64_MAX;
+  t->total = 0;
+  t->reps = 0;
+  memset(t->counts, 0, sizeof(t->counts));
+}
+
+/* Returns true if a measure over 'n' elements needs another repetition: until bench_reps(n)
+ * repetitions, or BENCH_MIN_REPS once the repetitions took BENCH_TIME_BUDGET (without --reps).
+ */
+static inline bool bench_more(const bench_timer_t *t, uint64_t n) {
+  if (t->reps >= bench_reps(n)) {
+    return false;
+  }
+  return bench_cfg.reps > 0 || t->reps < BENCH_MIN_REPS || prof_seconds(t->total) < BENCH_TIME_BUDGET;
+}
+
+static inline void bench_start(bench_timer_t *t) {
+  perfctr_start(&bench_pc);
+  t->start = prof_ticks();
+}
+
+static inline void bench_stop(bench_timer_t *t) {
+  prof_ticks_t elapsed = prof_ticks_end() - t->start;
+  perfctr_stop(&bench_pc);
+  t->total += elapsed;
+  ++t->reps;
+  if (elapsed < t->best) {
+    t->best = elapsed;
+  }
+  for (int e = 0; e < PERFCTR_EVENTS; ++e) {
+    t->counts[e] += perfctr_value(&bench_pc, (perfctr_event_t) e);
+  }
+}
+
+/* Returns the best time in nanoseconds divided by 'n' (the operations of the measure).
+ */
+static inline double bench_ns_per(const bench_timer_t *t, uint64_t n) {
+  return prof_seconds(t->best) * 1e9 / (double)(n > 0 ? n : 1);
+}
+
+/* Prints the line with the column names: the key columns of the benchmark, the time per
+ * operation, the benchmark specific columns, then the hardware counters.
+ */
+static inline void bench_header(const char *keys, const char *extra) {
+  printf("%s %10s %s %6s", keys, "ns/op", extra, "IPC");
+  for (int i = 0; i < BENCH_EVENTS; ++i) {
+    char name[32];
+    snprintf(name, sizeof(name), "%s/op", perfctr_name(bench_events[i]));
+    printf(" %18s", name);
+  }
+  printf("\n");
+}
+
+/* Prints a row. 'keys' and 'extra' are formatted by the caller with the widths of the header.
+ */
+static inline void bench_row(const char *keys, const bench_timer_t *t, uint64_t n, const char *extra) {
+  printf("%s %10.2f %s", keys, bench_ns_per(t, n), extra);
+  if (t->counts[PERFCTR_CYCLES] > 0 && perfctr_available(&bench_pc, PERFCTR_INSTRUCTIONS)) {
+    printf(" %6.2f", (double) t->counts[PERFCTR_INSTRUCTIONS] / (double) t->counts[PERFCTR_CYCLES]);
+  } else {
+    printf(" %6s", "-");
+  }
+  double ops = (double)(n > 0 ? n : 1) * (double)(t->reps > 0 ? t->reps : 1);
+  for (int i = 0; i < BENCH_EVENTS; ++i) {
+    if (perfctr_available(&bench_pc, bench_events[i])) {
+      printf(" %18.4f", (double) t->counts[bench_events[i]] / ops);
+    } else {
+      printf(" %18s", "-");
+    }
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+/* Random numbers: splitmix64 */
+static inline uint64_t bench_rand(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/* Input distributions */
+typedef enum bench_dist_t {
+  BENCH_RANDOM,      // uniform over the whole key range
+  BENCH_SORTED,      // increasing
+  BENCH_REVERSE,     // decreasing
+  BENCH_FEW_UNIQUE,  // 16 distinct keys
+  BENCH_ORGAN_PIPE,  // increasing then decreasing
+  BENCH_SAWTOOTH,    // 8 increasing runs
+  BENCH_ZIPF,        // Zipfian ranks (s = 1) over n values, in random order
+  BENCH_DISTS
+} bench_dist_t;
+
+static inline const char *bench_dist_name(bench_dist_t dist) {
+  static const char *names[BENCH_DISTS] = {
+    "random", "sorted", "reverse", "few-unique", "organ-pipe", "sawtooth", "zipf"
+  };
+  return names[dist];
+}
+
+/* Fills 'keys' with 'n' keys of a distribution, below 2^bits (bits <= 64).
+ */
+static inline void bench_fill_u64(uint64_t *keys, size_t n, bench_dist_t dist, unsigned bits, uint64_t seed) {
+  uint64_t state = seed;
+  uint64_t mask = (bits >= 64) ? UINT64_MAX : (((uint64_t) 1 << bits) - 1);
+  size_t tooth = (n + 7) / 8;
+  double log_n = log((double) n + 1.0);
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t key;
+    switch (dist) {
+      case BENCH_SORTED:
+        key = i;
+        break;
+      case BENCH_REVERSE:
+        key = n - i;
+        break;
+      case BENCH_FEW_UNIQUE:
+        key = bench_rand(&state) % 16;
+        break;
+      case BENCH_ORGAN_PIPE:
+        key = (i < n / 2) ? i : n - i;
+        break;
+      case BENCH_SAWTOOTH:
+        key = i % tooth;
+        break;
+      case BENCH_ZIPF: {
+        // inverse of the continuous approximation of the Zipf CDF, ln(k + 1) / ln(n + 1)
+        double u = (double)(bench_rand(&state) >> 11) * (1.0 / 9007199254740992.0);
+        key = (uint64_t) exp(u * log_n) - 1;
+        break;
+      }
+      default:
+        key = bench_rand(&state);
+        break;
+    }
+    keys[i] = key & mask;
+  }
+}
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,303 @@
+/* btree_bench.c - Ordered map of btree.h versus a sorted vector and hash.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * The same n random uint64_t keys (with uint64_t values) are stored in a B+tree (btree.h), in a
+ * sorted vector searched with binary search, and in a hash map (hash.h), which has no order. The
+ * operations:
+ *
+ *   insert  n inserts in random order, one at a time (the sorted vector moves the tail of the
+ *           vector at every insert, so it only runs up to BTREE_BENCH_VECTOR_INSERT_MAX keys)
+ *   load    build from the n unsorted pairs: btree_load on the heap and on an arena, s_sort_u64
+ *           for the vector, n puts into a map reserved in advance
+ *   lookup  n lookups of present keys in random order
+ *   scan    n / 64 range queries, each reading the 64 keys following a random key (hash.h has
+ *           no order and is skipped)
+ *
+ * Columns: time per key (per key read for scan), then the time relative to the btree row of the
+ * same operation and n.
+ */
+
+#include "bench.h"
+#include "btree.h"
+#include "arena.h"
+#include "hash.h"
+#include "sorting.h"
+
+/* Largest input of the inserts into the sorted vector, which are quadratic */
+#define BTREE_BENCH_VECTOR_INSERT_MAX 65536
+
+/* Keys read by a range query */
+#define BTREE_BENCH_SCAN 64
+
+typedef enum op_t { OP_INSERT, OP_LOAD, OP_LOOKUP, OP_SCAN, OPS } op_t;
+typedef enum store_t { STORE_BTREE, STORE_BTREE_ARENA, STORE_VECTOR, STORE_HASH, STORES } store_t;
+
+static const char *op_names[OPS] = {"insert", "load", "lookup", "scan"};
+static const char *store_names[STORES] = {"btree", "btree-arena", "vector", "hash"};
+static const uint64_t btree_dims[] = {256, 4096, 65536, 1 << 20, 1 << 24};
+
+#define BTREE_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+// Index of the first key of a sorted vector not smaller than 'key'
+static size_t lower_bound(const uint64_t *keys, size_t n, uint64_t key) {
+  size_t lo = 0;
+  while (n > 0) {
+    size_t half = n / 2;
+    if (keys[lo + half] < key) {
+      lo += half + 1;
+      n -= half + 1;
+    } else {
+      n = half;
+    }
+  }
+  return lo;
+}
+
+static bool applies(op_t op, store_t store, size_t n) {
+  if (store == STORE_BTREE_ARENA) {
+    return op == OP_LOAD;
+  }
+  if (store == STORE_HASH) {
+    return op != OP_SCAN;
+  }
+  return !(store == STORE_VECTOR && op == OP_INSERT && n > BTREE_BENCH_VECTOR_INSERT_MAX);
+}
+
+typedef struct stores_t {
+  btree_t *tree;
+  uint64_t *sorted;  // keys of the vector
+  uint64_t *map;     // hash map from the keys to the values
+} stores_t;
+
+int main(int argc, char **argv) {
+  bench_init("btree_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-6s %-11s %10s", "op", "store", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s", "vs btree");
+  bench_header(keys_header, extra_header);
+
+  arena_t arena;
+  arena_init(&arena, 0);
+  uint64_t checksum = 0;
+  for (size_t ni = 0; ni < BTREE_COUNT(btree_dims); ++ni) {
+    size_t n = (size_t) btree_dims[ni];
+    // keys, values, their copies for the loads, the queries and the containers
+    if (!bench_fits(n, 12 * (uint64_t) n * sizeof(uint64_t))) {
+      continue;
+    }
+    uint64_t *keys = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *vals = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *work_keys = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *work_vals = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *queries = (uint64_t *) malloc(n * sizeof(uint64_t));
+    if (keys == NULL || vals == NULL || work_keys == NULL || work_vals == NULL || queries == NULL) {
+      fprintf(stderr, "btree_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    uint64_t state = 83 + n;
+    for (size_t i = 0; i < n; ++i) {
+      keys[i] = bench_rand(&state);
+      vals[i] = i;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      queries[i] = keys[bench_rand(&state) % n];
+    }
+
+    // the containers queried by lookup and scan
+    stores_t stores;
+    memcpy(work_keys, keys, n * sizeof(uint64_t));
+    memcpy(work_vals, vals, n * sizeof(uint64_t));
+    stores.tree = btree_load(sizeof(uint64_t), work_keys, work_vals, n);
+    stores.sorted = (uint64_t *) malloc(n * sizeof(uint64_t));
+    stores.map = NULL;
+    hash_init_with(stores.map, NULL);
+    hash_reserve(stores.map, n);
+    if (stores.tree == NULL || stores.sorted == NULL || stores.map == NULL) {
+      fprintf(stderr, "btree_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    memcpy(stores.sorted, keys, n * sizeof(uint64_t));
+    s_sort_u64(stores.sorted, n);
+    for (size_t i = 0; i < n; ++i) {
+      hash_put(stores.map, keys[i], vals[i]);
+    }
+
+    for (int op = 0; op < OPS; ++op) {
+      uint64_t ops = (op == OP_SCAN) ? n / BTREE_BENCH_SCAN * BTREE_BENCH_SCAN : n;
+      double btree_ns = 0.0;
+      for (int store = 0; store < STORES; ++store) {
+        if (!applies((op_t) op, (store_t) store, n)) {
+          continue;
+        }
+        char row_keys[128];
+        snprintf(row_keys, sizeof(row_keys), "%-6s %-11s %10zu", op_names[op], store_names[store], n);
+        if (!bench_selected(row_keys)) {
+          continue;
+        }
+        bench_timer_t timer;
+        bench_timer_init(&timer);
+        while (bench_more(&timer, ops)) {
+          switch ((op_t) op) {
+            case OP_INSERT: {
+              if (store == STORE_BTREE) {
+                btree_t *tree = btree_new(sizeof(uint64_t));
+                bench_start(&timer);
+                for (size_t i = 0; i < n; ++i) {
+                  btree_put(tree, keys[i], &vals[i]);
+                }
+                bench_stop(&timer);
+                checksum += btree_size(tree);
+                btree_free(tree);
+              } else if (store == STORE_VECTOR) {
+                size_t size = 0;
+                bench_start(&timer);
+                for (size_t i = 0; i < n; ++i) {
+                  size_t pos = lower_bound(work_keys, size, keys[i]);
+                  memmove(work_keys + pos + 1, work_keys + pos, (size - pos) * sizeof(uint64_t));
+                  memmove(work_vals + pos + 1, work_vals + pos, (size - pos) * sizeof(uint64_t));
+                  work_keys[pos] = keys[i];
+                  work_vals[pos] = vals[i];
+                  ++size;
+                }
+                bench_stop(&timer);
+                checksum += work_keys[0];
+              } else {
+                uint64_t *map = NULL;
+                hash_init_with(map, NULL);
+                bench_start(&timer);
+                for (size_t i = 0; i < n; ++i) {
+                  hash_put(map, keys[i], vals[i]);
+                }
+                bench_stop(&timer);
+                checksum += hash_size(map);
+                hash_free(map);
+              }
+              break;
+            }
+            case OP_LOAD: {
+              memcpy(work_keys, keys, n * sizeof(uint64_t));
+              memcpy(work_vals, vals, n * sizeof(uint64_t));
+              if (store == STORE_BTREE || store == STORE_BTREE_ARENA) {
+                const chibi_allocator_t *allocator = (store == STORE_BTREE) ? NULL : arena_allocator(&arena);
+                bench_start(&timer);
+                btree_t *tree = btree_load_with(sizeof(uint64_t), work_keys, work_vals, n, allocator);
+                bench_stop(&timer);
+                checksum += btree_size(tree);
+                if (store == STORE_BTREE) {
+                  btree_free(tree);
+                } else {
+                  arena_reset(&arena);
+                }
+              } else if (store == STORE_VECTOR) {
+                bench_start(&timer);
+                s_radix_by_key_u64(work_keys, n, 1, work_vals, sizeof(uint64_t));
+                bench_stop(&timer);
+                checksum += work_keys[0];
+              } else {
+                uint64_t *map = NULL;
+                hash_init_with(map, NULL);
+                bench_start(&timer);
+                hash_reserve(map, n);
+                for (size_t i = 0; i < n; ++i) {
+                  hash_put(map, work_keys[i], work_vals[i]);
+                }
+                bench_stop(&timer);
+                checksum += hash_size(map);
+                hash_free(map);
+              }
+              break;
+            }
+            case OP_LOOKUP: {
+              uint64_t sum = 0;
+              bench_start(&timer);
+              if (store == STORE_BTREE) {
+                for (size_t i = 0; i < n; ++i) {
+                  sum += *(const uint64_t *) btree_get(stores.tree, queries[i]);
+                }
+              } else if (store == STORE_VECTOR) {
+                for (size_t i = 0; i < n; ++i) {
+                  sum += lower_bound(stores.sorted, n, queries[i]);
+                }
+              } else {
+                for (size_t i = 0; i < n; ++i) {
+                  sum += *(const uint64_t *) hash_get(stores.map, queries[i]);
+                }
+              }
+              bench_stop(&timer);
+              checksum += sum;
+              break;
+            }
+            default: {
+              uint64_t sum = 0;
+              bench_start(&timer);
+              for (size_t q = 0; q < ops / BTREE_BENCH_SCAN; ++q) {
+                if (store == STORE_BTREE) {
+                  btree_iter_t it = btree_seek(stores.tree, queries[q]);
+                  uint64_t key;
+                  for (int k = 0; k < BTREE_BENCH_SCAN && btree_next(&it, &key, NULL); ++k) {
+                    sum += key;
+                  }
+                } else {
+                  size_t pos = lower_bound(stores.sorted, n, queries[q]);
+                  for (size_t k = pos; k < pos + BTREE_BENCH_SCAN && k < n; ++k) {
+                    sum += stores.sorted[k];
+                  }
+                }
+              }
+              bench_stop(&timer);
+              checksum += sum;
+              break;
+            }
+          }
+        }
+        double ns = bench_ns_per(&timer, ops);
+        char extra[64];
+        if (store == STORE_BTREE) {
+          btree_ns = ns;
+        }
+        snprintf(extra, sizeof(extra), "%10.2f", (btree_ns > 0.0) ? ns / btree_ns : 1.0);
+        bench_row(row_keys, &timer, ops, extra);
+      }
+    }
+    btree_free(stores.tree);
+    free(stores.sorted);
+    hash_free(stores.map);
+    free(queries);
+    free(work_vals);
+    free(work_keys);
+    free(vals);
+    free(keys);
+  }
+  arena_free(&arena);
+  // keeps the operations from being optimized away
+  fprintf(stderr, "# checksum %llu\n", (unsigned long long) checksum);
+  return 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,380 @@
+/* counting_bench.c - Counting sort of sorting.h on small-range keys
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * n keys uniform over a small range (2, 16, 256, 4096 and 65536 values, starting at 1000 so
+ * that the minimum has to be detected), in two layouts:
+ *
+ *   keys     plain uint32_t keys: qsort (the baseline), pdq, s_sort_u32 (the adaptive sort,
+ *            which picks counting sort by itself on a small range), s_radix_u32 and
+ *            s_counting_u32; the key_range row times s_key_range_u32 alone, the detection every
+ *            one of them pays
+ *   records  16-byte records with a uint32_t key and a payload that must follow it: qsort,
+ *            s_sort and s_merge (the stable generic sort) through an ordering function, and
+ *            s_counting (stable) through a key function
+ *
+ * sorting.h has no quicksort of keys or records, so the pdq row is a pdqsort-style unstable
+ * introsort of the keys, written here: it is the comparison sort a counting sort has to beat on
+ * few distinct keys, since its equal-key partition also skips the runs of equal keys.
+ *
+ * Columns: time per element and the time relative to the qsort row of the same case.
+ *
+ * Every output is checked, and the benchmark exits with status 1 if one is not sorted (or, for
+ * the stable sorts, not stable).
+ */
+
+#include "bench.h"
+#include "sorting.h"
+
+/* Smallest key */
+#define COUNTING_BENCH_BASE 1000
+
+typedef enum layout_t { LAYOUT_KEYS, LAYOUT_RECORDS, LAYOUTS } layout_t;
+typedef enum algo_t {
+  ALGO_QSORT,
+  ALGO_PDQ,
+  ALGO_SORT,
+  ALGO_RADIX,
+  ALGO_COUNTING,
+  ALGO_KEY_RANGE,
+  ALGO_MERGE,
+  ALGOS
+} algo_t;
+
+// A record: the key and the position of the record in the input, the payload
+typedef struct record_t {
+  uint32_t key;
+  uint32_t pad;
+  uint64_t pos;
+} record_t;
+
+static const char *layout_names[LAYOUTS] = {"keys", "records"};
+static const char *algo_names[ALGOS] = {"qsort", "pdq", "s_sort", "s_radix", "s_counting", "key_range", "s_merge"};
+static const uint64_t counting_dims[] = {4096, 65536, 1 << 20, 1 << 24};
+static const size_t counting_ranges[] = {2, 16, 256, 4096, 65536};
+
+#define COUNTING_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static int cmp_u32(const void *lhs, const void *rhs) {
+  uint32_t a = *(const uint32_t *) lhs;
+  uint32_t b = *(const uint32_t *) rhs;
+  return (a > b) - (a < b);
+}
+
+// Orders by key then position: qsort is not stable, the position makes it give the stable order
+static int cmp_record(const void *lhs, const void *rhs) {
+  const record_t *a = (const record_t *) lhs;
+  const record_t *b = (const record_t *) rhs;
+  if (a->key != b->key) {
+    return (a->key > b->key) - (a->key < b->key);
+  }
+  return (a->pos > b->pos) - (a->pos < b->pos);
+}
+
+/* pdqsort-style introsort of uint32_t keys: median of three pivots, insertion sort below
+ * PDQ_INSERTION keys, heap sort past 2 log2(n) levels of recursion, and the equal-key partition of
+ * pdqsort. A range whose pivot equals the key just before it holds no smaller key, so it is split
+ * into the keys equal to the pivot, which are in place, and the greater ones.
+ */
+#define PDQ_INSERTION 24
+
+static void pdq_swap(uint32_t *a, uint32_t *b) {
+  uint32_t temp = *a;
+  *a = *b;
+  *b = temp;
+}
+
+static void pdq_insertion(uint32_t *keys, size_t n) {
+  for (size_t i = 1; i < n; ++i) {
+    uint32_t key = keys[i];
+    size_t j = i;
+    for (; j > 0 && keys[j - 1] > key; --j) {
+      keys[j] = keys[j - 1];
+    }
+    keys[j] = key;
+  }
+}
+
+static void pdq_sift_down(uint32_t *keys, size_t root, size_t n) {
+  uint32_t key = keys[root];
+  for (size_t child = 2 * root + 1; child < n; child = 2 * root + 1) {
+    if (child + 1 < n && keys[child] < keys[child + 1]) {
+      ++child;
+    }
+    if (keys[child] <= key) {
+      break;
+    }
+    keys[root] = keys[child];
+    root = child;
+  }
+  keys[root] = key;
+}
+
+static void pdq_heap(uint32_t *keys, size_t n) {
+  for (size_t i = n / 2; i-- > 0;) {
+    pdq_sift_down(keys, i, n);
+  }
+  for (size_t end = n - 1; end > 0; --end) {
+    pdq_swap(&keys[0], &keys[end]);
+    pdq_sift_down(keys, 0, end);
+  }
+}
+
+// Sorts keys[0, n); if 'bounded', keys[-1] is not greater than any key of the range
+static void pdq_loop(uint32_t *keys, size_t n, int depth, bool bounded) {
+  while (n > PDQ_INSERTION) {
+    if (depth-- == 0) {
+      pdq_heap(keys, n);
+      return;
+    }
+    // median of the first, middle and last key, moved to keys[0]
+    size_t mid = n / 2;
+    if (keys[mid] < keys[0]) {
+      pdq_swap(&keys[mid], &keys[0]);
+    }
+    if (keys[n - 1] < keys[mid]) {
+      pdq_swap(&keys[n - 1], &keys[mid]);
+      if (keys[mid] < keys[0]) {
+        pdq_swap(&keys[mid], &keys[0]);
+      }
+    }
+    pdq_swap(&keys[0], &keys[mid]);
+    uint32_t pivot = keys[0];
+
+    size_t i = 0;
+    size_t j = n;
+    if (bounded && keys[-1] == pivot) {
+      // keys[0, j] end up equal to the pivot, keys(j, n) greater
+      for (;;) {
+        do {
+          --j;
+        } while (pivot < keys[j]);
+        do {
+          ++i;
+        } while (i < j && !(pivot < keys[i]));
+        if (i >= j) {
+          break;
+        }
+        pdq_swap(&keys[i], &keys[j]);
+      }
+      keys += j + 1;
+      n -= j + 1;
+      continue;
+    }
+
+    // keys[0, j) not greater than the pivot, keys[j] the pivot, keys(j, n) not smaller
+    for (;;) {
+      do {
+        ++i;
+      } while (i < n && keys[i] < pivot);
+      do {
+        --j;
+      } while (pivot < keys[j]);
+      if (i >= j) {
+        break;
+      }
+      pdq_swap(&keys[i], &keys[j]);
+    }
+    pdq_swap(&keys[0], &keys[j]);
+    // recursion on the smaller side, loop on the larger one
+    if (j < n - j - 1) {
+      pdq_loop(keys, j, depth, bounded);
+      keys += j + 1;
+      n -= j + 1;
+      bounded = true;
+    } else {
+      pdq_loop(keys + j + 1, n - j - 1, depth, true);
+      n = j;
+    }
+  }
+  pdq_insertion(keys, n);
+}
+
+static void pdq_sort(uint32_t *keys, size_t n) {
+  int depth = 0;
+  for (size_t m = n; m > 1; m >>= 1) {
+    depth += 2;
+  }
+  pdq_loop(keys, n, depth, false);
+}
+
+static bool less_record(const void *lhs, const void *rhs) {
+  return ((const record_t *) lhs)->key < ((const record_t *) rhs)->key;
+}
+
+static size_t record_key(const void *elem) {
+  return ((const record_t *) elem)->key - COUNTING_BENCH_BASE;
+}
+
+static bool applies(layout_t layout, algo_t algo) {
+  if (layout == LAYOUT_KEYS) {
+    return algo != ALGO_MERGE;
+  }
+  return algo != ALGO_PDQ && algo != ALGO_RADIX && algo != ALGO_KEY_RANGE;
+}
+
+int main(int argc, char **argv) {
+  bench_init("counting_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-10s %-7s %6s %10s", "algorithm", "layout", "range", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s", "vs qsort");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  for (size_t ni = 0; ni < COUNTING_COUNT(counting_dims); ++ni) {
+    size_t n = (size_t) counting_dims[ni];
+    // the input and the work copy of the records, and the temporary buffers of the sorts
+    if (!bench_fits(n, (uint64_t) n * 4 * sizeof(record_t))) {
+      continue;
+    }
+    uint32_t *keys = (uint32_t *) malloc(n * sizeof(uint32_t));
+    uint32_t *work = (uint32_t *) malloc(n * sizeof(uint32_t));
+    record_t *records = (record_t *) malloc(n * sizeof(record_t));
+    record_t *rwork = (record_t *) malloc(n * sizeof(record_t));
+    if (keys == NULL || work == NULL || records == NULL || rwork == NULL) {
+      fprintf(stderr, "counting_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    for (size_t ri = 0; ri < COUNTING_COUNT(counting_ranges); ++ri) {
+      size_t range = counting_ranges[ri];
+      uint64_t state = 97 + n + range;
+      for (size_t i = 0; i < n; ++i) {
+        keys[i] = COUNTING_BENCH_BASE + (uint32_t)(bench_rand(&state) % range);
+        records[i].key = keys[i];
+        records[i].pad = 0;
+        records[i].pos = i;
+      }
+
+      for (int layout = 0; layout < LAYOUTS; ++layout) {
+        double qsort_ns = 0.0;
+        for (int algo = 0; algo < ALGOS; ++algo) {
+          if (!applies((layout_t) layout, (algo_t) algo)) {
+            continue;
+          }
+          char row_keys[128];
+          snprintf(row_keys, sizeof(row_keys), "%-10s %-7s %6zu %10zu", algo_names[algo], layout_names[layout],
+                   range, n);
+          if (!bench_selected(row_keys)) {
+            continue;
+          }
+          bench_timer_t timer;
+          bench_timer_init(&timer);
+          bool ok = true;
+          for (int r = 0; ok && bench_more(&timer, n); ++r) {
+            int64_t result = (int64_t) n;
+            if (layout == LAYOUT_KEYS) {
+              memcpy(work, keys, n * sizeof(uint32_t));
+              bench_start(&timer);
+              switch ((algo_t) algo) {
+                case ALGO_QSORT:
+                  qsort(work, n, sizeof(uint32_t), cmp_u32);
+                  break;
+                case ALGO_PDQ:
+                  pdq_sort(work, n);
+                  break;
+                case ALGO_SORT:
+                  result = s_sort_u32(work, n);
+                  break;
+                case ALGO_RADIX:
+                  result = s_radix_u32(work, n);
+                  break;
+                case ALGO_COUNTING:
+                  result = s_counting_u32(work, n);
+                  break;
+                default: {
+                  uint32_t min = 0, max = 0;
+                  s_key_range_u32(work, n, &min, &max);
+                  result = (min >= COUNTING_BENCH_BASE && max - min < range) ? (int64_t) n : -1;
+                  break;
+                }
+              }
+              bench_stop(&timer);
+              if (r == 0) {
+                ok = result == (int64_t) n;
+                for (size_t i = 1; ok && algo != ALGO_KEY_RANGE && i < n; ++i) {
+                  ok = work[i - 1] <= work[i];
+                }
+              }
+              checksum += work[n / 2];
+            } else {
+              memcpy(rwork, records, n * sizeof(record_t));
+              bench_start(&timer);
+              switch ((algo_t) algo) {
+                case ALGO_QSORT:
+                  qsort(rwork, n, sizeof(record_t), cmp_record);
+                  break;
+                case ALGO_SORT:
+                  result = s_sort(rwork, n, sizeof(record_t), less_record);
+                  break;
+                case ALGO_MERGE:
+                  result = s_merge(rwork, n, sizeof(record_t), less_record);
+                  break;
+                default:
+                  result = s_counting_typed(rwork, n, record_key, range);
+                  break;
+              }
+              bench_stop(&timer);
+              if (r == 0) {
+                // s_sort is not stable: only the keys must be in order
+                bool stable = algo != ALGO_SORT;
+                ok = result == (int64_t) n;
+                for (size_t i = 1; ok && i < n; ++i) {
+                  ok = rwork[i - 1].key < rwork[i].key ||
+                       (rwork[i - 1].key == rwork[i].key && (!stable || rwork[i - 1].pos < rwork[i].pos));
+                }
+              }
+              checksum += rwork[n / 2].pos;
+            }
+          }
+
+          double ns = bench_ns_per(&timer, n);
+          if (algo == ALGO_QSORT) {
+            qsort_ns = ns;
+          }
+          char extra[64];
+          if (!ok) {
+            snprintf(extra, sizeof(extra), "%10s", "FAILED");
+            failed = true;
+          } else {
+            snprintf(extra, sizeof(extra), "%10.2f", (qsort_ns > 0.0) ? ns / qsort_ns : 1.0);
+          }
+          bench_row(row_keys, &timer, n, extra);
+        }
+      }
+    }
+    free(rwork);
+    free(records);
+    free(work);
+    free(keys);
+  }
+  fprintf(stderr, "counting_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,236 @@
+/* cuckoo_bench.c - Lookup tail latency of cuckoo.h versus hash.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * n random uint64_t keys with a uint64_t value are inserted into a map of hash.h and of cuckoo.h,
+ * which then answer CUCKOO_BENCH_LOOKUPS lookups, every one timed on its own with prof_ticks and
+ * recorded into a histogram (hist.h). The cases:
+ *
+ *   hit / miss    lookups of keys in the map, or of random keys that are not in it
+ *   fresh         the maps right after the inserts
+ *   churn         then n / 4 times: a random key is deleted and a new one inserted. hash.h leaves a
+ *                 tombstone for every delete and a miss probes until it finds a free slot, so its
+ *                 misses get longer; cuckoo.h reuses the slot. (hash.h never removes tombstones:
+ *                 n / 4 replacements cannot fill the free slots left at a load of at most 75%)
+ *
+ * Columns: time per lookup and the time relative to the hash row of the same case, both including
+ * the cost of reading the time stamp counter twice, then the p50, p99, p99.9 and p99.99 latency
+ * in nanoseconds (same overhead included, within the 3% precision of the histogram), and the
+ * largest number of 16-slot groups (hash.h) or buckets and stash (cuckoo.h) read by one lookup.
+ *
+ * Every result is compared with the keys inserted, and the benchmark exits with status 1 if one
+ * differs.
+ */
+
+#include "bench.h"
+#include "cuckoo.h"
+#include "hash.h"
+#include "hist.h"
+
+/* Lookups per measure */
+#define CUCKOO_BENCH_LOOKUPS 65536
+
+typedef enum op_t { OP_HIT, OP_MISS, OPS } op_t;
+typedef enum state_t { STATE_FRESH, STATE_CHURN, STATES } state_t;
+typedef enum impl_t { IMPL_HASH, IMPL_CUCKOO, IMPLS } impl_t;
+
+static const char *op_names[OPS] = {"hit", "miss"};
+static const char *state_names[STATES] = {"fresh", "churn"};
+static const char *impl_names[IMPLS] = {"hash", "cuckoo"};
+static const uint64_t cuckoo_dims[] = {4096, 65536, 1 << 20, 1 << 24};
+
+#define CUCKOO_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static uint64_t value_of(uint64_t key) {
+  return key * 3 + 1;
+}
+
+// Groups read by a lookup of hash.h, following hash__get_idx
+static size_t hash_probes(uint64_t *map, uint64_t key) {
+  uint8_t *meta = hash__get_meta(map);
+  uint64_t *keys = hash__get_keys(map);
+  uint64_t hash = hash__hash(key);
+  size_t m = hash_capacity(map);
+  size_t i = (hash__hash57(hash) & ((m / 16) - 1)) * 16;
+  uint8_t tag = (uint8_t)(hash__hash7(hash) | 0x80);
+  for (size_t groups = 1;; ++groups) {
+    bool free_slot = false;
+    for (size_t s = 0; s < 16; ++s) {
+      if (meta[i + s] == tag && keys[i + s] == key) {
+        return groups;
+      }
+      free_slot = free_slot || meta[i + s] == HASH__FREE;
+    }
+    if (free_slot) {
+      return groups;
+    }
+    i = (i + 16) & (m - 1);
+  }
+}
+
+// Buckets read by a lookup of cuckoo.h, counting the stash as one more
+static size_t cuckoo_probes(const cuckoo_t *cuckoo, uint64_t key) {
+  uint64_t hash = cuckoo__hash(key);
+  size_t buckets[2] = {cuckoo__bucket1(cuckoo, hash), cuckoo__bucket2(cuckoo, hash)};
+  for (size_t b = 0; b < 2; ++b) {
+    size_t base = buckets[b] * CUCKOO_SLOTS;
+    for (size_t s = 0; s < CUCKOO_SLOTS; ++s) {
+      if (cuckoo->tags[base + s] != 0 && cuckoo->keys[base + s] == key) {
+        return b + 1;
+      }
+    }
+  }
+  return 2 + (cuckoo->nstash > 0);
+}
+
+int main(int argc, char **argv) {
+  bench_init("cuckoo_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-4s %-5s %-6s %10s", "op", "state", "impl", "n");
+  char extra_header[96];
+  snprintf(extra_header, sizeof(extra_header), "%8s %8s %8s %8s %8s %6s", "vs hash", "p50", "p99", "p99.9",
+           "p99.99", "probes");
+  bench_header(keys_header, extra_header);
+
+  double ns_per_tick = 1e9 / prof_ticks_per_second();
+  hist_t *hist = (hist_t *) malloc(sizeof(hist_t));
+  uint64_t *queries = (uint64_t *) malloc(CUCKOO_BENCH_LOOKUPS * sizeof(uint64_t));
+  if (hist == NULL || queries == NULL) {
+    fprintf(stderr, "cuckoo_bench: out of memory\n");
+    return 1;
+  }
+  bool failed = false;
+  uint64_t checksum = 0;
+  for (size_t ni = 0; ni < CUCKOO_COUNT(cuckoo_dims); ++ni) {
+    size_t n = (size_t) cuckoo_dims[ni];
+    // the keys, the slots, keys and values of both maps (hash.h at a load down to 37.5%)
+    if (!bench_fits(n, (uint64_t) n * 80)) {
+      continue;
+    }
+    uint64_t *keys = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *map = NULL;
+    cuckoo_t *cuckoo = cuckoo_new_typed(uint64_t);
+    if (keys == NULL || cuckoo == NULL) {
+      fprintf(stderr, "cuckoo_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    uint64_t state = 151 + n;
+    bool built = true;
+    for (size_t i = 0; i < n; ++i) {
+      keys[i] = bench_rand(&state);
+      uint64_t value = value_of(keys[i]);
+      hash_put(map, keys[i], value);
+      built = built && cuckoo_put(cuckoo, keys[i], &value) >= 0;
+    }
+
+    for (int st = 0; st < STATES; ++st) {
+      if (st == STATE_CHURN) {
+        for (size_t c = 0; c < n / 4; ++c) {
+          size_t i = (size_t)(bench_rand(&state) % n);
+          built = built && hash_del(map, keys[i], 0) && cuckoo_del(cuckoo, keys[i]);
+          keys[i] = bench_rand(&state);
+          uint64_t value = value_of(keys[i]);
+          hash_put(map, keys[i], value);
+          built = built && cuckoo_put(cuckoo, keys[i], &value) >= 0;
+        }
+      }
+      if (!built || hash_size(map) != cuckoo_size(cuckoo)) {
+        fprintf(stderr, "cuckoo_bench: the maps differ after the inserts at n = %zu\n", n);
+        return 1;
+      }
+
+      for (int op = 0; op < OPS; ++op) {
+        for (size_t q = 0; q < CUCKOO_BENCH_LOOKUPS; ++q) {
+          // a random 64-bit key is in the map with a negligible probability
+          queries[q] = (op == OP_HIT) ? keys[bench_rand(&state) % n] : bench_rand(&state);
+        }
+
+        double hash_ns = 0.0;
+        for (int impl = 0; impl < IMPLS; ++impl) {
+          char row_keys[128];
+          snprintf(row_keys, sizeof(row_keys), "%-4s %-5s %-6s %10zu", op_names[op], state_names[st],
+                   impl_names[impl], n);
+          if (!bench_selected(row_keys)) {
+            continue;
+          }
+          hist_init(hist);
+          bench_timer_t timer;
+          bench_timer_init(&timer);
+          bool ok = true;
+          for (int r = 0; bench_more(&timer, CUCKOO_BENCH_LOOKUPS); ++r) {
+            size_t hits = 0;
+            bench_start(&timer);
+            for (size_t q = 0; q < CUCKOO_BENCH_LOOKUPS; ++q) {
+              prof_ticks_t start = prof_ticks();
+              const uint64_t *value = (impl == IMPL_HASH) ? (const uint64_t *) hash_get(map, queries[q])
+                                                          : (const uint64_t *) cuckoo_get(cuckoo, queries[q]);
+              hist_record(hist, prof_ticks_end() - start);
+              if (value != NULL) {
+                ++hits;
+                ok = ok && *value == value_of(queries[q]);
+              }
+            }
+            bench_stop(&timer);
+            ok = ok && hits == ((op == OP_HIT) ? CUCKOO_BENCH_LOOKUPS : 0);
+            checksum += hits;
+          }
+          size_t probes = 0;
+          for (size_t q = 0; q < CUCKOO_BENCH_LOOKUPS; ++q) {
+            size_t p = (impl == IMPL_HASH) ? hash_probes(map, queries[q]) : cuckoo_probes(cuckoo, queries[q]);
+            probes = (p > probes) ? p : probes;
+          }
+
+          double ns = bench_ns_per(&timer, CUCKOO_BENCH_LOOKUPS);
+          if (impl == IMPL_HASH) {
+            hash_ns = ns;
+          }
+          char extra[96];
+          if (!ok) {
+            snprintf(extra, sizeof(extra), "%8s %8s %8s %8s %8s %6s", "FAILED", "-", "-", "-", "-", "-");
+            failed = true;
+          } else {
+            snprintf(extra, sizeof(extra), "%8.2f %8.1f %8.1f %8.1f %8.1f %6zu", (hash_ns > 0.0) ? ns / hash_ns : 1.0,
+                     (double) hist_percentile(hist, 50.0) * ns_per_tick,
+                     (double) hist_percentile(hist, 99.0) * ns_per_tick,
+                     (double) hist_percentile(hist, 99.9) * ns_per_tick,
+                     (double) hist_percentile(hist, 99.99) * ns_per_tick, probes);
+          }
+          bench_row(row_keys, &timer, CUCKOO_BENCH_LOOKUPS, extra);
+        }
+      }
+    }
+    cuckoo_free(cuckoo);
+    hash_free(map);
+    free(keys);
+  }
+  free(queries);
+  free(hist);
+  fprintf(stderr, "cuckoo_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,253 @@
+/* dispatch_bench.c - Decisions of the adaptive s_sort versus every algorithm it can choose
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Every distribution of bench.h runs on three types: uint32_t keys and uint64_t keys (s_sort_u32
+ * and s_sort_u64, which know that the keys are integers) and 16-byte records with a uint64_t key
+ * (s_sort, through an ordering function). For every case the candidates run first:
+ *
+ *   insertion  s_insertion (only up to DISPATCH_BENCH_INSERTION_MAX elements)
+ *   merge      s_merge through an ordering function
+ *   heap       s_heap through an ordering function (never chosen; it shows what merge is worth)
+ *   counting   s_counting_u32 (uint32_t only; past S_COUNTING_MAX_RANGE it falls back to radix)
+ *   radix      s_radix_u32 / s_radix_u64 (integer keys only)
+ *
+ * then s_sort itself. Its row shows the algorithm of its plan (s_sort_plan) and its time relative
+ * to the fastest candidate, which stays close to 1 when the decision is right; the sorted and
+ * reverse shapes, where s_sort does not sort at all, go well below 1. qsort runs as a reference.
+ *
+ * Columns: time per element, the time relative to the fastest candidate, and the plan of s_sort.
+ *
+ * Every output is checked, and the benchmark exits with status 1 if one is not sorted.
+ */
+
+#include "bench.h"
+#include "sorting.h"
+
+/* Largest input of insertion sort */
+#define DISPATCH_BENCH_INSERTION_MAX 4096
+
+typedef enum type_t { TYPE_U32, TYPE_U64, TYPE_RECORD, TYPES } type_t;
+typedef enum algo_t {
+  ALGO_INSERTION,
+  ALGO_MERGE,
+  ALGO_HEAP,
+  ALGO_COUNTING,
+  ALGO_RADIX,
+  ALGO_QSORT,
+  ALGO_SORT,
+  ALGOS
+} algo_t;
+
+static const char *type_names[TYPES] = {"u32", "u64", "record"};
+static const size_t type_sizes[TYPES] = {sizeof(uint32_t), sizeof(uint64_t), 16};
+static const char *algo_names[ALGOS] = {"insertion", "merge", "heap", "counting", "radix", "qsort", "s_sort"};
+static const uint64_t dispatch_dims[] = {16, 256, 4096, 65536, 1 << 20, 1 << 24};
+
+#define DISPATCH_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static bool less_u32(const void *lhs, const void *rhs) {
+  return *(const uint32_t *) lhs < *(const uint32_t *) rhs;
+}
+
+// the key of a record is its first 8 bytes
+static bool less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+static int cmp_u32(const void *lhs, const void *rhs) {
+  uint32_t a = *(const uint32_t *) lhs;
+  uint32_t b = *(const uint32_t *) rhs;
+  return (a > b) - (a < b);
+}
+
+static int cmp_u64(const void *lhs, const void *rhs) {
+  uint64_t a = *(const uint64_t *) lhs;
+  uint64_t b = *(const uint64_t *) rhs;
+  return (a > b) - (a < b);
+}
+
+static bool applies(type_t type, algo_t algo, size_t n) {
+  switch (algo) {
+    case ALGO_INSERTION:
+      return n <= DISPATCH_BENCH_INSERTION_MAX;
+    case ALGO_COUNTING:
+      return type == TYPE_U32;
+    case ALGO_RADIX:
+      return type != TYPE_RECORD;
+    default:
+      return true;
+  }
+}
+
+// Sorts 'work' with an algorithm
+static int64_t run(type_t type, algo_t algo, char *work, size_t n) {
+  size_t size = type_sizes[type];
+  bool (*order)(const void *lhs, const void *rhs) = (type == TYPE_U32) ? less_u32 : less_u64;
+  switch (algo) {
+    case ALGO_INSERTION:
+      return s_insertion(work, n, size, order);
+    case ALGO_MERGE:
+      return s_merge(work, n, size, order);
+    case ALGO_HEAP:
+      return s_heap(work, n, size, order);
+    case ALGO_COUNTING:
+      return s_counting_u32((uint32_t *) work, n);
+    case ALGO_RADIX:
+      return (type == TYPE_U32) ? s_radix_u32((uint32_t *) work, n) : s_radix_u64((uint64_t *) work, n);
+    case ALGO_QSORT:
+      qsort(work, n, size, (type == TYPE_U32) ? cmp_u32 : cmp_u64);
+      return (int64_t) n;
+    default:
+      if (type == TYPE_U32) {
+        return s_sort_u32((uint32_t *) work, n);
+      }
+      if (type == TYPE_U64) {
+        return s_sort_u64((uint64_t *) work, n);
+      }
+      return s_sort(work, n, size, order);
+  }
+}
+
+// Name of the algorithm that s_sort chooses for 'input'
+static const char *plan_name(type_t type, const char *input, size_t n) {
+  s_sort_plan_t plan;
+  if (type == TYPE_U32) {
+    plan = s_sort_plan_u32((const uint32_t *) input, n);
+  } else if (type == TYPE_U64) {
+    plan = s_sort_plan_u64((const uint64_t *) input, n);
+  } else {
+    plan = s_sort_plan(input, n, type_sizes[type], less_u64);
+  }
+  return s_algorithm_name(plan.algorithm);
+}
+
+int main(int argc, char **argv) {
+  bench_init("dispatch_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-9s %-6s %-10s %10s", "algorithm", "type", "dist", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s %-9s", "vs best", "plan");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  for (int type = 0; type < TYPES; ++type) {
+    size_t size = type_sizes[type];
+    for (size_t ni = 0; ni < DISPATCH_COUNT(dispatch_dims); ++ni) {
+      size_t n = (size_t) dispatch_dims[ni];
+      // the input, the work copy and the temporary buffer of the merge sort
+      if (!bench_fits(n, 3 * (uint64_t) n * size)) {
+        continue;
+      }
+      uint64_t *keys = (uint64_t *) malloc(n * sizeof(uint64_t));
+      char *input = (char *) malloc(n * size);
+      char *work = (char *) malloc(n * size);
+      if (keys == NULL || input == NULL || work == NULL) {
+        fprintf(stderr, "dispatch_bench: out of memory at n = %zu\n", n);
+        return 1;
+      }
+      for (int d = 0; d < BENCH_DISTS; ++d) {
+        bench_fill_u64(keys, n, (bench_dist_t) d, (type == TYPE_U32) ? 32 : 64, 101 + (uint64_t) d);
+        for (size_t i = 0; i < n; ++i) {
+          if (type == TYPE_U32) {
+            uint32_t key = (uint32_t) keys[i];
+            memcpy(input + i * size, &key, sizeof(uint32_t));
+          } else {
+            memcpy(input + i * size, &keys[i], sizeof(uint64_t));
+            memset(input + i * size + sizeof(uint64_t), (int)(i & 0xFF), size - sizeof(uint64_t));
+          }
+        }
+
+        // every algorithm of a case with a selected row runs first, then the rows are printed
+        // relative to the fastest candidate
+        char row_keys[ALGOS][128];
+        bool selected = false;
+        for (int algo = 0; algo < ALGOS; ++algo) {
+          snprintf(row_keys[algo], sizeof(row_keys[algo]), "%-9s %-6s %-10s %10zu", algo_names[algo],
+                   type_names[type], bench_dist_name((bench_dist_t) d), n);
+          selected = selected || (applies((type_t) type, (algo_t) algo, n) && bench_selected(row_keys[algo]));
+        }
+        if (!selected) {
+          continue;
+        }
+        bench_timer_t timers[ALGOS];
+        bool ran[ALGOS];
+        bool ok[ALGOS];
+        double best_ns = 0.0;
+        for (int algo = 0; algo < ALGOS; ++algo) {
+          ran[algo] = applies((type_t) type, (algo_t) algo, n);
+          ok[algo] = true;
+          if (!ran[algo]) {
+            continue;
+          }
+          bench_timer_init(&timers[algo]);
+          for (int r = 0; ok[algo] && bench_more(&timers[algo], n); ++r) {
+            memcpy(work, input, n * size);
+            bench_start(&timers[algo]);
+            int64_t result = run((type_t) type, (algo_t) algo, work, n);
+            bench_stop(&timers[algo]);
+            if (r == 0) {
+              ok[algo] = result == (int64_t) n;
+              for (size_t i = 1; ok[algo] && i < n; ++i) {
+                ok[algo] = (type == TYPE_U32) ? !less_u32(work + i * size, work + (i - 1) * size)
+                                              : !less_u64(work + i * size, work + (i - 1) * size);
+              }
+            }
+            checksum += (uint8_t) work[(n / 2) * size];
+          }
+          double ns = bench_ns_per(&timers[algo], n);
+          if (algo < ALGO_QSORT && (best_ns == 0.0 || ns < best_ns)) {
+            best_ns = ns;
+          }
+        }
+
+        for (int algo = 0; algo < ALGOS; ++algo) {
+          if (!ran[algo] || !bench_selected(row_keys[algo])) {
+            continue;
+          }
+          char extra[64];
+          if (!ok[algo]) {
+            snprintf(extra, sizeof(extra), "%10s %-9s", "FAILED", "-");
+            failed = true;
+          } else {
+            snprintf(extra, sizeof(extra), "%10.2f %-9s", bench_ns_per(&timers[algo], n) / best_ns,
+                     (algo == ALGO_SORT) ? plan_name((type_t) type, input, n) : "-");
+          }
+          bench_row(row_keys[algo], &timers[algo], n, extra);
+        }
+      }
+      free(work);
+      free(input);
+      free(keys);
+    }
+  }
+  fprintf(stderr, "dispatch_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,198 @@
+/* external_bench.c - Throughput of s_external (sorting.h) versus sort(1)
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * A file of n 16-byte records (a random 64-bit key and a payload) is sorted by s_external, on one
+ * thread and on a pool with one worker per processor (s_set_pool). The baseline is the sort(1)
+ * of the system on a file with the same number of bytes: one line per record, the key as 15 hex
+ * digits, so that the byte order of the lines is the order of the keys, sorted with LC_ALL=C on
+ * one thread and on all the processors (--parallel). Both get the same memory budget, an eighth of
+ * the input (at least 2 MB), so that every size is sorted out of core: the runs go to temporary
+ * files and are merged. The files are written in TMPDIR (/tmp by default).
+ *
+ * Columns: time per record, then the input megabytes sorted per second, the time relative to
+ * sort(1) on the same number of threads, and the number of runs written by s_external. sort(1) is
+ * run with system(), so its rows include the start of a process. Rows of sort(1) are skipped if it
+ * is not available.
+ */
+
+#include "bench.h"
+#include <unistd.h>
+#include "sorting.h"
+#include "pool.h"
+
+/* Bytes of a record, and of a line of the sort(1) input */
+#define EXTERNAL_BENCH_RECORD 16
+
+/* Smallest memory budget */
+#define EXTERNAL_BENCH_MIN_BUDGET ((size_t) 2 << 20)
+
+static const uint64_t external_dims[] = {1 << 16, 1 << 20, 1 << 24, 1 << 26};
+
+#define EXTERNAL_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+typedef struct record_t {
+  uint64_t key;
+  uint64_t payload;
+} record_t;
+
+static bool record_less(const void *lhs, const void *rhs) {
+  return ((const record_t *) lhs)->key < ((const record_t *) rhs)->key;
+}
+
+// Writes the binary input and the text input of n records. Returns false on I/O failure
+static bool write_inputs(const char *bin_path, const char *text_path, size_t n) {
+  FILE *bin = fopen(bin_path, "wb");
+  FILE *text = fopen(text_path, "w");
+  bool ok = bin != NULL && text != NULL;
+  uint64_t state = 127;
+  for (size_t i = 0; ok && i < n; ++i) {
+    record_t rec = {bench_rand(&state) >> 4, i};
+    ok = fwrite(&rec, sizeof(rec), 1, bin) == 1 && fprintf(text, "%015llx\n", (unsigned long long) rec.key) == 16;
+  }
+  ok = (bin == NULL || fclose(bin) == 0) && ok;
+  ok = (text == NULL || fclose(text) == 0) && ok;
+  return ok;
+}
+
+// Checks that a file of records is sorted
+static bool check_sorted(const char *path, size_t n) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return false;
+  }
+  record_t prev = {0, 0};
+  record_t rec;
+  size_t count = 0;
+  bool ok = true;
+  while (fread(&rec, sizeof(rec), 1, f) == 1) {
+    ok = ok && (count == 0 || prev.key <= rec.key);
+    prev = rec;
+    ++count;
+  }
+  fclose(f);
+  return ok && count == n;
+}
+
+int main(int argc, char **argv) {
+  bench_init("external_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-10s %7s %10s", "sort", "threads", "n");
+  char extra_header[128];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s %6s", "MB/s", "vs sort(1)", "runs");
+  bench_header(keys_header, extra_header);
+
+  const char *dir = getenv("TMPDIR");
+  if (dir == NULL) {
+    dir = "/tmp";
+  }
+  char bin_path[512];
+  char text_path[512];
+  char out_path[512];
+  snprintf(bin_path, sizeof(bin_path), "%s/chibi_external_bench_%ld.bin", dir, (long) getpid());
+  snprintf(text_path, sizeof(text_path), "%s/chibi_external_bench_%ld.txt", dir, (long) getpid());
+  snprintf(out_path, sizeof(out_path), "%s/chibi_external_bench_%ld.out", dir, (long) getpid());
+  bool have_sort = system("sort --version > /dev/null 2>&1") == 0;
+  long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t threads[2] = {1, (nprocs > 1) ? (size_t) nprocs : 1};
+
+  bool failed = false;
+  for (size_t ni = 0; ni < EXTERNAL_COUNT(external_dims); ++ni) {
+    size_t n = (size_t) external_dims[ni];
+    uint64_t bytes = (uint64_t) n * EXTERNAL_BENCH_RECORD;
+    // the memory in use is the budget, the input size is the limit
+    if (!bench_fits(n, bytes)) {
+      continue;
+    }
+    size_t budget = (size_t)(bytes / 8);
+    if (budget < EXTERNAL_BENCH_MIN_BUDGET) {
+      budget = EXTERNAL_BENCH_MIN_BUDGET;
+    }
+    if (!write_inputs(bin_path, text_path, n)) {
+      fprintf(stderr, "external_bench: cannot write the inputs in %s\n", dir);
+      return 1;
+    }
+    size_t chunk = budget / (2 * EXTERNAL_BENCH_RECORD);
+    size_t runs = (n + chunk - 1) / chunk;
+    for (int t = 0; t < 2; ++t) {
+      if (t == 1 && threads[1] == threads[0]) {
+        break;
+      }
+      double sort_ns = 0.0;
+      for (int tool = 1; tool >= 0; --tool) {
+        char row_keys[128];
+        snprintf(row_keys, sizeof(row_keys), "%-10s %7zu %10zu", tool ? "sort(1)" : "s_external", threads[t], n);
+        if (!bench_selected(row_keys) || (tool == 1 && !have_sort)) {
+          continue;
+        }
+        char command[2048];
+        snprintf(command, sizeof(command), "LC_ALL=C sort -S %zub --parallel=%zu -T '%s' -o '%s' '%s'", budget,
+                 threads[t], dir, out_path, text_path);
+        pool_t *pool = (tool == 0 && threads[t] > 1) ? pool_new(threads[t]) : NULL;
+        s_set_pool(pool);
+        bench_timer_t timer;
+        bench_timer_init(&timer);
+        bool ok = true;
+        while (ok && bench_more(&timer, n)) {
+          bench_start(&timer);
+          if (tool == 1) {
+            ok = system(command) == 0;
+          } else {
+            ok = s_external(bin_path, out_path, EXTERNAL_BENCH_RECORD, record_less, budget) == (int64_t) n;
+          }
+          bench_stop(&timer);
+        }
+        if (tool == 0) {
+          ok = ok && check_sorted(out_path, n);
+        }
+        s_set_pool(NULL);
+        pool_free(pool);
+        remove(out_path);
+
+        double ns = bench_ns_per(&timer, n);
+        char extra[128];
+        if (!ok) {
+          snprintf(extra, sizeof(extra), "%10s %10s %6s", "FAILED", "-", "-");
+          failed = true;
+        } else if (tool == 1) {
+          sort_ns = ns;
+          snprintf(extra, sizeof(extra), "%10.1f %10.2f %6s", 1e3 * EXTERNAL_BENCH_RECORD / ns, 1.0, "-");
+        } else {
+          char ratio[16];
+          snprintf(ratio, sizeof(ratio), (sort_ns > 0.0) ? "%.2f" : "-", ns / sort_ns);
+          snprintf(extra, sizeof(extra), "%10.1f %10s %6zu", 1e3 * EXTERNAL_BENCH_RECORD / ns, ratio, runs);
+        }
+        bench_row(row_keys, &timer, n, extra);
+      }
+    }
+    remove(bin_path);
+    remove(text_path);
+  }
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
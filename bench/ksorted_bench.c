@@ -0,0 +1,193 @@
+/* ksorted_bench.c - Sorts of sorting.h on k-sorted inputs, with their temporary memory
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * n 16-byte records (a uint64_t key and a payload) where every record is at most k positions from
+ * its sorted position, for k = 1, 8, 64 and 1024: record i gets the sort key i + a random offset
+ * in [0, k], which moves it by at most k. The sorts, all through an ordering function:
+ *
+ *   qsort        the baseline
+ *   s_insertion  O(n k) on such inputs (only while n * (k + 1) <= KSORTED_BENCH_INSERTION_WORK)
+ *   s_heap       in place, O(n log n), one temporary element
+ *   s_merge      O(n log n), a buffer of n records
+ *   s_sort       the adaptive sort
+ *   s_ksorted    O(n log k), a sliding heap of k + 1 records
+ *
+ * Columns: time per record, the time relative to the qsort row of the same case, then comparisons
+ * per record and the peak temporary memory in bytes, counted by SORTING_STATS during the first
+ * repetition (qsort reports neither).
+ *
+ * Every output is checked, and the benchmark exits with status 1 if one is not sorted.
+ */
+
+#define SORTING_STATS
+#include "bench.h"
+#include "sorting.h"
+
+/* Largest n * (k + 1) of insertion sort */
+#define KSORTED_BENCH_INSERTION_WORK ((uint64_t) 1 << 26)
+
+typedef enum algo_t { ALGO_QSORT, ALGO_INSERTION, ALGO_HEAP, ALGO_MERGE, ALGO_SORT, ALGO_KSORTED, ALGOS } algo_t;
+
+// A record: the key and a payload that must follow it
+typedef struct record_t {
+  uint64_t key;
+  uint64_t payload;
+} record_t;
+
+static const char *algo_names[ALGOS] = {"qsort", "s_insertion", "s_heap", "s_merge", "s_sort", "s_ksorted"};
+static const uint64_t ksorted_dims[] = {4096, 65536, 1 << 20, 1 << 24};
+static const size_t ksorted_ks[] = {1, 8, 64, 1024};
+
+#define KSORTED_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static bool less_record(const void *lhs, const void *rhs) {
+  return ((const record_t *) lhs)->key < ((const record_t *) rhs)->key;
+}
+
+static int cmp_record(const void *lhs, const void *rhs) {
+  uint64_t a = ((const record_t *) lhs)->key;
+  uint64_t b = ((const record_t *) rhs)->key;
+  return (a > b) - (a < b);
+}
+
+// Fills 'records' with the keys 0 .. n - 1, each at most 'k' positions from its sorted position:
+// 'order' is scratch space for n keys
+static void make_ksorted(record_t *records, uint64_t *order, size_t n, size_t k, uint64_t seed) {
+  uint64_t state = seed;
+  // the high bits order the records, the low 32 bits are the key of the record
+  for (size_t i = 0; i < n; ++i) {
+    order[i] = ((uint64_t)(i + bench_rand(&state) % (k + 1)) << 32) | (uint64_t) i;
+  }
+  s_radix_u64(order, n);
+  for (size_t i = 0; i < n; ++i) {
+    records[i].key = order[i] & UINT32_MAX;
+    records[i].payload = ~records[i].key;
+  }
+}
+
+static int64_t run(algo_t algo, record_t *work, size_t n, size_t k) {
+  switch (algo) {
+    case ALGO_QSORT:
+      qsort(work, n, sizeof(record_t), cmp_record);
+      return (int64_t) n;
+    case ALGO_INSERTION:
+      return s_insertion(work, n, sizeof(record_t), less_record);
+    case ALGO_HEAP:
+      return s_heap_typed(work, n, less_record);
+    case ALGO_MERGE:
+      return s_merge(work, n, sizeof(record_t), less_record);
+    case ALGO_SORT:
+      return s_sort(work, n, sizeof(record_t), less_record);
+    default:
+      return s_ksorted_typed(work, n, less_record, k);
+  }
+}
+
+int main(int argc, char **argv) {
+  bench_init("ksorted_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-11s %5s %10s", "algorithm", "k", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s %12s", "vs qsort", "cmp/elem", "peak bytes");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  for (size_t ni = 0; ni < KSORTED_COUNT(ksorted_dims); ++ni) {
+    size_t n = (size_t) ksorted_dims[ni];
+    // the input, the work copy and the buffer of the merge sort, the scratch keys
+    if (!bench_fits(n, (uint64_t) n * (3 * sizeof(record_t) + sizeof(uint64_t)))) {
+      continue;
+    }
+    record_t *input = (record_t *) malloc(n * sizeof(record_t));
+    record_t *work = (record_t *) malloc(n * sizeof(record_t));
+    uint64_t *order = (uint64_t *) malloc(n * sizeof(uint64_t));
+    if (input == NULL || work == NULL || order == NULL) {
+      fprintf(stderr, "ksorted_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    for (size_t ki = 0; ki < KSORTED_COUNT(ksorted_ks); ++ki) {
+      size_t k = ksorted_ks[ki];
+      make_ksorted(input, order, n, k, 131 + n + k);
+
+      double qsort_ns = 0.0;
+      for (int algo = 0; algo < ALGOS; ++algo) {
+        if (algo == ALGO_INSERTION && (uint64_t) n * (k + 1) > KSORTED_BENCH_INSERTION_WORK) {
+          continue;
+        }
+        char row_keys[128];
+        snprintf(row_keys, sizeof(row_keys), "%-11s %5zu %10zu", algo_names[algo], k, n);
+        if (!bench_selected(row_keys)) {
+          continue;
+        }
+        bench_timer_t timer;
+        bench_timer_init(&timer);
+        s_stats_t stats = {0, 0, 0, 0};
+        bool ok = true;
+        for (int r = 0; ok && bench_more(&timer, n); ++r) {
+          memcpy(work, input, n * sizeof(record_t));
+          s_stats_reset();
+          bench_start(&timer);
+          int64_t result = run((algo_t) algo, work, n, k);
+          bench_stop(&timer);
+          if (r == 0) {
+            stats = s_stats_get();
+            ok = result == (int64_t) n;
+            for (size_t i = 0; ok && i < n; ++i) {
+              ok = work[i].key == i && work[i].payload == ~(uint64_t) i;
+            }
+          }
+          checksum += work[n / 2].payload;
+        }
+
+        double ns = bench_ns_per(&timer, n);
+        if (algo == ALGO_QSORT) {
+          qsort_ns = ns;
+        }
+        char extra[64];
+        if (!ok) {
+          snprintf(extra, sizeof(extra), "%10s %10s %12s", "FAILED", "-", "-");
+          failed = true;
+        } else if (algo == ALGO_QSORT) {
+          snprintf(extra, sizeof(extra), "%10.2f %10s %12s", 1.0, "-", "-");
+        } else {
+          snprintf(extra, sizeof(extra), "%10.2f %10.2f %12zu", (qsort_ns > 0.0) ? ns / qsort_ns : 1.0,
+                   (double) stats.comparisons / (double) n, stats.peak_memory);
+        }
+        bench_row(row_keys, &timer, n, extra);
+      }
+    }
+    free(order);
+    free(work);
+    free(input);
+  }
+  fprintf(stderr, "ksorted_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,259 @@
+/* lsm_bench.c - Streaming inserts and queries of lsm.h versus a sorted vector
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * n random uint64_t keys are inserted one at a time, then the container answers
+ * LSM_BENCH_QUERIES queries. The operations:
+ *
+ *   insert  vector: v_insert at the position found by s_lower_bound_u64, O(n) moves per insert
+ *           (only up to LSM_BENCH_VINSERT_MAX keys); lsm: lsm_insert; sort_once: v_push_back of
+ *           every key and one s_sort_u64 at the end, the cost of an offline load
+ *   find    point queries, half of them for present keys: s_lower_bound_u64 on the sorted vector
+ *           versus lsm_find
+ *   range   ranges of about LSM_BENCH_SPAN keys: two s_lower_bound_u64 and a memcpy on the
+ *           sorted vector versus lsm_range
+ *
+ * Columns: time per insert or query, the time relative to the vector row of the same case (when
+ * there is one), and the levels of the container after the inserts.
+ *
+ * Every result is compared with the sorted vector, and the benchmark exits with status 1 if one
+ * differs.
+ */
+
+#include "bench.h"
+#include "lsm.h"
+#include "vectors.h"
+
+/* Largest n of the v_insert row, which moves O(n^2) keys */
+#define LSM_BENCH_VINSERT_MAX 65536
+
+/* Queries per measure */
+#define LSM_BENCH_QUERIES 65536
+
+/* Average keys per range query */
+#define LSM_BENCH_SPAN 64
+
+typedef enum op_t { OP_INSERT, OP_FIND, OP_RANGE, OPS } op_t;
+typedef enum impl_t { IMPL_VECTOR, IMPL_LSM, IMPL_SORT_ONCE, IMPLS } impl_t;
+
+static const char *op_names[OPS] = {"insert", "find", "range"};
+static const char *impl_names[IMPLS] = {"vector", "lsm", "sort_once"};
+static const uint64_t lsm_dims[] = {4096, 65536, 1 << 20, 1 << 24};
+
+#define LSM_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static bool less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+// Inserts the keys one at a time into a sorted vector, or appends them and sorts once.
+// Returns NULL if an allocation fails.
+static uint64_t *vector_insert(const uint64_t *keys, size_t n, bool sort_once) {
+  uint64_t *vec = NULL;
+  for (size_t i = 0; i < n; ++i) {
+    if (sort_once || vec == NULL) {
+      v_push_back(vec, keys[i]);
+    } else {
+      size_t pos = s_lower_bound_u64(vec, v_size(vec), keys[i]);
+      v_insert(vec, pos, keys[i]);
+    }
+    if (vec == NULL) {
+      return NULL;
+    }
+  }
+  if (sort_once) {
+    s_sort_u64(vec, v_size(vec));
+  }
+  return vec;
+}
+
+static lsm_t *lsm_build(const uint64_t *keys, size_t n) {
+  lsm_t *lsm = lsm_new_typed(uint64_t, less_u64);
+  for (size_t i = 0; lsm != NULL && i < n; ++i) {
+    if (lsm_insert(lsm, &keys[i]) < 0) {
+      lsm_free(lsm);
+      return NULL;
+    }
+  }
+  return lsm;
+}
+
+int main(int argc, char **argv) {
+  bench_init("lsm_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-6s %-9s %10s", "op", "impl", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s %7s", "vs vector", "levels");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  uint64_t *queries = (uint64_t *) malloc(LSM_BENCH_QUERIES * sizeof(uint64_t));
+  uint64_t *expected = (uint64_t *) malloc(LSM_BENCH_QUERIES * sizeof(uint64_t));
+  uint64_t *results = (uint64_t *) malloc(LSM_BENCH_QUERIES * sizeof(uint64_t));
+  if (queries == NULL || expected == NULL || results == NULL) {
+    fprintf(stderr, "lsm_bench: out of memory\n");
+    return 1;
+  }
+  for (size_t ni = 0; ni < LSM_COUNT(lsm_dims); ++ni) {
+    size_t n = (size_t) lsm_dims[ni];
+    // the keys, the sorted vector, the levels of the container and their free copies, the output
+    if (!bench_fits(n, (uint64_t) n * 6 * sizeof(uint64_t))) {
+      continue;
+    }
+    uint64_t *keys = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *output = (uint64_t *) malloc(n * sizeof(uint64_t));
+    if (keys == NULL || output == NULL) {
+      fprintf(stderr, "lsm_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    uint64_t state = 139 + n;
+    for (size_t i = 0; i < n; ++i) {
+      keys[i] = bench_rand(&state);
+    }
+    uint64_t span = UINT64_MAX / n * LSM_BENCH_SPAN;
+    for (size_t q = 0; q < LSM_BENCH_QUERIES; ++q) {
+      queries[q] = (q & 1) ? bench_rand(&state) : keys[bench_rand(&state) % n];
+    }
+
+    // the structures the queries run on, built once outside the timed region
+    uint64_t *sorted = vector_insert(keys, n, true);
+    lsm_t *lsm = lsm_build(keys, n);
+    if (sorted == NULL || lsm == NULL) {
+      fprintf(stderr, "lsm_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    size_t levels = lsm->nlevels;
+    failed = failed || lsm_export(lsm, output) != (int64_t) n || memcmp(output, sorted, n * sizeof(uint64_t)) != 0;
+
+    for (int op = 0; op < OPS; ++op) {
+      if (op != OP_INSERT) {
+        for (size_t q = 0; q < LSM_BENCH_QUERIES; ++q) {
+          size_t first = s_lower_bound_u64(sorted, n, queries[q]);
+          if (op == OP_FIND) {
+            expected[q] = first < n && sorted[first] == queries[q];
+          } else {
+            uint64_t hi = (queries[q] > UINT64_MAX - span) ? UINT64_MAX : queries[q] + span;
+            expected[q] = s_lower_bound_u64(sorted, n, hi) - first;
+          }
+        }
+      }
+
+      double base_ns = 0.0;
+      for (int impl = 0; impl < IMPLS; ++impl) {
+        if ((op != OP_INSERT && impl == IMPL_SORT_ONCE) ||
+            (op == OP_INSERT && impl == IMPL_VECTOR && n > LSM_BENCH_VINSERT_MAX)) {
+          continue;
+        }
+        char row_keys[128];
+        snprintf(row_keys, sizeof(row_keys), "%-6s %-9s %10zu", op_names[op], impl_names[impl], n);
+        if (!bench_selected(row_keys)) {
+          continue;
+        }
+        uint64_t per = (op == OP_INSERT) ? n : LSM_BENCH_QUERIES;
+        bench_timer_t timer;
+        bench_timer_init(&timer);
+        bool ok = true;
+        for (int r = 0; ok && bench_more(&timer, per); ++r) {
+          if (op == OP_INSERT) {
+            bench_start(&timer);
+            uint64_t *vec = NULL;
+            lsm_t *built = NULL;
+            if (impl == IMPL_LSM) {
+              built = lsm_build(keys, n);
+            } else {
+              vec = vector_insert(keys, n, impl == IMPL_SORT_ONCE);
+            }
+            bench_stop(&timer);
+            if (r == 0) {
+              ok = (impl == IMPL_LSM) ? built != NULL && lsm_export(built, output) == (int64_t) n
+                                      : vec != NULL && v_size(vec) == n;
+              ok = ok && memcmp((impl == IMPL_LSM) ? output : vec, sorted, n * sizeof(uint64_t)) == 0;
+            }
+            checksum += (impl == IMPL_LSM) ? lsm_size(built) : v_size(vec);
+            lsm_free(built);
+            v_free(vec);
+            continue;
+          }
+          bench_start(&timer);
+          for (size_t q = 0; q < LSM_BENCH_QUERIES; ++q) {
+            uint64_t key = queries[q];
+            if (op == OP_FIND) {
+              if (impl == IMPL_VECTOR) {
+                size_t pos = s_lower_bound_u64(sorted, n, key);
+                results[q] = pos < n && sorted[pos] == key;
+              } else {
+                results[q] = lsm_find(lsm, &key, NULL);
+              }
+            } else {
+              uint64_t hi = (key > UINT64_MAX - span) ? UINT64_MAX : key + span;
+              if (impl == IMPL_VECTOR) {
+                size_t first = s_lower_bound_u64(sorted, n, key);
+                size_t len = s_lower_bound_u64(sorted, n, hi) - first;
+                memcpy(output, sorted + first, len * sizeof(uint64_t));
+                results[q] = len;
+              } else {
+                results[q] = (uint64_t) lsm_range(lsm, &key, &hi, output);
+              }
+            }
+            checksum += output[0];
+          }
+          bench_stop(&timer);
+          if (r == 0) {
+            ok = memcmp(results, expected, LSM_BENCH_QUERIES * sizeof(uint64_t)) == 0;
+          }
+        }
+
+        double ns = bench_ns_per(&timer, per);
+        if (impl == IMPL_VECTOR) {
+          base_ns = ns;
+        }
+        char extra[64];
+        if (!ok) {
+          snprintf(extra, sizeof(extra), "%10s %7s", "FAILED", "-");
+          failed = true;
+        } else if (base_ns == 0.0) {
+          snprintf(extra, sizeof(extra), "%10s %7zu", "-", levels);
+        } else {
+          snprintf(extra, sizeof(extra), "%10.2f %7zu", ns / base_ns, levels);
+        }
+        bench_row(row_keys, &timer, per, extra);
+      }
+    }
+    lsm_free(lsm);
+    v_free(sorted);
+    free(output);
+    free(keys);
+  }
+  free(results);
+  free(expected);
+  free(queries);
+  fprintf(stderr, "lsm_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
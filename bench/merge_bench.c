@@ -0,0 +1,267 @@
+/* merge_bench.c - K-way merge of sorted runs (sorting.h)
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * n random uint64_t keys are split into k sorted runs of equal length, for k from 2 to 1024, and
+ * merged into one output by:
+ *
+ *   heap        a binary heap of the heads of the runs, the textbook k-way merge (up to
+ *               2 log2(k) comparisons per element), the baseline
+ *   loser-tree  s_merge_k, log2(k) comparisons per element
+ *   merger      the pull-based s_merger_pull, in batches of MERGE_BENCH_BATCH elements
+ *   pairwise    rounds of s_merge_2 over pairs of runs, log2(k) passes over the data
+ *   resort      the runs concatenated and sorted again with s_merge
+ *
+ * The ordering function is the same for all of them. Columns: time per element, then the
+ * comparisons per element counted by SORTING_STATS (the heap counts its own), and the time
+ * relative to the heap. Every output is checked.
+ */
+
+#define SORTING_STATS
+#include "bench.h"
+#include "sorting.h"
+
+/* Elements pulled per call of s_merger_pull */
+#define MERGE_BENCH_BATCH 256
+
+typedef enum merge_algo_t { MERGE_HEAP, MERGE_LOSER, MERGE_PULL, MERGE_PAIRWISE, MERGE_RESORT, MERGE_ALGOS } merge_algo_t;
+
+static const char *merge_names[MERGE_ALGOS] = {"heap", "loser-tree", "merger", "pairwise", "resort"};
+static const uint64_t merge_dims[] = {4096, 65536, 1 << 20, 1 << 24};
+static const size_t merge_ks[] = {2, 4, 8, 16, 32, 64, 128, 256, 512, 1024};
+
+#define MERGE_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+// Comparisons of the heap merge
+static uint64_t heap_comparisons = 0;
+
+static bool less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+// The ordering function of the heap, called through a pointer like in sorting.h. It has external
+// linkage so that the compiler cannot inline it
+bool (*heap_order)(const void *lhs, const void *rhs) = less_u64;
+
+static bool heap_less(const uint64_t *lhs, const uint64_t *rhs) {
+  ++heap_comparisons;
+  return heap_order(lhs, rhs);
+}
+
+// Heads of the runs in a binary min-heap: the cursor of each run and its end
+typedef struct heap_run_t {
+  const uint64_t *cur;
+  const uint64_t *end;
+} heap_run_t;
+
+static void heap_sift_down(heap_run_t *heap, size_t len, size_t i) {
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= len) {
+      return;
+    }
+    if (child + 1 < len && heap_less(heap[child + 1].cur, heap[child].cur)) {
+      ++child;
+    }
+    if (!heap_less(heap[child].cur, heap[i].cur)) {
+      return;
+    }
+    heap_run_t tmp = heap[i];
+    heap[i] = heap[child];
+    heap[child] = tmp;
+    i = child;
+  }
+}
+
+static void heap_merge(const s_span_t *spans, size_t k, uint64_t *output, heap_run_t *heap) {
+  size_t len = 0;
+  for (size_t r = 0; r < k; ++r) {
+    if (spans[r].dim > 0) {
+      heap[len].cur = (const uint64_t *) spans[r].data;
+      heap[len].end = heap[len].cur + spans[r].dim;
+      ++len;
+    }
+  }
+  for (size_t i = len / 2; i-- > 0;) {
+    heap_sift_down(heap, len, i);
+  }
+  while (len > 0) {
+    *output++ = *heap[0].cur++;
+    if (heap[0].cur == heap[0].end) {
+      heap[0] = heap[--len];
+    }
+    heap_sift_down(heap, len, 0);
+  }
+}
+
+// Merges pairs of runs until one is left; the result ends in 'output' or in 'temp'
+static uint64_t *pairwise_merge(uint64_t *data, size_t n, size_t k, uint64_t *temp) {
+  size_t run = n / k;
+  uint64_t *src = data;
+  uint64_t *dst = temp;
+  for (; run < n; run *= 2) {
+    for (size_t start = 0; start < n; start += 2 * run) {
+      size_t na = (start + run < n) ? run : n - start;
+      size_t nb = (start + 2 * run < n) ? run : n - start - na;
+      s_merge_2(src + start, na, src + start + na, nb, dst + start, sizeof(uint64_t), less_u64);
+    }
+    uint64_t *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  return src;
+}
+
+static void fill_random(uint64_t *keys, size_t n, uint64_t *state) {
+  for (size_t i = 0; i < n; ++i) {
+    keys[i] = bench_rand(state);
+  }
+}
+
+static bool check_merge(const uint64_t *output, const uint64_t *expected, size_t n) {
+  return memcmp(output, expected, n * sizeof(uint64_t)) == 0;
+}
+
+int main(int argc, char **argv) {
+  bench_init("merge_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-10s %5s %10s", "merge", "k", "n");
+  char extra_header[128];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s", "cmp/elem", "vs heap");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  for (size_t ni = 0; ni < MERGE_COUNT(merge_dims); ++ni) {
+    size_t n = (size_t) merge_dims[ni];
+    // runs, output, temporary buffer and expected output
+    if (!bench_fits(n, 4 * (uint64_t) n * sizeof(uint64_t))) {
+      continue;
+    }
+    uint64_t *runs = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *output = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *temp = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *expected = (uint64_t *) malloc(n * sizeof(uint64_t));
+    if (runs == NULL || output == NULL || temp == NULL || expected == NULL) {
+      fprintf(stderr, "merge_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    uint64_t state = 131 + n;
+    fill_random(expected, n, &state);
+    for (size_t ki = 0; ki < MERGE_COUNT(merge_ks); ++ki) {
+      size_t k = merge_ks[ki];
+      if (k > n / 4) {
+        continue;
+      }
+      // k runs of n / k keys (the last one takes the rest), each sorted
+      s_span_t spans[1024];
+      heap_run_t heap[1024];
+      memcpy(runs, expected, n * sizeof(uint64_t));
+      for (size_t r = 0; r < k; ++r) {
+        size_t start = r * (n / k);
+        spans[r].data = runs + start;
+        spans[r].dim = (r + 1 < k) ? n / k : n - start;
+        s_merge(runs + start, spans[r].dim, sizeof(uint64_t), less_u64);
+      }
+      s_merge(expected, n, sizeof(uint64_t), less_u64);
+
+      double heap_ns = 0.0;
+      for (int a = 0; a < MERGE_ALGOS; ++a) {
+        char row_keys[128];
+        snprintf(row_keys, sizeof(row_keys), "%-10s %5zu %10zu", merge_names[a], k, n);
+        if (!bench_selected(row_keys)) {
+          continue;
+        }
+        bench_timer_t timer;
+        bench_timer_init(&timer);
+        uint64_t comparisons = 0;
+        bool ok = true;
+        for (int r = 0; ok && bench_more(&timer, n); ++r) {
+          const uint64_t *result = output;
+          s_stats_reset();
+          heap_comparisons = 0;
+          if (a == MERGE_PAIRWISE || a == MERGE_RESORT) {
+            // both work in place on a copy of the runs
+            memcpy(output, runs, n * sizeof(uint64_t));
+          }
+          bench_start(&timer);
+          switch ((merge_algo_t) a) {
+            case MERGE_LOSER:
+              s_merge_k(spans, k, output, sizeof(uint64_t), less_u64);
+              break;
+            case MERGE_PULL: {
+              s_merger_t *merger = s_merger_new(spans, k, sizeof(uint64_t), less_u64);
+              size_t at = 0;
+              size_t got;
+              while ((got = s_merger_pull(merger, output + at, MERGE_BENCH_BATCH)) > 0) {
+                at += got;
+              }
+              s_merger_free(merger);
+              break;
+            }
+            case MERGE_HEAP:
+              heap_merge(spans, k, output, heap);
+              break;
+            case MERGE_PAIRWISE:
+              result = pairwise_merge(output, n, k, temp);
+              break;
+            default:
+              s_merge(output, n, sizeof(uint64_t), less_u64);
+              break;
+          }
+          bench_stop(&timer);
+          if (r == 0) {
+            comparisons = (a == MERGE_HEAP) ? heap_comparisons : s_stats_get().comparisons;
+            ok = check_merge(result, expected, n);
+          }
+        }
+        double ns = bench_ns_per(&timer, n);
+        char extra[128];
+        if (!ok) {
+          snprintf(extra, sizeof(extra), "%10s %10s", "FAILED", "-");
+          failed = true;
+        } else {
+          if (a == MERGE_HEAP) {
+            heap_ns = ns;
+          }
+          char ratio[16];
+          snprintf(ratio, sizeof(ratio), (heap_ns > 0.0) ? "%.2f" : "-", ns / heap_ns);
+          snprintf(extra, sizeof(extra), "%10.2f %10s", (double) comparisons / (double) n, ratio);
+        }
+        bench_row(row_keys, &timer, n, extra);
+      }
+      // the input of the next k
+      fill_random(expected, n, &state);
+    }
+    free(runs);
+    free(output);
+    free(temp);
+    free(expected);
+  }
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,192 @@
+/* move_bench.c - Element move engine of sorting.h by element size
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * n elements of 4 to 256 bytes are moved in the two patterns of the generic sorts:
+ *
+ *   gather  out[i] = in[perm[i]] for a random permutation (the scatter of the radix and counting
+ *           sorts, the merges)
+ *   swap    in[i] and in[perm[i]] exchanged through a temporary element (heap sort, partitions)
+ *
+ * with three ways to move one element:
+ *
+ *   bytes    a loop over the bytes, as s__copy was (the baseline; the compiler may still turn it
+ *            into a memcpy call)
+ *   memcpy   memcpy with the size known only at run time
+ *   s__move  the move engine of the sorts: word copies for 4 and 8 bytes, SSE2 copies for 16, 32
+ *            and 64 bytes, memcpy otherwise
+ *
+ * The whole sorts by element size are in sort_bench.
+ *
+ * Columns: time per element and the time relative to the bytes row of the same case.
+ *
+ * Every output is compared with the output of the bytes row, and the benchmark exits with status
+ * 1 if one differs.
+ */
+
+#include "bench.h"
+#include "sorting.h"
+
+typedef enum op_t { OP_GATHER, OP_SWAP, OPS } op_t;
+typedef enum impl_t { IMPL_BYTES, IMPL_MEMCPY, IMPL_MOVE, IMPLS } impl_t;
+
+static const char *op_names[OPS] = {"gather", "swap"};
+static const char *impl_names[IMPLS] = {"bytes", "memcpy", "s__move"};
+static const size_t move_sizes[] = {4, 8, 12, 16, 24, 32, 48, 64, 128, 256};
+static const uint64_t move_dims[] = {4096, 65536, 1 << 20, 1 << 24};
+
+#define MOVE_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static void move_bytes(char *dest, const char *source, size_t size) {
+  for (size_t b = 0; b < size; ++b) {
+    dest[b] = source[b];
+  }
+}
+
+static void move_one(impl_t impl, char *dest, const char *source, size_t size) {
+  switch (impl) {
+    case IMPL_BYTES:
+      move_bytes(dest, source, size);
+      return;
+    case IMPL_MEMCPY:
+      memcpy(dest, source, size);
+      return;
+    default:
+      s__move(dest, source, size);
+      return;
+  }
+}
+
+// Runs one pattern on 'work' (and 'out' for gather)
+static void run(op_t op, impl_t impl, char *work, char *out, const size_t *perm, size_t n, size_t size) {
+  char temp[S_STACK_TEMP];
+  for (size_t i = 0; i < n; ++i) {
+    if (op == OP_GATHER) {
+      move_one(impl, out + i * size, work + perm[i] * size, size);
+    } else {
+      move_one(impl, temp, work + i * size, size);
+      move_one(impl, work + i * size, work + perm[i] * size, size);
+      move_one(impl, work + perm[i] * size, temp, size);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  bench_init("move_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-6s %-7s %5s %10s", "op", "impl", "size", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s", "vs bytes");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  for (size_t si = 0; si < MOVE_COUNT(move_sizes); ++si) {
+    size_t size = move_sizes[si];
+    for (size_t ni = 0; ni < MOVE_COUNT(move_dims); ++ni) {
+      size_t n = (size_t) move_dims[ni];
+      // the input, the work copy, the output and the expected output, the permutation
+      if (!bench_fits(n, (uint64_t) n * (4 * size + sizeof(size_t)))) {
+        continue;
+      }
+      char *input = (char *) malloc(n * size);
+      char *work = (char *) malloc(n * size);
+      char *out = (char *) malloc(n * size);
+      char *expected = (char *) malloc(n * size);
+      size_t *perm = (size_t *) malloc(n * sizeof(size_t));
+      if (input == NULL || work == NULL || out == NULL || expected == NULL || perm == NULL) {
+        fprintf(stderr, "move_bench: out of memory at n = %zu\n", n);
+        return 1;
+      }
+      uint64_t state = 113 + n + size;
+      for (size_t i = 0; i < n * size; ++i) {
+        input[i] = (char) bench_rand(&state);
+      }
+      for (size_t i = 0; i < n; ++i) {
+        perm[i] = i;
+      }
+      for (size_t i = n; i > 1; --i) {
+        size_t j = (size_t)(bench_rand(&state) % i);
+        size_t tmp = perm[i - 1];
+        perm[i - 1] = perm[j];
+        perm[j] = tmp;
+      }
+
+      for (int op = 0; op < OPS; ++op) {
+        // the output of a pattern is in 'out' for gather and in 'work' for swap
+        memcpy(work, input, n * size);
+        run((op_t) op, IMPL_BYTES, work, out, perm, n, size);
+        memcpy(expected, (op == OP_GATHER) ? out : work, n * size);
+
+        double bytes_ns = 0.0;
+        for (int impl = 0; impl < IMPLS; ++impl) {
+          char row_keys[128];
+          snprintf(row_keys, sizeof(row_keys), "%-6s %-7s %5zu %10zu", op_names[op], impl_names[impl], size, n);
+          if (!bench_selected(row_keys)) {
+            continue;
+          }
+          bench_timer_t timer;
+          bench_timer_init(&timer);
+          bool ok = true;
+          for (int r = 0; ok && bench_more(&timer, n); ++r) {
+            memcpy(work, input, n * size);
+            bench_start(&timer);
+            run((op_t) op, (impl_t) impl, work, out, perm, n, size);
+            bench_stop(&timer);
+            const char *result = (op == OP_GATHER) ? out : work;
+            if (r == 0) {
+              ok = memcmp(result, expected, n * size) == 0;
+            }
+            checksum += (uint8_t) result[(n / 2) * size];
+          }
+
+          double ns = bench_ns_per(&timer, n);
+          if (impl == IMPL_BYTES) {
+            bytes_ns = ns;
+          }
+          char extra[64];
+          if (!ok) {
+            snprintf(extra, sizeof(extra), "%10s", "FAILED");
+            failed = true;
+          } else {
+            snprintf(extra, sizeof(extra), "%10.2f", (bytes_ns > 0.0) ? ns / bytes_ns : 1.0);
+          }
+          bench_row(row_keys, &timer, n, extra);
+        }
+      }
+      free(perm);
+      free(expected);
+      free(out);
+      free(work);
+      free(input);
+    }
+  }
+  fprintf(stderr, "move_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,200 @@
+/* parallel_bench.c - Scaling of the parallel prefix sum and partition of parallel.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * n uint64_t values go through the two primitives:
+ *
+ *   scan       par_exclusive_scan_u64 versus a sequential loop
+ *   partition  par_partition (stable, half of the values satisfy the predicate) versus a
+ *              sequential stable partition through a buffer
+ *
+ * on 1, 2, 4, ... threads up to the number of online processors (at least 4), either started by
+ * every call (threads) or taken from a pool_t created once (pool). A call uses at most one thread
+ * per PAR_MIN_BLOCK elements, so the thread counts that n cannot use are skipped.
+ *
+ * Columns: time per element, the time relative to the sequential row of the same case, and the
+ * parallel efficiency (the speedup over the sequential row divided by the threads).
+ *
+ * Every output is compared with the sequential one, and the benchmark exits with status 1 if one
+ * differs.
+ */
+
+#include "bench.h"
+#include "parallel.h"
+
+typedef enum op_t { OP_SCAN, OP_PARTITION, OPS } op_t;
+typedef enum exec_t { MODE_SEQ, MODE_THREADS, MODE_POOL, MODES } exec_t;
+
+static const char *op_names[OPS] = {"scan", "partition"};
+static const char *mode_names[MODES] = {"seq", "threads", "pool"};
+static const uint64_t parallel_dims[] = {65536, 1 << 20, 1 << 24, 1 << 27};
+
+#define PARALLEL_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static bool below(const void *elem, void *ctx) {
+  return *(const uint64_t *) elem < *(const uint64_t *) ctx;
+}
+
+static uint64_t seq_scan(const uint64_t *input, uint64_t *output, size_t dim) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < dim; ++i) {
+    uint64_t value = input[i];
+    output[i] = sum;
+    sum += value;
+  }
+  return sum;
+}
+
+// Calls the predicate through the same pointer as par_partition, so that only the partition differs
+static size_t seq_partition(uint64_t *input, uint64_t *buffer, size_t dim,
+                            bool (*pred)(const void *elem, void *ctx), void *ctx) {
+  size_t len = 0;
+  size_t rest = 0;
+  for (size_t i = 0; i < dim; ++i) {
+    if (pred(&input[i], ctx)) {
+      input[len++] = input[i];
+    } else {
+      buffer[rest++] = input[i];
+    }
+  }
+  memcpy(input + len, buffer, rest * sizeof(uint64_t));
+  return len;
+}
+
+int main(int argc, char **argv) {
+  bench_init("parallel_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-9s %-7s %7s %10s", "op", "mode", "threads", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s", "vs seq", "efficiency");
+  bench_header(keys_header, extra_header);
+
+  size_t max_threads = par_threads();
+  if (max_threads < 4) {
+    max_threads = 4;
+  }
+  pool_t *pool = pool_new(max_threads);
+  if (pool == NULL) {
+    fprintf(stderr, "parallel_bench: cannot create the pool\n");
+    return 1;
+  }
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  for (size_t ni = 0; ni < PARALLEL_COUNT(parallel_dims); ++ni) {
+    size_t n = (size_t) parallel_dims[ni];
+    // the input, the output and the expected output, one flag per element in par_partition
+    if (!bench_fits(n, (uint64_t) n * (4 * sizeof(uint64_t) + 1))) {
+      continue;
+    }
+    uint64_t *input = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *output = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *expected = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *buffer = (uint64_t *) malloc(n * sizeof(uint64_t));
+    if (input == NULL || output == NULL || expected == NULL || buffer == NULL) {
+      fprintf(stderr, "parallel_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    uint64_t state = 137 + n;
+    for (size_t i = 0; i < n; ++i) {
+      input[i] = bench_rand(&state) % 1000;
+    }
+    uint64_t pivot = 500;
+
+    for (int op = 0; op < OPS; ++op) {
+      size_t expected_len = 0;
+      if (op == OP_SCAN) {
+        expected_len = (size_t) seq_scan(input, expected, n);
+      } else {
+        memcpy(expected, input, n * sizeof(uint64_t));
+        expected_len = seq_partition(expected, buffer, n, below, &pivot);
+      }
+
+      double seq_ns = 0.0;
+      for (int mode = 0; mode < MODES; ++mode) {
+        for (size_t t = 1; t <= max_threads; t *= 2) {
+          if ((mode == MODE_SEQ && t > 1) || (t > 1 && t > n / PAR_MIN_BLOCK)) {
+            continue;
+          }
+          char row_keys[128];
+          snprintf(row_keys, sizeof(row_keys), "%-9s %-7s %7zu %10zu", op_names[op], mode_names[mode], t, n);
+          if (!bench_selected(row_keys)) {
+            continue;
+          }
+          par_set_pool((mode == MODE_POOL) ? pool : NULL);
+          bench_timer_t timer;
+          bench_timer_init(&timer);
+          bool ok = true;
+          for (int r = 0; ok && bench_more(&timer, n); ++r) {
+            size_t len = 0;
+            if (op == OP_PARTITION) {
+              memcpy(output, input, n * sizeof(uint64_t));
+            }
+            bench_start(&timer);
+            if (op == OP_SCAN) {
+              len = (size_t)((mode == MODE_SEQ) ? seq_scan(input, output, n)
+                                                : par_exclusive_scan_u64(input, output, n, t));
+            } else if (mode == MODE_SEQ) {
+              len = seq_partition(output, buffer, n, below, &pivot);
+            } else {
+              len = (size_t) par_partition(output, n, sizeof(uint64_t), below, &pivot, t);
+            }
+            bench_stop(&timer);
+            if (r == 0) {
+              ok = len == expected_len && memcmp(output, expected, n * sizeof(uint64_t)) == 0;
+            }
+            checksum += output[n / 2];
+          }
+          par_set_pool(NULL);
+
+          double ns = bench_ns_per(&timer, n);
+          if (mode == MODE_SEQ) {
+            seq_ns = ns;
+          }
+          char extra[64];
+          if (!ok) {
+            snprintf(extra, sizeof(extra), "%10s %10s", "FAILED", "-");
+            failed = true;
+          } else {
+            double ratio = (seq_ns > 0.0) ? ns / seq_ns : 1.0;
+            snprintf(extra, sizeof(extra), "%10.2f %10.2f", ratio, 1.0 / (ratio * (double) t));
+          }
+          bench_row(row_keys, &timer, n, extra);
+        }
+      }
+    }
+    free(buffer);
+    free(expected);
+    free(output);
+    free(input);
+  }
+  pool_free(pool);
+  fprintf(stderr, "parallel_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,271 @@
+/* pool_bench.c - Scheduling overhead and load balance of the work-stealing pool of pool.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * A loop over n elements where element i costs c(i) rounds of a hash, with four workloads:
+ *
+ *   empty     c(i) = 0 and a grain of 1: every element is a task, the row measures the cost of a
+ *             spawn, a steal or take and a wait
+ *   uniform   c(i) = 64
+ *   triangle  c(i) grows linearly from 1 to 128 along the range
+ *   skewed    one element in 16 costs 964, the others 4
+ *
+ * The irregular workloads average about 64 rounds per element like the uniform one, and run with
+ * a grain of POOL_BENCH_GRAIN elements. The loop runs:
+ *
+ *   seq     a sequential loop (the baseline)
+ *   static  threads started per call, each on a contiguous n / threads slice, as a fixed split
+ *           of the range would do
+ *   pool    pool_parallel_for on a pool_t of that many workers created once, which splits the
+ *           range on the deques of the workers (the calling thread only waits)
+ *
+ * on 1, 2, 4, ... threads up to the number of online processors (at least 4).
+ *
+ * Columns: time per element, the time relative to the seq row of the same case, the parallel
+ * efficiency (the speedup over the seq row divided by the threads) and the load imbalance of the
+ * first repetition: the rounds run by the busiest thread divided by the mean over the threads
+ * that ran some (1.00 is a perfect balance).
+ *
+ * Every output is compared with the sequential one, and the benchmark exits with status 1 if one
+ * differs.
+ */
+
+#include "bench.h"
+#include "pool.h"
+
+/* Elements per task of the workloads other than empty */
+#define POOL_BENCH_GRAIN 256
+
+/* Threads whose work is counted: the workers of the largest pool and the calling thread */
+#define POOL_BENCH_THREADS (POOL_MAX_WORKERS + 1)
+
+typedef enum work_t { WORK_EMPTY, WORK_UNIFORM, WORK_TRIANGLE, WORK_SKEWED, WORKS } work_t;
+typedef enum exec_t { MODE_SEQ, MODE_STATIC, MODE_POOL, MODES } exec_t;
+
+static const char *work_names[WORKS] = {"empty", "uniform", "triangle", "skewed"};
+static const char *mode_names[MODES] = {"seq", "static", "pool"};
+static const uint64_t pool_dims[] = {4096, 65536, 1 << 20, 1 << 24};
+
+#define POOL_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+// Rounds run by every thread, one cache line each
+typedef struct counter_t {
+  uint64_t rounds;
+  char pad[64 - sizeof(uint64_t)];
+} counter_t;
+
+static counter_t counters[POOL_BENCH_THREADS];
+
+// Counter of the threads that are not workers of a pool: the caller, or a static slice
+static POOL__THREAD_LOCAL size_t counter_slot = POOL_BENCH_THREADS - 1;
+
+typedef struct loop_t {
+  const uint32_t *costs;
+  uint64_t *output;
+} loop_t;
+
+static void body(void *ctx, size_t lo, size_t hi) {
+  const loop_t *loop = (const loop_t *) ctx;
+  uint64_t rounds = 0;
+  for (size_t i = lo; i < hi; ++i) {
+    uint64_t x = i;
+    for (uint32_t r = 0; r < loop->costs[i]; ++r) {
+      x = (x ^ (x >> 31)) * 0x9E3779B97F4A7C15ull + r;
+    }
+    loop->output[i] = x;
+    rounds += loop->costs[i];
+  }
+  pool__worker_t *self = pool__self;
+  counters[(self != NULL) ? self->id : counter_slot].rounds += rounds;
+}
+
+typedef struct slice_t {
+  loop_t *loop;
+  size_t lo;
+  size_t hi;
+  size_t id;
+} slice_t;
+
+static void *static_main(void *arg) {
+  slice_t *slice = (slice_t *) arg;
+  size_t slot = counter_slot;
+  counter_slot = slice->id;
+  body(slice->loop, slice->lo, slice->hi);
+  counter_slot = slot;
+  return NULL;
+}
+
+// Runs the loop on 'nthreads' threads started for the call, each on a contiguous slice
+static bool run_static(loop_t *loop, size_t n, size_t nthreads) {
+  pthread_t threads[POOL_MAX_WORKERS];
+  slice_t slices[POOL_MAX_WORKERS];
+  for (size_t i = 0; i < nthreads; ++i) {
+    slices[i].loop = loop;
+    slices[i].lo = n * i / nthreads;
+    slices[i].hi = n * (i + 1) / nthreads;
+    slices[i].id = i;
+  }
+  bool ok = true;
+  for (size_t i = 1; i < nthreads; ++i) {
+    ok = ok && pthread_create(&threads[i], NULL, static_main, &slices[i]) == 0;
+    if (!ok) {
+      nthreads = i;
+    }
+  }
+  static_main(&slices[0]);
+  for (size_t i = 1; i < nthreads; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  bench_init("pool_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-8s %-6s %7s %10s", "work", "mode", "threads", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s %9s", "vs seq", "efficiency", "imbalance");
+  bench_header(keys_header, extra_header);
+
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t max_threads = (online > 4) ? (size_t) online : 4;
+  if (max_threads > POOL_MAX_WORKERS) {
+    max_threads = POOL_MAX_WORKERS;
+  }
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  for (size_t ni = 0; ni < POOL_COUNT(pool_dims); ++ni) {
+    size_t n = (size_t) pool_dims[ni];
+    // the costs, the output and the expected output
+    if (!bench_fits(n, (uint64_t) n * (sizeof(uint32_t) + 2 * sizeof(uint64_t)))) {
+      continue;
+    }
+    uint32_t *costs = (uint32_t *) malloc(n * sizeof(uint32_t));
+    uint64_t *output = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *expected = (uint64_t *) malloc(n * sizeof(uint64_t));
+    if (costs == NULL || output == NULL || expected == NULL) {
+      fprintf(stderr, "pool_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+
+    for (int work = 0; work < WORKS; ++work) {
+      uint64_t state = 149 + n;
+      for (size_t i = 0; i < n; ++i) {
+        switch (work) {
+          case WORK_EMPTY:
+            costs[i] = 0;
+            break;
+          case WORK_UNIFORM:
+            costs[i] = 64;
+            break;
+          case WORK_TRIANGLE:
+            costs[i] = 1 + (uint32_t)((uint64_t) i * 128 / n);
+            break;
+          default:
+            costs[i] = (bench_rand(&state) % 16 == 0) ? 964 : 4;
+            break;
+        }
+      }
+      loop_t loop = {costs, expected};
+      body(&loop, 0, n);
+      loop.output = output;
+      size_t grain = (work == WORK_EMPTY) ? 1 : POOL_BENCH_GRAIN;
+
+      double seq_ns = 0.0;
+      for (int mode = 0; mode < MODES; ++mode) {
+        for (size_t t = 1; t <= max_threads; t *= 2) {
+          if (mode == MODE_SEQ && t > 1) {
+            continue;
+          }
+          char row_keys[128];
+          snprintf(row_keys, sizeof(row_keys), "%-8s %-6s %7zu %10zu", work_names[work], mode_names[mode], t, n);
+          if (!bench_selected(row_keys)) {
+            continue;
+          }
+          pool_t *pool = NULL;
+          if (mode == MODE_POOL && (pool = pool_new(t)) == NULL) {
+            fprintf(stderr, "pool_bench: cannot create a pool of %zu workers\n", t);
+            return 1;
+          }
+          bench_timer_t timer;
+          bench_timer_init(&timer);
+          bool ok = true;
+          double imbalance = 1.0;
+          for (int r = 0; ok && bench_more(&timer, n); ++r) {
+            memset(output, 0, n * sizeof(uint64_t));
+            memset(counters, 0, sizeof(counters));
+            bench_start(&timer);
+            if (mode == MODE_SEQ) {
+              body(&loop, 0, n);
+            } else if (mode == MODE_STATIC) {
+              ok = run_static(&loop, n, t);
+            } else {
+              pool_parallel_for(pool, 0, n, grain, body, &loop);
+            }
+            bench_stop(&timer);
+            if (r == 0) {
+              ok = ok && memcmp(output, expected, n * sizeof(uint64_t)) == 0;
+              uint64_t total = 0;
+              uint64_t busiest = 0;
+              size_t active = 0;
+              for (size_t i = 0; i < POOL_BENCH_THREADS; ++i) {
+                total += counters[i].rounds;
+                busiest = (counters[i].rounds > busiest) ? counters[i].rounds : busiest;
+                active += counters[i].rounds > 0;
+              }
+              imbalance = (total > 0) ? (double) busiest * (double) active / (double) total : 1.0;
+            }
+            checksum += output[n / 2];
+          }
+          pool_free(pool);
+
+          double ns = bench_ns_per(&timer, n);
+          if (mode == MODE_SEQ) {
+            seq_ns = ns;
+          }
+          char extra[64];
+          if (!ok) {
+            snprintf(extra, sizeof(extra), "%10s %10s %9s", "FAILED", "-", "-");
+            failed = true;
+          } else {
+            double ratio = (seq_ns > 0.0) ? ns / seq_ns : 1.0;
+            snprintf(extra, sizeof(extra), "%10.2f %10.2f %9.2f", ratio, 1.0 / (ratio * (double) t), imbalance);
+          }
+          bench_row(row_keys, &timer, n, extra);
+        }
+      }
+    }
+    free(expected);
+    free(output);
+    free(costs);
+  }
+  fprintf(stderr, "pool_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,226 @@
+/* search_bench.c - Binary searches of sorting.h from L1-resident to 1 GB vectors
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * A sorted vector of uint32_t or uint64_t keys of 4 KB, 32 KB, 256 KB, 4 MB, 64 MB and 1 GB
+ * (within the limits of the configuration) answers SEARCH_BENCH_QUERIES lower bound queries for
+ * random keys, half of them present. The searches:
+ *
+ *   plain       the usual binary search with a branch on every step (the baseline; the compiler
+ *               may still turn the branch into a conditional move)
+ *   branchless  s_lower_bound_u32 / s_lower_bound_u64
+ *   batch       s_lower_bound_batch_u32 / s_lower_bound_batch_u64, all the queries in one call
+ *   kary        s_lower_bound_kary_u32 (uint32_t only)
+ *   generic     s_lower_bound through an ordering function
+ *
+ * Columns: time per query, the time relative to the plain row of the same vector, and the size
+ * of the vector in KB.
+ *
+ * Every result is compared with the plain search, and the benchmark exits with status 1 if one
+ * differs.
+ */
+
+#include "bench.h"
+#include "sorting.h"
+
+/* Queries per measure */
+#define SEARCH_BENCH_QUERIES 65536
+
+typedef enum algo_t { ALGO_PLAIN, ALGO_BRANCHLESS, ALGO_BATCH, ALGO_KARY, ALGO_GENERIC, ALGOS } algo_t;
+
+static const char *algo_names[ALGOS] = {"plain", "branchless", "batch", "kary", "generic"};
+static const uint64_t search_bytes[] = {(uint64_t) 4 << 10, (uint64_t) 32 << 10, (uint64_t) 256 << 10,
+                                        (uint64_t) 4 << 20, (uint64_t) 64 << 20, (uint64_t) 1 << 30};
+
+#define SEARCH_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static bool less_u32(const void *lhs, const void *rhs) {
+  return *(const uint32_t *) lhs < *(const uint32_t *) rhs;
+}
+
+static bool less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+#define PLAIN_LOWER_BOUND(input, dim, key) do { \
+    size_t lo = 0;                              \
+    size_t hi = (dim);                          \
+    while (lo < hi) {                           \
+      size_t mid = lo + (hi - lo) / 2;          \
+      if ((input)[mid] < (key)) {               \
+        lo = mid + 1;                           \
+      } else {                                  \
+        hi = mid;                               \
+      }                                         \
+    }                                           \
+    return lo;                                  \
+  } while (0)
+
+static size_t plain_u32(const uint32_t *input, size_t dim, uint32_t key) {
+  PLAIN_LOWER_BOUND(input, dim, key);
+}
+
+static size_t plain_u64(const uint64_t *input, size_t dim, uint64_t key) {
+  PLAIN_LOWER_BOUND(input, dim, key);
+}
+
+// Runs the queries of a search on the vector of 'wide' (uint64_t) or narrow (uint32_t) keys
+static void run_search(algo_t algo, bool wide, const void *input, size_t n, const void *keys, size_t *out) {
+  const uint32_t *in32 = (const uint32_t *) input;
+  const uint64_t *in64 = (const uint64_t *) input;
+  const uint32_t *k32 = (const uint32_t *) keys;
+  const uint64_t *k64 = (const uint64_t *) keys;
+  if (algo == ALGO_BATCH) {
+    if (wide) {
+      s_lower_bound_batch_u64(in64, n, k64, SEARCH_BENCH_QUERIES, out);
+    } else {
+      s_lower_bound_batch_u32(in32, n, k32, SEARCH_BENCH_QUERIES, out);
+    }
+    return;
+  }
+  for (size_t q = 0; q < SEARCH_BENCH_QUERIES; ++q) {
+    switch (algo) {
+      case ALGO_PLAIN:
+        out[q] = wide ? plain_u64(in64, n, k64[q]) : plain_u32(in32, n, k32[q]);
+        break;
+      case ALGO_BRANCHLESS:
+        out[q] = wide ? s_lower_bound_u64(in64, n, k64[q]) : s_lower_bound_u32(in32, n, k32[q]);
+        break;
+      case ALGO_KARY:
+        out[q] = s_lower_bound_kary_u32(in32, n, k32[q]);
+        break;
+      default:
+        out[q] = wide ? s_lower_bound_typed(in64, n, less_u64, &k64[q])
+                      : s_lower_bound_typed(in32, n, less_u32, &k32[q]);
+        break;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  bench_init("search_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-10s %-4s %10s", "search", "type", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s", "vs plain", "KB");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  size_t *expected = (size_t *) malloc(SEARCH_BENCH_QUERIES * sizeof(size_t));
+  size_t *out = (size_t *) malloc(SEARCH_BENCH_QUERIES * sizeof(size_t));
+  uint64_t *keys = (uint64_t *) malloc(SEARCH_BENCH_QUERIES * sizeof(uint64_t));
+  if (expected == NULL || out == NULL || keys == NULL) {
+    fprintf(stderr, "search_bench: out of memory\n");
+    return 1;
+  }
+  for (int wide = 0; wide < 2; ++wide) {
+    size_t ksize = wide ? sizeof(uint64_t) : sizeof(uint32_t);
+    for (size_t bi = 0; bi < SEARCH_COUNT(search_bytes); ++bi) {
+      uint64_t bytes = search_bytes[bi];
+      size_t n = (size_t)(bytes / ksize);
+      if (!bench_fits(n, bytes)) {
+        continue;
+      }
+      void *input = malloc((size_t) bytes);
+      if (input == NULL) {
+        fprintf(stderr, "search_bench: out of memory at n = %zu\n", n);
+        return 1;
+      }
+      // increasing keys with gaps of 1 or 2, then queries: half present keys, half random keys
+      // over the whole range (the missing ones land in the gaps)
+      uint64_t state = 89 + n;
+      uint64_t value = 0;
+      for (size_t i = 0; i < n; ++i) {
+        value += 1 + (bench_rand(&state) & 1);
+        if (wide) {
+          ((uint64_t *) input)[i] = value;
+        } else {
+          ((uint32_t *) input)[i] = (uint32_t) value;
+        }
+      }
+      uint32_t *keys32 = (uint32_t *) keys;
+      for (size_t q = 0; q < SEARCH_BENCH_QUERIES; ++q) {
+        size_t pos = (size_t)(bench_rand(&state) % n);
+        uint64_t key = (q & 1) ? bench_rand(&state) % (value + 2)
+                               : (wide ? ((uint64_t *) input)[pos] : ((uint32_t *) input)[pos]);
+        if (wide) {
+          keys[q] = key;
+        } else {
+          keys32[q] = (uint32_t) key;
+        }
+      }
+      run_search(ALGO_PLAIN, wide != 0, input, n, keys, expected);
+
+      double plain_ns = 0.0;
+      for (int algo = 0; algo < ALGOS; ++algo) {
+        if (algo == ALGO_KARY && wide) {
+          continue;
+        }
+        char row_keys[128];
+        snprintf(row_keys, sizeof(row_keys), "%-10s %-4s %10zu", algo_names[algo], wide ? "u64" : "u32", n);
+        if (!bench_selected(row_keys)) {
+          continue;
+        }
+        bench_timer_t timer;
+        bench_timer_init(&timer);
+        bool ok = true;
+        for (int r = 0; ok && bench_more(&timer, SEARCH_BENCH_QUERIES); ++r) {
+          bench_start(&timer);
+          run_search((algo_t) algo, wide != 0, input, n, keys, out);
+          bench_stop(&timer);
+          if (r == 0) {
+            ok = memcmp(out, expected, SEARCH_BENCH_QUERIES * sizeof(size_t)) == 0;
+          }
+          checksum += out[r % SEARCH_BENCH_QUERIES];
+        }
+
+        double ns = bench_ns_per(&timer, SEARCH_BENCH_QUERIES);
+        if (algo == ALGO_PLAIN) {
+          plain_ns = ns;
+        }
+        char extra[64];
+        if (!ok) {
+          snprintf(extra, sizeof(extra), "%10s %10s", "FAILED", "-");
+          failed = true;
+        } else {
+          snprintf(extra, sizeof(extra), "%10.2f %10llu", (plain_ns > 0.0) ? ns / plain_ns : 1.0,
+                   (unsigned long long)(bytes >> 10));
+        }
+        bench_row(row_keys, &timer, SEARCH_BENCH_QUERIES, extra);
+      }
+      free(input);
+    }
+  }
+  free(keys);
+  free(out);
+  free(expected);
+  fprintf(stderr, "search_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
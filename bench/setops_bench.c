@@ -0,0 +1,284 @@
+/* setops_bench.c - Sorted-array utilities of sorting.h on posting lists
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Posting lists are strictly increasing document IDs. The long list has n IDs drawn from 8n
+ * documents; the short one has n / ratio IDs from the same documents, for ratios 1 (similar
+ * lengths, the SIMD block compares), 8, 64 and 1024 (skewed lengths, the galloping search beyond
+ * S_GALLOP_RATIO). The operations:
+ *
+ *   intersect   s_intersect_u32 versus a plain merge
+ *   union       s_union_u32 versus a plain merge
+ *   difference  s_difference_u32 (long minus short) versus a plain merge
+ *   unique      s_unique_u32 and s_unique versus a plain loop, on the sorted term IDs of n
+ *               tokens (Zipfian over n / 8 terms, ratio 1)
+ *   groups      s_groups_u32 and s_groups versus a plain loop, on the same term IDs
+ *
+ * Columns: time per input element (both lists for the set operations), the time relative to the
+ * plain row of the same case, and the output elements (groups for groups) per input element.
+ * The inputs repeat for every repetition, so at small n the branch predictor can learn them and
+ * the plain merge looks faster than it would be on fresh lists.
+ *
+ * Every output is compared with the plain one, and the benchmark exits with status 1 if one
+ * differs.
+ */
+
+#include "bench.h"
+#include "sorting.h"
+
+typedef enum op_t { OP_INTERSECT, OP_UNION, OP_DIFFERENCE, OP_UNIQUE, OP_GROUPS, OPS } op_t;
+typedef enum impl_t { IMPL_PLAIN, IMPL_U32, IMPL_GENERIC, IMPLS } impl_t;
+
+static const char *op_names[OPS] = {"intersect", "union", "difference", "unique", "groups"};
+static const char *impl_names[IMPLS] = {"plain", "u32", "generic"};
+static const uint64_t setops_dims[] = {4096, 65536, 1 << 20, 1 << 24};
+static const size_t setops_ratios[] = {1, 8, 64, 1024};
+
+#define SETOPS_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static bool less_u32(const void *lhs, const void *rhs) {
+  return *(const uint32_t *) lhs < *(const uint32_t *) rhs;
+}
+
+// Plain merge of two strictly increasing lists
+static size_t plain_setop(op_t op, const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *output) {
+  size_t len = 0;
+  size_t i = 0;
+  size_t j = 0;
+  while (i < na && j < nb) {
+    if (a[i] < b[j]) {
+      if (op != OP_INTERSECT) {
+        output[len++] = a[i];
+      }
+      ++i;
+    } else if (b[j] < a[i]) {
+      if (op == OP_UNION) {
+        output[len++] = b[j];
+      }
+      ++j;
+    } else {
+      if (op != OP_DIFFERENCE) {
+        output[len++] = a[i];
+      }
+      ++i;
+      ++j;
+    }
+  }
+  if (op != OP_INTERSECT) {
+    while (i < na) {
+      output[len++] = a[i++];
+    }
+  }
+  if (op == OP_UNION) {
+    while (j < nb) {
+      output[len++] = b[j++];
+    }
+  }
+  return len;
+}
+
+static size_t plain_unique(uint32_t *input, size_t dim) {
+  size_t len = 0;
+  for (size_t i = 0; i < dim; ++i) {
+    if (len == 0 || input[i] != input[len - 1]) {
+      input[len++] = input[i];
+    }
+  }
+  return len;
+}
+
+static size_t plain_groups(const uint32_t *input, size_t dim, size_t *bounds) {
+  size_t count = 0;
+  for (size_t i = 0; i < dim; ++i) {
+    if (i == 0 || input[i] != input[i - 1]) {
+      bounds[count++] = i;
+    }
+  }
+  bounds[count] = dim;
+  return count;
+}
+
+static int cmp_u32(const void *lhs, const void *rhs) {
+  uint32_t a = *(const uint32_t *) lhs;
+  uint32_t b = *(const uint32_t *) rhs;
+  return (a > b) - (a < b);
+}
+
+// Fills 'list' with 'n' strictly increasing IDs below 'docs' (n <= docs), each document taken
+// with probability n / docs
+static void make_list(uint32_t *list, size_t n, size_t docs, uint64_t seed) {
+  uint64_t state = seed;
+  size_t len = 0;
+  for (size_t d = 0; d < docs && len < n; ++d) {
+    // take the document if a random number below the remaining documents falls below the missing IDs
+    if (bench_rand(&state) % (docs - d) < n - len) {
+      list[len++] = (uint32_t) d;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  bench_init("setops_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-10s %5s %-7s %10s", "op", "ratio", "impl", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s", "vs plain", "out/in");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  for (size_t ni = 0; ni < SETOPS_COUNT(setops_dims); ++ni) {
+    size_t n = (size_t) setops_dims[ni];
+    // the two lists, the output and the expected output, the bounds of groups
+    if (!bench_fits(n, (uint64_t) n * (4 * sizeof(uint32_t) + 2 * sizeof(size_t)))) {
+      continue;
+    }
+    uint32_t *a = (uint32_t *) malloc(n * sizeof(uint32_t));
+    uint32_t *b = (uint32_t *) malloc(n * sizeof(uint32_t));
+    uint32_t *out = (uint32_t *) malloc(2 * n * sizeof(uint32_t));
+    uint32_t *expected = (uint32_t *) malloc(2 * n * sizeof(uint32_t));
+    size_t *bounds = (size_t *) malloc((n + 1) * sizeof(size_t));
+    size_t *expected_bounds = (size_t *) malloc((n + 1) * sizeof(size_t));
+    uint64_t *terms = (uint64_t *) malloc(n * sizeof(uint64_t));
+    if (a == NULL || b == NULL || out == NULL || expected == NULL || bounds == NULL || expected_bounds == NULL ||
+        terms == NULL) {
+      fprintf(stderr, "setops_bench: out of memory at n = %zu\n", n);
+      return 1;
+    }
+    make_list(a, n, 8 * n, 71 + n);
+
+    for (int op = 0; op < OPS; ++op) {
+      bool setop = op == OP_INTERSECT || op == OP_UNION || op == OP_DIFFERENCE;
+      for (size_t ri = 0; ri < SETOPS_COUNT(setops_ratios); ++ri) {
+        size_t ratio = setops_ratios[ri];
+        if (!setop && ratio != 1) {
+          continue;
+        }
+        size_t nb = n / ratio;
+        uint64_t in = setop ? n + nb : n;
+        // the input of the case and its expected output
+        size_t expected_len = 0;
+        if (setop) {
+          make_list(b, nb, 8 * n, 73 + n + ratio);
+          expected_len = plain_setop((op_t) op, a, n, b, nb, expected);
+        } else {
+          bench_fill_u64(terms, n, BENCH_ZIPF, 64, 79 + n);
+          for (size_t i = 0; i < n; ++i) {
+            b[i] = (uint32_t)(terms[i] % (n / 8));
+          }
+          qsort(b, n, sizeof(uint32_t), cmp_u32);
+          memcpy(expected, b, n * sizeof(uint32_t));
+          expected_len = (op == OP_UNIQUE) ? plain_unique(expected, n) : plain_groups(b, n, expected_bounds);
+        }
+
+        double plain_ns = 0.0;
+        for (int impl = 0; impl < IMPLS; ++impl) {
+          if (setop && impl == IMPL_GENERIC) {
+            continue;
+          }
+          char row_keys[128];
+          snprintf(row_keys, sizeof(row_keys), "%-10s %5zu %-7s %10zu", op_names[op], ratio, impl_names[impl], n);
+          if (!bench_selected(row_keys)) {
+            continue;
+          }
+          bench_timer_t timer;
+          bench_timer_init(&timer);
+          bool ok = true;
+          for (int r = 0; ok && bench_more(&timer, in); ++r) {
+            size_t len = 0;
+            if (op == OP_UNIQUE) {
+              memcpy(out, b, n * sizeof(uint32_t));
+            }
+            bench_start(&timer);
+            if (setop) {
+              if (impl == IMPL_PLAIN) {
+                len = plain_setop((op_t) op, a, n, b, nb, out);
+              } else if (op == OP_INTERSECT) {
+                len = s_intersect_u32(a, n, b, nb, out);
+              } else if (op == OP_UNION) {
+                len = s_union_u32(a, n, b, nb, out);
+              } else {
+                len = s_difference_u32(a, n, b, nb, out);
+              }
+            } else if (op == OP_UNIQUE) {
+              if (impl == IMPL_PLAIN) {
+                len = plain_unique(out, n);
+              } else if (impl == IMPL_U32) {
+                len = s_unique_u32(out, n);
+              } else {
+                len = (size_t) s_unique_typed(out, n, less_u32);
+              }
+            } else {
+              if (impl == IMPL_PLAIN) {
+                len = plain_groups(b, n, bounds);
+              } else if (impl == IMPL_U32) {
+                len = s_groups_u32(b, n, bounds);
+              } else {
+                len = (size_t) s_groups_typed(b, n, less_u32, bounds);
+              }
+            }
+            bench_stop(&timer);
+            if (r == 0) {
+              ok = len == expected_len;
+              if (ok && op == OP_GROUPS) {
+                ok = memcmp(bounds, expected_bounds, (len + 1) * sizeof(size_t)) == 0;
+              } else if (ok) {
+                ok = len == 0 || memcmp(out, expected, len * sizeof(uint32_t)) == 0;
+              }
+            }
+            checksum += len;
+          }
+
+          double ns = bench_ns_per(&timer, in);
+          if (impl == IMPL_PLAIN) {
+            plain_ns = ns;
+          }
+          char extra[64];
+          if (!ok) {
+            snprintf(extra, sizeof(extra), "%10s %10s", "FAILED", "-");
+            failed = true;
+          } else {
+            snprintf(extra, sizeof(extra), "%10.2f %10.3f", (plain_ns > 0.0) ? ns / plain_ns : 1.0,
+                     (double) expected_len / (double) in);
+          }
+          bench_row(row_keys, &timer, in, extra);
+        }
+      }
+    }
+    free(terms);
+    free(expected_bounds);
+    free(bounds);
+    free(expected);
+    free(out);
+    free(b);
+    free(a);
+  }
+  fprintf(stderr, "setops_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,279 @@
+/* sort_bench.c - Benchmark of the sorting algorithms of sorting.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Every sorting algorithm runs on every distribution of bench.h, on records of 4 to 256 bytes
+ * whose key is their first 4 bytes (4-byte records) or 8 bytes (larger records), for n from 16 to
+ * 10^8 within the limits of the configuration. The generic algorithms sort records through an
+ * ordering function; the typed ones (radix, counting, bucket, typed s_sort) run on the 4 and 8
+ * byte records, which are plain keys. qsort is the baseline.
+ *
+ * Columns: best time per element, then comparisons and element moves per element and the peak
+ * temporary memory in bytes per element, counted by SORTING_STATS during the first repetition
+ * (qsort only reports its comparisons). The working set of a case is three times the input:
+ * the input, the copy being sorted and the temporary buffer of the merge sorts. The quadratic
+ * sorts only run up to SORT_BENCH_QUADRATIC_MAX elements.
+ *
+ * Every sorted output is checked, and the benchmark exits with status 1 if one is not sorted.
+ */
+
+#define SORTING_STATS
+#include "bench.h"
+#include "sorting.h"
+
+/* Largest input of the quadratic sorts (insertion and selection) */
+#define SORT_BENCH_QUADRATIC_MAX 4096
+
+typedef enum sort_kind_t {
+  SORT_GENERIC,  // records of any size, through the ordering function
+  SORT_U32,      // 4-byte records as uint32_t keys
+  SORT_U64,      // 8-byte records as uint64_t keys
+  SORT_F32,      // 4-byte records as float values
+  SORT_F64,      // 8-byte records as double values
+  SORT_QSORT     // the C library
+} sort_kind_t;
+
+typedef struct sort_algo_t {
+  const char *name;
+  sort_kind_t kind;
+  int64_t (*generic)(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs));
+  int64_t (*u32)(uint32_t *keys, size_t dim);
+  int64_t (*u64)(uint64_t *keys, size_t dim);
+  bool quadratic;
+} sort_algo_t;
+
+static int64_t sort_bucket_f32(uint32_t *keys, size_t dim) {
+  return s_bucket_f32((float *) keys, dim);
+}
+
+static int64_t sort_bucket_f64(uint64_t *keys, size_t dim) {
+  return s_bucket_f64((double *) keys, dim);
+}
+
+static const sort_algo_t sort_algos[] = {
+  {"qsort",          SORT_QSORT,   NULL,        NULL,            NULL,            false},
+  {"s_insertion",    SORT_GENERIC, s_insertion, NULL,            NULL,            true},
+  {"s_selection",    SORT_GENERIC, s_selection, NULL,            NULL,            true},
+  {"s_merge",        SORT_GENERIC, s_merge,     NULL,            NULL,            false},
+  {"s_heap",         SORT_GENERIC, s_heap,      NULL,            NULL,            false},
+  {"s_sort",         SORT_GENERIC, s_sort,      NULL,            NULL,            false},
+  {"s_radix_u32",    SORT_U32,     NULL,        s_radix_u32,     NULL,            false},
+  {"s_counting_u32", SORT_U32,     NULL,        s_counting_u32,  NULL,            false},
+  {"s_sort_u32",     SORT_U32,     NULL,        s_sort_u32,      NULL,            false},
+  {"s_bucket_f32",   SORT_F32,     NULL,        sort_bucket_f32, NULL,            false},
+  {"s_radix_u64",    SORT_U64,     NULL,        NULL,            s_radix_u64,     false},
+  {"s_sort_u64",     SORT_U64,     NULL,        NULL,            s_sort_u64,      false},
+  {"s_bucket_f64",   SORT_F64,     NULL,        NULL,            sort_bucket_f64, false},
+};
+
+static const size_t sort_sizes[] = {4, 8, 16, 32, 64, 128, 256};
+static const uint64_t sort_dims[] = {16, 256, 4096, 65536, 1 << 20, 1 << 24, 100000000};
+
+#define SORT_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+// Comparisons performed by qsort
+static uint64_t sort_qsort_comparisons = 0;
+
+static bool less_u32(const void *lhs, const void *rhs) {
+  return *(const uint32_t *) lhs < *(const uint32_t *) rhs;
+}
+
+static bool less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+static bool less_f32(const void *lhs, const void *rhs) {
+  return *(const float *) lhs < *(const float *) rhs;
+}
+
+static bool less_f64(const void *lhs, const void *rhs) {
+  return *(const double *) lhs < *(const double *) rhs;
+}
+
+static int cmp_u32(const void *lhs, const void *rhs) {
+  uint32_t a = *(const uint32_t *) lhs;
+  uint32_t b = *(const uint32_t *) rhs;
+  ++sort_qsort_comparisons;
+  return (a > b) - (a < b);
+}
+
+static int cmp_u64(const void *lhs, const void *rhs) {
+  uint64_t a = *(const uint64_t *) lhs;
+  uint64_t b = *(const uint64_t *) rhs;
+  ++sort_qsort_comparisons;
+  return (a > b) - (a < b);
+}
+
+// Returns true if an algorithm applies to records of 'size' bytes
+static bool sort_applies(const sort_algo_t *algo, size_t size) {
+  switch (algo->kind) {
+    case SORT_U32:
+    case SORT_F32:
+      return size == 4;
+    case SORT_U64:
+    case SORT_F64:
+      return size == 8;
+    default:
+      return true;
+  }
+}
+
+// Builds records of 'size' bytes from keys: the key, then payload bytes
+static void sort_make_records(char *records, const uint64_t *keys, size_t n, size_t size, sort_kind_t kind) {
+  for (size_t i = 0; i < n; ++i) {
+    char *rec = records + i * size;
+    if (kind == SORT_F32) {
+      float value = (float) keys[i];
+      memcpy(rec, &value, 4);
+    } else if (kind == SORT_F64) {
+      double value = (double) keys[i];
+      memcpy(rec, &value, 8);
+    } else if (size == 4) {
+      uint32_t key = (uint32_t) keys[i];
+      memcpy(rec, &key, 4);
+    } else {
+      memcpy(rec, &keys[i], 8);
+      memset(rec + 8, (int)(i & 0xFF), size - 8);
+    }
+  }
+}
+
+static bool (*sort_order(sort_kind_t kind, size_t size))(const void *lhs, const void *rhs) {
+  if (kind == SORT_F32) {
+    return less_f32;
+  }
+  if (kind == SORT_F64) {
+    return less_f64;
+  }
+  return (size == 4) ? less_u32 : less_u64;
+}
+
+static int64_t sort_run(const sort_algo_t *algo, char *work, size_t n, size_t size) {
+  switch (algo->kind) {
+    case SORT_QSORT:
+      qsort(work, n, size, (size == 4) ? cmp_u32 : cmp_u64);
+      return (int64_t) n;
+    case SORT_U32:
+    case SORT_F32:
+      return algo->u32((uint32_t *) work, n);
+    case SORT_U64:
+    case SORT_F64:
+      return algo->u64((uint64_t *) work, n);
+    default:
+      return algo->generic(work, n, size, sort_order(SORT_GENERIC, size));
+  }
+}
+
+static bool sort_check(const char *work, size_t n, size_t size, sort_kind_t kind) {
+  bool (*order)(const void *lhs, const void *rhs) = sort_order(kind, size);
+  for (size_t i = 1; i < n; ++i) {
+    if (order(work + i * size, work + (i - 1) * size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bench_init("sort_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-14s %-10s %5s %10s", "algorithm", "dist", "size", "n");
+  char extra_header[128];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s %10s", "cmp/elem", "moves/elem", "mem B/elem");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  for (size_t si = 0; si < SORT_COUNT(sort_sizes); ++si) {
+    size_t size = sort_sizes[si];
+    for (size_t ni = 0; ni < SORT_COUNT(sort_dims); ++ni) {
+      size_t n = (size_t) sort_dims[ni];
+      if (!bench_fits(n, 3 * (uint64_t) n * size)) {
+        continue;
+      }
+      uint64_t *keys = (uint64_t *) malloc(n * sizeof(uint64_t));
+      char *input = (char *) malloc(n * size);
+      char *work = (char *) malloc(n * size);
+      if (keys == NULL || input == NULL || work == NULL) {
+        fprintf(stderr, "sort_bench: out of memory at n = %zu, size = %zu\n", n, size);
+        return 1;
+      }
+      for (int d = 0; d < BENCH_DISTS; ++d) {
+        bench_fill_u64(keys, n, (bench_dist_t) d, (size == 4) ? 32 : 64, 42 + (uint64_t) d);
+        for (size_t a = 0; a < SORT_COUNT(sort_algos); ++a) {
+          const sort_algo_t *algo = &sort_algos[a];
+          if (!sort_applies(algo, size) || (algo->quadratic && n > SORT_BENCH_QUADRATIC_MAX)) {
+            continue;
+          }
+          char row_keys[128];
+          snprintf(row_keys, sizeof(row_keys), "%-14s %-10s %5zu %10zu", algo->name,
+                   bench_dist_name((bench_dist_t) d), size, n);
+          if (!bench_selected(row_keys)) {
+            continue;
+          }
+          sort_make_records(input, keys, n, size, algo->kind);
+
+          bench_timer_t timer;
+          bench_timer_init(&timer);
+          s_stats_t stats = {0, 0, 0, 0};
+          uint64_t qsort_comparisons = 0;
+          bool ok = true;
+          for (int r = 0; ok && bench_more(&timer, n); ++r) {
+            memcpy(work, input, n * size);
+            s_stats_reset();
+            sort_qsort_comparisons = 0;
+            bench_start(&timer);
+            int64_t result = sort_run(algo, work, n, size);
+            bench_stop(&timer);
+            if (r == 0) {
+              stats = s_stats_get();
+              qsort_comparisons = sort_qsort_comparisons;
+              ok = result == (int64_t) n && sort_check(work, n, size, algo->kind);
+            }
+          }
+
+          char extra[128];
+          if (!ok) {
+            snprintf(extra, sizeof(extra), "%10s %10s %10s", "FAILED", "-", "-");
+            failed = true;
+          } else if (algo->kind == SORT_QSORT) {
+            snprintf(extra, sizeof(extra), "%10.2f %10s %10s", (double) qsort_comparisons / (double) n, "-", "-");
+          } else {
+            snprintf(extra, sizeof(extra), "%10.2f %10.2f %10.1f", (double) stats.comparisons / (double) n,
+                     (double) stats.moves / (double) n, (double) stats.peak_memory / (double) n);
+          }
+          bench_row(row_keys, &timer, n, extra);
+        }
+      }
+      free(work);
+      free(input);
+      free(keys);
+    }
+  }
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,249 @@
+/* string_bench.c - String sorts of sorting.h versus qsort and strcmp
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Two sets of n strings with long shared prefixes, in random order:
+ *
+ *   url  URLs of a few hundred hosts (Zipfian over the hosts), with paths and a query id
+ *   log  log keys: a timestamp within one day, a host, a level and a request id, as in
+ *        "2025-06-01T13:07:42.118Z web-017 INFO req=00000000004d2f1a"
+ *
+ * The sorts: qsort with strcmp (the baseline), s_sort through an ordering function that calls
+ * strcmp, s_strings_mkqs and s_strings_msd on the char * vector, and s_pstrs_mkqs and s_pstrs_msd
+ * on the views of a length-prefixed table of the same strings (built by s_pstrs_from_table
+ * outside the timed region).
+ *
+ * Columns: time per string, the time relative to the qsort row of the same set, and the average
+ * length of the longest common prefix of adjacent sorted strings (the bytes every sort must read
+ * to tell them apart, the same for every row of a set).
+ *
+ * Every sorted output is checked, and the benchmark exits with status 1 if one is not sorted.
+ */
+
+#include "bench.h"
+#include "sorting.h"
+
+/* Hosts of the URLs and the logs */
+#define STRING_BENCH_HOSTS 300
+
+/* Longest string, terminator included */
+#define STRING_BENCH_STRIDE 80
+
+typedef enum strset_t { SET_URL, SET_LOG, STRSETS } strset_t;
+typedef enum algo_t { ALGO_QSORT, ALGO_SORT, ALGO_MKQS, ALGO_MSD, ALGO_PSTRS_MKQS, ALGO_PSTRS_MSD, ALGOS } algo_t;
+
+static const char *strset_names[STRSETS] = {"url", "log"};
+static const char *algo_names[ALGOS] = {"qsort", "s_sort", "s_strings_mkqs", "s_strings_msd", "s_pstrs_mkqs",
+                                        "s_pstrs_msd"};
+static const uint64_t string_dims[] = {256, 4096, 65536, 1 << 20, 1 << 24};
+
+#define STRING_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static int cmp_str(const void *lhs, const void *rhs) {
+  return strcmp(*(char *const *) lhs, *(char *const *) rhs);
+}
+
+static bool less_str(const void *lhs, const void *rhs) {
+  return strcmp(*(char *const *) lhs, *(char *const *) rhs) < 0;
+}
+
+static int cmp_pstr(const s_pstr_t *a, const s_pstr_t *b) {
+  size_t len = (a->len < b->len) ? a->len : b->len;
+  int c = (len == 0) ? 0 : memcmp(a->data, b->data, len);
+  if (c != 0) {
+    return c;
+  }
+  return (a->len > b->len) - (a->len < b->len);
+}
+
+// Index in [0, hosts) with a Zipfian distribution
+static unsigned zipf_host(uint64_t *state) {
+  double u = (double)(bench_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+  return (unsigned)(exp(u * log((double) STRING_BENCH_HOSTS + 1.0)) - 1.0);
+}
+
+// Builds the strings of a set in 'text' and the vector of pointers to them, in random order
+static void make_strings(strset_t set, char *text, char **strs, size_t n) {
+  static const char *levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+  uint64_t state = 211 + n + (uint64_t) set;
+  for (size_t i = 0; i < n; ++i) {
+    char *s = text + i * STRING_BENCH_STRIDE;
+    if (set == SET_URL) {
+      snprintf(s, STRING_BENCH_STRIDE, "https://www.host%u.example.com/section%u/item%u?id=%zu", zipf_host(&state),
+               (unsigned)(bench_rand(&state) % 20), (unsigned)(bench_rand(&state) % 1000), i);
+    } else {
+      unsigned ms = (unsigned)(bench_rand(&state) % 86400000);
+      snprintf(s, STRING_BENCH_STRIDE, "2025-06-01T%02u:%02u:%02u.%03uZ web-%03u %s req=%016llx", ms / 3600000,
+               ms / 60000 % 60, ms / 1000 % 60, ms % 1000, zipf_host(&state),
+               levels[bench_rand(&state) % STRING_COUNT(levels)], (unsigned long long) bench_rand(&state));
+    }
+    strs[i] = s;
+  }
+  for (size_t i = n; i > 1; --i) {
+    size_t j = (size_t)(bench_rand(&state) % i);
+    char *tmp = strs[i - 1];
+    strs[i - 1] = strs[j];
+    strs[j] = tmp;
+  }
+}
+
+// Writes the strings as a table of length-prefixed entries and returns its size in bytes
+static size_t make_table(char *const *strs, size_t n, char *table) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t len = (uint32_t) strlen(strs[i]);
+    memcpy(table + bytes, &len, sizeof(uint32_t));
+    memcpy(table + bytes + sizeof(uint32_t), strs[i], len);
+    bytes += sizeof(uint32_t) + len;
+  }
+  return bytes;
+}
+
+// Average length of the longest common prefix of adjacent strings of a sorted vector
+static double average_lcp(char *const *sorted, size_t n) {
+  uint64_t total = 0;
+  for (size_t i = 1; i < n; ++i) {
+    const char *a = sorted[i - 1];
+    const char *b = sorted[i];
+    size_t l = 0;
+    while (a[l] != '\0' && a[l] == b[l]) {
+      ++l;
+    }
+    total += l;
+  }
+  return (n > 1) ? (double) total / (double)(n - 1) : 0.0;
+}
+
+int main(int argc, char **argv) {
+  bench_init("string_bench", argc, argv);
+  char keys_header[128];
+  snprintf(keys_header, sizeof(keys_header), "%-14s %-4s %10s", "algorithm", "set", "n");
+  char extra_header[64];
+  snprintf(extra_header, sizeof(extra_header), "%10s %10s", "vs qsort", "avg lcp");
+  bench_header(keys_header, extra_header);
+
+  bool failed = false;
+  uint64_t checksum = 0;
+  for (int set = 0; set < STRSETS; ++set) {
+    for (size_t ni = 0; ni < STRING_COUNT(string_dims); ++ni) {
+      size_t n = (size_t) string_dims[ni];
+      // the text, the table, the input and work vectors, and the temporary memory of the sorts
+      if (!bench_fits(n, (uint64_t) n * (2 * STRING_BENCH_STRIDE + 4 * sizeof(char *) + 48))) {
+        continue;
+      }
+      char *text = (char *) malloc(n * STRING_BENCH_STRIDE);
+      char *table = (char *) malloc(n * (STRING_BENCH_STRIDE + sizeof(uint32_t)));
+      char **input = (char **) malloc(n * sizeof(char *));
+      char **work = (char **) malloc(n * sizeof(char *));
+      s_pstr_t *views = (s_pstr_t *) malloc(n * sizeof(s_pstr_t));
+      s_pstr_t *pwork = (s_pstr_t *) malloc(n * sizeof(s_pstr_t));
+      if (text == NULL || table == NULL || input == NULL || work == NULL || views == NULL || pwork == NULL) {
+        fprintf(stderr, "string_bench: out of memory at n = %zu\n", n);
+        return 1;
+      }
+      make_strings((strset_t) set, text, input, n);
+      make_table(input, n, table);
+      s_pstrs_from_table(table, n, views);
+      memcpy(work, input, n * sizeof(char *));
+      qsort(work, n, sizeof(char *), cmp_str);
+      double lcp = average_lcp(work, n);
+
+      double qsort_ns = 0.0;
+      for (int algo = 0; algo < ALGOS; ++algo) {
+        char row_keys[128];
+        snprintf(row_keys, sizeof(row_keys), "%-14s %-4s %10zu", algo_names[algo], strset_names[set], n);
+        if (!bench_selected(row_keys)) {
+          continue;
+        }
+        bool pstrs = algo == ALGO_PSTRS_MKQS || algo == ALGO_PSTRS_MSD;
+        bench_timer_t timer;
+        bench_timer_init(&timer);
+        bool ok = true;
+        for (int r = 0; ok && bench_more(&timer, n); ++r) {
+          int64_t result = (int64_t) n;
+          if (pstrs) {
+            memcpy(pwork, views, n * sizeof(s_pstr_t));
+          } else {
+            memcpy(work, input, n * sizeof(char *));
+          }
+          bench_start(&timer);
+          switch ((algo_t) algo) {
+            case ALGO_QSORT:
+              qsort(work, n, sizeof(char *), cmp_str);
+              break;
+            case ALGO_SORT:
+              result = s_sort(work, n, sizeof(char *), less_str);
+              break;
+            case ALGO_MKQS:
+              result = s_strings_mkqs(work, n);
+              break;
+            case ALGO_MSD:
+              result = s_strings_msd(work, n);
+              break;
+            case ALGO_PSTRS_MKQS:
+              result = s_pstrs_mkqs(pwork, n);
+              break;
+            default:
+              result = s_pstrs_msd(pwork, n);
+              break;
+          }
+          bench_stop(&timer);
+          if (r == 0) {
+            ok = result == (int64_t) n;
+            for (size_t i = 1; ok && i < n; ++i) {
+              ok = pstrs ? cmp_pstr(&pwork[i - 1], &pwork[i]) <= 0 : strcmp(work[i - 1], work[i]) <= 0;
+            }
+          }
+          checksum += pstrs ? pwork[n / 2].len : (uint64_t) strlen(work[n / 2]);
+        }
+
+        double ns = bench_ns_per(&timer, n);
+        if (algo == ALGO_QSORT) {
+          qsort_ns = ns;
+        }
+        char extra[64];
+        if (!ok) {
+          snprintf(extra, sizeof(extra), "%10s %10s", "FAILED", "-");
+          failed = true;
+        } else {
+          snprintf(extra, sizeof(extra), "%10.2f %10.1f", (qsort_ns > 0.0) ? ns / qsort_ns : 1.0, lcp);
+        }
+        bench_row(row_keys, &timer, n, extra);
+      }
+      free(pwork);
+      free(views);
+      free(work);
+      free(input);
+      free(table);
+      free(text);
+    }
+  }
+  fprintf(stderr, "string_bench: checksum %llu\n", (unsigned long long) checksum);
+  return failed ? 1 : 0;
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
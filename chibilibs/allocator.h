@@ -0,0 +1,166 @@
+/* allocator.h - Allocator interface shared by the chibilibs containers
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * An allocator is a table of three callbacks and a context pointer. vectors.h, hash.h and
+ * sorting.h take their memory from an allocator instead of calling malloc directly, so that,
+ * for example, all the containers of a request can live in one arena (arena.h) and be released
+ * at once.
+ *
+ * Every callback receives the size of the block (and its alignment when it is allocated), so
+ * that allocators do not need to store a header in front of every block.
+ *
+ * A NULL allocator pointer selects the heap allocator (malloc, realloc and free, or their
+ * aligned versions when the requested alignment is larger than the malloc one).
+ */
+
+#ifndef CHIBI_ALLOCATOR_H
+#define CHIBI_ALLOCATOR_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Alignment guaranteed by malloc, and used by the containers for their blocks */
+#define CHIBI_DEFAULT_ALIGN 16
+
+typedef struct chibi_allocator_t {
+  // Returns a block of 'bytes' bytes aligned to 'align' (a power of two), or NULL
+  void *(*alloc)(void *ctx, size_t bytes, size_t align);
+  // Grows or shrinks a block keeping its content, or returns NULL and leaves it unchanged
+  void *(*resize)(void *ctx, void *ptr, size_t old_bytes, size_t bytes, size_t align);
+  // Releases a block
+  void (*release)(void *ctx, void *ptr, size_t bytes);
+  void *ctx;
+} chibi_allocator_t;
+
+/* Returns the heap allocator, the one selected by a NULL allocator pointer.
+ */
+static inline const chibi_allocator_t *chibi_heap_allocator(void);
+
+/* Allocation through an allocator (NULL selects the heap allocator).
+ * chibi_alloc returns NULL on failure; chibi_resize returns NULL on failure and leaves the
+ * block unchanged; chibi_release ignores NULL blocks.
+ */
+static inline void *chibi_alloc(const chibi_allocator_t *allocator, size_t bytes, size_t align);
+static inline void *chibi_resize(const chibi_allocator_t *allocator, void *ptr, size_t old_bytes, size_t bytes, size_t align);
+static inline void chibi_release(const chibi_allocator_t *allocator, void *ptr, size_t bytes);
+
+// MSVC cannot mix _aligned_malloc with free, so the heap allocator always uses the aligned functions there
+#ifdef _MSC_VER
+static inline void *chibi__heap_alloc(void *ctx, size_t bytes, size_t align) {
+  (void) ctx;
+  return _aligned_malloc(bytes, align);
+}
+
+static inline void *chibi__heap_resize(void *ctx, void *ptr, size_t old_bytes, size_t bytes, size_t align) {
+  (void) ctx;
+  (void) old_bytes;
+  return _aligned_realloc(ptr, bytes, align);
+}
+
+static inline void chibi__heap_release(void *ctx, void *ptr, size_t bytes) {
+  (void) ctx;
+  (void) bytes;
+  _aligned_free(ptr);
+}
+#else
+static inline void *chibi__heap_alloc(void *ctx, size_t bytes, size_t align) {
+  (void) ctx;
+  if (align <= CHIBI_DEFAULT_ALIGN) {
+    return malloc(bytes);
+  }
+  // aligned_alloc wants a multiple of the alignment
+  return aligned_alloc(align, (bytes + align - 1) & ~(align - 1));
+}
+
+static inline void *chibi__heap_resize(void *ctx, void *ptr, size_t old_bytes, size_t bytes, size_t align) {
+  if (align <= CHIBI_DEFAULT_ALIGN) {
+    return realloc(ptr, bytes);
+  }
+  // realloc does not keep larger alignments
+  void *aligned = chibi__heap_alloc(ctx, bytes, align);
+  if (aligned != NULL) {
+    memcpy(aligned, ptr, (old_bytes < bytes) ? old_bytes : bytes);
+    free(ptr);
+  }
+  return aligned;
+}
+
+static inline void chibi__heap_release(void *ctx, void *ptr, size_t bytes) {
+  (void) ctx;
+  (void) bytes;
+  free(ptr);
+}
+#endif
+
+static inline const chibi_allocator_t *chibi_heap_allocator(void) {
+  static const chibi_allocator_t heap = {chibi__heap_alloc, chibi__heap_resize, chibi__heap_release, NULL};
+  return &heap;
+}
+
+static inline void *chibi_alloc(const chibi_allocator_t *allocator, size_t bytes, size_t align) {
+  if (allocator == NULL) {
+    return chibi__heap_alloc(NULL, bytes, align);
+  }
+  return allocator->alloc(allocator->ctx, bytes, align);
+}
+
+static inline void *chibi_resize(const chibi_allocator_t *allocator, void *ptr, size_t old_bytes, size_t bytes, size_t align) {
+  if (allocator == NULL) {
+    return chibi__heap_resize(NULL, ptr, old_bytes, bytes, align);
+  }
+  return allocator->resize(allocator->ctx, ptr, old_bytes, bytes, align);
+}
+
+static inline void chibi_release(const chibi_allocator_t *allocator, void *ptr, size_t bytes) {
+  if (ptr == NULL) {
+    return;
+  }
+  if (allocator == NULL) {
+    chibi__heap_release(NULL, ptr, bytes);
+  } else {
+    allocator->release(allocator->ctx, ptr, bytes);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
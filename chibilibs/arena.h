@@ -0,0 +1,271 @@
+/* arena.h - Arena (bump pointer) allocator
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * An arena serves allocations by bumping a pointer inside a chunk of memory, and releases them
+ * all at once. It fits request-scoped workloads: everything allocated while serving a request
+ * goes into the arena, and the arena is reset when the request is done.
+ *
+ * - chunks are taken from the heap and chained; when the current chunk is full a new one is
+ *   added, at least ARENA_CHUNK_SIZE bytes (or the chunk size given to arena_init) large.
+ *   Allocations larger than a chunk get a chunk of their own.
+ * - every allocation can ask for any power of two alignment.
+ * - arena_save and arena_restore release everything allocated after a mark (a stack discipline).
+ * - arena_reset releases everything but keeps the first chunk for reuse.
+ * - single allocations are never released, except the last one, which can also grow or shrink
+ *   in place: a vector growing at the top of the arena does not copy its elements.
+ *
+ * arena_allocator returns a chibi_allocator_t (allocator.h), so that vectors.h, hash.h and
+ * sorting.h can allocate from the arena.
+ *
+ * Arenas are not thread safe.
+ */
+
+#ifndef CHIBI_ARENA_H
+#define CHIBI_ARENA_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "allocator.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Default size of the chunks, in bytes */
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct arena__chunk_t {
+  struct arena__chunk_t *prev;  // older chunk
+  size_t capacity;              // bytes after the header
+  size_t used;
+} arena__chunk_t;
+
+typedef struct arena_t {
+  arena__chunk_t *chunk;   // current chunk
+  size_t chunk_size;
+  char *last;              // last allocation, the only one that can be resized in place
+  chibi_allocator_t allocator;
+} arena_t;
+
+/* A position in the arena, returned by arena_save */
+typedef struct arena_mark_t {
+  arena__chunk_t *chunk;
+  size_t used;
+} arena_mark_t;
+
+/* Initializes an empty arena. No memory is taken until the first allocation.
+ * Arguments:
+ * - the arena
+ * - the minimum size of the chunks, in bytes (0 selects ARENA_CHUNK_SIZE)
+ */
+static inline void arena_init(arena_t *arena, size_t chunk_size);
+
+/* Allocates 'bytes' bytes aligned to 'align' (a power of two).
+ * Return:
+ * - the memory, or NULL if a new chunk was needed and could not be allocated
+ */
+static inline void *arena_alloc(arena_t *arena, size_t bytes, size_t align);
+
+/* Resizes an allocation. The last allocation of the arena is resized in place when the chunk has
+ * room, any other one is copied to a new allocation.
+ * Return:
+ * - the resized memory, or NULL on failure (the old allocation is left unchanged)
+ */
+static inline void *arena_resize(arena_t *arena, void *ptr, size_t old_bytes, size_t bytes, size_t align);
+
+/* Returns the current position of the arena.
+ */
+static inline arena_mark_t arena_save(const arena_t *arena);
+
+/* Releases everything allocated after the mark. The chunks added after it are freed.
+ */
+static inline void arena_restore(arena_t *arena, arena_mark_t mark);
+
+/* Releases all the allocations, keeping the first chunk for reuse.
+ */
+static inline void arena_reset(arena_t *arena);
+
+/* Releases the allocations and returns all the chunks to the heap.
+ */
+static inline void arena_free(arena_t *arena);
+
+/* Returns an allocator that allocates from the arena. It stays valid as long as the arena is
+ * neither moved nor freed. Releasing a block through it is a no-op, except for the last one.
+ */
+static inline const chibi_allocator_t *arena_allocator(arena_t *arena);
+
+#ifdef __cplusplus
+#define arena__alignof(type) alignof(type)
+#else
+#define arena__alignof(type) _Alignof(type)
+#endif
+
+/* Typed interface: allocates 'n' elements of 'type' */
+#define arena_alloc_typed(arena, type, n) ((type *) arena_alloc((arena), sizeof(type) * (n), arena__alignof(type)))
+
+static inline void arena_init(arena_t *arena, size_t chunk_size) {
+  arena->chunk = NULL;
+  arena->chunk_size = (chunk_size > 0) ? chunk_size : ARENA_CHUNK_SIZE;
+  arena->last = NULL;
+  arena->allocator.alloc = NULL;
+  arena->allocator.resize = NULL;
+  arena->allocator.release = NULL;
+  arena->allocator.ctx = NULL;
+}
+
+// First byte of the data area of a chunk
+#define arena__data(chunk) ((char *)((arena__chunk_t *)(chunk) + 1))
+
+// Bump-allocates from the current chunk, NULL if it has no room
+static inline void *arena__bump(arena_t *arena, size_t bytes, size_t align) {
+  arena__chunk_t *chunk = arena->chunk;
+  if (chunk == NULL) {
+    return NULL;
+  }
+  uintptr_t base = (uintptr_t) arena__data(chunk);
+  uintptr_t start = (base + chunk->used + align - 1) & ~(uintptr_t)(align - 1);
+  if (start - base > chunk->capacity || bytes > chunk->capacity - (start - base)) {
+    return NULL;
+  }
+  chunk->used = (size_t)(start - base) + bytes;
+  arena->last = (char *) start;
+  return (void *) start;
+}
+
+static inline void *arena_alloc(arena_t *arena, size_t bytes, size_t align) {
+  void *ptr = arena__bump(arena, bytes, align);
+  if (ptr != NULL) {
+    return ptr;
+  }
+  // worst case padding is align - 1 bytes
+  size_t capacity = (bytes + align - 1 > arena->chunk_size) ? bytes + align - 1 : arena->chunk_size;
+  arena__chunk_t *chunk = (arena__chunk_t *) malloc(sizeof(arena__chunk_t) + capacity);
+  if (chunk == NULL) {
+    return NULL;
+  }
+  chunk->prev = arena->chunk;
+  chunk->capacity = capacity;
+  chunk->used = 0;
+  arena->chunk = chunk;
+  return arena__bump(arena, bytes, align);
+}
+
+static inline void *arena_resize(arena_t *arena, void *ptr, size_t old_bytes, size_t bytes, size_t align) {
+  if (ptr == NULL) {
+    return arena_alloc(arena, bytes, align);
+  }
+  arena__chunk_t *chunk = arena->chunk;
+  if ((char *) ptr == arena->last && ((uintptr_t) ptr & (align - 1)) == 0) {
+    size_t offset = (size_t)((char *) ptr - arena__data(chunk));
+    if (bytes <= chunk->capacity - offset) {
+      chunk->used = offset + bytes;
+      return ptr;
+    }
+  }
+  if (bytes <= old_bytes && ((uintptr_t) ptr & (align - 1)) == 0) {
+    return ptr;
+  }
+  void *nptr = arena_alloc(arena, bytes, align);
+  if (nptr != NULL) {
+    memcpy(nptr, ptr, (old_bytes < bytes) ? old_bytes : bytes);
+  }
+  return nptr;
+}
+
+static inline arena_mark_t arena_save(const arena_t *arena) {
+  arena_mark_t mark;
+  mark.chunk = arena->chunk;
+  mark.used = (arena->chunk != NULL) ? arena->chunk->used : 0;
+  return mark;
+}
+
+static inline void arena_restore(arena_t *arena, arena_mark_t mark) {
+  while (arena->chunk != mark.chunk) {
+    arena__chunk_t *prev = arena->chunk->prev;
+    free(arena->chunk);
+    arena->chunk = prev;
+  }
+  if (arena->chunk != NULL) {
+    arena->chunk->used = mark.used;
+  }
+  arena->last = NULL;
+}
+
+static inline void arena_reset(arena_t *arena) {
+  if (arena->chunk == NULL) {
+    return;
+  }
+  while (arena->chunk->prev != NULL) {
+    arena__chunk_t *prev = arena->chunk->prev;
+    free(arena->chunk);
+    arena->chunk = prev;
+  }
+  arena->chunk->used = 0;
+  arena->last = NULL;
+}
+
+static inline void arena_free(arena_t *arena) {
+  arena_reset(arena);
+  free(arena->chunk);
+  arena->chunk = NULL;
+}
+
+static inline void *arena__allocator_alloc(void *ctx, size_t bytes, size_t align) {
+  return arena_alloc((arena_t *) ctx, bytes, align);
+}
+
+static inline void *arena__allocator_resize(void *ctx, void *ptr, size_t old_bytes, size_t bytes, size_t align) {
+  return arena_resize((arena_t *) ctx, ptr, old_bytes, bytes, align);
+}
+
+static inline void arena__allocator_release(void *ctx, void *ptr, size_t bytes) {
+  arena_t *arena = (arena_t *) ctx;
+  // the last allocation can be given back, so that a temporary buffer does not waste the chunk
+  if ((char *) ptr == arena->last && (char *) ptr + bytes == arena__data(arena->chunk) + arena->chunk->used) {
+    arena->chunk->used = (size_t)((char *) ptr - arena__data(arena->chunk));
+    arena->last = NULL;
+  }
+}
+
+static inline const chibi_allocator_t *arena_allocator(arena_t *arena) {
+  arena->allocator.alloc = arena__allocator_alloc;
+  arena->allocator.resize = arena__allocator_resize;
+  arena->allocator.release = arena__allocator_release;
+  arena->allocator.ctx = arena;
+  return &arena->allocator;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
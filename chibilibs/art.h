@@ -0,0 +1,1024 @@
+/* art.h - Adaptive radix tree for byte-string and integer keys
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * An adaptive radix tree (Leis, Kemper, Neumann, "The Adaptive Radix Tree", ICDE 2013) maps
+ * byte-string keys to values. Unlike hash.h, it keeps the keys in lexicographic order, so it
+ * supports ordered iteration and prefix queries (all the URLs of a host, all the IDs of a range),
+ * and unlike a comparison tree its lookups cost O(key length), independently of the number of keys.
+ *
+ * - every inner node consumes one byte of the key and has one of four layouts, chosen by its
+ *   number of children: Node4 and Node16 keep sorted arrays of bytes and children (Node16 is
+ *   searched with a single SSE2 compare of its 16 bytes), Node48 maps every byte to one of 48
+ *   child slots, Node256 is a plain array of children. Nodes grow and shrink between the layouts
+ *   as children are added and removed.
+ * - the bytes shared by all the keys below a node are stored in the node (path compression), up
+ *   to ART_MAX_PREFIX of them; longer prefixes are skipped during lookups and checked against the
+ *   full key stored in the leaf.
+ * - the leaves store the full key and a value of 'val_size' bytes, like hash.h. A key may be a
+ *   prefix of another key: it is then stored in the node where it ends.
+ * - integer keys are stored big-endian (art_put_u64, ...), so that their byte order is their
+ *   numerical order.
+ * - inner nodes come from a pool: they are carved from an arena (arena.h) and freed nodes are kept
+ *   in one free list per layout, for reuse by the next node of the same layout.
+ *
+ * Memory comes from the allocator given to art_new_with (allocator.h), or from the heap. With the
+ * heap, the inner nodes are carved from an arena owned by the tree; with an allocator, the tree,
+ * the leaves and the inner nodes all come from it (an arena given by the caller carves the nodes
+ * itself). The free lists recycle the inner nodes in both cases.
+ *
+ * The tree is not thread safe. Pointers returned by art_get are invalidated by art_del of the
+ * same key and by art_free.
+ */
+
+#ifndef CHIBI_ART_H
+#define CHIBI_ART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "allocator.h"
+#include "arena.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ART__SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Maximum number of prefix bytes stored in a node */
+#define ART_MAX_PREFIX 10
+
+enum {
+  ART__NODE4,
+  ART__NODE16,
+  ART__NODE48,
+  ART__NODE256,
+  ART__LAYOUTS
+};
+
+// Header shared by the four layouts
+typedef struct art__node_t {
+  uint8_t type;
+  uint16_t nchildren;
+  uint32_t prefix_len;              // bytes shared by all the keys below the node
+  uint8_t prefix[ART_MAX_PREFIX];   // the first of them
+  struct art__leaf_t *end;          // the key that ends at this node, or NULL
+} art__node_t;
+
+// The children are inner nodes or tagged leaves (see art__is_leaf)
+typedef struct art__node4_t {
+  art__node_t node;
+  uint8_t keys[4];
+  void *children[4];
+} art__node4_t;
+
+typedef struct art__node16_t {
+  art__node_t node;
+  uint8_t keys[16];
+  void *children[16];
+} art__node16_t;
+
+typedef struct art__node48_t {
+  art__node_t node;
+  uint8_t index[256];  // slot of the child of every byte plus one, 0 if none
+  void *children[48];
+} art__node48_t;
+
+typedef struct art__node256_t {
+  art__node_t node;
+  void *children[256];
+} art__node256_t;
+
+// A leaf: the length of the key, the key, then the value, aligned to 16 bytes
+typedef struct art__leaf_t {
+  size_t len;
+} art__leaf_t;
+
+typedef struct art_t {
+  void *root;
+  size_t count;     // number of keys
+  size_t val_size;
+  const chibi_allocator_t *allocator;  // memory of the tree, the leaves and the nodes (NULL for the heap)
+  arena_t arena;    // memory of the inner nodes with the heap
+  void *free[ART__LAYOUTS];  // free lists of the inner nodes
+} art_t;
+
+/* Called for every visited key, in lexicographic order. Returns false to stop the visit.
+ */
+typedef bool (*art_visit_t)(void *ctx, const uint8_t *key, size_t len, void *value);
+
+/* Creates an empty tree.
+ * Arguments:
+ * - size of the value type (0 for a set of keys)
+ * Return:
+ * - the new tree, or NULL on allocation failure
+ */
+static inline art_t *art_new(size_t val_size);
+
+/* Creates an empty tree whose memory comes from a given allocator (NULL selects the heap).
+ */
+static inline art_t *art_new_with(size_t val_size, const chibi_allocator_t *allocator);
+
+/* Inserts a key with a copy of its value, or replaces the value if the key is already present.
+ * Arguments:
+ * - the tree
+ * - the key and its length in bytes
+ * - the value
+ * Return:
+ * - the number of keys in the tree on success or -1 on failure (the tree is left unchanged)
+ */
+static inline int64_t art_put(art_t *art, const void *key, size_t len, const void *value);
+
+/* Returns a pointer to the value of a key, or NULL if the key is not in the tree.
+ */
+static inline void *art_get(const art_t *art, const void *key, size_t len);
+
+/* Removes a key and its value.
+ * Return:
+ * - true if the key was in the tree
+ */
+static inline bool art_del(art_t *art, const void *key, size_t len);
+
+/* Prefix query.
+ * Visits, in lexicographic order, the keys that start with 'prefix' (all the keys if 'len' is 0).
+ * Arguments:
+ * - the tree
+ * - the prefix and its length in bytes
+ * - the function called for every key, and its context
+ * Return:
+ * - the number of keys visited
+ */
+static inline size_t art_prefix(const art_t *art, const void *prefix, size_t len, art_visit_t visit, void *ctx);
+
+/* Visits all the keys in lexicographic order */
+#define art_iterate(art, visit, ctx) art_prefix((art), NULL, 0, (visit), (ctx))
+
+/* Integer keys, stored as 8 big-endian bytes */
+static inline void art_key_u64(uint64_t key, uint8_t bytes[8]);
+static inline int64_t art_put_u64(art_t *art, uint64_t key, const void *value);
+static inline void *art_get_u64(const art_t *art, uint64_t key);
+static inline bool art_del_u64(art_t *art, uint64_t key);
+
+/* Returns the number of keys in the tree */
+#define art_size(art) (((art) == NULL) ? 0 : (art)->count)
+
+/* Frees the tree.
+ */
+static inline void art_free(art_t *art);
+
+/* Typed interface: infers the size of the value type */
+#define art_new_typed(type) art_new(sizeof(type))
+
+// Leaves are tagged with the lowest bit in the children arrays
+#define art__is_leaf(ptr) (((uintptr_t)(ptr) & 1) != 0)
+#define art__leaf(ptr) ((art__leaf_t *)((uintptr_t)(ptr) & ~(uintptr_t) 1))
+#define art__tag(leaf) ((void *)((uintptr_t)(leaf) | 1))
+
+#define art__leaf_key(leaf) ((uint8_t *)((art__leaf_t *)(leaf) + 1))
+#define art__leaf_value(leaf) ((char *)(leaf) + ((sizeof(art__leaf_t) + (leaf)->len + 15) & ~(size_t) 15))
+
+#define art__min(a, b) (((a) < (b)) ? (a) : (b))
+
+static inline unsigned art__ctz(unsigned mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (unsigned) index;
+#else
+  return (unsigned) __builtin_ctz(mask);
+#endif
+}
+
+static inline art_t *art_new_with(size_t val_size, const chibi_allocator_t *allocator) {
+  art_t *art = (art_t *) chibi_alloc(allocator, sizeof(art_t), CHIBI_DEFAULT_ALIGN);
+  if (art == NULL) {
+    return NULL;
+  }
+  memset(art, 0, sizeof(art_t));
+  art->val_size = val_size;
+  art->allocator = allocator;
+  arena_init(&art->arena, 0);
+  return art;
+}
+
+static inline art_t *art_new(size_t val_size) {
+  return art_new_with(val_size, NULL);
+}
+
+// Size in bytes of a leaf with a key of 'len' bytes
+#define art__leaf_bytes(art, len) ((((sizeof(art__leaf_t) + (len) + 15) & ~(size_t) 15)) + (art)->val_size)
+
+static inline art__leaf_t *art__leaf_new(const art_t *art, const uint8_t *key, size_t len, const void *value) {
+  art__leaf_t *leaf = (art__leaf_t *) chibi_alloc(art->allocator, art__leaf_bytes(art, len), CHIBI_DEFAULT_ALIGN);
+  if (leaf == NULL) {
+    return NULL;
+  }
+  leaf->len = len;
+  memcpy(art__leaf_key(leaf), key, len);
+  if (art->val_size > 0) {
+    memcpy(art__leaf_value(leaf), value, art->val_size);
+  }
+  return leaf;
+}
+
+// Releases a leaf (nothing if NULL)
+static inline void art__leaf_free(const art_t *art, art__leaf_t *leaf) {
+  if (leaf != NULL) {
+    chibi_release(art->allocator, leaf, art__leaf_bytes(art, leaf->len));
+  }
+}
+
+static inline bool art__leaf_matches(const art__leaf_t *leaf, const uint8_t *key, size_t len) {
+  return leaf->len == len && memcmp(art__leaf_key(leaf), key, len) == 0;
+}
+
+static inline size_t art__node_bytes(uint8_t type) {
+  switch (type) {
+    case ART__NODE4:  return sizeof(art__node4_t);
+    case ART__NODE16: return sizeof(art__node16_t);
+    case ART__NODE48: return sizeof(art__node48_t);
+    default:          return sizeof(art__node256_t);
+  }
+}
+
+// Takes a node from the pool: its free list, or the arena (the allocator, if the tree has one)
+static inline art__node_t *art__node_new(art_t *art, uint8_t type) {
+  art__node_t *node = (art__node_t *) art->free[type];
+  if (node != NULL) {
+    art->free[type] = *(void **) node;
+  } else {
+    node = (art__node_t *) ((art->allocator != NULL) ? chibi_alloc(art->allocator, art__node_bytes(type), 16)
+                                                     : arena_alloc(&art->arena, art__node_bytes(type), 16));
+    if (node == NULL) {
+      return NULL;
+    }
+  }
+  memset(node, 0, art__node_bytes(type));
+  node->type = type;
+  return node;
+}
+
+// Gives a node back to the pool
+static inline void art__node_free(art_t *art, art__node_t *node) {
+  uint8_t type = node->type;
+  *(void **) node = art->free[type];
+  art->free[type] = node;
+}
+
+// Copies the header of a node into a node of another layout
+static inline void art__copy_header(art__node_t *dest, const art__node_t *source) {
+  dest->nchildren = source->nchildren;
+  dest->prefix_len = source->prefix_len;
+  memcpy(dest->prefix, source->prefix, ART_MAX_PREFIX);
+  dest->end = source->end;
+}
+
+// Returns the slot of the child of 'byte', or NULL
+static inline void **art__find_child(art__node_t *node, uint8_t byte) {
+  switch (node->type) {
+    case ART__NODE4: {
+      art__node4_t *n = (art__node4_t *) node;
+      for (unsigned i = 0; i < node->nchildren; ++i) {
+        if (n->keys[i] == byte) {
+          return &n->children[i];
+        }
+      }
+      return NULL;
+    }
+    case ART__NODE16: {
+      art__node16_t *n = (art__node16_t *) node;
+#ifdef ART__SSE2
+      __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char) byte), _mm_loadu_si128((const __m128i *) n->keys));
+      unsigned mask = (unsigned) _mm_movemask_epi8(cmp) & ((1u << node->nchildren) - 1);
+      return (mask != 0) ? &n->children[art__ctz(mask)] : NULL;
+#else
+      for (unsigned i = 0; i < node->nchildren; ++i) {
+        if (n->keys[i] == byte) {
+          return &n->children[i];
+        }
+      }
+      return NULL;
+#endif
+    }
+    case ART__NODE48: {
+      art__node48_t *n = (art__node48_t *) node;
+      return (n->index[byte] != 0) ? &n->children[n->index[byte] - 1] : NULL;
+    }
+    default: {
+      art__node256_t *n = (art__node256_t *) node;
+      return (n->children[byte] != NULL) ? &n->children[byte] : NULL;
+    }
+  }
+}
+
+// Position of 'byte' in the sorted keys of a Node16: the number of keys smaller than it
+static inline unsigned art__node16_position(const art__node16_t *n, uint8_t byte) {
+#ifdef ART__SSE2
+  // SSE2 only compares signed bytes: flipping the sign bit keeps the unsigned order
+  const __m128i flip = _mm_set1_epi8((char) 0x80);
+  __m128i keys = _mm_xor_si128(_mm_loadu_si128((const __m128i *) n->keys), flip);
+  __m128i cmp = _mm_cmplt_epi8(keys, _mm_xor_si128(_mm_set1_epi8((char) byte), flip));
+  unsigned mask = (unsigned) _mm_movemask_epi8(cmp) & ((1u << n->node.nchildren) - 1);
+#ifdef _MSC_VER
+  return (unsigned) __popcnt(mask);
+#else
+  return (unsigned) __builtin_popcount(mask);
+#endif
+#else
+  unsigned pos = 0;
+  while (pos < n->node.nchildren && n->keys[pos] < byte) {
+    ++pos;
+  }
+  return pos;
+#endif
+}
+
+// Adds a child to a node, moving it to a larger layout if it is full. Returns false on failure
+static inline bool art__add_child(art_t *art, void **ref, art__node_t *node, uint8_t byte, void *child) {
+  switch (node->type) {
+    case ART__NODE4: {
+      art__node4_t *n = (art__node4_t *) node;
+      if (node->nchildren < 4) {
+        unsigned pos = 0;
+        while (pos < node->nchildren && n->keys[pos] < byte) {
+          ++pos;
+        }
+        memmove(n->keys + pos + 1, n->keys + pos, node->nchildren - pos);
+        memmove(n->children + pos + 1, n->children + pos, (node->nchildren - pos) * sizeof(void *));
+        n->keys[pos] = byte;
+        n->children[pos] = child;
+        node->nchildren++;
+        return true;
+      }
+      art__node16_t *bigger = (art__node16_t *) art__node_new(art, ART__NODE16);
+      if (bigger == NULL) {
+        return false;
+      }
+      art__copy_header(&bigger->node, node);
+      memcpy(bigger->keys, n->keys, 4);
+      memcpy(bigger->children, n->children, 4 * sizeof(void *));
+      *ref = bigger;
+      art__node_free(art, node);
+      return art__add_child(art, ref, &bigger->node, byte, child);
+    }
+    case ART__NODE16: {
+      art__node16_t *n = (art__node16_t *) node;
+      if (node->nchildren < 16) {
+        unsigned pos = art__node16_position(n, byte);
+        memmove(n->keys + pos + 1, n->keys + pos, node->nchildren - pos);
+        memmove(n->children + pos + 1, n->children + pos, (node->nchildren - pos) * sizeof(void *));
+        n->keys[pos] = byte;
+        n->children[pos] = child;
+        node->nchildren++;
+        return true;
+      }
+      art__node48_t *bigger = (art__node48_t *) art__node_new(art, ART__NODE48);
+      if (bigger == NULL) {
+        return false;
+      }
+      art__copy_header(&bigger->node, node);
+      for (unsigned i = 0; i < 16; ++i) {
+        bigger->index[n->keys[i]] = (uint8_t)(i + 1);
+        bigger->children[i] = n->children[i];
+      }
+      *ref = bigger;
+      art__node_free(art, node);
+      return art__add_child(art, ref, &bigger->node, byte, child);
+    }
+    case ART__NODE48: {
+      art__node48_t *n = (art__node48_t *) node;
+      if (node->nchildren < 48) {
+        // removals leave holes, so the first free slot is not necessarily the last one
+        unsigned slot = 0;
+        while (n->children[slot] != NULL) {
+          ++slot;
+        }
+        n->children[slot] = child;
+        n->index[byte] = (uint8_t)(slot + 1);
+        node->nchildren++;
+        return true;
+      }
+      art__node256_t *bigger = (art__node256_t *) art__node_new(art, ART__NODE256);
+      if (bigger == NULL) {
+        return false;
+      }
+      art__copy_header(&bigger->node, node);
+      for (unsigned b = 0; b < 256; ++b) {
+        if (n->index[b] != 0) {
+          bigger->children[b] = n->children[n->index[b] - 1];
+        }
+      }
+      *ref = bigger;
+      art__node_free(art, node);
+      return art__add_child(art, ref, &bigger->node, byte, child);
+    }
+    default: {
+      art__node256_t *n = (art__node256_t *) node;
+      n->children[byte] = child;
+      node->nchildren++;
+      return true;
+    }
+  }
+}
+
+// Returns the leaf with the smallest key below a node (used to read the prefix bytes not stored)
+static inline const art__leaf_t *art__min_leaf(const void *ptr) {
+  while (!art__is_leaf(ptr)) {
+    const art__node_t *node = (const art__node_t *) ptr;
+    if (node->end != NULL) {
+      return node->end;
+    }
+    switch (node->type) {
+      case ART__NODE4:  ptr = ((const art__node4_t *) node)->children[0]; break;
+      case ART__NODE16: ptr = ((const art__node16_t *) node)->children[0]; break;
+      case ART__NODE48: {
+        const art__node48_t *n = (const art__node48_t *) node;
+        unsigned b = 0;
+        while (n->index[b] == 0) {
+          ++b;
+        }
+        ptr = n->children[n->index[b] - 1];
+        break;
+      }
+      default: {
+        const art__node256_t *n = (const art__node256_t *) node;
+        unsigned b = 0;
+        while (n->children[b] == NULL) {
+          ++b;
+        }
+        ptr = n->children[b];
+        break;
+      }
+    }
+  }
+  return art__leaf(ptr);
+}
+
+// Number of bytes of the prefix of a node that match the key from 'depth'
+static inline size_t art__prefix_match(const art__node_t *node, const uint8_t *key, size_t len, size_t depth) {
+  size_t max = art__min(art__min((size_t) node->prefix_len, (size_t) ART_MAX_PREFIX), len - depth);
+  size_t i = 0;
+  while (i < max && node->prefix[i] == key[depth + i]) {
+    ++i;
+  }
+  if (i == ART_MAX_PREFIX && node->prefix_len > ART_MAX_PREFIX) {
+    // the rest of the prefix is read from any key below the node
+    const art__leaf_t *leaf = art__min_leaf(node);
+    max = art__min((size_t) node->prefix_len, art__min(leaf->len, len) - depth);
+    while (i < max && art__leaf_key(leaf)[depth + i] == key[depth + i]) {
+      ++i;
+    }
+  }
+  return i;
+}
+
+static inline void *art_get(const art_t *art, const void *key, size_t len) {
+  const uint8_t *bytes = (const uint8_t *) key;
+  void *ptr = art->root;
+  size_t depth = 0;
+  while (ptr != NULL) {
+    if (art__is_leaf(ptr)) {
+      art__leaf_t *leaf = art__leaf(ptr);
+      return art__leaf_matches(leaf, bytes, len) ? art__leaf_value(leaf) : NULL;
+    }
+    art__node_t *node = (art__node_t *) ptr;
+    if (node->prefix_len > 0) {
+      // only the stored bytes are compared: the leaf check covers the others
+      if (node->prefix_len > len - depth) {
+        return NULL;
+      }
+      size_t stored = art__min((size_t) node->prefix_len, (size_t) ART_MAX_PREFIX);
+      if (memcmp(node->prefix, bytes + depth, stored) != 0) {
+        return NULL;
+      }
+      depth += node->prefix_len;
+    }
+    if (depth == len) {
+      art__leaf_t *leaf = node->end;
+      return (leaf != NULL && art__leaf_matches(leaf, bytes, len)) ? art__leaf_value(leaf) : NULL;
+    }
+    void **child = art__find_child(node, bytes[depth]);
+    ptr = (child != NULL) ? *child : NULL;
+    ++depth;
+  }
+  return NULL;
+}
+
+static inline int64_t art_put(art_t *art, const void *key, size_t len, const void *value) {
+  const uint8_t *bytes = (const uint8_t *) key;
+  void **ref = &art->root;
+  size_t depth = 0;
+  for (;;) {
+    void *ptr = *ref;
+    if (ptr == NULL) {
+      art__leaf_t *leaf = art__leaf_new(art, bytes, len, value);
+      if (leaf == NULL) {
+        return -1;
+      }
+      *ref = art__tag(leaf);
+      return (int64_t) ++art->count;
+    }
+
+    if (art__is_leaf(ptr)) {
+      art__leaf_t *old = art__leaf(ptr);
+      if (art__leaf_matches(old, bytes, len)) {
+        if (art->val_size > 0) {
+          memcpy(art__leaf_value(old), value, art->val_size);
+        }
+        return (int64_t) art->count;
+      }
+      // a Node4 holds the bytes shared by the two keys and then splits them
+      art__leaf_t *leaf = art__leaf_new(art, bytes, len, value);
+      art__node_t *node = (leaf != NULL) ? art__node_new(art, ART__NODE4) : NULL;
+      if (node == NULL) {
+        art__leaf_free(art, leaf);
+        return -1;
+      }
+      const uint8_t *old_key = art__leaf_key(old);
+      size_t max = art__min(old->len, len);
+      size_t shared = depth;
+      while (shared < max && old_key[shared] == bytes[shared]) {
+        ++shared;
+      }
+      node->prefix_len = (uint32_t)(shared - depth);
+      memcpy(node->prefix, bytes + depth, art__min((size_t) node->prefix_len, (size_t) ART_MAX_PREFIX));
+      // the two keys differ, so at most one of them ends here and the children do not collide
+      if (old->len == shared) {
+        node->end = old;
+      } else {
+        art__add_child(art, ref, node, old_key[shared], ptr);
+      }
+      if (len == shared) {
+        node->end = leaf;
+      } else {
+        art__add_child(art, ref, node, bytes[shared], art__tag(leaf));
+      }
+      *ref = node;
+      return (int64_t) ++art->count;
+    }
+
+    art__node_t *node = (art__node_t *) ptr;
+    if (node->prefix_len > 0) {
+      size_t match = art__prefix_match(node, bytes, len, depth);
+      if (match < node->prefix_len) {
+        // the key leaves the prefix: a Node4 takes the shared part and splits the node from the key
+        art__leaf_t *leaf = art__leaf_new(art, bytes, len, value);
+        art__node_t *parent = (leaf != NULL) ? art__node_new(art, ART__NODE4) : NULL;
+        if (parent == NULL) {
+          art__leaf_free(art, leaf);
+          return -1;
+        }
+        parent->prefix_len = (uint32_t) match;
+        memcpy(parent->prefix, node->prefix, art__min(match, (size_t) ART_MAX_PREFIX));
+        uint8_t byte;
+        if (node->prefix_len <= ART_MAX_PREFIX) {
+          byte = node->prefix[match];
+          node->prefix_len -= (uint32_t)(match + 1);
+          memmove(node->prefix, node->prefix + match + 1, node->prefix_len);
+        } else {
+          const uint8_t *full = art__leaf_key(art__min_leaf(node));
+          byte = full[depth + match];
+          node->prefix_len -= (uint32_t)(match + 1);
+          memcpy(node->prefix, full + depth + match + 1, art__min((size_t) node->prefix_len, (size_t) ART_MAX_PREFIX));
+        }
+        art__add_child(art, ref, parent, byte, node);
+        if (depth + match == len) {
+          parent->end = leaf;
+        } else {
+          art__add_child(art, ref, parent, bytes[depth + match], art__tag(leaf));
+        }
+        *ref = parent;
+        return (int64_t) ++art->count;
+      }
+      depth += node->prefix_len;
+    }
+
+    if (depth == len) {
+      if (node->end != NULL) {
+        if (art->val_size > 0) {
+          memcpy(art__leaf_value(node->end), value, art->val_size);
+        }
+        return (int64_t) art->count;
+      }
+      node->end = art__leaf_new(art, bytes, len, value);
+      if (node->end == NULL) {
+        return -1;
+      }
+      return (int64_t) ++art->count;
+    }
+
+    void **child = art__find_child(node, bytes[depth]);
+    if (child != NULL) {
+      ref = child;
+      ++depth;
+      continue;
+    }
+    art__leaf_t *leaf = art__leaf_new(art, bytes, len, value);
+    if (leaf == NULL) {
+      return -1;
+    }
+    if (!art__add_child(art, ref, node, bytes[depth], art__tag(leaf))) {
+      art__leaf_free(art, leaf);
+      return -1;
+    }
+    return (int64_t) ++art->count;
+  }
+}
+
+// Moves a node to a smaller layout when it has few children, or replaces a Node4 with its only child
+static inline void art__shrink(art_t *art, void **ref, art__node_t *node) {
+  switch (node->type) {
+    case ART__NODE4: {
+      art__node4_t *n = (art__node4_t *) node;
+      if (node->nchildren == 0) {
+        *ref = (node->end != NULL) ? art__tag(node->end) : NULL;
+        art__node_free(art, node);
+      } else if (node->nchildren == 1 && node->end == NULL) {
+        void *child = n->children[0];
+        if (!art__is_leaf(child)) {
+          // the child takes the prefix of the node and the byte that led to it
+          art__node_t *next = (art__node_t *) child;
+          uint8_t prefix[ART_MAX_PREFIX];
+          size_t stored = art__min((size_t) node->prefix_len, (size_t) ART_MAX_PREFIX);
+          memcpy(prefix, node->prefix, stored);
+          if (stored < ART_MAX_PREFIX) {
+            prefix[stored++] = n->keys[0];
+          }
+          size_t more = art__min((size_t) next->prefix_len, ART_MAX_PREFIX - stored);
+          memcpy(prefix + stored, next->prefix, more);
+          next->prefix_len += node->prefix_len + 1;
+          memcpy(next->prefix, prefix, art__min((size_t) next->prefix_len, (size_t) ART_MAX_PREFIX));
+        }
+        *ref = child;
+        art__node_free(art, node);
+      }
+      return;
+    }
+    case ART__NODE16: {
+      if (node->nchildren > 3) {
+        return;
+      }
+      art__node16_t *n = (art__node16_t *) node;
+      art__node4_t *smaller = (art__node4_t *) art__node_new(art, ART__NODE4);
+      if (smaller == NULL) {
+        return;
+      }
+      art__copy_header(&smaller->node, node);
+      memcpy(smaller->keys, n->keys, node->nchildren);
+      memcpy(smaller->children, n->children, node->nchildren * sizeof(void *));
+      *ref = smaller;
+      art__node_free(art, node);
+      return;
+    }
+    case ART__NODE48: {
+      if (node->nchildren > 12) {
+        return;
+      }
+      art__node48_t *n = (art__node48_t *) node;
+      art__node16_t *smaller = (art__node16_t *) art__node_new(art, ART__NODE16);
+      if (smaller == NULL) {
+        return;
+      }
+      art__copy_header(&smaller->node, node);
+      unsigned pos = 0;
+      for (unsigned b = 0; b < 256; ++b) {
+        if (n->index[b] != 0) {
+          smaller->keys[pos] = (uint8_t) b;
+          smaller->children[pos++] = n->children[n->index[b] - 1];
+        }
+      }
+      *ref = smaller;
+      art__node_free(art, node);
+      return;
+    }
+    default: {
+      if (node->nchildren > 37) {
+        return;
+      }
+      art__node256_t *n = (art__node256_t *) node;
+      art__node48_t *smaller = (art__node48_t *) art__node_new(art, ART__NODE48);
+      if (smaller == NULL) {
+        return;
+      }
+      art__copy_header(&smaller->node, node);
+      unsigned slot = 0;
+      for (unsigned b = 0; b < 256; ++b) {
+        if (n->children[b] != NULL) {
+          smaller->index[b] = (uint8_t)(slot + 1);
+          smaller->children[slot++] = n->children[b];
+        }
+      }
+      *ref = smaller;
+      art__node_free(art, node);
+      return;
+    }
+  }
+}
+
+// Removes the child in 'slot', the child of 'byte'
+static inline void art__remove_child(art__node_t *node, uint8_t byte, void **slot) {
+  switch (node->type) {
+    case ART__NODE4: {
+      art__node4_t *n = (art__node4_t *) node;
+      size_t pos = (size_t)(slot - n->children);
+      memmove(n->keys + pos, n->keys + pos + 1, node->nchildren - pos - 1);
+      memmove(n->children + pos, n->children + pos + 1, (node->nchildren - pos - 1) * sizeof(void *));
+      break;
+    }
+    case ART__NODE16: {
+      art__node16_t *n = (art__node16_t *) node;
+      size_t pos = (size_t)(slot - n->children);
+      memmove(n->keys + pos, n->keys + pos + 1, node->nchildren - pos - 1);
+      memmove(n->children + pos, n->children + pos + 1, (node->nchildren - pos - 1) * sizeof(void *));
+      break;
+    }
+    case ART__NODE48: {
+      art__node48_t *n = (art__node48_t *) node;
+      *slot = NULL;
+      n->index[byte] = 0;
+      break;
+    }
+    default:
+      *slot = NULL;
+      break;
+  }
+  node->nchildren--;
+}
+
+static inline bool art_del(art_t *art, const void *key, size_t len) {
+  const uint8_t *bytes = (const uint8_t *) key;
+  void **ref = &art->root;
+  size_t depth = 0;
+  while (*ref != NULL) {
+    void *ptr = *ref;
+    if (art__is_leaf(ptr)) {
+      // only the root can be a leaf here
+      art__leaf_t *leaf = art__leaf(ptr);
+      if (!art__leaf_matches(leaf, bytes, len)) {
+        return false;
+      }
+      art__leaf_free(art, leaf);
+      *ref = NULL;
+      art->count--;
+      return true;
+    }
+    art__node_t *node = (art__node_t *) ptr;
+    if (node->prefix_len > 0) {
+      if (node->prefix_len > len - depth) {
+        return false;
+      }
+      size_t stored = art__min((size_t) node->prefix_len, (size_t) ART_MAX_PREFIX);
+      if (memcmp(node->prefix, bytes + depth, stored) != 0) {
+        return false;
+      }
+      depth += node->prefix_len;
+    }
+    if (depth == len) {
+      art__leaf_t *leaf = node->end;
+      if (leaf == NULL || !art__leaf_matches(leaf, bytes, len)) {
+        return false;
+      }
+      art__leaf_free(art, leaf);
+      node->end = NULL;
+      art->count--;
+      art__shrink(art, ref, node);
+      return true;
+    }
+    void **child = art__find_child(node, bytes[depth]);
+    if (child == NULL) {
+      return false;
+    }
+    if (art__is_leaf(*child)) {
+      art__leaf_t *leaf = art__leaf(*child);
+      if (!art__leaf_matches(leaf, bytes, len)) {
+        return false;
+      }
+      art__leaf_free(art, leaf);
+      art__remove_child(node, bytes[depth], child);
+      art->count--;
+      art__shrink(art, ref, node);
+      return true;
+    }
+    ref = child;
+    ++depth;
+  }
+  return false;
+}
+
+// Visits all the keys below a node in order. Returns false if the visit was stopped
+static inline bool art__walk(const void *ptr, art_visit_t visit, void *ctx, size_t *visited) {
+  if (art__is_leaf(ptr)) {
+    art__leaf_t *leaf = art__leaf(ptr);
+    ++*visited;
+    return visit(ctx, art__leaf_key(leaf), leaf->len, art__leaf_value(leaf));
+  }
+  const art__node_t *node = (const art__node_t *) ptr;
+  // a key that ends at the node is a prefix of all the others, so it comes first
+  if (node->end != NULL && !art__walk(art__tag(node->end), visit, ctx, visited)) {
+    return false;
+  }
+  switch (node->type) {
+    case ART__NODE4: {
+      const art__node4_t *n = (const art__node4_t *) node;
+      for (unsigned i = 0; i < node->nchildren; ++i) {
+        if (!art__walk(n->children[i], visit, ctx, visited)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case ART__NODE16: {
+      const art__node16_t *n = (const art__node16_t *) node;
+      for (unsigned i = 0; i < node->nchildren; ++i) {
+        if (!art__walk(n->children[i], visit, ctx, visited)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case ART__NODE48: {
+      const art__node48_t *n = (const art__node48_t *) node;
+      for (unsigned b = 0; b < 256; ++b) {
+        if (n->index[b] != 0 && !art__walk(n->children[n->index[b] - 1], visit, ctx, visited)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default: {
+      const art__node256_t *n = (const art__node256_t *) node;
+      for (unsigned b = 0; b < 256; ++b) {
+        if (n->children[b] != NULL && !art__walk(n->children[b], visit, ctx, visited)) {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+}
+
+static inline size_t art_prefix(const art_t *art, const void *prefix, size_t len, art_visit_t visit, void *ctx) {
+  const uint8_t *bytes = (const uint8_t *) prefix;
+  const void *ptr = art->root;
+  size_t depth = 0;
+  size_t visited = 0;
+  while (ptr != NULL) {
+    if (art__is_leaf(ptr)) {
+      const art__leaf_t *leaf = art__leaf(ptr);
+      if (leaf->len >= len && (len == 0 || memcmp(art__leaf_key(leaf), bytes, len) == 0)) {
+        art__walk(ptr, visit, ctx, &visited);
+      }
+      return visited;
+    }
+    const art__node_t *node = (const art__node_t *) ptr;
+    if (node->prefix_len > 0) {
+      size_t match = art__prefix_match(node, bytes, len, depth);
+      if (depth + match == len) {
+        // the query ends inside the prefix of the node: all its keys match
+        break;
+      }
+      if (match < node->prefix_len) {
+        return 0;
+      }
+      depth += node->prefix_len;
+    }
+    if (depth == len) {
+      break;
+    }
+    void **child = art__find_child((art__node_t *) node, bytes[depth]);
+    ptr = (child != NULL) ? *child : NULL;
+    ++depth;
+  }
+  if (ptr != NULL) {
+    art__walk(ptr, visit, ctx, &visited);
+  }
+  return visited;
+}
+
+static inline void art_key_u64(uint64_t key, uint8_t bytes[8]) {
+  for (int i = 7; i >= 0; --i) {
+    bytes[i] = (uint8_t) key;
+    key >>= 8;
+  }
+}
+
+static inline int64_t art_put_u64(art_t *art, uint64_t key, const void *value) {
+  uint8_t bytes[8];
+  art_key_u64(key, bytes);
+  return art_put(art, bytes, 8, value);
+}
+
+static inline void *art_get_u64(const art_t *art, uint64_t key) {
+  uint8_t bytes[8];
+  art_key_u64(key, bytes);
+  return art_get(art, bytes, 8);
+}
+
+static inline bool art_del_u64(art_t *art, uint64_t key) {
+  uint8_t bytes[8];
+  art_key_u64(key, bytes);
+  return art_del(art, bytes, 8);
+}
+
+// Frees the leaves below a node, and the inner nodes if they come from the allocator (otherwise
+// they go away with the arena)
+static inline void art__free_subtree(const art_t *art, void *ptr) {
+  if (art__is_leaf(ptr)) {
+    art__leaf_free(art, art__leaf(ptr));
+    return;
+  }
+  art__node_t *node = (art__node_t *) ptr;
+  art__leaf_free(art, node->end);
+  switch (node->type) {
+    case ART__NODE4:
+      for (unsigned i = 0; i < node->nchildren; ++i) {
+        art__free_subtree(art, ((art__node4_t *) node)->children[i]);
+      }
+      break;
+    case ART__NODE16:
+      for (unsigned i = 0; i < node->nchildren; ++i) {
+        art__free_subtree(art, ((art__node16_t *) node)->children[i]);
+      }
+      break;
+    case ART__NODE48:
+      for (unsigned i = 0; i < 48; ++i) {
+        if (((art__node48_t *) node)->children[i] != NULL) {
+          art__free_subtree(art, ((art__node48_t *) node)->children[i]);
+        }
+      }
+      break;
+    default:
+      for (unsigned b = 0; b < 256; ++b) {
+        if (((art__node256_t *) node)->children[b] != NULL) {
+          art__free_subtree(art, ((art__node256_t *) node)->children[b]);
+        }
+      }
+      break;
+  }
+  if (art->allocator != NULL) {
+    chibi_release(art->allocator, node, art__node_bytes(node->type));
+  }
+}
+
+static inline void art_free(art_t *art) {
+  if (art == NULL) {
+    return;
+  }
+  if (art->root != NULL) {
+    art__free_subtree(art, art->root);
+  }
+  if (art->allocator != NULL) {
+    // the links of the free lists overwrite the type of the nodes, which is the index of the list
+    for (uint8_t type = 0; type < ART__LAYOUTS; ++type) {
+      while (art->free[type] != NULL) {
+        void *node = art->free[type];
+        art->free[type] = *(void **) node;
+        chibi_release(art->allocator, node, art__node_bytes(type));
+      }
+    }
+  }
+  arena_free(&art->arena);
+  chibi_release(art->allocator, art, sizeof(art_t));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,778 @@
+/* btree.h - Ordered map from uint64_t keys to generic values (B+tree)
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * hash.h maps uint64_t keys to values but has no order, and a sorted vector costs O(n) moves per
+ * insert. This library keeps the keys in a B+tree: lookups, inserts and deletes in O(log n), and
+ * ordered iteration and range queries over the leaves, which are linked in key order.
+ *
+ * - nodes hold up to BTREE_KEYS keys, stored first in the node, which is aligned to a cache line:
+ *   with the default of 16 keys, the keys of a node fill two adjacent cache lines. The values are
+ *   only stored in the leaves, after the keys, so the search down the tree only touches keys.
+ * - the position of a key in a node is the number of keys smaller than it, counted with SIMD
+ *   compares over the whole node (four keys per compare with AVX2, two with SSE4.2, and two with
+ *   SSE2, which builds the 64-bit compare from 32-bit ones) instead of a chain of unpredictable
+ *   branches. SSE2 is part of every x86-64 target, so the default build uses it; elsewhere the
+ *   count is a plain loop.
+ * - values have a generic size, like in hash.h: every value is a block of 'val_size' bytes, copied
+ *   with memcpy, and btree_get returns a pointer to it.
+ * - nodes are split when full and merged with (or refilled from) a sibling when less than half
+ *   full, so every node but the root is at least half full and the height stays O(log n).
+ * - btree_load builds a tree from unsorted arrays in O(n) after sorting them with sorting.h (radix
+ *   sort by key), spreading the keys evenly over the fewest leaves that can hold them, so that every
+ *   leaf has at least BTREE__MIN keys. This is much faster than n inserts.
+ *
+ * Memory comes from the allocator given to btree_new_with or btree_load_with (allocator.h), or
+ * from the heap.
+ *
+ * The tree is not thread safe. Pointers returned by btree_get and iterators are invalidated by
+ * btree_put and btree_del.
+ */
+
+#ifndef CHIBI_BTREE_H
+#define CHIBI_BTREE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "allocator.h"
+#include "sorting.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BTREE__AVX2
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define BTREE__SSE42
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BTREE__SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Maximum number of keys per node (a multiple of 4, at most 32) */
+#ifndef BTREE_KEYS
+#define BTREE_KEYS 16
+#endif
+
+/* Minimum number of keys of a node other than the root */
+#define BTREE__MIN (BTREE_KEYS / 2)
+
+/* Maximum height of the tree: nodes are at least half full, so this is never reached */
+#define BTREE_MAX_HEIGHT 32
+
+/* Alignment of the nodes (a cache line) */
+#define BTREE__ALIGN 64
+
+typedef struct btree__leaf_t {
+  uint64_t keys[BTREE_KEYS];
+  struct btree__leaf_t *next;  // leaf with the following keys
+  struct btree__leaf_t *prev;
+  uint32_t nkeys;
+  // followed by BTREE_KEYS values of val_size bytes
+} btree__leaf_t;
+
+typedef struct btree__inner_t {
+  uint64_t keys[BTREE_KEYS];
+  void *children[BTREE_KEYS + 1];  // children[i] holds the keys in [keys[i - 1], keys[i])
+  uint32_t nkeys;
+} btree__inner_t;
+
+typedef struct btree_t {
+  void *root;
+  size_t height;    // number of inner levels above the leaves
+  size_t count;     // number of keys
+  size_t val_size;
+  const chibi_allocator_t *allocator;
+} btree_t;
+
+/* A position in the tree, for ordered iteration */
+typedef struct btree_iter_t {
+  const btree__leaf_t *leaf;
+  uint32_t pos;
+  size_t val_size;
+} btree_iter_t;
+
+/* Creates an empty tree.
+ * Arguments:
+ * - size of the value type (0 for a set of keys)
+ * Return:
+ * - the new tree, or NULL on allocation failure
+ */
+static inline btree_t *btree_new(size_t val_size);
+
+/* Creates an empty tree whose memory comes from a given allocator (NULL selects the heap).
+ */
+static inline btree_t *btree_new_with(size_t val_size, const chibi_allocator_t *allocator);
+
+/* Bulk load.
+ * Builds a tree from a vector of keys and a vector of values. The two vectors are sorted in place
+ * by key (with s_radix_by_key_u64) unless the keys are already sorted. If a key appears more than
+ * once, the last of its values is kept, as if the pairs were inserted in order.
+ * Arguments:
+ * - size of the value type (0 for a set of keys)
+ * - the key vector
+ * - the value vector (NULL if val_size is 0)
+ * - the dimension of the vectors
+ * Return:
+ * - the new tree, or NULL on allocation failure
+ */
+static inline btree_t *btree_load(size_t val_size, uint64_t *keys, void *values, size_t dim);
+
+/* Same as btree_load, with the tree and all the temporary memory of the load (the buffers of the
+ * sort and of the node lists) taken from 'allocator' (NULL selects the heap), e.g. an arena.
+ */
+static inline btree_t *btree_load_with(size_t val_size, uint64_t *keys, void *values, size_t dim,
+                                       const chibi_allocator_t *allocator);
+
+/* Inserts a key with a copy of its value, or replaces the value if the key is already present.
+ * Return:
+ * - the number of keys in the tree on success or -1 on failure (the tree is left unchanged)
+ */
+static inline int64_t btree_put(btree_t *btree, uint64_t key, const void *value);
+
+/* Returns a pointer to the value of a key, or NULL if the key is not in the tree.
+ */
+static inline void *btree_get(const btree_t *btree, uint64_t key);
+
+/* Removes a key and its value.
+ * Return:
+ * - true if the key was in the tree
+ */
+static inline bool btree_del(btree_t *btree, uint64_t key);
+
+/* Returns an iterator to the first key not smaller than 'key'.
+ */
+static inline btree_iter_t btree_seek(const btree_t *btree, uint64_t key);
+
+/* Returns an iterator to the smallest key.
+ */
+#define btree_begin(btree) btree_seek((btree), 0)
+
+/* Reads the key and the value at the iterator and advances it. Keys are visited in increasing
+ * order. For example, to visit the keys in [lo, hi):
+ *
+ *   uint64_t key;
+ *   void *value;
+ *   btree_iter_t it = btree_seek(tree, lo);
+ *   while (btree_next(&it, &key, &value) && key < hi) { ... }
+ *
+ * Arguments:
+ * - the iterator
+ * - where to store the key, or NULL
+ * - where to store a pointer to the value, or NULL
+ * Return:
+ * - false if the iterator was past the last key
+ */
+static inline bool btree_next(btree_iter_t *it, uint64_t *key, void **value);
+
+/* Returns the number of keys in the tree */
+#define btree_size(btree) (((btree) == NULL) ? 0 : (btree)->count)
+
+/* Frees the tree.
+ */
+static inline void btree_free(btree_t *btree);
+
+/* Typed interface: infers the size of the value type */
+#define btree_new_typed(type) btree_new(sizeof(type))
+
+// Offset of the values in a leaf, aligned for any scalar type
+#define BTREE__LEAF_HEADER ((sizeof(btree__leaf_t) + 15) & ~(size_t) 15)
+
+#define btree__value(btree, leaf, i) ((char *)(leaf) + BTREE__LEAF_HEADER + (size_t)(i) * (btree)->val_size)
+
+#ifdef _MSC_VER
+#define btree__popcount(x) ((uint32_t) __popcnt64(x))
+#else
+#define btree__popcount(x) ((uint32_t) __builtin_popcountll(x))
+#endif
+
+// Number of keys of a node smaller than 'key'
+static inline uint32_t btree__count_less(const uint64_t *keys, uint32_t nkeys, uint64_t key) {
+#if defined(BTREE__AVX2)
+  // there is no unsigned 64 bit compare: flipping the sign bit turns it into a signed one
+  const __m256i flip = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i k = _mm256_set1_epi64x((int64_t)(key ^ ((uint64_t) 1 << 63)));
+  uint64_t mask = 0;
+  for (uint32_t i = 0; i < BTREE_KEYS; i += 4) {
+    __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(keys + i)), flip);
+    mask |= (uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v))) << i;
+  }
+  return btree__popcount(mask & (((uint64_t) 1 << nkeys) - 1));
+#elif defined(BTREE__SSE42)
+  const __m128i flip = _mm_set1_epi64x(INT64_MIN);
+  const __m128i k = _mm_set1_epi64x((int64_t)(key ^ ((uint64_t) 1 << 63)));
+  uint64_t mask = 0;
+  for (uint32_t i = 0; i < BTREE_KEYS; i += 2) {
+    __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(keys + i)), flip);
+    mask |= (uint64_t) _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v))) << i;
+  }
+  return btree__popcount(mask & (((uint64_t) 1 << nkeys) - 1));
+#elif defined(BTREE__SSE2)
+  // no 64 bit compare: with the sign bit of every 32 bit half flipped, the signed 32 bit compares
+  // order the halves as unsigned, and key > v if its high half is greater, or equal with a
+  // greater low half. The result is in the high half, whose sign bit movemask_pd reads
+  const __m128i flip = _mm_set1_epi32(INT32_MIN);
+  const __m128i k = _mm_xor_si128(_mm_set1_epi64x((int64_t) key), flip);
+  uint64_t mask = 0;
+  for (uint32_t i = 0; i < BTREE_KEYS; i += 2) {
+    __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(keys + i)), flip);
+    __m128i gt = _mm_cmpgt_epi32(k, v);
+    __m128i eq = _mm_cmpeq_epi32(k, v);
+    __m128i gt_low = _mm_shuffle_epi32(gt, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128i less = _mm_or_si128(gt, _mm_and_si128(eq, gt_low));
+    mask |= (uint64_t) _mm_movemask_pd(_mm_castsi128_pd(less)) << i;
+  }
+  return btree__popcount(mask & (((uint64_t) 1 << nkeys) - 1));
+#else
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < nkeys; ++i) {
+    count += (keys[i] < key);
+  }
+  return count;
+#endif
+}
+
+// Child of an inner node that holds 'key': the number of separators not greater than it
+static inline uint32_t btree__child(const btree__inner_t *inner, uint64_t key) {
+  return (key == UINT64_MAX) ? inner->nkeys : btree__count_less(inner->keys, inner->nkeys, key + 1);
+}
+
+static inline btree__leaf_t *btree__leaf_new(btree_t *btree) {
+  size_t bytes = BTREE__LEAF_HEADER + BTREE_KEYS * btree->val_size;
+  btree__leaf_t *leaf = (btree__leaf_t *) chibi_alloc(btree->allocator, bytes, BTREE__ALIGN);
+  if (leaf != NULL) {
+    // the SIMD search reads the unused keys too
+    memset(leaf, 0, sizeof(btree__leaf_t));
+  }
+  return leaf;
+}
+
+static inline btree__inner_t *btree__inner_new(btree_t *btree) {
+  btree__inner_t *inner = (btree__inner_t *) chibi_alloc(btree->allocator, sizeof(btree__inner_t), BTREE__ALIGN);
+  if (inner != NULL) {
+    memset(inner, 0, sizeof(btree__inner_t));
+  }
+  return inner;
+}
+
+static inline void btree__leaf_free(btree_t *btree, btree__leaf_t *leaf) {
+  chibi_release(btree->allocator, leaf, BTREE__LEAF_HEADER + BTREE_KEYS * btree->val_size);
+}
+
+static inline void btree__inner_free(btree_t *btree, btree__inner_t *inner) {
+  chibi_release(btree->allocator, inner, sizeof(btree__inner_t));
+}
+
+// Frees a subtree of the given height
+static inline void btree__free_node(btree_t *btree, void *node, size_t height) {
+  if (height == 0) {
+    btree__leaf_free(btree, (btree__leaf_t *) node);
+    return;
+  }
+  btree__inner_t *inner = (btree__inner_t *) node;
+  for (uint32_t i = 0; i <= inner->nkeys; ++i) {
+    btree__free_node(btree, inner->children[i], height - 1);
+  }
+  btree__inner_free(btree, inner);
+}
+
+static inline btree_t *btree_new_with(size_t val_size, const chibi_allocator_t *allocator) {
+  btree_t *btree = (btree_t *) chibi_alloc(allocator, sizeof(btree_t), CHIBI_DEFAULT_ALIGN);
+  if (btree == NULL) {
+    return NULL;
+  }
+  btree->height = 0;
+  btree->count = 0;
+  btree->val_size = val_size;
+  btree->allocator = allocator;
+  btree->root = btree__leaf_new(btree);
+  if (btree->root == NULL) {
+    chibi_release(allocator, btree, sizeof(btree_t));
+    return NULL;
+  }
+  return btree;
+}
+
+static inline btree_t *btree_new(size_t val_size) {
+  return btree_new_with(val_size, NULL);
+}
+
+static inline void btree_free(btree_t *btree) {
+  if (btree == NULL) {
+    return;
+  }
+  btree__free_node(btree, btree->root, btree->height);
+  chibi_release(btree->allocator, btree, sizeof(btree_t));
+}
+
+static inline btree__leaf_t *btree__find_leaf(const btree_t *btree, uint64_t key) {
+  void *node = btree->root;
+  for (size_t h = btree->height; h > 0; --h) {
+    const btree__inner_t *inner = (const btree__inner_t *) node;
+    node = inner->children[btree__child(inner, key)];
+  }
+  return (btree__leaf_t *) node;
+}
+
+static inline void *btree_get(const btree_t *btree, uint64_t key) {
+  btree__leaf_t *leaf = btree__find_leaf(btree, key);
+  uint32_t pos = btree__count_less(leaf->keys, leaf->nkeys, key);
+  if (pos < leaf->nkeys && leaf->keys[pos] == key) {
+    return btree__value(btree, leaf, pos);
+  }
+  return NULL;
+}
+
+// Inserts a key and its value at position 'pos' of a leaf that is not full
+static inline void btree__leaf_insert(btree_t *btree, btree__leaf_t *leaf, uint32_t pos, uint64_t key, const void *value) {
+  size_t val_size = btree->val_size;
+  memmove(leaf->keys + pos + 1, leaf->keys + pos, (leaf->nkeys - pos) * sizeof(uint64_t));
+  memmove(btree__value(btree, leaf, pos + 1), btree__value(btree, leaf, pos), (leaf->nkeys - pos) * val_size);
+  leaf->keys[pos] = key;
+  if (val_size > 0) {
+    memcpy(btree__value(btree, leaf, pos), value, val_size);
+  }
+  leaf->nkeys++;
+}
+
+// Inserts a separator and the child on its right at position 'pos' of an inner node that is not full
+static inline void btree__inner_insert(btree__inner_t *inner, uint32_t pos, uint64_t key, void *child) {
+  memmove(inner->keys + pos + 1, inner->keys + pos, (inner->nkeys - pos) * sizeof(uint64_t));
+  memmove(inner->children + pos + 2, inner->children + pos + 1, (inner->nkeys - pos) * sizeof(void *));
+  inner->keys[pos] = key;
+  inner->children[pos + 1] = child;
+  inner->nkeys++;
+}
+
+// Removes the separator at position 'pos' of an inner node and the child on its right
+static inline void btree__inner_remove(btree__inner_t *inner, uint32_t pos) {
+  memmove(inner->keys + pos, inner->keys + pos + 1, (inner->nkeys - pos - 1) * sizeof(uint64_t));
+  memmove(inner->children + pos + 1, inner->children + pos + 2, (inner->nkeys - pos - 1) * sizeof(void *));
+  inner->nkeys--;
+}
+
+static inline int64_t btree_put(btree_t *btree, uint64_t key, const void *value) {
+  btree__inner_t *path[BTREE_MAX_HEIGHT];
+  uint32_t slots[BTREE_MAX_HEIGHT];
+  void *node = btree->root;
+  for (size_t h = 0; h < btree->height; ++h) {
+    path[h] = (btree__inner_t *) node;
+    slots[h] = btree__child(path[h], key);
+    node = path[h]->children[slots[h]];
+  }
+  btree__leaf_t *leaf = (btree__leaf_t *) node;
+  uint32_t pos = btree__count_less(leaf->keys, leaf->nkeys, key);
+  if (pos < leaf->nkeys && leaf->keys[pos] == key) {
+    if (btree->val_size > 0) {
+      memcpy(btree__value(btree, leaf, pos), value, btree->val_size);
+    }
+    return (int64_t) btree->count;
+  }
+  if (leaf->nkeys < BTREE_KEYS) {
+    btree__leaf_insert(btree, leaf, pos, key, value);
+    return (int64_t) ++btree->count;
+  }
+
+  // the leaf splits, and so do the full inner nodes right above it, plus a new root if they all are.
+  // The new nodes are allocated first, so that a failure leaves the tree unchanged
+  size_t full = 0;
+  while (full < btree->height && path[btree->height - 1 - full]->nkeys == BTREE_KEYS) {
+    ++full;
+  }
+  size_t nspare = (full == btree->height) ? full + 1 : full;
+  if (btree->height + 1 >= BTREE_MAX_HEIGHT) {
+    return -1;
+  }
+  btree__inner_t *spare[BTREE_MAX_HEIGHT];
+  btree__leaf_t *right = btree__leaf_new(btree);
+  size_t allocated = 0;
+  while (right != NULL && allocated < nspare && (spare[allocated] = btree__inner_new(btree)) != NULL) {
+    ++allocated;
+  }
+  if (right == NULL || allocated < nspare) {
+    while (allocated > 0) {
+      btree__inner_free(btree, spare[--allocated]);
+    }
+    if (right != NULL) {
+      btree__leaf_free(btree, right);
+    }
+    return -1;
+  }
+
+  // the upper half of the leaf moves to the new leaf, on its right
+  size_t val_size = btree->val_size;
+  memcpy(right->keys, leaf->keys + BTREE__MIN, (BTREE_KEYS - BTREE__MIN) * sizeof(uint64_t));
+  memcpy(btree__value(btree, right, 0), btree__value(btree, leaf, BTREE__MIN), (BTREE_KEYS - BTREE__MIN) * val_size);
+  right->nkeys = BTREE_KEYS - BTREE__MIN;
+  leaf->nkeys = BTREE__MIN;
+  right->next = leaf->next;
+  right->prev = leaf;
+  if (leaf->next != NULL) {
+    leaf->next->prev = right;
+  }
+  leaf->next = right;
+  if (pos <= BTREE__MIN) {
+    btree__leaf_insert(btree, leaf, pos, key, value);
+  } else {
+    btree__leaf_insert(btree, right, pos - BTREE__MIN, key, value);
+  }
+  btree->count++;
+
+  // the first key of the new node and the node itself go up, until a node has room for them
+  uint64_t separator = right->keys[0];
+  void *child = right;
+  for (size_t h = btree->height; h > 0; --h) {
+    btree__inner_t *inner = path[h - 1];
+    uint32_t slot = slots[h - 1];
+    if (inner->nkeys < BTREE_KEYS) {
+      btree__inner_insert(inner, slot, separator, child);
+      return (int64_t) btree->count;
+    }
+    // BTREE_KEYS + 1 separators: the middle one goes up, the ones after it go to the new node
+    uint64_t keys[BTREE_KEYS + 1];
+    void *children[BTREE_KEYS + 2];
+    memcpy(keys, inner->keys, slot * sizeof(uint64_t));
+    keys[slot] = separator;
+    memcpy(keys + slot + 1, inner->keys + slot, (BTREE_KEYS - slot) * sizeof(uint64_t));
+    memcpy(children, inner->children, (slot + 1) * sizeof(void *));
+    children[slot + 1] = child;
+    memcpy(children + slot + 2, inner->children + slot + 1, (BTREE_KEYS - slot) * sizeof(void *));
+
+    btree__inner_t *sibling = spare[--nspare];
+    memcpy(inner->keys, keys, BTREE__MIN * sizeof(uint64_t));
+    memcpy(inner->children, children, (BTREE__MIN + 1) * sizeof(void *));
+    inner->nkeys = BTREE__MIN;
+    memcpy(sibling->keys, keys + BTREE__MIN + 1, (BTREE_KEYS - BTREE__MIN) * sizeof(uint64_t));
+    memcpy(sibling->children, children + BTREE__MIN + 1, (BTREE_KEYS - BTREE__MIN + 1) * sizeof(void *));
+    sibling->nkeys = BTREE_KEYS - BTREE__MIN;
+    separator = keys[BTREE__MIN];
+    child = sibling;
+  }
+
+  // the root was split
+  btree__inner_t *root = spare[--nspare];
+  root->keys[0] = separator;
+  root->children[0] = btree->root;
+  root->children[1] = child;
+  root->nkeys = 1;
+  btree->root = root;
+  btree->height++;
+  return (int64_t) btree->count;
+}
+
+// Refills or merges the leaf at position 'slot' of 'parent', which has less than BTREE__MIN keys
+static inline void btree__leaf_rebalance(btree_t *btree, btree__inner_t *parent, uint32_t slot) {
+  size_t val_size = btree->val_size;
+  btree__leaf_t *leaf = (btree__leaf_t *) parent->children[slot];
+  if (slot > 0) {
+    btree__leaf_t *left = (btree__leaf_t *) parent->children[slot - 1];
+    if (left->nkeys > BTREE__MIN) {
+      // the last key of the left sibling moves to the front
+      btree__leaf_insert(btree, leaf, 0, left->keys[left->nkeys - 1], btree__value(btree, left, left->nkeys - 1));
+      left->nkeys--;
+      parent->keys[slot - 1] = leaf->keys[0];
+      return;
+    }
+    // merge into the left sibling
+    memcpy(left->keys + left->nkeys, leaf->keys, leaf->nkeys * sizeof(uint64_t));
+    memcpy(btree__value(btree, left, left->nkeys), btree__value(btree, leaf, 0), leaf->nkeys * val_size);
+    left->nkeys += leaf->nkeys;
+    left->next = leaf->next;
+    if (leaf->next != NULL) {
+      leaf->next->prev = left;
+    }
+    btree__inner_remove(parent, slot - 1);
+    btree__leaf_free(btree, leaf);
+    return;
+  }
+  btree__leaf_t *right = (btree__leaf_t *) parent->children[1];
+  if (right->nkeys > BTREE__MIN) {
+    // the first key of the right sibling moves to the back
+    btree__leaf_insert(btree, leaf, leaf->nkeys, right->keys[0], btree__value(btree, right, 0));
+    memmove(right->keys, right->keys + 1, (right->nkeys - 1) * sizeof(uint64_t));
+    memmove(btree__value(btree, right, 0), btree__value(btree, right, 1), (right->nkeys - 1) * val_size);
+    right->nkeys--;
+    parent->keys[0] = right->keys[0];
+    return;
+  }
+  // merge the right sibling into the leaf
+  memcpy(leaf->keys + leaf->nkeys, right->keys, right->nkeys * sizeof(uint64_t));
+  memcpy(btree__value(btree, leaf, leaf->nkeys), btree__value(btree, right, 0), right->nkeys * val_size);
+  leaf->nkeys += right->nkeys;
+  leaf->next = right->next;
+  if (right->next != NULL) {
+    right->next->prev = leaf;
+  }
+  btree__inner_remove(parent, 0);
+  btree__leaf_free(btree, right);
+}
+
+// Refills or merges the inner node at position 'slot' of 'parent', which has less than BTREE__MIN keys
+static inline void btree__inner_rebalance(btree_t *btree, btree__inner_t *parent, uint32_t slot) {
+  btree__inner_t *inner = (btree__inner_t *) parent->children[slot];
+  if (slot > 0) {
+    btree__inner_t *left = (btree__inner_t *) parent->children[slot - 1];
+    if (left->nkeys > BTREE__MIN) {
+      // the last child of the left sibling moves to the front, rotating the separators
+      memmove(inner->keys + 1, inner->keys, inner->nkeys * sizeof(uint64_t));
+      memmove(inner->children + 1, inner->children, (inner->nkeys + 1) * sizeof(void *));
+      inner->keys[0] = parent->keys[slot - 1];
+      inner->children[0] = left->children[left->nkeys];
+      inner->nkeys++;
+      parent->keys[slot - 1] = left->keys[left->nkeys - 1];
+      left->nkeys--;
+      return;
+    }
+    slot--;
+  } else {
+    btree__inner_t *right = (btree__inner_t *) parent->children[1];
+    if (right->nkeys > BTREE__MIN) {
+      // the first child of the right sibling moves to the back
+      inner->keys[inner->nkeys] = parent->keys[0];
+      inner->children[inner->nkeys + 1] = right->children[0];
+      inner->nkeys++;
+      parent->keys[0] = right->keys[0];
+      memmove(right->keys, right->keys + 1, (right->nkeys - 1) * sizeof(uint64_t));
+      memmove(right->children, right->children + 1, right->nkeys * sizeof(void *));
+      right->nkeys--;
+      return;
+    }
+  }
+  // merge the node at 'slot + 1' into the one at 'slot', with their separator between them
+  btree__inner_t *left = (btree__inner_t *) parent->children[slot];
+  btree__inner_t *right = (btree__inner_t *) parent->children[slot + 1];
+  left->keys[left->nkeys] = parent->keys[slot];
+  memcpy(left->keys + left->nkeys + 1, right->keys, right->nkeys * sizeof(uint64_t));
+  memcpy(left->children + left->nkeys + 1, right->children, (right->nkeys + 1) * sizeof(void *));
+  left->nkeys += right->nkeys + 1;
+  btree__inner_remove(parent, slot);
+  btree__inner_free(btree, right);
+}
+
+static inline bool btree_del(btree_t *btree, uint64_t key) {
+  btree__inner_t *path[BTREE_MAX_HEIGHT];
+  uint32_t slots[BTREE_MAX_HEIGHT];
+  void *node = btree->root;
+  for (size_t h = 0; h < btree->height; ++h) {
+    path[h] = (btree__inner_t *) node;
+    slots[h] = btree__child(path[h], key);
+    node = path[h]->children[slots[h]];
+  }
+  btree__leaf_t *leaf = (btree__leaf_t *) node;
+  uint32_t pos = btree__count_less(leaf->keys, leaf->nkeys, key);
+  if (pos >= leaf->nkeys || leaf->keys[pos] != key) {
+    return false;
+  }
+  memmove(leaf->keys + pos, leaf->keys + pos + 1, (leaf->nkeys - pos - 1) * sizeof(uint64_t));
+  memmove(btree__value(btree, leaf, pos), btree__value(btree, leaf, pos + 1), (leaf->nkeys - pos - 1) * btree->val_size);
+  leaf->nkeys--;
+  btree->count--;
+
+  if (btree->height == 0 || leaf->nkeys >= BTREE__MIN) {
+    return true;
+  }
+  size_t h = btree->height - 1;
+  btree__leaf_rebalance(btree, path[h], slots[h]);
+  // a merge removes a separator from the parent, which can underflow in turn
+  while (h > 0 && path[h]->nkeys < BTREE__MIN) {
+    btree__inner_rebalance(btree, path[h - 1], slots[h - 1]);
+    --h;
+  }
+  btree__inner_t *root = (btree__inner_t *) btree->root;
+  if (root->nkeys == 0) {
+    btree->root = root->children[0];
+    btree->height--;
+    btree__inner_free(btree, root);
+  }
+  return true;
+}
+
+static inline btree_iter_t btree_seek(const btree_t *btree, uint64_t key) {
+  btree_iter_t it;
+  it.leaf = btree__find_leaf(btree, key);
+  it.pos = btree__count_less(it.leaf->keys, it.leaf->nkeys, key);
+  it.val_size = btree->val_size;
+  return it;
+}
+
+static inline bool btree_next(btree_iter_t *it, uint64_t *key, void **value) {
+  while (it->leaf != NULL && it->pos >= it->leaf->nkeys) {
+    it->leaf = it->leaf->next;
+    it->pos = 0;
+  }
+  if (it->leaf == NULL) {
+    return false;
+  }
+  if (key != NULL) {
+    *key = it->leaf->keys[it->pos];
+  }
+  if (value != NULL) {
+    *value = (char *) it->leaf + BTREE__LEAF_HEADER + it->pos * it->val_size;
+  }
+  it->pos++;
+  return true;
+}
+
+static inline btree_t *btree_load_with(size_t val_size, uint64_t *keys, void *values, size_t dim,
+                                       const chibi_allocator_t *allocator) {
+  btree_t *btree = btree_new_with(val_size, allocator);
+  if (btree == NULL || dim == 0) {
+    return btree;
+  }
+  size_t unique = 1;
+  bool sorted = true;
+  for (size_t i = 1; i < dim; ++i) {
+    sorted = sorted && keys[i - 1] <= keys[i];
+  }
+  if (!sorted) {
+    // the buffers of the sort come from the allocator of the tree too
+    const chibi_allocator_t *sort_allocator = s__allocator;
+    s_set_allocator(allocator);
+    int64_t result = (val_size > 0) ? s_radix_by_key_u64(keys, dim, 1, values, val_size) : s_radix_u64(keys, dim);
+    s_set_allocator(sort_allocator);
+    if (result < 0) {
+      btree_free(btree);
+      return NULL;
+    }
+  }
+  for (size_t i = 1; i < dim; ++i) {
+    unique += (keys[i - 1] != keys[i]);
+  }
+
+  // leaves, filled evenly so that all of them have at least BTREE__MIN keys
+  size_t nnodes = (unique + BTREE_KEYS - 1) / BTREE_KEYS;
+  size_t nodes_bytes = nnodes * sizeof(void *);
+  size_t mins_bytes = nnodes * sizeof(uint64_t);
+  void **nodes = (void **) chibi_alloc(allocator, nodes_bytes, CHIBI_DEFAULT_ALIGN);
+  uint64_t *mins = (uint64_t *) chibi_alloc(allocator, mins_bytes, CHIBI_DEFAULT_ALIGN);
+  if (nodes == NULL || mins == NULL) {
+    chibi_release(allocator, mins, mins_bytes);
+    chibi_release(allocator, nodes, nodes_bytes);
+    btree_free(btree);
+    return NULL;
+  }
+  btree__leaf_free(btree, (btree__leaf_t *) btree->root);
+  btree->root = NULL;
+  btree__leaf_t *prev = NULL;
+  size_t i = 0;
+  for (size_t n = 0; n < nnodes; ++n) {
+    btree__leaf_t *leaf = btree__leaf_new(btree);
+    if (leaf == NULL) {
+      while (n > 0) {
+        btree__leaf_free(btree, (btree__leaf_t *) nodes[--n]);
+      }
+      chibi_release(allocator, mins, mins_bytes);
+      chibi_release(allocator, nodes, nodes_bytes);
+      chibi_release(allocator, btree, sizeof(btree_t));
+      return NULL;
+    }
+    size_t take = unique / nnodes + (n < unique % nnodes);
+    for (uint32_t k = 0; k < take; ++k) {
+      // the last of the equal keys wins
+      while (i + 1 < dim && keys[i + 1] == keys[i]) {
+        ++i;
+      }
+      leaf->keys[k] = keys[i];
+      if (val_size > 0) {
+        memcpy(btree__value(btree, leaf, k), (char *) values + i * val_size, val_size);
+      }
+      ++i;
+    }
+    leaf->nkeys = (uint32_t) take;
+    leaf->prev = prev;
+    if (prev != NULL) {
+      prev->next = leaf;
+    }
+    prev = leaf;
+    nodes[n] = leaf;
+    mins[n] = leaf->keys[0];
+  }
+  btree->count = unique;
+
+  // inner levels, until a single node is left
+  size_t height = 0;
+  while (nnodes > 1) {
+    size_t nparents = (nnodes + BTREE_KEYS) / (BTREE_KEYS + 1);
+    size_t child = 0;
+    for (size_t p = 0; p < nparents; ++p) {
+      btree__inner_t *inner = btree__inner_new(btree);
+      if (inner == NULL) {
+        // the parents built so far own their children, the other children are still unowned
+        for (size_t q = 0; q < p; ++q) {
+          btree__free_node(btree, nodes[q], height + 1);
+        }
+        for (; child < nnodes; ++child) {
+          btree__free_node(btree, nodes[child], height);
+        }
+        chibi_release(allocator, mins, mins_bytes);
+        chibi_release(allocator, nodes, nodes_bytes);
+        chibi_release(allocator, btree, sizeof(btree_t));
+        return NULL;
+      }
+      size_t take = nnodes / nparents + (p < nnodes % nparents);
+      uint64_t min = mins[child];
+      for (size_t k = 0; k < take; ++k, ++child) {
+        inner->children[k] = nodes[child];
+        if (k > 0) {
+          inner->keys[k - 1] = mins[child];
+        }
+      }
+      inner->nkeys = (uint32_t)(take - 1);
+      // nodes[p] and mins[p] are no longer needed as children, since p < child
+      nodes[p] = inner;
+      mins[p] = min;
+    }
+    nnodes = nparents;
+    ++height;
+  }
+  btree->root = nodes[0];
+  btree->height = height;
+  chibi_release(allocator, mins, mins_bytes);
+  chibi_release(allocator, nodes, nodes_bytes);
+  return btree;
+}
+
+static inline btree_t *btree_load(size_t val_size, uint64_t *keys, void *values, size_t dim) {
+  return btree_load_with(val_size, keys, values, dim, NULL);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,470 @@
+/* cuckoo.h - Bucketized cuckoo hash map with bounded lookups
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * hash.h probes groups of slots until it finds a key or a free slot: a lookup is usually one
+ * group, but a miss in a region full of keys and tombstones can scan many of them. This map
+ * bounds the work of every lookup instead, which matters more than the average when lookups have
+ * a deadline.
+ *
+ * - every key has two candidate buckets of CUCKOO_SLOTS slots, chosen by its hash, and is always
+ *   stored in one of them or in the stash (below). A lookup reads at most the two buckets, and
+ *   then scans the keys in the stash, up to CUCKOO_STASH of them, when it is not empty.
+ * - every slot has a 1-byte tag taken from the hash of its key (0 marks an empty slot). The tags of
+ *   a bucket are compared with the tag of the key in a single SSE2 compare, and only the keys whose
+ *   tag matches are read: a miss almost never reads a key. The keys of a bucket fill one cache line.
+ * - when both buckets of a new key are full, a breadth-first search over the keys that could move
+ *   to their other bucket finds the shortest chain of moves that frees a slot (at most
+ *   CUCKOO_BFS_NODES buckets are visited), and the chain is applied from its end.
+ * - a key that finds no chain goes to a small stash of CUCKOO_STASH keys. The table doubles only
+ *   when the stash is full too, so it usually reaches a load above 95% before growing. A delete
+ *   moves a stashed key back into a bucket when it frees a slot in one of its buckets.
+ *
+ * Values have a generic size, like in hash.h: every value is a block of 'val_size' bytes, copied
+ * with memcpy, and cuckoo_get returns a pointer to it. Memory comes from the allocator given to
+ * cuckoo_new_with (allocator.h), or from the heap. cuckoo_reserve sizes the table up front for a
+ * load of at most 90%, so that inserts within the reserved size rarely need a resize: one still
+ * happens if a key finds no chain of moves while the stash is full.
+ *
+ * The map is not thread safe. Pointers returned by cuckoo_get are invalidated by cuckoo_put and
+ * cuckoo_del.
+ */
+
+#ifndef CHIBI_CUCKOO_H
+#define CHIBI_CUCKOO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "allocator.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CUCKOO__SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Slots per bucket: the keys of a bucket fill a cache line */
+#define CUCKOO_SLOTS 8
+
+/* Keys that can be stored outside their buckets before the table grows */
+#define CUCKOO_STASH 16
+
+/* Maximum number of buckets visited by the search for a free slot */
+#define CUCKOO_BFS_NODES 256
+
+#define CUCKOO__START_BUCKETS 8
+
+typedef struct cuckoo_t {
+  uint8_t *tags;       // CUCKOO_SLOTS tags per bucket, 0 for an empty slot
+  uint64_t *keys;      // CUCKOO_SLOTS keys per bucket
+  char *values;        // CUCKOO_SLOTS values per bucket, then the values of the stash
+  size_t nbuckets;     // a power of two
+  size_t count;        // number of keys
+  size_t val_size;
+  size_t nstash;
+  uint64_t stash[CUCKOO_STASH];
+  const chibi_allocator_t *allocator;
+} cuckoo_t;
+
+/* Creates an empty map.
+ * Arguments:
+ * - size of the value type (0 for a set of keys)
+ * Return:
+ * - the new map, or NULL on allocation failure
+ */
+static inline cuckoo_t *cuckoo_new(size_t val_size);
+
+/* Creates an empty map whose memory comes from a given allocator (NULL selects the heap).
+ */
+static inline cuckoo_t *cuckoo_new_with(size_t val_size, const chibi_allocator_t *allocator);
+
+/* Grows the table so that 'count' keys fill at most 90% of its slots, a load that inserts rarely
+ * need to exceed to find a slot: up to that count, a resize is unlikely but not ruled out.
+ * Return:
+ * - false on allocation failure (the map is left unchanged)
+ */
+static inline bool cuckoo_reserve(cuckoo_t *cuckoo, size_t count);
+
+/* Inserts a key with a copy of its value, or replaces the value if the key is already present.
+ * Return:
+ * - the number of keys in the map on success or -1 on failure (the map is left unchanged)
+ */
+static inline int64_t cuckoo_put(cuckoo_t *cuckoo, uint64_t key, const void *value);
+
+/* Returns a pointer to the value of a key, or NULL if the key is not in the map.
+ */
+static inline void *cuckoo_get(const cuckoo_t *cuckoo, uint64_t key);
+
+/* Removes a key and its value.
+ * Return:
+ * - true if the key was in the map
+ */
+static inline bool cuckoo_del(cuckoo_t *cuckoo, uint64_t key);
+
+/* Returns the number of keys in the map */
+#define cuckoo_size(cuckoo) (((cuckoo) == NULL) ? 0 : (cuckoo)->count)
+
+/* Frees the map.
+ */
+static inline void cuckoo_free(cuckoo_t *cuckoo);
+
+/* Typed interface: infers the size of the value type */
+#define cuckoo_new_typed(type) cuckoo_new(sizeof(type))
+
+// Same mixing function as hash.h, with a fixed seed
+static inline uint64_t cuckoo__hash(uint64_t key) {
+  key ^= 0x12345678ABCDEF00ULL;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+// The tag is taken from the bits that do not select the buckets
+static inline uint8_t cuckoo__tag(uint64_t hash) {
+  uint8_t tag = (uint8_t)(hash >> 56);
+  return (tag != 0) ? tag : 1;
+}
+
+static inline size_t cuckoo__bucket1(const cuckoo_t *cuckoo, uint64_t hash) {
+  return (size_t) hash & (cuckoo->nbuckets - 1);
+}
+
+static inline size_t cuckoo__bucket2(const cuckoo_t *cuckoo, uint64_t hash) {
+  size_t b1 = (size_t) hash & (cuckoo->nbuckets - 1);
+  size_t b2 = (size_t)(hash >> 32) & (cuckoo->nbuckets - 1);
+  // the two buckets must differ, or the key would have a single choice
+  return (b2 != b1) ? b2 : b1 ^ 1;
+}
+
+// Mask of the slots of a bucket whose tag is 'tag'
+static inline unsigned cuckoo__match(const uint8_t *tags, uint8_t tag) {
+#ifdef CUCKOO__SSE2
+  __m128i bucket = _mm_loadl_epi64((const __m128i *) tags);
+  return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(bucket, _mm_set1_epi8((char) tag))) & ((1u << CUCKOO_SLOTS) - 1);
+#else
+  unsigned mask = 0;
+  for (unsigned s = 0; s < CUCKOO_SLOTS; ++s) {
+    mask |= (unsigned)(tags[s] == tag) << s;
+  }
+  return mask;
+#endif
+}
+
+static inline unsigned cuckoo__ctz(unsigned mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (unsigned) index;
+#else
+  return (unsigned) __builtin_ctz(mask);
+#endif
+}
+
+#define cuckoo__value(cuckoo, index) ((cuckoo)->values + (size_t)(index) * (cuckoo)->val_size)
+
+// Allocates the arrays of a table of 'nbuckets' empty buckets
+static inline bool cuckoo__alloc(cuckoo_t *cuckoo, size_t nbuckets) {
+  size_t slots = nbuckets * CUCKOO_SLOTS;
+  cuckoo->tags = (uint8_t *) chibi_alloc(cuckoo->allocator, slots, CHIBI_DEFAULT_ALIGN);
+  cuckoo->keys = (uint64_t *) chibi_alloc(cuckoo->allocator, slots * sizeof(uint64_t), 64);
+  cuckoo->values = (char *) chibi_alloc(cuckoo->allocator, (slots + CUCKOO_STASH) * cuckoo->val_size + 1,
+                                        CHIBI_DEFAULT_ALIGN);
+  if (cuckoo->tags == NULL || cuckoo->keys == NULL || cuckoo->values == NULL) {
+    chibi_release(cuckoo->allocator, cuckoo->tags, slots);
+    chibi_release(cuckoo->allocator, cuckoo->keys, slots * sizeof(uint64_t));
+    chibi_release(cuckoo->allocator, cuckoo->values, (slots + CUCKOO_STASH) * cuckoo->val_size + 1);
+    return false;
+  }
+  memset(cuckoo->tags, 0, slots);
+  cuckoo->nbuckets = nbuckets;
+  cuckoo->nstash = 0;
+  return true;
+}
+
+static inline void cuckoo__release(cuckoo_t *cuckoo) {
+  size_t slots = cuckoo->nbuckets * CUCKOO_SLOTS;
+  chibi_release(cuckoo->allocator, cuckoo->tags, slots);
+  chibi_release(cuckoo->allocator, cuckoo->keys, slots * sizeof(uint64_t));
+  chibi_release(cuckoo->allocator, cuckoo->values, (slots + CUCKOO_STASH) * cuckoo->val_size + 1);
+}
+
+static inline cuckoo_t *cuckoo_new_with(size_t val_size, const chibi_allocator_t *allocator) {
+  cuckoo_t *cuckoo = (cuckoo_t *) chibi_alloc(allocator, sizeof(cuckoo_t), CHIBI_DEFAULT_ALIGN);
+  if (cuckoo == NULL) {
+    return NULL;
+  }
+  cuckoo->count = 0;
+  cuckoo->val_size = val_size;
+  cuckoo->allocator = allocator;
+  if (!cuckoo__alloc(cuckoo, CUCKOO__START_BUCKETS)) {
+    chibi_release(allocator, cuckoo, sizeof(cuckoo_t));
+    return NULL;
+  }
+  return cuckoo;
+}
+
+static inline cuckoo_t *cuckoo_new(size_t val_size) {
+  return cuckoo_new_with(val_size, NULL);
+}
+
+static inline void cuckoo_free(cuckoo_t *cuckoo) {
+  if (cuckoo == NULL) {
+    return;
+  }
+  cuckoo__release(cuckoo);
+  chibi_release(cuckoo->allocator, cuckoo, sizeof(cuckoo_t));
+}
+
+// Looks for a key. Its index is a slot (bucket * CUCKOO_SLOTS + slot) or, past the slots, a stash entry
+static inline bool cuckoo__find(const cuckoo_t *cuckoo, uint64_t key, size_t *index) {
+  uint64_t hash = cuckoo__hash(key);
+  uint8_t tag = cuckoo__tag(hash);
+  size_t buckets[2] = {cuckoo__bucket1(cuckoo, hash), cuckoo__bucket2(cuckoo, hash)};
+  for (int i = 0; i < 2; ++i) {
+    size_t base = buckets[i] * CUCKOO_SLOTS;
+    unsigned mask = cuckoo__match(cuckoo->tags + base, tag);
+    while (mask != 0) {
+      size_t slot = base + cuckoo__ctz(mask);
+      if (cuckoo->keys[slot] == key) {
+        *index = slot;
+        return true;
+      }
+      mask &= mask - 1;
+    }
+  }
+  for (size_t i = 0; i < cuckoo->nstash; ++i) {
+    if (cuckoo->stash[i] == key) {
+      *index = cuckoo->nbuckets * CUCKOO_SLOTS + i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline void *cuckoo_get(const cuckoo_t *cuckoo, uint64_t key) {
+  size_t index;
+  return cuckoo__find(cuckoo, key, &index) ? cuckoo__value(cuckoo, index) : NULL;
+}
+
+// Stores a key in a slot
+static inline void cuckoo__place(cuckoo_t *cuckoo, size_t slot, uint8_t tag, uint64_t key, const void *value) {
+  cuckoo->tags[slot] = tag;
+  cuckoo->keys[slot] = key;
+  if (cuckoo->val_size > 0) {
+    memcpy(cuckoo__value(cuckoo, slot), value, cuckoo->val_size);
+  }
+}
+
+// A bucket reached by the search: the key in 'slot' of the parent bucket can move into it
+typedef struct cuckoo__bfs_t {
+  size_t bucket;
+  int parent;
+  unsigned slot;
+} cuckoo__bfs_t;
+
+// Looks for a chain of moves that frees a slot in one of the two buckets and applies it.
+// Returns the freed slot, or -1 if none was found
+static inline int64_t cuckoo__bfs(cuckoo_t *cuckoo, size_t b1, size_t b2) {
+  cuckoo__bfs_t queue[CUCKOO_BFS_NODES];
+  int head = 0;
+  int tail = 2;
+  queue[0].bucket = b1;
+  queue[0].parent = -1;
+  queue[1].bucket = b2;
+  queue[1].parent = -1;
+  for (; head < tail; ++head) {
+    size_t bucket = queue[head].bucket;
+    unsigned empty = cuckoo__match(cuckoo->tags + bucket * CUCKOO_SLOTS, 0);
+    if (empty != 0) {
+      // move every key of the chain into the slot freed by the next one, starting from the end
+      int node = head;
+      unsigned free_slot = cuckoo__ctz(empty);
+      while (queue[node].parent >= 0) {
+        size_t from = queue[queue[node].parent].bucket * CUCKOO_SLOTS + queue[node].slot;
+        size_t to = queue[node].bucket * CUCKOO_SLOTS + free_slot;
+        cuckoo__place(cuckoo, to, cuckoo->tags[from], cuckoo->keys[from], cuckoo__value(cuckoo, from));
+        free_slot = queue[node].slot;
+        node = queue[node].parent;
+      }
+      return (int64_t)(queue[node].bucket * CUCKOO_SLOTS + free_slot);
+    }
+    for (unsigned s = 0; s < CUCKOO_SLOTS && tail < CUCKOO_BFS_NODES; ++s) {
+      uint64_t hash = cuckoo__hash(cuckoo->keys[bucket * CUCKOO_SLOTS + s]);
+      size_t alt = cuckoo__bucket1(cuckoo, hash);
+      if (alt == bucket) {
+        alt = cuckoo__bucket2(cuckoo, hash);
+      }
+      // a bucket already on the chain would be moved into twice
+      bool cycle = false;
+      for (int node = head; node >= 0 && !cycle; node = queue[node].parent) {
+        cycle = (queue[node].bucket == alt);
+      }
+      if (!cycle) {
+        queue[tail].bucket = alt;
+        queue[tail].parent = head;
+        queue[tail].slot = s;
+        ++tail;
+      }
+    }
+  }
+  return -1;
+}
+
+// Inserts a key that is not in the map. Returns false if the table is too full
+static inline bool cuckoo__insert(cuckoo_t *cuckoo, uint64_t key, const void *value) {
+  uint64_t hash = cuckoo__hash(key);
+  uint8_t tag = cuckoo__tag(hash);
+  size_t b1 = cuckoo__bucket1(cuckoo, hash);
+  size_t b2 = cuckoo__bucket2(cuckoo, hash);
+  unsigned empty = cuckoo__match(cuckoo->tags + b1 * CUCKOO_SLOTS, 0);
+  if (empty != 0) {
+    cuckoo__place(cuckoo, b1 * CUCKOO_SLOTS + cuckoo__ctz(empty), tag, key, value);
+    return true;
+  }
+  empty = cuckoo__match(cuckoo->tags + b2 * CUCKOO_SLOTS, 0);
+  if (empty != 0) {
+    cuckoo__place(cuckoo, b2 * CUCKOO_SLOTS + cuckoo__ctz(empty), tag, key, value);
+    return true;
+  }
+  int64_t slot = cuckoo__bfs(cuckoo, b1, b2);
+  if (slot >= 0) {
+    cuckoo__place(cuckoo, (size_t) slot, tag, key, value);
+    return true;
+  }
+  if (cuckoo->nstash < CUCKOO_STASH) {
+    size_t index = cuckoo->nbuckets * CUCKOO_SLOTS + cuckoo->nstash;
+    cuckoo->stash[cuckoo->nstash++] = key;
+    if (cuckoo->val_size > 0) {
+      memcpy(cuckoo__value(cuckoo, index), value, cuckoo->val_size);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Moves all the keys to a table of at least 'nbuckets' buckets, doubling it until they fit
+static inline bool cuckoo__resize(cuckoo_t *cuckoo, size_t nbuckets) {
+  for (;;) {
+    cuckoo_t resized = *cuckoo;
+    if (!cuckoo__alloc(&resized, nbuckets)) {
+      return false;
+    }
+    bool fits = true;
+    size_t slots = cuckoo->nbuckets * CUCKOO_SLOTS;
+    for (size_t i = 0; i < slots && fits; ++i) {
+      if (cuckoo->tags[i] != 0) {
+        fits = cuckoo__insert(&resized, cuckoo->keys[i], cuckoo__value(cuckoo, i));
+      }
+    }
+    for (size_t i = 0; i < cuckoo->nstash && fits; ++i) {
+      fits = cuckoo__insert(&resized, cuckoo->stash[i], cuckoo__value(cuckoo, slots + i));
+    }
+    if (fits) {
+      cuckoo__release(cuckoo);
+      *cuckoo = resized;
+      return true;
+    }
+    cuckoo__release(&resized);
+    nbuckets *= 2;
+  }
+}
+
+static inline bool cuckoo_reserve(cuckoo_t *cuckoo, size_t count) {
+  // sized for a load of 90%, below the load the table reaches before growing
+  size_t slots = count + count / 9;
+  size_t nbuckets = cuckoo->nbuckets;
+  while (nbuckets * CUCKOO_SLOTS < slots) {
+    nbuckets *= 2;
+  }
+  return nbuckets == cuckoo->nbuckets || cuckoo__resize(cuckoo, nbuckets);
+}
+
+static inline int64_t cuckoo_put(cuckoo_t *cuckoo, uint64_t key, const void *value) {
+  size_t index;
+  if (cuckoo__find(cuckoo, key, &index)) {
+    if (cuckoo->val_size > 0) {
+      memcpy(cuckoo__value(cuckoo, index), value, cuckoo->val_size);
+    }
+    return (int64_t) cuckoo->count;
+  }
+  while (!cuckoo__insert(cuckoo, key, value)) {
+    if (!cuckoo__resize(cuckoo, cuckoo->nbuckets * 2)) {
+      return -1;
+    }
+  }
+  return (int64_t) ++cuckoo->count;
+}
+
+static inline bool cuckoo_del(cuckoo_t *cuckoo, uint64_t key) {
+  size_t index;
+  if (!cuckoo__find(cuckoo, key, &index)) {
+    return false;
+  }
+  size_t slots = cuckoo->nbuckets * CUCKOO_SLOTS;
+  cuckoo->count--;
+  if (index >= slots) {
+    // the last stash entry takes the place of the removed one
+    size_t last = --cuckoo->nstash;
+    cuckoo->stash[index - slots] = cuckoo->stash[last];
+    memmove(cuckoo__value(cuckoo, index), cuckoo__value(cuckoo, slots + last), cuckoo->val_size);
+    return true;
+  }
+  cuckoo->tags[index] = 0;
+  // a stashed key whose buckets include this one takes the free slot
+  size_t bucket = index / CUCKOO_SLOTS;
+  for (size_t i = 0; i < cuckoo->nstash; ++i) {
+    uint64_t hash = cuckoo__hash(cuckoo->stash[i]);
+    if (cuckoo__bucket1(cuckoo, hash) == bucket || cuckoo__bucket2(cuckoo, hash) == bucket) {
+      cuckoo__place(cuckoo, index, cuckoo__tag(hash), cuckoo->stash[i], cuckoo__value(cuckoo, slots + i));
+      size_t last = --cuckoo->nstash;
+      cuckoo->stash[i] = cuckoo->stash[last];
+      memmove(cuckoo__value(cuckoo, slots + i), cuckoo__value(cuckoo, slots + last), cuckoo->val_size);
+      break;
+    }
+  }
+  return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -55,7 +55,8 @@
  *   generic <key, value> hash map. To increase flexibility, I chose to use 64-bit keys that can store, via appropriate
  *   casting, any kind of 64-bit value — integers, floats, and pointers.
  *
- * - A struct that stores information about the entire map, such as its size, capacity, and the size in bytes of the value type.
+ * - A struct that stores information about the entire map, such as its size, capacity, the size in bytes of the value type
+ *   and the allocator the map memory comes from (allocator.h).
  *
  * - An array that stores the user-provided values.
  *
@@ -69,6 +70,8 @@
  * - hash_is_full: macro that checks whether a slot in the map contains a valid element (i.e., not deleted or free).
  * - hash_is_free: macro that checks whether a slot in the map is free and ready to be filled.
  * - hash_free: macro that frees the map's resources.
+ * - hash_init_with: macro that allocates an empty map whose memory comes from a given allocator (allocator.h), for
+ *   example an arena (arena.h). Maps created implicitly by hash_put or hash_reserve use the heap.
  * - hash_set_hash_seed: function used to set the seed that randomizes the hash function output
  * - hash_reserve: ensures the map has capacity for at least the specified number of elements, resizing the map if necessary to the next power of two.
  * - hash_get: function that returns a pointer to the element associated with a given key. Returns NULL if the element
@@ -76,11 +79,11 @@
  * - hash_del: function that deletes the element associated with a given key. If the element does not exist, the
  *   function returns false; otherwise, it returns true.
  * - hash_put: macro that inserts a <key, value> pair into the map.
+ * - hash_export: function that copies all the <key, value> pairs of the map into a keys array and a values array.
  *
  * Private macros and functions (should not be used directly by the user, unless they really want to):
  *
- * - hash__aligned_allocation: cross-platform aligned malloc macro.
- * - hash__aligned_free: cross-platform aligned free macro.
+ * - hash__bytes: function that returns the size in bytes of the allocation of a map with a given capacity.
  * - hash__cast: macro that casts a pointer. This is required for C++ (in C, casting to void * is sufficient).
  * - hash__get_info: macro that "returns" a pointer to the `hash__info_t` structure.
  * - hash__get_keys: macro that "returns" a pointer to the first element of the keys array.
@@ -89,9 +92,10 @@
  *   performing allocation/deallocation, while `meta` is used when accessing metadata.
  * - hash__hash57: macro that extracts the 57 least significant bits from the computed hash value.
  * - hash__hash7: macro that extracts the 7 most significant bits from the computed hash value.
- * - hash__malloc: function that allocates a map with a given capacity.
- * - hash__init: macro that initializes the map to its initial capacity. A macro is used to infer the value type
+ * - hash__malloc: function that allocates a map with a given capacity from a given allocator.
+ * - hash__init_with: macro that initializes the map to its initial capacity. A macro is used to infer the value type
  *   from the pointer type.
+ * - hash__init: macro equivalent to `hash__init_with`, using the heap.
  * - hash__hash: the hash function used by this library.
  * - hash__rehash: function that performs rehashing after reallocating the map.
  * - hash__resize: macro that allocates a new map and rehashes the old one into it.
@@ -112,6 +116,11 @@
  * If multiple TUs operate on the same hash map, the user must ensure that the seed is
  * explicitly set to the same value in all of them using `hash_set_hash_seed()`.
  *
+ * When CHIBI_PROFILE is defined, hash_put, hash_get, hash_del and the resizes are timed with prof.h
+ * (entries hash_put, hash_get, hash_del and hash_resize of prof_report). When CHIBI_TRACE is
+ * defined, every resize is also recorded as a trace event (trace.h). With CHIBI_PROFILE_HIST the
+ * report also shows the p50, p99 and p99.9 latency of each of these operations (hist.h).
+ *
  * The library does not provide built-in thread safety. If hash maps are accessed
  * concurrently, it is the user's responsibility to enforce synchronization and ensure
  * consistent seed initialization across threads and compilation units.
@@ -123,8 +132,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#ifdef _MSC_VER
 #include <intrin.h>
+#endif
 #include <emmintrin.h>
+#include "allocator.h"
+#include "prof.h"
+#include "trace.h"
 
 /*
  * The map capacity should be a power of two
@@ -133,19 +147,26 @@
 */
 #define HASH__START_CAPACITY 16
 
+// Stores the index of the lowest set bit of 'mask' in 'off' and returns 1, or returns 0 if 'mask' is 0
+static inline unsigned char hash__bsf(unsigned long *off, unsigned long mask) {
+#ifdef _MSC_VER
+  return _BitScanForward(off, mask);
+#else
+  if (mask == 0) {
+    return 0;
+  }
+  *off = (unsigned long) __builtin_ctzl(mask);
+  return 1;
+#endif
+}
+
 typedef struct hash__info_t{
   size_t size;
   size_t capacity;
   size_t val_size;  // Value size in bytes, inferred from the pointer provided by the user
+  const chibi_allocator_t *allocator;  // Where the map memory comes from, NULL for the heap
 } hash__info_t;
 
-// Currently only supports Windows (MSVC); cross-platform support will be added in the future.
-#ifdef _MSC_VER
-#include <malloc.h>
-#define hash__aligned_allocation(size, align) _aligned_malloc((size), (align))
-#define hash__aligned_free(ptr)               _aligned_free((ptr))
-#endif
-
 // C++ requires an explicit cast; use reinterpret_cast to preserve type informationx
 #ifdef __cplusplus
 #define hash__cast(map, ptr) reinterpret_cast<decltype(map)>(ptr)
@@ -171,36 +192,49 @@ typedef struct hash__info_t{
 #define hash__hash57(h) ((h) & 0x01FFFFFFFFFFFFFF)
 #define hash__hash7(h)  (((h) >> 57) & 0x7F)
 
-#define hash_free(map) (hash__aligned_free(hash__get_base(map)))
-
-
-static inline void *hash__malloc(size_t capacity, size_t val_size) {
-  size_t bytes = sizeof(uint8_t) * capacity +
+static inline size_t hash__bytes(size_t capacity, size_t val_size) {
+  return sizeof(uint8_t) * capacity +
     sizeof(uint64_t) * capacity +
     sizeof(hash__info_t) +
     val_size * capacity;
+}
+
+#define hash_free(map) (chibi_release(hash__get_info(map)->allocator, hash__get_base(map),                    \
+                                      hash__bytes(hash_capacity(map), hash__get_info(map)->val_size)))
 
+
+static inline void *hash__malloc(size_t capacity, size_t val_size, const chibi_allocator_t *allocator) {
   // performs an aligned allocation, to facilitate SSE2 load 
-  void *base = hash__aligned_allocation(bytes, 16);
+  void *base = chibi_alloc(allocator, hash__bytes(capacity, val_size), 16);
 
   return base;
 }
 
 // We use a macro to infer the value size from the map pointer provided by the user
-#define hash__init(map) do {                                                                                             \
+#define hash__init_with(map, alloc) do {                                                                                 \
   if((map) == NULL) {                                                                                                    \
-    uint8_t *base = (uint8_t *) hash__malloc(HASH__START_CAPACITY, sizeof(*(map)));                                      \
+    const chibi_allocator_t *allocator__ = (alloc);                                                                      \
+    uint8_t *base = (uint8_t *) hash__malloc(HASH__START_CAPACITY, sizeof(*(map)), allocator__);                         \
     if (base != NULL) {                                                                                                  \
       memset(base, HASH__FREE, HASH__START_CAPACITY);                                                                    \
       hash__info_t *info = (hash__info_t *)(base + HASH__START_CAPACITY + sizeof(uint64_t) * HASH__START_CAPACITY);      \
       info->size = 0;                                                                                                    \
       info->capacity = HASH__START_CAPACITY;                                                                             \
       info->val_size = sizeof(*(map));                                                                                   \
+      info->allocator = allocator__;                                                                                     \
       (map) = hash__cast(map, (info + 1));                                                                               \
     }                                                                                                                    \
   }                                                                                                                      \
 } while(0)
 
+#define hash__init(map) hash__init_with(map, NULL)
+
+/*
+ * Allocates an empty map whose memory comes from 'allocator' (a const chibi_allocator_t *, NULL for the heap).
+ * The map must be NULL. The allocator is used for all the following resizes and must outlive the map.
+*/
+#define hash_init_with(map, allocator) hash__init_with(map, allocator)
+
 /*
  * Note: hash__seed is defined as a static variable, so each translation unit (TU) gets its own copy.
  * If multiple TUs operate on the same hash map, the user must ensure that the seed is set consistently
@@ -245,18 +279,24 @@ static inline void hash__rehash(void *map, void *nmap) {
 }
 
 #define hash__resize(map, ncapacity) do {                                                        \
+  PROF_BEGIN(hash_resize);                                                                       \
+  TRACE_BEGIN(hash_resize);                                                                      \
   size_t val_size = hash__get_info(map)->val_size;                                               \
-  uint8_t *nbase = (uint8_t *) hash__malloc((ncapacity), val_size);	                         \
+  const chibi_allocator_t *allocator__ = hash__get_info(map)->allocator;                         \
+  uint8_t *nbase = (uint8_t *) hash__malloc((ncapacity), val_size, allocator__);                 \
   if (nbase != 0) {                                                                              \
     memset(nbase, HASH__FREE, (ncapacity));				                         \
     hash__info_t *info = (hash__info_t *)(nbase + (ncapacity) + sizeof(uint64_t) * (ncapacity)); \
     info->size = hash_size(map);                                                                 \
     info->capacity = (ncapacity);                                                                \
     info->val_size = val_size;                                                                   \
+    info->allocator = allocator__;                                                               \
     hash__rehash((void *) map, (void *)(info + 1));                                              \
     hash_free(map);                                                                              \
     (map) = hash__cast(map, (info + 1));                                                         \
   }                                                                                              \
+  TRACE_END(hash_resize);                                                                        \
+  PROF_END(hash_resize);                                                                         \
 } while(0)
 
 /*
@@ -306,7 +346,7 @@ static inline int hash__get_idx(void *map, uint64_t key, size_t *idx) {
     
     if (match != 0) {
       unsigned long off;
-      while(_BitScanForward(&off, match)) {
+      while(hash__bsf(&off, match)) {
 	if (keys[i + off] == key) {
 	  *idx = i + off;
 	  return 1;
@@ -326,19 +366,23 @@ static inline int hash__get_idx(void *map, uint64_t key, size_t *idx) {
 }
 
 static inline void *hash_get(void *map, uint64_t key) {
+  PROF_BEGIN(hash_get);
   size_t val_size = hash__get_info(map)->val_size;
   size_t idx;
+  void *val = NULL;
   if(hash__get_idx(map, key, &idx) == 1) {
-    return (void *)((char *)(map) + val_size * idx);
-  } else {
-    return NULL;
+    val = (void *)((char *)(map) + val_size * idx);
   }
+  PROF_END(hash_get);
+  return val;
 }
 
 static inline bool hash_del(void *map, uint64_t key, int free_val) {
+  PROF_BEGIN(hash_del);
   size_t val_size = hash__get_info(map)->val_size;
   uint8_t *meta   = hash__get_meta(map);
   size_t idx;
+  bool found = false;
   if(hash__get_idx(map, key, &idx) == 1) {
     meta[idx] = HASH__TOMB;
     // If the map stores dynamically allocated values,
@@ -348,10 +392,37 @@ static inline bool hash_del(void *map, uint64_t key, int free_val) {
       free(val_ptr);
     }
     hash__get_info(map)->size--;
-    return true;
-  } else {
-    return false;
+    found = true;
+  }
+  PROF_END(hash_del);
+  return found;
+}
+
+/*
+ * Copies the keys and the values of the map into the 'keys' and 'vals' arrays, which must have room for
+ * hash_size(map) elements each, in slot order. The metadata is scanned one group at a time: the mask of
+ * the FULL slots of a group is the SIMD mask of the most significant bits of its 16 metadata bytes.
+ * Returns the number of pairs copied. sorting.h provides hash_sort_export to export them sorted by key.
+*/
+static inline size_t hash_export(void *map, uint64_t *keys, void *vals) {
+  if (map == NULL) {
+    return 0;
+  }
+  size_t val_size = hash__get_info(map)->val_size;
+  uint8_t *meta   = hash__get_meta(map);
+  uint64_t *mkeys = hash__get_keys(map);
+  size_t n = 0;
+  for (size_t i = 0; i < hash_capacity(map); i += 16) {
+    int full = _mm_movemask_epi8(_mm_load_si128((__m128i *)(meta + i)));
+    unsigned long off;
+    while(hash__bsf(&off, full)) {
+      keys[n] = mkeys[i + off];
+      memcpy((uint8_t *)(vals) + val_size * n, (uint8_t *)(map) + val_size * (i + off), val_size);
+      n++;
+      full &= (full - 1);
+    }
   }
+  return n;
 }
 
 static inline size_t hash__get_freetombidx(void *map, uint64_t key) {
@@ -367,7 +438,7 @@ static inline size_t hash__get_freetombidx(void *map, uint64_t key) {
     int freetomb = _mm_movemask_epi8(_mm_cmpeq_epi8(vmask, _mm_setzero_si128()));
     if (freetomb != 0) {
       unsigned long off;
-      _BitScanForward(&off, freetomb);
+      hash__bsf(&off, freetomb);
       return i + off;
     }
 
@@ -384,10 +455,10 @@ static inline size_t hash__get_freetombidx(void *map, uint64_t key) {
  * Inserts the new pair or updates the existing value.
  * Increments the size accordingly.
  * Automatically resizes the map when the load factor exceeds 75%.
- * Measures performance ticks for profiling.
+ * Timed with prof.h when CHIBI_PROFILE is defined.
 */
 #define hash_put(map, key, val) do{                           \
-  ticks_t start = prof_get_ticks();                           \
+  PROF_BEGIN(hash_put);                                       \
   if ((map) == NULL) {					      \
     hash__init(map);                                          \
   }                                                           \
@@ -409,8 +480,7 @@ static inline size_t hash__get_freetombidx(void *map, uint64_t key) {
   if(hash_size(map) >= (hash_capacity(map) / 4) * 3) {        \
     hash__resize(map, hash_capacity(map) * 2);                \
   }                                                           \
-  perf_ticks += (prof_get_ticks() - start);                   \
-  perf_count++;                                               \
+  PROF_END(hash_put);                                         \
 } while(0)
 
 #endif
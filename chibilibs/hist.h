@@ -0,0 +1,233 @@
+/* hist.h - Log-linear latency histogram
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * An average hides the rare slow calls (a resize in the middle of thousands of fast inserts) that
+ * make the tail latency. This histogram keeps the whole distribution of a value, typically a
+ * latency, in a fixed amount of memory, and answers percentile queries (p50, p99, p99.9, ...).
+ *
+ * The buckets are log-linear, like in HdrHistogram: every power of two is split into
+ * 2^HIST_SUB_BITS buckets of equal width, so every value is stored with a relative error of at
+ * most 2^-HIST_SUB_BITS (about 3%), from 0 to UINT64_MAX.
+ *
+ * - hist_record is constant time: a leading zero count, a shift and an increment.
+ * - histograms with the same HIST_SUB_BITS can be merged, so every thread can record into its own
+ *   histogram without synchronization, and the histograms are merged for the report.
+ * - hist_percentile scans the HIST_BUCKETS counters, so its cost does not depend on the number
+ *   of recorded values.
+ *
+ * prof.h records the duration of every timed region into a histogram when CHIBI_PROFILE_HIST is
+ * defined, which gives the percentiles of the operations of hash.h, vectors.h and sorting.h.
+ */
+
+#ifndef CHIBI_HIST_H
+#define CHIBI_HIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Every power of two is split into 2^HIST_SUB_BITS buckets */
+#ifndef HIST_SUB_BITS
+#define HIST_SUB_BITS 5
+#endif
+
+#define HIST__SUB_COUNT ((uint64_t) 1 << HIST_SUB_BITS)
+
+/* Number of buckets: the values below 2^HIST_SUB_BITS have one bucket each, then every power of two
+ * up to 2^63 has HIST__SUB_COUNT buckets */
+#define HIST_BUCKETS ((65 - HIST_SUB_BITS) * (1 << HIST_SUB_BITS))
+
+typedef struct hist_t {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total;  // number of recorded values
+  uint64_t min;
+  uint64_t max;
+  double sum;      // sum of the recorded values, for the mean
+} hist_t;
+
+/* Initializes an empty histogram.
+ */
+static inline void hist_init(hist_t *hist);
+
+/* Records a value.
+ */
+static inline void hist_record(hist_t *hist, uint64_t value);
+
+/* Records 'n' occurrences of a value.
+ */
+static inline void hist_record_n(hist_t *hist, uint64_t value, uint64_t n);
+
+/* Adds all the values recorded in 'src' to 'dst'.
+ */
+static inline void hist_merge(hist_t *dst, const hist_t *src);
+
+/* Returns the value below or at which 'percentile' percent (0 to 100) of the recorded values fall,
+ * within the precision of the buckets and never above the largest recorded value.
+ * Return:
+ * - the value, or 0 if the histogram is empty
+ */
+static inline uint64_t hist_percentile(const hist_t *hist, double percentile);
+
+/* Returns the mean of the recorded values (0 if the histogram is empty).
+ */
+static inline double hist_mean(const hist_t *hist);
+
+/* Returns the number of recorded values.
+ */
+#define hist_count(hist) ((hist)->total)
+
+/* Prints the count, the mean, p50, p90, p99, p99.9 and the maximum, each value multiplied by 'scale'
+ * (for example nanoseconds per tick).
+ */
+static inline void hist_print(const hist_t *hist, FILE *out, double scale);
+
+// Position of the most significant bit of a non zero value
+static inline int hist__msb(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return (int) index;
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+
+// Bucket of a value
+static inline size_t hist__index(uint64_t value) {
+  if (value < HIST__SUB_COUNT) {
+    return (size_t) value;
+  }
+  int shift = hist__msb(value) - HIST_SUB_BITS;
+  // the HIST_SUB_BITS bits below the most significant one select the bucket in the power of two
+  return (size_t)(shift + 1) * HIST__SUB_COUNT + (size_t)((value >> shift) - HIST__SUB_COUNT);
+}
+
+// Largest value of a bucket
+static inline uint64_t hist__upper(size_t index) {
+  if (index < HIST__SUB_COUNT) {
+    return (uint64_t) index;
+  }
+  int shift = (int)(index / HIST__SUB_COUNT) - 1;
+  uint64_t lower = (HIST__SUB_COUNT + (index % HIST__SUB_COUNT)) << shift;
+  return lower + (((uint64_t) 1 << shift) - 1);
+}
+
+static inline void hist_init(hist_t *hist) {
+  memset(hist, 0, sizeof(*hist));
+  hist->min = UINT64_MAX;
+}
+
+static inline void hist_record_n(hist_t *hist, uint64_t value, uint64_t n) {
+  if (n == 0) {
+    return;
+  }
+  hist->counts[hist__index(value)] += n;
+  hist->total += n;
+  hist->sum += (double) value * (double) n;
+  if (value < hist->min) {
+    hist->min = value;
+  }
+  if (value > hist->max) {
+    hist->max = value;
+  }
+}
+
+static inline void hist_record(hist_t *hist, uint64_t value) {
+  hist_record_n(hist, value, 1);
+}
+
+static inline void hist_merge(hist_t *dst, const hist_t *src) {
+  if (src->total == 0) {
+    return;
+  }
+  for (size_t i = 0; i < HIST_BUCKETS; ++i) {
+    dst->counts[i] += src->counts[i];
+  }
+  dst->total += src->total;
+  dst->sum += src->sum;
+  if (src->min < dst->min) {
+    dst->min = src->min;
+  }
+  if (src->max > dst->max) {
+    dst->max = src->max;
+  }
+}
+
+static inline uint64_t hist_percentile(const hist_t *hist, double percentile) {
+  if (hist->total == 0) {
+    return 0;
+  }
+  if (percentile <= 0.0) {
+    return hist->min;
+  }
+  // rank of the value, between 1 and total
+  double rank = percentile / 100.0 * (double) hist->total;
+  uint64_t target = (rank >= (double) hist->total) ? hist->total : (uint64_t) rank;
+  if ((double) target < rank || target == 0) {
+    ++target;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < HIST_BUCKETS; ++i) {
+    seen += hist->counts[i];
+    if (seen >= target) {
+      uint64_t upper = hist__upper(i);
+      return (upper < hist->max) ? upper : hist->max;
+    }
+  }
+  return hist->max;
+}
+
+static inline double hist_mean(const hist_t *hist) {
+  return (hist->total > 0) ? hist->sum / (double) hist->total : 0.0;
+}
+
+static inline void hist_print(const hist_t *hist, FILE *out, double scale) {
+  fprintf(out, "count %llu  mean %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+          (unsigned long long) hist->total, hist_mean(hist) * scale,
+          (double) hist_percentile(hist, 50.0) * scale, (double) hist_percentile(hist, 90.0) * scale,
+          (double) hist_percentile(hist, 99.0) * scale, (double) hist_percentile(hist, 99.9) * scale,
+          (double) hist->max * scale);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,427 @@
+/* intern.h - String interning with dense, stable IDs
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * An interning table gives every distinct string a small integer ID: 0 for the first string
+ * interned, 1 for the second, and so on. The ID of a string never changes, so code that would
+ * hash and compare the same strings over and over (tag names, field keys) can intern them once
+ * and then work on uint32_t IDs, for example as the keys of a hash.h map or as array indices.
+ *
+ * - the bytes of the strings are copied into an arena (arena.h), one after the other, each
+ *   followed by a '\0'. They never move, so the pointer returned by intern_str stays valid until
+ *   intern_free.
+ * - the ID to string lookup (intern_str) is an array index.
+ * - the string to ID lookup goes through an index in the style of hash.h: one control byte per
+ *   slot with 7 bits of the hash, groups of 16 slots probed with SSE2 compares, and a maximum
+ *   load of 75%. The control bytes are packed in 64-bit words, which are the unit of the atomic
+ *   accesses: a group is read with two acquire loads, and a writer fills a slot by storing the
+ *   whole word of its byte. The full hash of every string is stored next to it, so a probe compares the
+ *   bytes of a string only when the hashes are equal, and growing the index does not hash the
+ *   strings again.
+ *
+ * Threads: intern_find, intern_str and intern_count are lock-free and can run at any time,
+ * concurrently with each other and with intern_put. intern_put takes a lock only to add a new
+ * string; interning a string that is already in the table is a lock-free lookup. To make this
+ * possible, the arrays of the table are never freed while the table is alive: when the index or
+ * the array of strings grows, the new copy is published with a release store and the old one
+ * stays in the arena (at most as much memory as the current copy), so a reader that loaded the
+ * old pointer can finish its lookup. A string that is being added while a lookup runs may or may
+ * not be found by it.
+ *
+ * The atomics are the GCC/Clang __atomic builtins, or volatile accesses with MSVC (see trace.h).
+ */
+
+#ifndef CHIBI_INTERN_H
+#define CHIBI_INTERN_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "arena.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define INTERN__SSE2
+#endif
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* ID returned for a string that is not in the table, or when intern_put fails */
+#define INTERN_NONE UINT32_MAX
+
+#define INTERN__GROUP 16
+#define INTERN__START_SLOTS 64
+#define INTERN__START_ENTRIES 64
+
+typedef struct intern__entry_t {
+  const char *str;
+  uint64_t hash;
+  uint32_t len;
+} intern__entry_t;
+
+typedef struct intern__index_t {
+  size_t capacity;  // number of slots, a power of two and a multiple of INTERN__GROUP
+  uint64_t *ctrl;   // control bytes, 8 per word from the low byte: 0 for an empty slot, 0x80 | 7 bits of the hash for a full one
+  uint32_t *ids;
+} intern__index_t;
+
+typedef struct intern_t {
+  intern__index_t *index;    // published with a release store
+  intern__entry_t *entries;  // indexed by ID, published with a release store
+  uint32_t count;            // published with a release store, after the string it counts
+  uint32_t capacity;         // of 'entries'
+  arena_t arena;             // strings, arrays of entries and indexes
+#ifdef _WIN32
+  SRWLOCK lock;              // serializes the writers
+#else
+  pthread_mutex_t lock;
+#endif
+} intern_t;
+
+/* Creates an empty table.
+ * Return:
+ * - the new table, or NULL on allocation failure
+ */
+static inline intern_t *intern_new(void);
+
+/* Returns the ID of a string, adding a copy of it to the table if it is not there yet.
+ * Arguments:
+ * - the table
+ * - the string, which does not need to be '\0' terminated
+ * - its length in bytes
+ * Return:
+ * - the ID, or INTERN_NONE on allocation failure or if the table is full
+ */
+static inline uint32_t intern_put(intern_t *intern, const char *str, size_t len);
+
+/* Returns the ID of a string, or INTERN_NONE if it was never interned. Lock-free.
+ */
+static inline uint32_t intern_find(const intern_t *intern, const char *str, size_t len);
+
+/* Returns the '\0' terminated copy of the string with a given ID, and optionally its length.
+ * The ID must have been returned by intern_put or intern_find on this table. Lock-free.
+ */
+static inline const char *intern_str(const intern_t *intern, uint32_t id, size_t *len);
+
+/* Returns the number of strings in the table, which are the IDs from 0 to count - 1. Lock-free.
+ */
+static inline uint32_t intern_count(const intern_t *intern);
+
+/* Frees the table and all its strings. No other thread may be using the table.
+ */
+static inline void intern_free(intern_t *intern);
+
+/* '\0' terminated strings */
+#define intern_put_cstr(intern, str) intern_put((intern), (str), strlen(str))
+#define intern_find_cstr(intern, str) intern_find((intern), (str), strlen(str))
+
+#if defined(_MSC_VER) && !defined(__clang__)
+// volatile accesses have acquire/release semantics with MSVC (/volatile:ms, the default on x86 and x64)
+#define intern__load_acquire(p) (*(void *const volatile *)(p))
+#define intern__store_release(p, v) (*(void *volatile *)(p) = (void *)(v))
+// on 32-bit x86 a word may be read in two halves, but a writer changes a single byte of it
+#define intern__load_ctrl(p) (*(volatile const uint64_t *)(p))
+#define intern__store_ctrl(p, v) (*(volatile uint64_t *)(p) = (v))
+#define intern__load_count(p) (*(volatile const uint32_t *)(p))
+#define intern__store_count(p, v) (*(volatile uint32_t *)(p) = (v))
+#define intern__lock_init(l) InitializeSRWLock(l)
+#define intern__lock_acquire(l) AcquireSRWLockExclusive(l)
+#define intern__lock_release(l) ReleaseSRWLockExclusive(l)
+#define intern__lock_destroy(l) ((void) 0)
+#else
+#define intern__load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define intern__store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define intern__load_ctrl(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define intern__store_ctrl(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define intern__load_count(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define intern__store_count(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#ifdef _WIN32
+#define intern__lock_init(l) InitializeSRWLock(l)
+#define intern__lock_acquire(l) AcquireSRWLockExclusive(l)
+#define intern__lock_release(l) ReleaseSRWLockExclusive(l)
+#define intern__lock_destroy(l) ((void) 0)
+#else
+#define intern__lock_init(l) pthread_mutex_init((l), NULL)
+#define intern__lock_acquire(l) pthread_mutex_lock(l)
+#define intern__lock_release(l) pthread_mutex_unlock(l)
+#define intern__lock_destroy(l) pthread_mutex_destroy(l)
+#endif
+#endif
+
+// Hash of a byte string: 8 bytes at a time, then the finalizer of hash.h
+static inline uint64_t intern__hash(const char *str, size_t len) {
+  uint64_t hash = 0x12345678ABCDEF00ULL ^ (len * 0x9E3779B97F4A7C15ULL);
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    memcpy(&word, str + i, 8);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 32;
+  }
+  if (i < len) {
+    uint64_t word = 0;
+    memcpy(&word, str + i, len - i);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+#define intern__hash7(hash) ((uint8_t)(0x80 | ((hash) & 0x7F)))
+#define intern__group(hash, capacity) ((size_t)((hash) >> 7) & ((capacity) - 1) & ~(size_t)(INTERN__GROUP - 1))
+
+// Control byte of a slot, and the word that holds it
+#define intern__ctrl_word(index, slot) (&(index)->ctrl[(slot) / 8])
+#define intern__ctrl_shift(slot) (8 * (unsigned)((slot) % 8))
+
+// Masks of the slots of a group whose control byte is 'ctrl', and of the empty slots. The two
+// words of the group are read with acquire loads, so a matching byte makes the ID of its slot and
+// its entry visible
+static inline unsigned intern__match(const uint64_t *group, uint8_t ctrl, unsigned *empty) {
+  uint64_t lo = intern__load_ctrl(&group[0]);
+  uint64_t hi = intern__load_ctrl(&group[1]);
+#ifdef INTERN__SSE2
+  __m128i bytes = _mm_set_epi64x((long long) hi, (long long) lo);
+  *empty = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+  return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char) ctrl)));
+#else
+  unsigned match = 0;
+  *empty = 0;
+  for (unsigned i = 0; i < INTERN__GROUP; ++i) {
+    uint8_t byte = (uint8_t)(((i < 8) ? lo : hi) >> intern__ctrl_shift(i));
+    match |= (unsigned)(byte == ctrl) << i;
+    *empty |= (unsigned)(byte == 0) << i;
+  }
+  return match;
+#endif
+}
+
+static inline unsigned intern__ctz(unsigned mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (unsigned) index;
+#else
+  return (unsigned) __builtin_ctz(mask);
+#endif
+}
+
+// Looks up a string with a known hash
+static inline uint32_t intern__find(const intern_t *intern, const char *str, size_t len, uint64_t hash) {
+  const intern__index_t *index = (const intern__index_t *) intern__load_acquire(&intern->index);
+  uint8_t ctrl = intern__hash7(hash);
+  size_t i = intern__group(hash, index->capacity);
+  for (;;) {
+    unsigned empty;
+    unsigned match = intern__match(intern__ctrl_word(index, i), ctrl, &empty);
+    while (match != 0) {
+      size_t slot = i + intern__ctz(match);
+      uint32_t id = index->ids[slot];
+      const intern__entry_t *entries = (const intern__entry_t *) intern__load_acquire(&intern->entries);
+      const intern__entry_t *entry = &entries[id];
+      if (entry->hash == hash && entry->len == len && memcmp(entry->str, str, len) == 0) {
+        return id;
+      }
+      match &= match - 1;
+    }
+    if (empty != 0) {
+      return INTERN_NONE;
+    }
+    i = (i + INTERN__GROUP) & (index->capacity - 1);
+  }
+}
+
+// Adds an ID to an index that has room for it. There is a single writer, so the word of the slot
+// cannot change between its load and its store
+static inline void intern__index_add(intern__index_t *index, uint64_t hash, uint32_t id) {
+  size_t i = intern__group(hash, index->capacity);
+  for (;;) {
+    unsigned empty;
+    intern__match(intern__ctrl_word(index, i), 0, &empty);
+    if (empty != 0) {
+      size_t slot = i + intern__ctz(empty);
+      index->ids[slot] = id;
+      uint64_t *word = intern__ctrl_word(index, slot);
+      uint64_t filled = intern__load_ctrl(word) | ((uint64_t) intern__hash7(hash) << intern__ctrl_shift(slot));
+      intern__store_ctrl(word, filled);
+      return;
+    }
+    i = (i + INTERN__GROUP) & (index->capacity - 1);
+  }
+}
+
+// Builds an index of 'capacity' slots holding the first 'count' entries
+static inline intern__index_t *intern__index_new(intern_t *intern, size_t capacity, uint32_t count) {
+  intern__index_t *index = arena_alloc_typed(&intern->arena, intern__index_t, 1);
+  uint64_t *ctrl = (uint64_t *) arena_alloc(&intern->arena, capacity, INTERN__GROUP);
+  uint32_t *ids = arena_alloc_typed(&intern->arena, uint32_t, capacity);
+  if (index == NULL || ctrl == NULL || ids == NULL) {
+    return NULL;
+  }
+  memset(ctrl, 0, capacity);
+  index->capacity = capacity;
+  index->ctrl = ctrl;
+  index->ids = ids;
+  for (uint32_t id = 0; id < count; ++id) {
+    intern__index_add(index, intern->entries[id].hash, id);
+  }
+  return index;
+}
+
+static inline intern_t *intern_new(void) {
+  intern_t *intern = (intern_t *) malloc(sizeof(intern_t));
+  if (intern == NULL) {
+    return NULL;
+  }
+  arena_init(&intern->arena, 0);
+  intern->count = 0;
+  intern->capacity = INTERN__START_ENTRIES;
+  intern->entries = arena_alloc_typed(&intern->arena, intern__entry_t, INTERN__START_ENTRIES);
+  intern->index = (intern->entries != NULL) ? intern__index_new(intern, INTERN__START_SLOTS, 0) : NULL;
+  if (intern->index == NULL) {
+    arena_free(&intern->arena);
+    free(intern);
+    return NULL;
+  }
+  intern__lock_init(&intern->lock);
+  return intern;
+}
+
+static inline void intern_free(intern_t *intern) {
+  if (intern == NULL) {
+    return;
+  }
+  intern__lock_destroy(&intern->lock);
+  arena_free(&intern->arena);
+  free(intern);
+}
+
+static inline uint32_t intern_find(const intern_t *intern, const char *str, size_t len) {
+  return intern__find(intern, str, len, intern__hash(str, len));
+}
+
+static inline const char *intern_str(const intern_t *intern, uint32_t id, size_t *len) {
+  const intern__entry_t *entries = (const intern__entry_t *) intern__load_acquire(&intern->entries);
+  if (len != NULL) {
+    *len = entries[id].len;
+  }
+  return entries[id].str;
+}
+
+static inline uint32_t intern_count(const intern_t *intern) {
+  return intern__load_count(&intern->count);
+}
+
+// Adds a string that is not in the table; the caller holds the lock
+static inline uint32_t intern__add(intern_t *intern, const char *str, size_t len, uint64_t hash) {
+  uint32_t id = intern->count;
+  if (id == INTERN_NONE || len > UINT32_MAX) {
+    return INTERN_NONE;
+  }
+  if (id == intern->capacity) {
+    if (intern->capacity > UINT32_MAX / 2) {
+      return INTERN_NONE;
+    }
+    uint32_t capacity = intern->capacity * 2;
+    intern__entry_t *entries = arena_alloc_typed(&intern->arena, intern__entry_t, capacity);
+    if (entries == NULL) {
+      return INTERN_NONE;
+    }
+    memcpy(entries, intern->entries, id * sizeof(intern__entry_t));
+    intern__store_release(&intern->entries, entries);
+    intern->capacity = capacity;
+  }
+  intern__index_t *index = intern->index;
+  if (((size_t) id + 1) * 4 > index->capacity * 3) {
+    index = intern__index_new(intern, index->capacity * 2, id);
+    if (index == NULL) {
+      return INTERN_NONE;
+    }
+  }
+  char *copy = (char *) arena_alloc(&intern->arena, len + 1, 1);
+  if (copy == NULL) {
+    return INTERN_NONE;
+  }
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  intern__entry_t *entry = &intern->entries[id];
+  entry->str = copy;
+  entry->hash = hash;
+  entry->len = (uint32_t) len;
+  // the release stores make the entry visible before the index slot that leads to it
+  intern__index_add(index, hash, id);
+  if (index != intern->index) {
+    intern__store_release(&intern->index, index);
+  }
+  intern__store_count(&intern->count, id + 1);
+  return id;
+}
+
+static inline uint32_t intern_put(intern_t *intern, const char *str, size_t len) {
+  uint64_t hash = intern__hash(str, len);
+  uint32_t id = intern__find(intern, str, len, hash);
+  if (id != INTERN_NONE) {
+    return id;
+  }
+  intern__lock_acquire(&intern->lock);
+  // another thread may have added the string since the lookup
+  id = intern__find(intern, str, len, hash);
+  if (id == INTERN_NONE) {
+    id = intern__add(intern, str, len, hash);
+  }
+  intern__lock_release(&intern->lock);
+  return id;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,340 @@
+/* lsm.h - Incremental sorted container built on sorted levels
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * This library keeps a sorted multiset of generic elements under continuous inserts, as an
+ * alternative to v_insert at a binary-searched position, which moves O(n) elements per insert.
+ *
+ * New elements are inserted into a small sorted buffer of LSM_BUFFER elements (a binary search
+ * and a move of at most LSM_BUFFER elements). When the buffer is full it is pushed into a list
+ * of sorted levels whose sizes grow exponentially,
+ * like the digits of a binary counter: level i is either empty or holds about LSM_BUFFER * 2^i
+ * elements. Pushing a run into a non-empty level merges the two (s_merge_2) and carries the
+ * result to the next level. Every element takes part in at most log2(n / LSM_BUFFER) merges,
+ * so inserts cost amortized O(log n) sequential moves.
+ *
+ * Queries binary search the buffer and every level, so a point query costs O(log^2 n) and a
+ * range query merges the matching span of the buffer and of every level (s_merge_k) into a
+ * sorted output.
+ *
+ * Levels keep their storage when they are emptied by a merge, so that it can be reused by the
+ * next carry: the container uses about twice the memory of its elements. All the memory of a
+ * container comes from the allocator given to lsm_new_with (allocator.h); the merger of a range
+ * query over more than two spans comes from the allocator of sorting.h (s_set_allocator).
+ */
+
+#ifndef CHIBI_LSM_H
+#define CHIBI_LSM_H
+
+#include "sorting.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Number of elements of the sorted insert buffer */
+#define LSM_BUFFER 64
+
+/* Maximum number of levels (LSM_BUFFER * 2^LSM_MAX_LEVELS elements) */
+#define LSM_MAX_LEVELS 48
+
+// A vector of elements with its capacity
+typedef struct lsm__block_t {
+  char *data;
+  size_t dim;
+  size_t capacity;
+} lsm__block_t;
+
+typedef struct lsm_t {
+  const chibi_allocator_t *allocator;  // where the memory comes from, NULL for the heap
+  size_t size;
+  size_t count;  // total number of elements
+  bool (*order)(const void *lhs, const void *rhs);
+  lsm__block_t buffer;   // recent inserts, sorted, equal keys in insertion order
+  lsm__block_t carry;    // sorted run being pushed into the levels
+  lsm__block_t scratch;  // output of the merges
+  size_t nlevels;
+  lsm__block_t levels[LSM_MAX_LEVELS];
+} lsm_t;
+
+/* Creates an empty container.
+ * Arguments:
+ * - size of element type
+ * - a pointer to an ordering function
+ * Return:
+ * - the new container, or NULL on allocation failure
+ */
+static inline lsm_t *lsm_new(size_t size, bool (*order)(const void *lhs, const void *rhs));
+
+/* Creates an empty container whose memory comes from 'allocator' (NULL for the heap). The
+ * allocator must outlive the container.
+ * Arguments:
+ * - size of element type
+ * - a pointer to an ordering function
+ * - the allocator
+ * Return:
+ * - the new container, or NULL on allocation failure
+ */
+static inline lsm_t *lsm_new_with(size_t size, bool (*order)(const void *lhs, const void *rhs),
+                                  const chibi_allocator_t *allocator);
+
+/* Inserts a copy of an element. Equal elements are kept, in insertion order.
+ * Return:
+ * - the number of elements in the container on success or -1 on failure
+ */
+static inline int64_t lsm_insert(lsm_t *lsm, const void *elem);
+
+/* Pushes the insert buffer into the levels.
+ * Return:
+ * - the number of elements in the container on success or -1 on failure
+ */
+static inline int64_t lsm_flush(lsm_t *lsm);
+
+/* Point query.
+ * Looks for an element equal to 'key' (neither orders before the other), starting from the
+ * most recent inserts.
+ * Arguments:
+ * - the container
+ * - the key
+ * - where to copy the element found, or NULL
+ * Return:
+ * - true if an element was found
+ */
+static inline bool lsm_find(const lsm_t *lsm, const void *key, void *output);
+
+/* Returns the number of elements equal to 'key'.
+ */
+static inline size_t lsm_count(const lsm_t *lsm, const void *key);
+
+/* Range query.
+ * Copies the elements in [lo, hi) (lo <= elem < hi according to the ordering function) to
+ * 'output', in sorted order. Equal elements keep their insertion order.
+ * Arguments:
+ * - the container
+ * - the lower bound (included)
+ * - the upper bound (excluded)
+ * - the output vector, or NULL to only count the elements
+ * Return:
+ * - the number of elements in the range on success or -1 on failure
+ */
+static inline int64_t lsm_range(const lsm_t *lsm, const void *lo, const void *hi, void *output);
+
+/* Copies all the elements to 'output' (with room for lsm_size elements), in sorted order.
+ * Return:
+ * - the number of elements written on success or -1 on failure
+ */
+static inline int64_t lsm_export(const lsm_t *lsm, void *output);
+
+/* Returns the number of elements in the container */
+#define lsm_size(lsm) (((lsm) == NULL) ? 0 : (lsm)->count)
+
+/* Frees the container.
+ */
+static inline void lsm_free(lsm_t *lsm);
+
+/* Typed interface: infers the size of the element type from a pointer to it */
+#define lsm_new_typed(type, order) lsm_new(sizeof(type), (order))
+#define lsm_new_with_typed(type, order, allocator) lsm_new_with(sizeof(type), (order), (allocator))
+
+static inline lsm_t *lsm_new_with(size_t size, bool (*order)(const void *lhs, const void *rhs),
+                                  const chibi_allocator_t *allocator) {
+  lsm_t *lsm = (lsm_t *) chibi_alloc(allocator, sizeof(lsm_t), CHIBI_DEFAULT_ALIGN);
+  if (lsm == NULL) {
+    return NULL;
+  }
+  memset(lsm, 0, sizeof(lsm_t));
+  lsm->allocator = allocator;
+  lsm->size = size;
+  lsm->order = order;
+  return lsm;
+}
+
+static inline lsm_t *lsm_new(size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  return lsm_new_with(size, order, NULL);
+}
+
+// Grows the block so that it holds at least 'capacity' elements. Returns false on failure
+static inline bool lsm__reserve(const lsm_t *lsm, lsm__block_t *block, size_t capacity) {
+  if (block->capacity >= capacity) {
+    return true;
+  }
+  char *data = (char *) chibi_resize(lsm->allocator, block->data, block->capacity * lsm->size,
+                                     capacity * lsm->size, CHIBI_DEFAULT_ALIGN);
+  if (data == NULL) {
+    return false;
+  }
+  block->data = data;
+  block->capacity = capacity;
+  return true;
+}
+
+static inline void lsm__swap(lsm__block_t *a, lsm__block_t *b) {
+  lsm__block_t swap = *a;
+  *a = *b;
+  *b = swap;
+}
+
+static inline int64_t lsm_flush(lsm_t *lsm) {
+  size_t size = lsm->size;
+  if (lsm->buffer.dim == 0) {
+    return (int64_t) lsm->count;
+  }
+
+  // the buffer becomes the carry, the old carry storage becomes the new buffer
+  lsm__swap(&lsm->buffer, &lsm->carry);
+  for (size_t i = 0; ; ++i) {
+    if (i == LSM_MAX_LEVELS) {
+      lsm__swap(&lsm->buffer, &lsm->carry);
+      return -1;
+    }
+    lsm__block_t *level = &lsm->levels[i];
+    if (i == lsm->nlevels) {
+      ++lsm->nlevels;
+    }
+    if (level->dim == 0) {
+      lsm__swap(level, &lsm->carry);
+      break;
+    }
+
+    size_t dim = level->dim + lsm->carry.dim;
+    if (!lsm__reserve(lsm, &lsm->scratch, dim)) {
+      // the carry goes back in the buffer, where the next flush will find it
+      lsm__swap(&lsm->buffer, &lsm->carry);
+      return -1;
+    }
+    // the older level goes first, so that equal elements keep their insertion order
+    s_merge_2(level->data, level->dim, lsm->carry.data, lsm->carry.dim, lsm->scratch.data, size, lsm->order);
+    lsm->scratch.dim = dim;
+    level->dim = 0;
+    lsm->carry.dim = 0;
+    lsm__swap(&lsm->carry, &lsm->scratch);
+  }
+  lsm->carry.dim = 0;
+  return (int64_t) lsm->count;
+}
+
+static inline int64_t lsm_insert(lsm_t *lsm, const void *elem) {
+  // after a failed flush the buffer may hold more than LSM_BUFFER elements
+  if (lsm->buffer.dim >= LSM_BUFFER && lsm_flush(lsm) < 0) {
+    return -1;
+  }
+  if (!lsm__reserve(lsm, &lsm->buffer, LSM_BUFFER)) {
+    return -1;
+  }
+  size_t size = lsm->size;
+  char *data = lsm->buffer.data;
+  // after the equal elements, which keep their insertion order
+  size_t pos = s_upper_bound(data, lsm->buffer.dim, size, lsm->order, elem);
+  memmove(data + (pos + 1) * size, data + pos * size, (lsm->buffer.dim - pos) * size);
+  memcpy(data + pos * size, elem, size);
+  ++lsm->buffer.dim;
+  return (int64_t) ++lsm->count;
+}
+
+// Returns the last element of a sorted block equal to 'key', or NULL
+static inline const char *lsm__find_in(const lsm_t *lsm, const lsm__block_t *block, const void *key) {
+  size_t i = s_upper_bound(block->data, block->dim, lsm->size, lsm->order, key);
+  if (i > 0 && !lsm->order(block->data + (i - 1) * lsm->size, key)) {
+    return block->data + (i - 1) * lsm->size;
+  }
+  return NULL;
+}
+
+static inline bool lsm_find(const lsm_t *lsm, const void *key, void *output) {
+  // the buffer holds the most recent inserts, then level 0 the most recent sorted run
+  const char *found = lsm__find_in(lsm, &lsm->buffer, key);
+  for (size_t l = 0; l < lsm->nlevels && found == NULL; ++l) {
+    found = lsm__find_in(lsm, &lsm->levels[l], key);
+  }
+  if (found != NULL && output != NULL) {
+    memcpy(output, found, lsm->size);
+  }
+  return found != NULL;
+}
+
+static inline size_t lsm_count(const lsm_t *lsm, const void *key) {
+  s_range_t range = s_equal_range(lsm->buffer.data, lsm->buffer.dim, lsm->size, lsm->order, key);
+  size_t count = range.last - range.first;
+  for (size_t l = 0; l < lsm->nlevels; ++l) {
+    const lsm__block_t *level = &lsm->levels[l];
+    s_range_t range = s_equal_range(level->data, level->dim, lsm->size, lsm->order, key);
+    count += range.last - range.first;
+  }
+  return count;
+}
+
+static inline int64_t lsm_range(const lsm_t *lsm, const void *lo, const void *hi, void *output) {
+  size_t size = lsm->size;
+  s_span_t spans[LSM_MAX_LEVELS + 1];
+  size_t k = 0;
+  size_t total = 0;
+
+  // oldest level first and the buffer, the most recent inserts, last: s_merge_k puts the
+  // elements of the lower spans first on ties
+  for (size_t l = lsm->nlevels + 1; l-- > 0; ) {
+    const lsm__block_t *block = (l == 0) ? &lsm->buffer : &lsm->levels[l - 1];
+    size_t first = (lo != NULL) ? s_lower_bound(block->data, block->dim, size, lsm->order, lo) : 0;
+    size_t last = (hi != NULL) ? s_lower_bound(block->data, block->dim, size, lsm->order, hi) : block->dim;
+    if (last > first) {
+      spans[k].data = block->data + first * size;
+      spans[k].dim = last - first;
+      total += spans[k].dim;
+      ++k;
+    }
+  }
+  if (output == NULL || total == 0) {
+    return (int64_t) total;
+  }
+  return s_merge_k(spans, k, output, size, lsm->order);
+}
+
+static inline int64_t lsm_export(const lsm_t *lsm, void *output) {
+  return lsm_range(lsm, NULL, NULL, output);
+}
+
+static inline void lsm_free(lsm_t *lsm) {
+  if (lsm == NULL) {
+    return;
+  }
+  const chibi_allocator_t *allocator = lsm->allocator;
+  for (size_t l = 0; l < lsm->nlevels; ++l) {
+    chibi_release(allocator, lsm->levels[l].data, lsm->levels[l].capacity * lsm->size);
+  }
+  chibi_release(allocator, lsm->buffer.data, lsm->buffer.capacity * lsm->size);
+  chibi_release(allocator, lsm->carry.data, lsm->carry.capacity * lsm->size);
+  chibi_release(allocator, lsm->scratch.data, lsm->scratch.capacity * lsm->size);
+  chibi_release(allocator, lsm, sizeof(lsm_t));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,371 @@
+/* parallel.h - Parallel partition and prefix sum primitives
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * This library provides the building blocks shared by parallel sorting, radix scatters and
+ * stream compaction:
+ *
+ * - par_exclusive_scan_u64: work-efficient parallel exclusive prefix sum. The input is split in
+ *   one block per thread; every thread sums its block, the block sums are scanned (there are only
+ *   a few of them), then every thread scans its block starting from the offset of the block.
+ *   Each element is read twice and written once, so the total work stays O(n).
+ *
+ * - par_partition: blocked parallel stable partition. Every thread classifies the elements of its
+ *   block with the predicate and counts the ones that satisfy it; a prefix sum of the counts gives
+ *   every block its output offsets in both parts; then every thread scatters its block to a
+ *   temporary buffer, which is copied back in parallel.
+ *
+ * Inputs shorter than PAR_MIN_BLOCK elements per thread use fewer threads, down to a plain
+ * sequential loop, because starting a thread costs more than processing a small block.
+ *
+ * By default every call starts its own threads. After par_set_pool, the calls of the translation
+ * unit run their blocks as tasks of a pool.h work-stealing pool instead, which avoids the thread
+ * start-up cost and lets the calls nest inside other pool tasks.
+ *
+ * The threads are POSIX threads, so this header needs pthreads (on Windows, a pthreads
+ * implementation such as winpthreads).
+ */
+
+#ifndef CHIBI_PARALLEL_H
+#define CHIBI_PARALLEL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "allocator.h"
+#include "pool.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Minimum number of elements given to each thread */
+#define PAR_MIN_BLOCK 16384
+
+/* Upper bound on the number of threads used by a single call */
+#define PAR_MAX_THREADS 256
+
+/* Returns the number of online processors, the default number of threads.
+ */
+static inline size_t par_threads(void);
+
+/* Makes the calls of this translation unit run on a pool, or start their own threads if
+ * 'pool' is NULL. The pool must outlive the calls. With a pool, 0 threads selects the number
+ * of workers of the pool.
+ */
+static inline void par_set_pool(pool_t *pool);
+
+/* Parallel exclusive prefix sum: output[i] = input[0] + ... + input[i - 1], output[0] = 0.
+ * Arguments:
+ * - the input vector
+ * - the output vector (it may be the input vector itself)
+ * - the dimension of the vectors
+ * - the number of threads (0 selects par_threads())
+ * Return:
+ * - the sum of all the elements
+ */
+static inline uint64_t par_exclusive_scan_u64(const uint64_t *input, uint64_t *output, size_t dim, size_t nthreads);
+
+/* Parallel stable partition.
+ * Moves the elements that satisfy the predicate before the ones that do not, keeping the
+ * relative order inside both parts. Uses a temporary buffer as large as the input plus one
+ * byte per element.
+ * Arguments:
+ * - the vector to partition
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to the predicate, called exactly once per element, possibly from several threads
+ * - a context pointer passed to the predicate
+ * - the number of threads (0 selects par_threads())
+ * Return:
+ * - the number of elements that satisfy the predicate on success or -1 on failure
+ */
+static inline int64_t par_partition(void *input, size_t dim, size_t size,
+                                    bool (*pred)(const void *elem, void *ctx), void *ctx, size_t nthreads);
+
+/* Same as par_partition, with the temporary buffer taken from 'allocator' (NULL for the heap),
+ * e.g. the arena of the current request. The allocator is only called by the calling thread.
+ */
+static inline int64_t par_partition_with(void *input, size_t dim, size_t size,
+                                         bool (*pred)(const void *elem, void *ctx), void *ctx, size_t nthreads,
+                                         const chibi_allocator_t *allocator);
+
+// Pool selected by par_set_pool, NULL to start threads per call
+static pool_t *par__pool = NULL;
+
+static inline void par_set_pool(pool_t *pool) {
+  par__pool = pool;
+}
+
+static inline size_t par_threads(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (size_t) n : 1;
+}
+
+// Number of threads worth using for 'dim' elements
+static inline size_t par__threads_for(size_t dim, size_t nthreads) {
+  if (nthreads == 0) {
+    nthreads = (par__pool != NULL) ? pool_workers(par__pool) : par_threads();
+  }
+  if (nthreads > PAR_MAX_THREADS) {
+    nthreads = PAR_MAX_THREADS;
+  }
+  size_t useful = dim / PAR_MIN_BLOCK;
+  if (nthreads > useful) {
+    nthreads = (useful > 0) ? useful : 1;
+  }
+  return nthreads;
+}
+
+// Bounds of the i-th of 'nblocks' blocks of 'dim' elements
+static inline size_t par__block_start(size_t dim, size_t nblocks, size_t i) {
+  return (size_t)(((uint64_t) dim * i) / nblocks);
+}
+
+typedef struct par__task_t {
+  void (*fn)(void *ctx, size_t id);
+  void *ctx;
+  size_t id;
+} par__task_t;
+
+static inline void *par__thread_main(void *arg) {
+  par__task_t *task = (par__task_t *) arg;
+  task->fn(task->ctx, task->id);
+  return NULL;
+}
+
+static inline void par__pool_main(void *arg) {
+  par__thread_main(arg);
+}
+
+/* Calls fn(ctx, id) for every id in [0, nthreads), in parallel. The calling thread runs id 0.
+ * If a thread cannot be started, its id runs on the calling thread.
+ */
+static inline void par__run(size_t nthreads, void (*fn)(void *ctx, size_t id), void *ctx) {
+  par__task_t tasks[PAR_MAX_THREADS];
+  for (size_t i = 1; i < nthreads; ++i) {
+    tasks[i].fn = fn;
+    tasks[i].ctx = ctx;
+    tasks[i].id = i;
+  }
+
+  pool_t *pool = par__pool;
+  if (pool != NULL) {
+    pool_task_t joins[PAR_MAX_THREADS];
+    for (size_t i = 1; i < nthreads; ++i) {
+      pool_spawn(pool, &joins[i], par__pool_main, &tasks[i]);
+    }
+    fn(ctx, 0);
+    for (size_t i = 1; i < nthreads; ++i) {
+      pool_wait(pool, &joins[i]);
+    }
+    return;
+  }
+
+  pthread_t threads[PAR_MAX_THREADS];
+  bool started[PAR_MAX_THREADS];
+  for (size_t i = 1; i < nthreads; ++i) {
+    started[i] = pthread_create(&threads[i], NULL, par__thread_main, &tasks[i]) == 0;
+  }
+  fn(ctx, 0);
+  for (size_t i = 1; i < nthreads; ++i) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    } else {
+      fn(ctx, i);
+    }
+  }
+}
+
+typedef struct par__scan_t {
+  const uint64_t *input;
+  uint64_t *output;
+  size_t dim;
+  size_t nblocks;
+  uint64_t *sums;  // sum of every block, then offset of every block
+} par__scan_t;
+
+static inline void par__scan_sum(void *ctx, size_t id) {
+  par__scan_t *scan = (par__scan_t *) ctx;
+  size_t lo = par__block_start(scan->dim, scan->nblocks, id);
+  size_t hi = par__block_start(scan->dim, scan->nblocks, id + 1);
+  uint64_t sum = 0;
+  for (size_t i = lo; i < hi; ++i) {
+    sum += scan->input[i];
+  }
+  scan->sums[id] = sum;
+}
+
+static inline void par__scan_block(void *ctx, size_t id) {
+  par__scan_t *scan = (par__scan_t *) ctx;
+  size_t lo = par__block_start(scan->dim, scan->nblocks, id);
+  size_t hi = par__block_start(scan->dim, scan->nblocks, id + 1);
+  uint64_t sum = scan->sums[id];
+  for (size_t i = lo; i < hi; ++i) {
+    // read before writing, so that input and output may be the same vector
+    uint64_t x = scan->input[i];
+    scan->output[i] = sum;
+    sum += x;
+  }
+  scan->sums[id] = sum;  // end of the block, read back by the sequential path
+}
+
+static inline uint64_t par_exclusive_scan_u64(const uint64_t *input, uint64_t *output, size_t dim, size_t nthreads) {
+  uint64_t sums[PAR_MAX_THREADS];
+  par__scan_t scan;
+  scan.input = input;
+  scan.output = output;
+  scan.dim = dim;
+  scan.nblocks = par__threads_for(dim, nthreads);
+  scan.sums = sums;
+
+  if (scan.nblocks == 1) {
+    sums[0] = 0;
+    par__scan_block(&scan, 0);
+    return sums[0];
+  }
+
+  par__run(scan.nblocks, par__scan_sum, &scan);
+  uint64_t total = 0;
+  for (size_t b = 0; b < scan.nblocks; ++b) {
+    uint64_t s = sums[b];
+    sums[b] = total;
+    total += s;
+  }
+  par__run(scan.nblocks, par__scan_block, &scan);
+  return total;
+}
+
+typedef struct par__partition_t {
+  char *input;
+  char *temp;
+  uint8_t *flags;
+  size_t dim;
+  size_t size;
+  size_t nblocks;
+  bool (*pred)(const void *elem, void *ctx);
+  void *ctx;
+  size_t counts[PAR_MAX_THREADS];  // elements that satisfy the predicate in every block
+  size_t trues[PAR_MAX_THREADS];   // output offset of the first such element of every block
+  size_t falses[PAR_MAX_THREADS];  // output offset of the first other element of every block
+} par__partition_t;
+
+static inline void par__partition_classify(void *ctx, size_t id) {
+  par__partition_t *part = (par__partition_t *) ctx;
+  size_t lo = par__block_start(part->dim, part->nblocks, id);
+  size_t hi = par__block_start(part->dim, part->nblocks, id + 1);
+  size_t count = 0;
+  for (size_t i = lo; i < hi; ++i) {
+    bool flag = part->pred(part->input + i * part->size, part->ctx);
+    part->flags[i] = (uint8_t) flag;
+    count += flag;
+  }
+  part->counts[id] = count;
+}
+
+static inline void par__partition_scatter(void *ctx, size_t id) {
+  par__partition_t *part = (par__partition_t *) ctx;
+  size_t lo = par__block_start(part->dim, part->nblocks, id);
+  size_t hi = par__block_start(part->dim, part->nblocks, id + 1);
+  size_t size = part->size;
+  char *dest[2];
+  dest[1] = part->temp + part->trues[id] * size;
+  dest[0] = part->temp + part->falses[id] * size;
+  for (size_t i = lo; i < hi; ++i) {
+    uint8_t flag = part->flags[i];
+    memcpy(dest[flag], part->input + i * size, size);
+    dest[flag] += size;
+  }
+}
+
+static inline void par__partition_copy(void *ctx, size_t id) {
+  par__partition_t *part = (par__partition_t *) ctx;
+  size_t lo = par__block_start(part->dim, part->nblocks, id);
+  size_t hi = par__block_start(part->dim, part->nblocks, id + 1);
+  memcpy(part->input + lo * part->size, part->temp + lo * part->size, (hi - lo) * part->size);
+}
+
+static inline int64_t par_partition_with(void *input, size_t dim, size_t size,
+                                         bool (*pred)(const void *elem, void *ctx), void *ctx, size_t nthreads,
+                                         const chibi_allocator_t *allocator) {
+  par__partition_t *part = (par__partition_t *) chibi_alloc(allocator, sizeof(par__partition_t), CHIBI_DEFAULT_ALIGN);
+  char *temp = (char *) chibi_alloc(allocator, dim * size + dim, CHIBI_DEFAULT_ALIGN);
+  if (part == NULL || temp == NULL) {
+    chibi_release(allocator, temp, dim * size + dim);
+    chibi_release(allocator, part, sizeof(par__partition_t));
+    return (dim == 0) ? 0 : -1;
+  }
+  part->input = (char *) input;
+  part->temp = temp;
+  part->flags = (uint8_t *)(temp + dim * size);
+  part->dim = dim;
+  part->size = size;
+  part->nblocks = par__threads_for(dim, nthreads);
+  part->pred = pred;
+  part->ctx = ctx;
+
+  par__run(part->nblocks, par__partition_classify, part);
+
+  size_t total = 0;
+  for (size_t b = 0; b < part->nblocks; ++b) {
+    total += part->counts[b];
+  }
+  size_t trues = 0;
+  size_t falses = total;
+  for (size_t b = 0; b < part->nblocks; ++b) {
+    size_t lo = par__block_start(dim, part->nblocks, b);
+    size_t hi = par__block_start(dim, part->nblocks, b + 1);
+    part->trues[b] = trues;
+    part->falses[b] = falses;
+    trues += part->counts[b];
+    falses += (hi - lo) - part->counts[b];
+  }
+
+  par__run(part->nblocks, par__partition_scatter, part);
+  par__run(part->nblocks, par__partition_copy, part);
+
+  chibi_release(allocator, temp, dim * size + dim);
+  chibi_release(allocator, part, sizeof(par__partition_t));
+  return (int64_t) total;
+}
+
+static inline int64_t par_partition(void *input, size_t dim, size_t size,
+                                    bool (*pred)(const void *elem, void *ctx), void *ctx, size_t nthreads) {
+  return par_partition_with(input, dim, size, pred, ctx, nthreads, NULL);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,337 @@
+/* perfctr.h - Hardware performance counters around a region of code
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Wall time does not tell whether a change to a hash map or a sort reduced cache misses or branch
+ * mispredictions. This library reads the hardware counters of the calling thread around a region:
+ *
+ *   perfctr_t pc;
+ *   perfctr_open(&pc);
+ *   perfctr_start(&pc);
+ *   ... region ...
+ *   perfctr_stop(&pc);
+ *   perfctr_report(&pc, stdout);
+ *   perfctr_close(&pc);
+ *
+ * The counters are opened with perf_event_open (Linux) in groups, so that the counters of a group
+ * are always scheduled together and their ratios (instructions per cycle, misses per instruction)
+ * are consistent. When the PMU has fewer counters than requested, the kernel multiplexes the
+ * groups and the values are scaled by the fraction of time each group was running.
+ *
+ * The counters exclude the kernel and the hypervisor, which is what the default
+ * perf_event_paranoid setting allows to unprivileged users. Counters that cannot be opened (no
+ * permission, event not supported by the CPU, virtual machines without a virtual PMU, other
+ * operating systems) are reported as unavailable and read as zero, so a benchmark using this
+ * library keeps working everywhere and simply prints less information.
+ *
+ * On Linux the counters are opened with syscall(), which the C library only declares with
+ * _GNU_SOURCE or _DEFAULT_SOURCE: the strict C modes (-std=c11) define neither, so the header
+ * declares it itself and can be included in any order.
+ */
+
+#ifndef CHIBI_PERFCTR_H
+#define CHIBI_PERFCTR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+// not declared by <unistd.h> in the strict C modes; C++ compilers always define _GNU_SOURCE
+#ifndef __cplusplus
+long syscall(long number, ...);
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* The counted events */
+typedef enum perfctr_event_t {
+  PERFCTR_CYCLES,
+  PERFCTR_INSTRUCTIONS,
+  PERFCTR_BRANCH_MISSES,
+  PERFCTR_L1D_MISSES,
+  PERFCTR_LLC_MISSES,
+  PERFCTR_DTLB_MISSES,
+  PERFCTR_EVENTS
+} perfctr_event_t;
+
+/* Number of counter groups: {cycles, instructions, branch misses} and {L1D, LLC, dTLB misses} */
+#define PERFCTR_GROUPS 2
+
+typedef struct perfctr_t {
+  int fds[PERFCTR_EVENTS];           // file descriptor of every counter, -1 if unavailable
+  int leaders[PERFCTR_GROUPS];       // file descriptor of the first counter of every group
+  uint64_t values[PERFCTR_EVENTS];   // values of the last region, scaled
+  double running[PERFCTR_GROUPS];    // fraction of the region every group was counting
+  int error;                         // errno of the first counter that could not be opened
+} perfctr_t;
+
+/* Opens the counters.
+ * Return:
+ * - the number of counters available (0 if none could be opened)
+ */
+static inline int perfctr_open(perfctr_t *pc);
+
+/* Resets and starts the counters.
+ */
+static inline void perfctr_start(perfctr_t *pc);
+
+/* Stops the counters and stores their values.
+ */
+static inline void perfctr_stop(perfctr_t *pc);
+
+/* Returns true if the counter of the event is available.
+ */
+static inline bool perfctr_available(const perfctr_t *pc, perfctr_event_t event);
+
+/* Returns the value of an event in the last region (0 if the counter is unavailable).
+ */
+static inline uint64_t perfctr_value(const perfctr_t *pc, perfctr_event_t event);
+
+/* Returns the name of an event.
+ */
+static inline const char *perfctr_name(perfctr_event_t event);
+
+/* Prints the values of the last region, the instructions per cycle and the reason why
+ * unavailable counters could not be opened.
+ */
+static inline void perfctr_report(const perfctr_t *pc, FILE *out);
+
+/* Closes the counters.
+ */
+static inline void perfctr_close(perfctr_t *pc);
+
+static inline const char *perfctr_name(perfctr_event_t event) {
+  static const char *names[PERFCTR_EVENTS] = {
+    "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses", "dTLB-misses"
+  };
+  return ((int) event >= 0 && event < PERFCTR_EVENTS) ? names[event] : "unknown";
+}
+
+// Group of every event
+static inline int perfctr__group(perfctr_event_t event) {
+  return (event < PERFCTR_L1D_MISSES) ? 0 : 1;
+}
+
+#ifdef __linux__
+
+// Type and configuration of every event
+static inline void perfctr__attr(perfctr_event_t event, struct perf_event_attr *attr) {
+  memset(attr, 0, sizeof(*attr));
+  attr->size = sizeof(*attr);
+  attr->exclude_kernel = 1;
+  attr->exclude_hv = 1;
+  attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  switch (event) {
+    case PERFCTR_CYCLES:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PERFCTR_INSTRUCTIONS:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PERFCTR_BRANCH_MISSES:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    case PERFCTR_L1D_MISSES:
+      attr->type = PERF_TYPE_HW_CACHE;
+      attr->config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+      break;
+    case PERFCTR_LLC_MISSES:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    default:
+      attr->type = PERF_TYPE_HW_CACHE;
+      attr->config = PERF_COUNT_HW_CACHE_DTLB | read_miss;
+      break;
+  }
+}
+
+static inline int perfctr_open(perfctr_t *pc) {
+  int opened = 0;
+  memset(pc, 0, sizeof(*pc));
+  for (int g = 0; g < PERFCTR_GROUPS; ++g) {
+    pc->leaders[g] = -1;
+  }
+  for (int e = 0; e < PERFCTR_EVENTS; ++e) {
+    int g = perfctr__group((perfctr_event_t) e);
+    struct perf_event_attr attr;
+    perfctr__attr((perfctr_event_t) e, &attr);
+    // the leader starts disabled and drives the whole group
+    attr.disabled = (pc->leaders[g] == -1);
+    int fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, pc->leaders[g], 0);
+    if (fd < 0 && pc->error == 0) {
+      pc->error = errno;
+    }
+    pc->fds[e] = fd;
+    if (fd >= 0) {
+      if (pc->leaders[g] == -1) {
+        pc->leaders[g] = fd;
+      }
+      ++opened;
+    }
+  }
+  return opened;
+}
+
+static inline void perfctr_start(perfctr_t *pc) {
+  for (int g = 0; g < PERFCTR_GROUPS; ++g) {
+    if (pc->leaders[g] >= 0) {
+      ioctl(pc->leaders[g], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(pc->leaders[g], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+  }
+}
+
+static inline void perfctr_stop(perfctr_t *pc) {
+  for (int g = 0; g < PERFCTR_GROUPS; ++g) {
+    if (pc->leaders[g] >= 0) {
+      ioctl(pc->leaders[g], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+  }
+  memset(pc->values, 0, sizeof(pc->values));
+  for (int g = 0; g < PERFCTR_GROUPS; ++g) {
+    pc->running[g] = 0.0;
+    if (pc->leaders[g] < 0) {
+      continue;
+    }
+    // { nr, time_enabled, time_running, value[nr] }, values in the order the counters joined the group
+    uint64_t data[3 + PERFCTR_EVENTS];
+    if (read(pc->leaders[g], data, sizeof(data)) < (ssize_t)(3 * sizeof(uint64_t)) || data[1] == 0) {
+      continue;
+    }
+    double running = (double) data[2] / (double) data[1];
+    pc->running[g] = running;
+    uint64_t n = 0;
+    for (int e = 0; e < PERFCTR_EVENTS && n < data[0]; ++e) {
+      if (perfctr__group((perfctr_event_t) e) == g && pc->fds[e] >= 0) {
+        pc->values[e] = (running > 0.0) ? (uint64_t)((double) data[3 + n] / running) : 0;
+        ++n;
+      }
+    }
+  }
+}
+
+static inline void perfctr_close(perfctr_t *pc) {
+  for (int e = 0; e < PERFCTR_EVENTS; ++e) {
+    if (pc->fds[e] >= 0) {
+      close(pc->fds[e]);
+      pc->fds[e] = -1;
+    }
+  }
+  for (int g = 0; g < PERFCTR_GROUPS; ++g) {
+    pc->leaders[g] = -1;
+  }
+}
+
+#else
+
+static inline int perfctr_open(perfctr_t *pc) {
+  memset(pc, 0, sizeof(*pc));
+  for (int e = 0; e < PERFCTR_EVENTS; ++e) {
+    pc->fds[e] = -1;
+  }
+  for (int g = 0; g < PERFCTR_GROUPS; ++g) {
+    pc->leaders[g] = -1;
+  }
+  return 0;
+}
+
+static inline void perfctr_start(perfctr_t *pc) {
+  (void) pc;
+}
+
+static inline void perfctr_stop(perfctr_t *pc) {
+  (void) pc;
+}
+
+static inline void perfctr_close(perfctr_t *pc) {
+  (void) pc;
+}
+
+#endif
+
+static inline bool perfctr_available(const perfctr_t *pc, perfctr_event_t event) {
+  return pc->fds[event] >= 0;
+}
+
+static inline uint64_t perfctr_value(const perfctr_t *pc, perfctr_event_t event) {
+  return pc->values[event];
+}
+
+static inline void perfctr_report(const perfctr_t *pc, FILE *out) {
+  for (int e = 0; e < PERFCTR_EVENTS; ++e) {
+    if (!perfctr_available(pc, (perfctr_event_t) e)) {
+      fprintf(out, "%-16s %20s\n", perfctr_name((perfctr_event_t) e), "unavailable");
+      continue;
+    }
+    double running = pc->running[perfctr__group((perfctr_event_t) e)];
+    fprintf(out, "%-16s %20llu", perfctr_name((perfctr_event_t) e), (unsigned long long) pc->values[e]);
+    if (running < 1.0) {
+      fprintf(out, "  (counted %.0f%% of the time)", running * 100.0);
+    }
+    fprintf(out, "\n");
+  }
+  if (pc->values[PERFCTR_CYCLES] > 0 && perfctr_available(pc, PERFCTR_INSTRUCTIONS)) {
+    fprintf(out, "%-16s %20.2f\n", "IPC",
+            (double) pc->values[PERFCTR_INSTRUCTIONS] / (double) pc->values[PERFCTR_CYCLES]);
+  }
+  if (pc->error != 0) {
+#ifdef __linux__
+    fprintf(out, "some counters could not be opened: %s", strerror(pc->error));
+    if (pc->error == EACCES || pc->error == EPERM) {
+      fprintf(out, " (see /proc/sys/kernel/perf_event_paranoid)");
+    }
+    fprintf(out, "\n");
+#endif
+  }
+#ifndef __linux__
+  fprintf(out, "hardware counters are only supported on Linux\n");
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,507 @@
+/* pool.h - Work-stealing thread pool
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * This library provides the scheduler shared by the parallel algorithms of chibilibs:
+ *
+ * - every worker owns a Chase-Lev deque of tasks. The owner pushes and takes tasks at the bottom
+ *   (LIFO, so the most recent and cache-hot task runs first) without locks; idle workers steal
+ *   from the top of a random victim's deque (FIFO, so they get the oldest and largest tasks).
+ *
+ * - tasks submitted from threads that are not workers go to a shared injection queue.
+ *
+ * - fork/join: pool_spawn makes a task available to the other workers, pool_wait waits for it
+ *   while running other tasks, and sleeps only once there is nothing left to run. A thread that is not a worker
+ *   waits without running tasks: it has no deque of its own, so it would run unrelated tasks
+ *   that wait in turn, and its stack would grow without bound.
+ *
+ * - pool_parallel_for splits a range in halves recursively down to a grain size, spawning one
+ *   half and running the other, so load balance comes from stealing and not from a static split.
+ *
+ * - an idle worker spins for a while, then yields, then sleeps on a condition variable until a
+ *   new task is submitted. A waiter with nothing to run backs off in the same way and then sleeps
+ *   until its task completes. The spin and yield rounds still use the CPU, so a pool that is idle
+ *   for short gaps keeps its cores busy; only a longer idle period puts the threads to sleep.
+ *
+ * Tasks are caller-allocated (pool_task_t), usually on the stack of the thread that spawns and
+ * waits for them, so the pool does not allocate memory after its creation.
+ *
+ * The threads are POSIX threads and the atomics are the GCC/Clang __atomic builtins.
+ */
+
+#ifndef CHIBI_POOL_H
+#define CHIBI_POOL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Capacity of every worker deque. Spawning into a full deque runs the task immediately */
+#define POOL_DEQUE_SIZE 4096
+
+/* Idle rounds spent spinning, then yielding, before a worker or a waiter goes to sleep */
+#define POOL_SPIN  64
+#define POOL_YIELD 16
+
+/* Maximum number of workers */
+#define POOL_MAX_WORKERS 256
+
+#ifdef __cplusplus
+#define POOL__THREAD_LOCAL thread_local
+#else
+#define POOL__THREAD_LOCAL _Thread_local
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define pool__pause() __builtin_ia32_pause()
+#else
+#define pool__pause() ((void) 0)
+#endif
+
+#define pool__load(ptr, mo)         __atomic_load_n((ptr), (mo))
+#define pool__store(ptr, val, mo)   __atomic_store_n((ptr), (val), (mo))
+#define pool__cas(ptr, exp, val)    __atomic_compare_exchange_n((ptr), (exp), (val), false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)
+#define pool__fence(mo)             __atomic_thread_fence((mo))
+
+/* A unit of work. The fields are private: initialize a task with pool_spawn and keep it alive
+ * until pool_wait returns.
+ */
+typedef struct pool_task_t {
+  void (*fn)(void *arg);
+  void *arg;
+  int done;
+  struct pool_task_t *next;  // link in the injection queue
+} pool_task_t;
+
+typedef struct pool__deque_t {
+  int64_t top;      // next task to steal
+  char pad0[64 - sizeof(int64_t)];
+  int64_t bottom;   // next free slot of the owner
+  char pad1[64 - sizeof(int64_t)];
+  pool_task_t *tasks[POOL_DEQUE_SIZE];
+} pool__deque_t;
+
+typedef struct pool__worker_t {
+  struct pool_t *pool;
+  size_t id;
+  uint64_t seed;  // state of the victim selection
+  pthread_t thread;
+  pool__deque_t deque;
+} pool__worker_t;
+
+typedef struct pool_t {
+  size_t nworkers;
+  int stop;
+  int pending;   // tasks submitted and not yet started
+  int sleepers;  // workers sleeping on 'wake'
+  int waiters;   // threads sleeping on 'finished' in pool_wait
+  pthread_mutex_t lock;  // protects the injection queue and the sleep
+  pthread_cond_t wake;
+  pthread_cond_t finished;  // signaled when a task completes while there are waiters
+  pool_task_t *head;     // injection queue
+  pool_task_t *tail;
+  pool__worker_t *workers;
+} pool_t;
+
+/* Creates a pool.
+ * Arguments:
+ * - the number of workers (0 selects the number of online processors)
+ * Return:
+ * - the new pool, or NULL on failure
+ */
+static inline pool_t *pool_new(size_t nworkers);
+
+/* Stops the workers and frees the pool. All the spawned tasks must have been waited for.
+ */
+static inline void pool_free(pool_t *pool);
+
+/* Returns the number of workers of the pool */
+#define pool_workers(pool) ((pool)->nworkers)
+
+/* Fork: makes 'fn(arg)' available to the workers.
+ * Arguments:
+ * - the pool
+ * - the task, which must stay valid until pool_wait returns
+ * - the function to run and its argument
+ */
+static inline void pool_spawn(pool_t *pool, pool_task_t *task, void (*fn)(void *arg), void *arg);
+
+/* Join: returns when the task has completed. A worker of the pool runs other tasks in the
+ * meantime. When there is nothing to run, or on any other thread, it spins, yields and then
+ * sleeps until the task completes.
+ */
+static inline void pool_wait(pool_t *pool, pool_task_t *task);
+
+/* Parallel loop.
+ * Calls body(ctx, lo, hi) on disjoint subranges covering [begin, end), each at most 'grain'
+ * elements long, in parallel. Returns when all of them have completed. It can be called from
+ * inside a task (nested parallelism) or from any other thread, which hands the whole range to
+ * the workers and waits.
+ * Arguments:
+ * - the pool
+ * - the range [begin, end)
+ * - the grain size (0 is treated as 1)
+ * - the loop body and its context
+ */
+static inline void pool_parallel_for(pool_t *pool, size_t begin, size_t end, size_t grain,
+                                     void (*body)(void *ctx, size_t lo, size_t hi), void *ctx);
+
+// Worker running on this thread, NULL for threads that are not workers
+static POOL__THREAD_LOCAL pool__worker_t *pool__self = NULL;
+
+static inline bool pool__push(pool__deque_t *deque, pool_task_t *task) {
+  int64_t b = pool__load(&deque->bottom, __ATOMIC_RELAXED);
+  int64_t t = pool__load(&deque->top, __ATOMIC_ACQUIRE);
+  if (b - t >= POOL_DEQUE_SIZE) {
+    return false;
+  }
+  pool__store(&deque->tasks[b & (POOL_DEQUE_SIZE - 1)], task, __ATOMIC_RELAXED);
+  pool__store(&deque->bottom, b + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+// Owner side: pops the most recent task
+static inline pool_task_t *pool__take(pool__deque_t *deque) {
+  int64_t b = pool__load(&deque->bottom, __ATOMIC_RELAXED) - 1;
+  pool__store(&deque->bottom, b, __ATOMIC_RELAXED);
+  pool__fence(__ATOMIC_SEQ_CST);
+  int64_t t = pool__load(&deque->top, __ATOMIC_RELAXED);
+  if (t > b) {
+    pool__store(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  pool_task_t *task = pool__load(&deque->tasks[b & (POOL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+  if (t == b) {
+    // last task: race against the thieves
+    if (!pool__cas(&deque->top, &t, t + 1)) {
+      task = NULL;
+    }
+    pool__store(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+  }
+  return task;
+}
+
+// Thief side: pops the oldest task, NULL if the deque is empty or the race was lost
+static inline pool_task_t *pool__steal(pool__deque_t *deque) {
+  int64_t t = pool__load(&deque->top, __ATOMIC_ACQUIRE);
+  pool__fence(__ATOMIC_SEQ_CST);
+  int64_t b = pool__load(&deque->bottom, __ATOMIC_ACQUIRE);
+  if (t >= b) {
+    return NULL;
+  }
+  pool_task_t *task = pool__load(&deque->tasks[t & (POOL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+  if (!pool__cas(&deque->top, &t, t + 1)) {
+    return NULL;
+  }
+  return task;
+}
+
+static inline pool_task_t *pool__pop_injected(pool_t *pool) {
+  if (pool__load(&pool->head, __ATOMIC_RELAXED) == NULL) {
+    return NULL;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool_task_t *task = pool->head;
+  if (task != NULL) {
+    pool__store(&pool->head, task->next, __ATOMIC_RELAXED);
+    if (task->next == NULL) {
+      pool->tail = NULL;
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return task;
+}
+
+static inline uint64_t pool__random(uint64_t *seed) {
+  uint64_t x = *seed;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *seed = x;
+  return x;
+}
+
+/* Looks for a task to run for the worker 'self': its own deque first, then the other deques
+ * starting from a random victim, then the injection queue.
+ */
+static inline pool_task_t *pool__find(pool_t *pool, pool__worker_t *self) {
+  pool_task_t *task = NULL;
+  if ((task = pool__take(&self->deque)) != NULL) {
+    goto found;
+  }
+  {
+    size_t n = pool->nworkers;
+    size_t start = (size_t) pool__random(&self->seed) % n;
+    for (size_t i = 0; i < n; ++i) {
+      pool__worker_t *victim = &pool->workers[(start + i) % n];
+      if (victim != self && (task = pool__steal(&victim->deque)) != NULL) {
+        goto found;
+      }
+    }
+  }
+  if ((task = pool__pop_injected(pool)) != NULL) {
+    goto found;
+  }
+  return NULL;
+
+found:
+  __atomic_fetch_sub(&pool->pending, 1, __ATOMIC_SEQ_CST);
+  return task;
+}
+
+static inline void pool__execute(pool_t *pool, pool_task_t *task) {
+  task->fn(task->arg);
+  // the task may be freed as soon as 'done' is set, so only the pool is read afterwards.
+  // A waiter increments 'waiters' before reading 'done': at least one of the two sees the other
+  pool__store(&task->done, 1, __ATOMIC_SEQ_CST);
+  if (pool__load(&pool->waiters, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->finished);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+static inline void *pool__worker_main(void *arg) {
+  pool__worker_t *self = (pool__worker_t *) arg;
+  pool_t *pool = self->pool;
+  pool__self = self;
+  size_t idle = 0;
+  while (!pool__load(&pool->stop, __ATOMIC_ACQUIRE)) {
+    pool_task_t *task = pool__find(pool, self);
+    if (task != NULL) {
+      pool__execute(pool, task);
+      idle = 0;
+      continue;
+    }
+
+    ++idle;
+    if (idle < POOL_SPIN) {
+      pool__pause();
+    } else if (idle < POOL_SPIN + POOL_YIELD) {
+      sched_yield();
+    } else {
+      // a submitter increments 'pending' before reading 'sleepers', a sleeper increments
+      // 'sleepers' before reading 'pending': at least one of them sees the other
+      pthread_mutex_lock(&pool->lock);
+      __atomic_fetch_add(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+      if (pool__load(&pool->pending, __ATOMIC_SEQ_CST) == 0 && !pool__load(&pool->stop, __ATOMIC_ACQUIRE)) {
+        pthread_cond_wait(&pool->wake, &pool->lock);
+      }
+      __atomic_fetch_sub(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock(&pool->lock);
+      idle = 0;
+    }
+  }
+  pool__self = NULL;
+  return NULL;
+}
+
+static inline pool_t *pool_new(size_t nworkers) {
+  if (nworkers == 0) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    nworkers = (n > 0) ? (size_t) n : 1;
+  }
+  if (nworkers > POOL_MAX_WORKERS) {
+    nworkers = POOL_MAX_WORKERS;
+  }
+
+  pool_t *pool = (pool_t *) calloc(1, sizeof(pool_t));
+  pool__worker_t *workers = (pool__worker_t *) calloc(nworkers, sizeof(pool__worker_t));
+  if (pool == NULL || workers == NULL) {
+    free(workers);
+    free(pool);
+    return NULL;
+  }
+  pool->workers = workers;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->finished, NULL);
+
+  for (size_t i = 0; i < nworkers; ++i) {
+    workers[i].pool = pool;
+    workers[i].id = i;
+    workers[i].seed = 0x9E3779B97F4A7C15ull * (i + 1);
+  }
+  pool->nworkers = nworkers;
+  for (size_t i = 0; i < nworkers; ++i) {
+    if (pthread_create(&workers[i].thread, NULL, pool__worker_main, &workers[i]) != 0) {
+      // stop the workers started so far
+      pool->nworkers = i;
+      pool_free(pool);
+      return NULL;
+    }
+  }
+  return pool;
+}
+
+static inline void pool_free(pool_t *pool) {
+  if (pool == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool__store(&pool->stop, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t i = 0; i < pool->nworkers; ++i) {
+    pthread_join(pool->workers[i].thread, NULL);
+  }
+  pthread_cond_destroy(&pool->finished);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->workers);
+  free(pool);
+}
+
+static inline void pool_spawn(pool_t *pool, pool_task_t *task, void (*fn)(void *arg), void *arg) {
+  task->fn = fn;
+  task->arg = arg;
+  task->done = 0;
+  task->next = NULL;
+
+  // counted before it becomes visible, so that 'pending' never goes below zero
+  __atomic_fetch_add(&pool->pending, 1, __ATOMIC_SEQ_CST);
+  pool__worker_t *self = pool__self;
+  if (self != NULL && self->pool == pool) {
+    if (!pool__push(&self->deque, task)) {
+      // full deque: there is plenty of parallelism already, run it now
+      __atomic_fetch_sub(&pool->pending, 1, __ATOMIC_SEQ_CST);
+      pool__execute(pool, task);
+      return;
+    }
+  } else {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail != NULL) {
+      pool->tail->next = task;
+    } else {
+      pool__store(&pool->head, task, __ATOMIC_RELAXED);
+    }
+    pool->tail = task;
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  if (pool__load(&pool->sleepers, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+static inline void pool_wait(pool_t *pool, pool_task_t *task) {
+  pool__worker_t *self = pool__self;
+  if (self != NULL && self->pool != pool) {
+    self = NULL;
+  }
+  size_t idle = 0;
+  while (!pool__load(&task->done, __ATOMIC_ACQUIRE)) {
+    pool_task_t *other = (self != NULL) ? pool__find(pool, self) : NULL;
+    if (other != NULL) {
+      pool__execute(pool, other);
+      idle = 0;
+    } else if (++idle < POOL_SPIN) {
+      pool__pause();
+    } else if (idle < POOL_SPIN + POOL_YIELD) {
+      sched_yield();
+    } else {
+      // nothing to run: the task runs on another thread, sleep until it completes
+      pthread_mutex_lock(&pool->lock);
+      __atomic_fetch_add(&pool->waiters, 1, __ATOMIC_SEQ_CST);
+      while (!pool__load(&task->done, __ATOMIC_SEQ_CST)) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+      }
+      __atomic_fetch_sub(&pool->waiters, 1, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock(&pool->lock);
+      return;
+    }
+  }
+}
+
+typedef struct pool__for_t {
+  pool_t *pool;
+  size_t lo;
+  size_t hi;
+  size_t grain;
+  void (*body)(void *ctx, size_t lo, size_t hi);
+  void *ctx;
+} pool__for_t;
+
+static inline void pool__for_task(void *arg) {
+  pool__for_t *range = (pool__for_t *) arg;
+  if (range->hi - range->lo <= range->grain) {
+    range->body(range->ctx, range->lo, range->hi);
+    return;
+  }
+  // split the range in halves: spawn the upper half, keep working on the lower one
+  size_t mid = range->lo + (range->hi - range->lo) / 2;
+  pool__for_t lower = *range;
+  pool__for_t upper = *range;
+  lower.hi = mid;
+  upper.lo = mid;
+  pool_task_t task;
+  pool_spawn(range->pool, &task, pool__for_task, &upper);
+  pool__for_task(&lower);
+  pool_wait(range->pool, &task);
+}
+
+static inline void pool_parallel_for(pool_t *pool, size_t begin, size_t end, size_t grain,
+                                     void (*body)(void *ctx, size_t lo, size_t hi), void *ctx) {
+  if (begin >= end) {
+    return;
+  }
+  pool__for_t range;
+  range.pool = pool;
+  range.lo = begin;
+  range.hi = end;
+  range.grain = (grain > 0) ? grain : 1;
+  range.body = body;
+  range.ctx = ctx;
+  pool__worker_t *self = pool__self;
+  if (self == NULL || self->pool != pool) {
+    // the split runs on the deques of the workers
+    pool_task_t task;
+    pool_spawn(pool, &task, pool__for_task, &range);
+    pool_wait(pool, &task);
+    return;
+  }
+  pool__for_task(&range);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,469 @@
+/* prof.h - Lightweight instrumentation profiler
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * This library measures named regions of code in CPU ticks and counts named events.
+ *
+ * - prof_ticks reads the time stamp counter (rdtsc); prof_ticks_end uses rdtscp, which waits for
+ *   the instructions before it, to close a region. On other architectures both fall back to the
+ *   C11 clock in nanoseconds.
+ * - prof_ticks_per_second calibrates the time stamp counter against the C11 clock once
+ *   (about 20 ms), so that ticks can be reported as time.
+ * - PROF_BEGIN(name) / PROF_END(name) time a region, PROF_COUNT(name, n) adds n to a counter.
+ *   'name' is an identifier (hash_put, s_sort, ...), used as the name of the entry in the report.
+ * - every thread accumulates into its own table of entries, so the hot path is a couple of plain
+ *   additions, without atomics or locks. The table of a thread is registered once, under a lock,
+ *   the first time the thread records something, and it is kept after the thread exits so that
+ *   the report includes it.
+ * - prof_report prints, for every entry, the calls, the total and average time and the slowest call
+ *   summed over all the threads. It should be called while no other thread is recording.
+ *
+ * When CHIBI_PROFILE_HIST is also defined, every thread records the duration of each call of a region
+ * into a latency histogram (hist.h), and prof_report adds the p50, p99 and p99.9 of every region.
+ * The histogram of an entry is allocated the first time the thread records it (about 15 KB).
+ *
+ * The macros compile to nothing unless CHIBI_PROFILE is defined before including this file, so the
+ * instrumentation of hash.h, vectors.h and sorting.h costs nothing in normal builds. Without
+ * CHIBI_PROFILE the report is empty, while the tick functions remain available.
+ *
+ * The entries and the thread tables are per translation unit, like the hash seed of hash.h: the
+ * report of a translation unit covers the regions compiled in it.
+ */
+
+#ifndef CHIBI_PROF_H
+#define CHIBI_PROF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hist.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PROF__TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF__TSC
+#endif
+
+#ifdef CHIBI_PROFILE
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Maximum number of distinct entries per translation unit */
+#define PROF_MAX_ENTRIES 128
+
+typedef uint64_t prof_ticks_t;
+
+/* Returns the current tick count (time stamp counter, or nanoseconds without one).
+ */
+static inline prof_ticks_t prof_ticks(void);
+
+/* Like prof_ticks, but waits for the previous instructions to complete: used to close a region.
+ */
+static inline prof_ticks_t prof_ticks_end(void);
+
+/* Returns the number of ticks per second. The first call calibrates the counter (about 20 ms).
+ */
+static inline double prof_ticks_per_second(void);
+
+/* Converts ticks to seconds.
+ */
+static inline double prof_seconds(prof_ticks_t ticks);
+
+/* Prints the report of all the entries, summed over all the threads.
+ */
+static inline void prof_report(FILE *out);
+
+/* Sets all the entries of all the threads to zero.
+ */
+static inline void prof_reset(void);
+
+/* An entry of the report: a timed region or a counter */
+typedef struct prof_entry_t {
+  uint64_t count;      // calls of the region, or sum of a counter
+  prof_ticks_t ticks;  // total ticks spent in the region
+  prof_ticks_t max;    // slowest call
+} prof_entry_t;
+
+/* Returns the total of an entry over all the threads (all zeros if the entry does not exist).
+ */
+static inline prof_entry_t prof_get(const char *name);
+
+/* Stores into 'out' the histogram of the durations of an entry, in ticks, merged over all the
+ * threads. Requires CHIBI_PROFILE_HIST.
+ * Return:
+ * - false if the entry does not exist or has no histogram ('out' is then empty)
+ */
+static inline bool prof_get_hist(const char *name, hist_t *out);
+
+#ifdef CHIBI_PROFILE
+
+// The entry id of a call site is cached in a static variable that several threads may fill at
+// once: relaxed atomic accesses are enough, since prof__register returns the same id to all of them
+#ifdef _MSC_VER
+#define prof__load_id(p) (*(volatile const int *)(p))
+#define prof__store_id(p, v) (*(volatile int *)(p) = (v))
+#else
+#define prof__load_id(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define prof__store_id(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#endif
+
+#define PROF_BEGIN(name) prof_ticks_t prof__start_##name = prof_ticks()
+
+#define PROF_END(name) do {                                                              \
+    prof_ticks_t prof__elapsed = prof_ticks_end() - prof__start_##name;                  \
+    static int prof__id = -1;                                                            \
+    int prof__cached = prof__load_id(&prof__id);                                         \
+    if (prof__cached < 0) {                                                              \
+      prof__cached = prof__register(#name);                                              \
+      prof__store_id(&prof__id, prof__cached);                                           \
+    }                                                                                    \
+    prof__record(prof__cached, prof__elapsed);                                           \
+  } while (0)
+
+#define PROF_COUNT(name, n) do {                                                         \
+    static int prof__id = -1;                                                            \
+    int prof__cached = prof__load_id(&prof__id);                                         \
+    if (prof__cached < 0) {                                                              \
+      prof__cached = prof__register(#name);                                              \
+      prof__store_id(&prof__id, prof__cached);                                           \
+    }                                                                                    \
+    prof__add(prof__cached, (uint64_t)(n));                                              \
+  } while (0)
+
+#else
+
+#define PROF_BEGIN(name) ((void) 0)
+#define PROF_END(name) ((void) 0)
+#define PROF_COUNT(name, n) ((void) 0)
+
+#endif
+
+// Counter calibrated by prof_ticks_per_second
+static double prof__frequency = 0.0;
+
+// C11 clock in nanoseconds, available on every platform
+static inline uint64_t prof__clock_ns(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static inline prof_ticks_t prof_ticks(void) {
+#ifdef PROF__TSC
+  return (prof_ticks_t) __rdtsc();
+#else
+  return (prof_ticks_t) prof__clock_ns();
+#endif
+}
+
+static inline prof_ticks_t prof_ticks_end(void) {
+#ifdef PROF__TSC
+  unsigned int aux;
+  return (prof_ticks_t) __rdtscp(&aux);
+#else
+  return (prof_ticks_t) prof__clock_ns();
+#endif
+}
+
+static inline double prof_ticks_per_second(void) {
+  if (prof__frequency == 0.0) {
+#ifdef PROF__TSC
+    uint64_t ns0 = prof__clock_ns();
+    prof_ticks_t t0 = prof_ticks();
+    uint64_t ns1;
+    do {
+      ns1 = prof__clock_ns();
+    } while (ns1 - ns0 < 20000000);
+    prof_ticks_t t1 = prof_ticks_end();
+    prof__frequency = (double)(t1 - t0) * 1e9 / (double)(ns1 - ns0);
+#else
+    prof__frequency = 1e9;
+#endif
+  }
+  return prof__frequency;
+}
+
+static inline double prof_seconds(prof_ticks_t ticks) {
+  return (double) ticks / prof_ticks_per_second();
+}
+
+#ifdef CHIBI_PROFILE
+
+#ifdef __cplusplus
+#define PROF__THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define PROF__THREAD_LOCAL __declspec(thread)
+#else
+#define PROF__THREAD_LOCAL _Thread_local
+#endif
+
+#ifdef _WIN32
+static SRWLOCK prof__lock = SRWLOCK_INIT;
+#define prof__lock_acquire() AcquireSRWLockExclusive(&prof__lock)
+#define prof__lock_release() ReleaseSRWLockExclusive(&prof__lock)
+#else
+static pthread_mutex_t prof__lock = PTHREAD_MUTEX_INITIALIZER;
+#define prof__lock_acquire() pthread_mutex_lock(&prof__lock)
+#define prof__lock_release() pthread_mutex_unlock(&prof__lock)
+#endif
+
+// Entries of one thread
+typedef struct prof__thread_t {
+  prof_entry_t entries[PROF_MAX_ENTRIES];
+#ifdef CHIBI_PROFILE_HIST
+  hist_t *hists[PROF_MAX_ENTRIES];  // durations of the timed regions, allocated on first use
+#endif
+  struct prof__thread_t *next;
+} prof__thread_t;
+
+static const char *prof__names[PROF_MAX_ENTRIES];
+static int prof__nentries = 0;
+static prof__thread_t *prof__threads = NULL;
+static PROF__THREAD_LOCAL prof__thread_t *prof__self = NULL;
+
+// Returns the index of the entry called 'name', adding it if needed (-1 if the table is full)
+static inline int prof__register(const char *name) {
+  prof__lock_acquire();
+  int id = -1;
+  for (int i = 0; i < prof__nentries; ++i) {
+    if (strcmp(prof__names[i], name) == 0) {
+      id = i;
+      break;
+    }
+  }
+  if (id < 0 && prof__nentries < PROF_MAX_ENTRIES) {
+    id = prof__nentries++;
+    prof__names[id] = name;
+  }
+  prof__lock_release();
+  return id;
+}
+
+// Returns the table of the calling thread, registering it on first use
+static inline prof__thread_t *prof__thread(void) {
+  prof__thread_t *self = prof__self;
+  if (self == NULL) {
+    self = (prof__thread_t *) calloc(1, sizeof(prof__thread_t));
+    if (self == NULL) {
+      return NULL;
+    }
+    prof__lock_acquire();
+    self->next = prof__threads;
+    prof__threads = self;
+    prof__lock_release();
+    prof__self = self;
+  }
+  return self;
+}
+
+static inline void prof__record(int id, prof_ticks_t elapsed) {
+  prof__thread_t *self = prof__thread();
+  if (self == NULL || id < 0) {
+    return;
+  }
+  prof_entry_t *entry = &self->entries[id];
+  entry->count++;
+  entry->ticks += elapsed;
+  if (elapsed > entry->max) {
+    entry->max = elapsed;
+  }
+#ifdef CHIBI_PROFILE_HIST
+  if (self->hists[id] == NULL) {
+    self->hists[id] = (hist_t *) malloc(sizeof(hist_t));
+    if (self->hists[id] == NULL) {
+      return;
+    }
+    hist_init(self->hists[id]);
+  }
+  hist_record(self->hists[id], elapsed);
+#endif
+}
+
+static inline void prof__add(int id, uint64_t n) {
+  prof__thread_t *self = prof__thread();
+  if (self == NULL || id < 0) {
+    return;
+  }
+  self->entries[id].count += n;
+}
+
+// Sum of the entry 'id' over all the threads. Called with the lock held
+static inline prof_entry_t prof__total(int id) {
+  prof_entry_t total = {0, 0, 0};
+  for (prof__thread_t *t = prof__threads; t != NULL; t = t->next) {
+    total.count += t->entries[id].count;
+    total.ticks += t->entries[id].ticks;
+    if (t->entries[id].max > total.max) {
+      total.max = t->entries[id].max;
+    }
+  }
+  return total;
+}
+
+static inline prof_entry_t prof_get(const char *name) {
+  prof_entry_t total = {0, 0, 0};
+  prof__lock_acquire();
+  for (int i = 0; i < prof__nentries; ++i) {
+    if (strcmp(prof__names[i], name) == 0) {
+      total = prof__total(i);
+      break;
+    }
+  }
+  prof__lock_release();
+  return total;
+}
+
+// Merges the histograms of the entry 'id' over all the threads. Called with the lock held
+static inline bool prof__total_hist(int id, hist_t *out) {
+  bool found = false;
+  hist_init(out);
+#ifdef CHIBI_PROFILE_HIST
+  for (prof__thread_t *t = prof__threads; t != NULL; t = t->next) {
+    if (t->hists[id] != NULL) {
+      hist_merge(out, t->hists[id]);
+      found = true;
+    }
+  }
+#else
+  (void) id;
+#endif
+  return found;
+}
+
+static inline bool prof_get_hist(const char *name, hist_t *out) {
+  bool found = false;
+  hist_init(out);
+  prof__lock_acquire();
+  for (int i = 0; i < prof__nentries; ++i) {
+    if (strcmp(prof__names[i], name) == 0) {
+      found = prof__total_hist(i, out);
+      break;
+    }
+  }
+  prof__lock_release();
+  return found;
+}
+
+static inline void prof_report(FILE *out) {
+  double frequency = prof_ticks_per_second();
+#ifdef CHIBI_PROFILE_HIST
+  hist_t *hist = (hist_t *) malloc(sizeof(hist_t));
+#endif
+  prof__lock_acquire();
+  fprintf(out, "%-24s %14s %14s %14s %14s", "entry", "calls", "total ms", "avg ns", "max ns");
+#ifdef CHIBI_PROFILE_HIST
+  fprintf(out, " %14s %14s %14s", "p50 ns", "p99 ns", "p99.9 ns");
+#endif
+  fprintf(out, "\n");
+  for (int i = 0; i < prof__nentries; ++i) {
+    prof_entry_t total = prof__total(i);
+    if (total.ticks == 0) {
+      // a counter
+      fprintf(out, "%-24s %14llu\n", prof__names[i], (unsigned long long) total.count);
+      continue;
+    }
+    fprintf(out, "%-24s %14llu %14.3f %14.1f %14.1f", prof__names[i], (unsigned long long) total.count,
+            (double) total.ticks * 1e3 / frequency,
+            (double) total.ticks * 1e9 / frequency / (double) total.count,
+            (double) total.max * 1e9 / frequency);
+#ifdef CHIBI_PROFILE_HIST
+    if (hist != NULL && prof__total_hist(i, hist)) {
+      fprintf(out, " %14.1f %14.1f %14.1f", (double) hist_percentile(hist, 50.0) * 1e9 / frequency,
+              (double) hist_percentile(hist, 99.0) * 1e9 / frequency,
+              (double) hist_percentile(hist, 99.9) * 1e9 / frequency);
+    }
+#endif
+    fprintf(out, "\n");
+  }
+  prof__lock_release();
+#ifdef CHIBI_PROFILE_HIST
+  free(hist);
+#endif
+}
+
+static inline void prof_reset(void) {
+  prof__lock_acquire();
+  for (prof__thread_t *t = prof__threads; t != NULL; t = t->next) {
+    memset(t->entries, 0, sizeof(t->entries));
+#ifdef CHIBI_PROFILE_HIST
+    for (int i = 0; i < PROF_MAX_ENTRIES; ++i) {
+      if (t->hists[i] != NULL) {
+        hist_init(t->hists[i]);
+      }
+    }
+#endif
+  }
+  prof__lock_release();
+}
+
+#else
+
+static inline prof_entry_t prof_get(const char *name) {
+  (void) name;
+  prof_entry_t total = {0, 0, 0};
+  return total;
+}
+
+static inline bool prof_get_hist(const char *name, hist_t *out) {
+  (void) name;
+  hist_init(out);
+  return false;
+}
+
+static inline void prof_report(FILE *out) {
+  (void) out;
+}
+
+static inline void prof_reset(void) {
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
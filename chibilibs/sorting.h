@@ -14,19 +14,102 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "allocator.h"
+#include "prof.h"
+#include "trace.h"
+
+// pool.h needs POSIX threads
+#ifndef _MSC_VER
+#include "pool.h"
+#define S__POOL
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define S__SSE2
+#endif
+
+/* Runs shorter than this are sorted with insertion sort before being merged */
+#define S_MERGE_RUN 16
+
+/* Memory budget used by s_external when the caller passes 0 */
+#define S_EXTERNAL_DEFAULT_BUDGET ((size_t)64 << 20)
+
+/* Minimum size in bytes of each run buffer during the merge phase of s_external.
+ * Together with the memory budget it decides how many runs are merged per pass.
+ */
+#define S_EXTERNAL_MIN_BUFFER ((size_t)1 << 20)
+
+/* Upper bound on the number of runs merged per pass, to stay below the open files limit */
+#define S_EXTERNAL_MAX_FANIN 256
+
+/* Minimum number of records of the slices of a chunk sorted in parallel by s_external */
+#define S_EXTERNAL_MIN_SLICE ((size_t)1 << 14)
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+/* Temporary elements (insertion keys, swap and pivot buffers) up to this many bytes live
+ * on the stack; only larger element types need a heap allocation.
+ */
+#define S_STACK_TEMP 256
+
 /* Copy function.
+ * Moves one element, with word or SSE2 copies for the common sizes (see s__move).
  * Arguments:
  * - destination array
  * - source array
  * - size of the destination and source array
  */
-static inline void s__copy(char *dest, char *source, size_t dim);
+static inline void s__copy(char *dest, const char *source, size_t dim);
+
+/* Statistics.
+ * When SORTING_STATS is defined before including this file, every algorithm counts the
+ * comparisons it performs, the elements it moves and the temporary memory it allocates.
+ * This makes runs comparable across commits independently of the machine.
+ * The counters are per translation unit and not thread safe. Without SORTING_STATS
+ * the counting compiles to nothing and s_stats_get always returns zeros.
+ * Wall time is measured separately by prof.h: when CHIBI_PROFILE is defined, the s_sort
+ * dispatchers and the radix sorts are timed (entries s_sort, s_sort_u32, s_sort_u64,
+ * s_radix_u32 and s_radix_u64 of prof_report). When CHIBI_TRACE is defined, the s_sort dispatchers
+ * also record a trace event (trace.h) for every sort of at least S_TRACE_MIN_DIM elements.
+ */
+typedef struct s_stats_t {
+  uint64_t comparisons;  // calls to the ordering function
+  uint64_t moves;        // element copies
+  size_t memory;         // temporary memory currently allocated, in bytes
+  size_t peak_memory;    // highest value of 'memory' since the last reset
+} s_stats_t;
+
+/* Resets all the counters to zero.
+ */
+static inline void s_stats_reset(void);
+
+/* Returns a copy of the counters.
+ */
+static inline s_stats_t s_stats_get(void);
+
+/* Temporary memory.
+ * Selects the allocator (allocator.h) of all the temporary buffers of the algorithms, for
+ * example an arena (arena.h) to keep them out of the heap. NULL restores the heap.
+ * The setting is per translation unit and not thread safe.
+ */
+static inline void s_set_allocator(const chibi_allocator_t *allocator);
+
+#ifdef S__POOL
+/* Parallelism.
+ * Makes s_external sort every chunk on a pool.h work-stealing pool: the chunk is split in one
+ * slice per worker (of at least S_EXTERNAL_MIN_SLICE records), the slices are sorted in parallel
+ * and merged with a loser tree while the run is written. NULL, the default, sorts the chunks on
+ * the calling thread. With SORTING_STATS the chunks are always sorted on the calling thread,
+ * because the counters are not thread safe. The setting is per translation unit.
+ */
+static inline void s_set_pool(pool_t *pool);
+#endif
 
 /* Insertion Sort.
  * Arguments:
@@ -50,59 +133,3068 @@ int64_t s_insertion(void *input, size_t dim, size_t size, bool (*order)(const vo
  */
 int64_t s_selection(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs));
 
+/* Merge Sort.
+ * Stable bottom-up merge sort. Short runs are sorted with insertion sort first.
+ * Uses a temporary buffer as large as the input.
+ * Arguments:
+ * - the vector to sort
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_merge(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs));
 
-#ifdef SORTING_IMPLEMENTATIONS
+/* External Merge Sort.
+ * Sorts a binary file of fixed-size records that does not need to fit in memory.
+ * The input is read in chunks as large as the memory budget allows, every chunk is
+ * sorted with a merge sort (in parallel after s_set_pool) and written to a temporary run
+ * file, then the runs are merged with a loser tree. When there are more runs than can be merged at once, the merge
+ * is done in several passes. All I/O is sequential and goes through large buffers.
+ * The input file is closed before the output file is opened, so the two paths may be equal.
+ * Arguments:
+ * - path of the input file
+ * - path of the output file
+ * - size of a record
+ * - a pointer to an ordering function
+ * - memory budget in bytes (0 selects S_EXTERNAL_DEFAULT_BUDGET)
+ * Return:
+ * - the number of records on success or -1 on failure (I/O error, allocation failure,
+ *   or an input file whose length is not a multiple of the record size)
+ */
+int64_t s_external(const char *in_path, const char *out_path, size_t size,
+                   bool (*order)(const void *lhs, const void *rhs), size_t budget);
 
-static inline void s__copy(char *dest, char *source, size_t dim) {
-  for(size_t i = 0; i < dim; ++i) {
-      dest[i] = source[i];
-  }
-}
+/* Nth Element.
+ * Introselect: quickselect with a median-of-three pivot, falling back to a heap based
+ * selection when the partitions stay unbalanced for too long, so the worst case is O(n log n).
+ * After the call the element at position 'nth' is the one that would be there if the
+ * whole vector was sorted, no element before it is ordered after it, and no element
+ * after it is ordered before it.
+ * Arguments:
+ * - the vector to partition
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ * - the position of the element to select
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_nth_element(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), size_t nth);
 
-// for increasing order, lhs < rhs. For decreasing order rhs < lhs
-int64_t s_insertion(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
-  char *start = (char *)input;
-  char *key = (char *)malloc(size);
-  if (key == NULL) {
-	return -1;
-  }
-  for( size_t i = 1; i < dim; ++i) {
-      s__copy(key, start + i * size, size);
-      size_t j = i - 1;
-      while( (j != SIZE_MAX) && (*order)(key, start + j * size) ) {
-		s__copy(start + (j + 1)*size, start + j * size, size);
-		--j;
-	  }
-      s__copy(start + (j + 1)*size, key, size);
-  }
+/* Partial Sort.
+ * Moves the k first elements (according to the ordering function) to the front of the
+ * vector, in order. The order of the remaining elements is unspecified. O(n log k).
+ * Arguments:
+ * - the vector to partially sort
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ * - the number of elements to sort
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_partial_sort(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), size_t k);
 
-  free(key);
-  return (int64_t) dim;
-}
+/* Streaming top-k.
+ * Keeps the k first elements (according to the ordering function) among all the elements
+ * pushed so far, in a bounded heap. Every push costs O(log k) and no more than k elements
+ * are ever stored.
+ */
+typedef struct s_topk_t {
+  size_t k;
+  size_t size;
+  size_t len;
+  bool (*order)(const void *lhs, const void *rhs);
+  char *data;  // heap of 'len' elements, the root is the last of the k first elements
+  char *temp;  // temporary element used while sifting
+} s_topk_t;
 
-// for increasing order, lhs < rhs. For decreasing order rhs < lhs
-int64_t s_selection(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
-  char *start = (char *)input;
+/* Creates a top-k accumulator.
+ * Arguments:
+ * - the number of elements to keep
+ * - size of the element type
+ * - a pointer to an ordering function
+ * Return:
+ * - a pointer to the accumulator, or NULL on failure
+ */
+s_topk_t *s_topk_new(size_t k, size_t size, bool (*order)(const void *lhs, const void *rhs));
 
-  char *temp = (char *) malloc(size);
-  if (temp == NULL) {
-	return -1;
-  }
+/* Offers an element to the accumulator. The element is copied if it is kept.
+ */
+void s_topk_push(s_topk_t *topk, const void *elem);
 
-  for (size_t i = 0; i < dim - 1; ++i) {
-	  size_t min_idx = i;
-	  for (size_t j = i + 1; j < dim; j++) {
-		if (order(start + j * size, start + min_idx * size)) {
-			min_idx = j;
-		}
-	  }
-	  s__copy(temp, start + min_idx * size, size);
-	  s__copy(start + min_idx * size, start + i * size, size);
-	  s__copy(start + i * size, temp, size);
+/* Writes the elements kept so far to 'output', in order. The accumulator is left unchanged.
+ * Return:
+ * - the number of elements written (at most k)
+ */
+size_t s_topk_sorted(const s_topk_t *topk, void *output);
+
+/* Frees the accumulator.
+ */
+void s_topk_free(s_topk_t *topk);
+
+/* Typed interface.
+ * These macros infer the size of the element type from the array pointer, the same way
+ * vectors.h and hash.h infer the value type, so 'arr' must be a pointer to the real element type.
+ */
+#define s_insertion_typed(arr, dim, order)         s_insertion((arr), (dim), sizeof(*(arr)), (order))
+#define s_selection_typed(arr, dim, order)         s_selection((arr), (dim), sizeof(*(arr)), (order))
+#define s_merge_typed(arr, dim, order)             s_merge((arr), (dim), sizeof(*(arr)), (order))
+#define s_nth_element_typed(arr, dim, order, nth)  s_nth_element((arr), (dim), sizeof(*(arr)), (order), (nth))
+#define s_partial_sort_typed(arr, dim, order, k)   s_partial_sort((arr), (dim), sizeof(*(arr)), (order), (k))
+#define s_topk_new_typed(type, k, order)           s_topk_new((k), sizeof(type), (order))
+
+/* A sorted input of a k-way merge: 'dim' elements starting at 'data'.
+ */
+typedef struct s_span_t {
+  const void *data;
+  size_t dim;
+} s_span_t;
+
+/* Two-way Merge.
+ * Merges two sorted vectors into 'output' with a branchless inner loop: the comparison
+ * result selects the source pointer and advances the cursors arithmetically, so there
+ * is no data-dependent branch to mispredict. Stable: on ties the elements of 'a' come first.
+ * Arguments:
+ * - the first sorted vector and its dimension
+ * - the second sorted vector and its dimension
+ * - the output vector, with room for na + nb elements, not overlapping the inputs
+ * - size of vector type
+ * - a pointer to an ordering function
+ * Return:
+ * - the number of elements written
+ */
+int64_t s_merge_2(const void *a, size_t na, const void *b, size_t nb, void *output, size_t size,
+                  bool (*order)(const void *lhs, const void *rhs));
+
+/* K-way Merge.
+ * Merges k sorted spans into 'output' using a loser tree, with log2(k) comparisons per
+ * element. Stable: on ties the elements of the span with the lower index come first.
+ * Arguments:
+ * - the array of sorted spans
+ * - the number of spans
+ * - the output vector, with room for the sum of the span dimensions, not overlapping the inputs
+ * - size of vector type
+ * - a pointer to an ordering function
+ * Return:
+ * - the number of elements written on success or -1 on failure
+ */
+int64_t s_merge_k(const s_span_t *spans, size_t k, void *output, size_t size,
+                  bool (*order)(const void *lhs, const void *rhs));
+
+/* Pull-based k-way merge.
+ * Produces the merged sequence of k sorted spans one element (or one batch) at a time,
+ * without an output buffer for the whole result. The spans must stay valid and unchanged
+ * while the merger is in use.
+ */
+typedef struct s_merger_t s_merger_t;
+
+/* Creates a merger over k sorted spans. The span array is copied.
+ * Return:
+ * - a pointer to the merger, or NULL on failure
+ */
+s_merger_t *s_merger_new(const s_span_t *spans, size_t k, size_t size,
+                         bool (*order)(const void *lhs, const void *rhs));
+
+/* Returns a pointer to the next element (inside its input span), or NULL when all the spans are exhausted.
+ */
+const void *s_merger_next(s_merger_t *merger);
+
+/* Copies up to 'max' of the next elements to 'output'.
+ * Return:
+ * - the number of elements copied, 0 when all the spans are exhausted
+ */
+size_t s_merger_pull(s_merger_t *merger, void *output, size_t max);
+
+/* Frees the merger.
+ */
+void s_merger_free(s_merger_t *merger);
+
+/* String sorting.
+ * Sorting strings through the generic interface compares them from the first byte every
+ * time, even when they share long prefixes. The string sorts below look at every byte of
+ * a common prefix only once: strings are partitioned on the byte at the current depth and
+ * then each partition is sorted on the following bytes. Partitions shorter than
+ * S_STRING_SMALL are finished with insertion sort. Strings are ordered byte-wise, as unsigned
+ * chars, and a string comes before every longer string with the same prefix (like strcmp).
+ * Neither sort is stable; both only move the pointers, never the string bytes.
+ */
+#define S_STRING_SMALL 32
+
+/* A string with an explicit length. It can contain zero bytes. It is used to sort the entries
+ * of length-prefixed string tables, or any string that is not zero terminated.
+ */
+typedef struct s_pstr_t {
+  const char *data;
+  size_t len;
+} s_pstr_t;
+
+/* Multikey Quicksort (three-way radix quicksort) of zero-terminated strings.
+ * Arguments:
+ * - the vector of strings to sort
+ * - the dimension of the vector
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_strings_mkqs(char **strs, size_t dim);
+
+/* MSD Radix Sort of zero-terminated strings.
+ * Every string carries a cache of its next 8 key bytes, so 8 levels of the radix sort
+ * run without touching the string bytes. Uses a temporary buffer of about 48 bytes per string.
+ * Arguments:
+ * - the vector of strings to sort
+ * - the dimension of the vector
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_strings_msd(char **strs, size_t dim);
+
+/* Multikey Quicksort of strings with an explicit length.
+ * Arguments:
+ * - the vector of strings to sort
+ * - the dimension of the vector
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_pstrs_mkqs(s_pstr_t *strs, size_t dim);
+
+/* MSD Radix Sort of strings with an explicit length, with the same 8-byte key cache as s_strings_msd.
+ * Arguments:
+ * - the vector of strings to sort
+ * - the dimension of the vector
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_pstrs_msd(s_pstr_t *strs, size_t dim);
+
+/* Builds the views of a table of 'dim' length-prefixed strings. Every entry of the table is a
+ * native endian uint32_t length immediately followed by the string bytes, with no padding.
+ * Arguments:
+ * - the table
+ * - the number of entries
+ * - the output vector of 'dim' views
+ * Return:
+ * - the number of bytes of the table that were read
+ */
+size_t s_pstrs_from_table(const void *table, size_t dim, s_pstr_t *strs);
+
+/* LSD Radix Sort of unsigned integer keys.
+ * Sorts one byte per pass, least significant first. All the byte histograms are computed
+ * in a single pass over the keys, and the passes where every key has the same byte are
+ * skipped. Uses a temporary buffer as large as the input.
+ * Arguments:
+ * - the vector to sort
+ * - the dimension of the vector
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_radix_u32(uint32_t *keys, size_t dim);
+int64_t s_radix_u64(uint64_t *keys, size_t dim);
+
+/* Sort by key.
+ * Sorts a key array and permutes one or more value arrays (of any element size) along with
+ * it, without zipping them into records. The sort is stable. The keys are sorted together
+ * with their original positions using s_merge, then every value array is gathered through
+ * the resulting permutation.
+ * Arguments:
+ * - the key vector to sort
+ * - the dimension of the key vector and of every value vector
+ * - size of key type
+ * - a pointer to an ordering function for the keys
+ * - the number of value vectors
+ * - for every value vector: a pointer to the vector (void *) and the size of its type (size_t)
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_sort_by_key(void *keys, size_t dim, size_t key_size, bool (*order)(const void *lhs, const void *rhs),
+                      size_t nvals, ...);
+
+/* Radix sort by key.
+ * Same as s_sort_by_key for unsigned integer keys, using an LSD radix sort (stable) instead of
+ * a comparison sort.
+ * Arguments:
+ * - the key vector to sort
+ * - the dimension of the key vector and of every value vector
+ * - the number of value vectors
+ * - for every value vector: a pointer to the vector (void *) and the size of its type (size_t)
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_radix_by_key_u32(uint32_t *keys, size_t dim, size_t nvals, ...);
+int64_t s_radix_by_key_u64(uint64_t *keys, size_t dim, size_t nvals, ...);
+
+#define s_sort_by_key_typed(keys, dim, order, ...) s_sort_by_key((keys), (dim), sizeof(*(keys)), (order), __VA_ARGS__)
+
+/* Sorted-array utilities.
+ * Elements are equal when neither is ordered before the other. The _u32 variants are
+ * specialized for sorted uint32_t arrays (e.g. posting lists): when SSE2 is available
+ * they compare four elements at a time.
+ * The set operations expect strictly increasing inputs (no duplicates) and produce a
+ * strictly increasing output. When one input is more than S_GALLOP_RATIO times longer than
+ * the other, they walk the shorter one and gallop (exponential then binary search) through
+ * the longer one, so the cost depends mostly on the shorter input. Below that ratio, s_union_u32
+ * still copies whole runs of the longer input once it is more than 4 times longer.
+ */
+#define S_GALLOP_RATIO 32
+
+// Length ratio beyond which s_union_u32 copies runs of the longer input instead of merging
+// one element at a time
+#define S__RUN_RATIO 4
+
+/* Removes consecutive equal elements from a sorted vector, keeping the first of each group.
+ * Arguments:
+ * - the sorted vector
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ * Return:
+ * - the new length of the vector
+ */
+int64_t s_unique(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs));
+size_t s_unique_u32(uint32_t *input, size_t dim);
+
+/* Finds the groups of equal elements of a sorted vector. The i-th group spans the positions
+ * [bounds[i], bounds[i + 1]); the last bound is always 'dim'.
+ * Arguments:
+ * - the sorted vector
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ * - the output vector of bounds, with room for dim + 1 elements
+ * Return:
+ * - the number of groups
+ */
+int64_t s_groups(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs),
+                 size_t *bounds);
+size_t s_groups_u32(const uint32_t *input, size_t dim, size_t *bounds);
+
+/* Sorted set operations on uint32_t arrays.
+ * Arguments:
+ * - the first strictly increasing vector and its dimension
+ * - the second strictly increasing vector and its dimension
+ * - the output vector, with room for min(na, nb) elements for the intersection,
+ *   na + nb for the union and na for the difference; it must not overlap the inputs
+ * Return:
+ * - the number of elements written
+ */
+size_t s_intersect_u32(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *output);
+size_t s_union_u32(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *output);
+size_t s_difference_u32(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *output);
+
+#define s_unique_typed(arr, dim, order)         s_unique((arr), (dim), sizeof(*(arr)), (order))
+#define s_groups_typed(arr, dim, order, bounds) s_groups((arr), (dim), sizeof(*(arr)), (order), (bounds))
+
+/* Binary search.
+ * The searches are branchless: every step halves the range with a conditional move instead
+ * of a branch, so the number of steps depends only on the dimension and there is nothing
+ * to mispredict. While the range is larger than 32 KB, the typed searches also prefetch both
+ * positions that the next step may read, since there is no speculation to do it for them.
+ * - lower bound: position of the first element not ordered before the key
+ * - upper bound: position of the first element ordered after the key
+ * - equal range: both of them
+ * The positions go from 0 to dim, where dim means that there is no such element.
+ */
+typedef struct s_range_t {
+  size_t first;
+  size_t last;
+} s_range_t;
+
+/* Arguments:
+ * - the sorted vector
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ * - a pointer to the key to look for
+ */
+size_t s_lower_bound(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), const void *key);
+size_t s_upper_bound(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), const void *key);
+s_range_t s_equal_range(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), const void *key);
+
+size_t s_lower_bound_u32(const uint32_t *input, size_t dim, uint32_t key);
+size_t s_upper_bound_u32(const uint32_t *input, size_t dim, uint32_t key);
+s_range_t s_equal_range_u32(const uint32_t *input, size_t dim, uint32_t key);
+size_t s_lower_bound_u64(const uint64_t *input, size_t dim, uint64_t key);
+size_t s_upper_bound_u64(const uint64_t *input, size_t dim, uint64_t key);
+s_range_t s_equal_range_u64(const uint64_t *input, size_t dim, uint64_t key);
+
+/* Batched lower bound.
+ * Looks for many keys at once. The searches advance in groups of S_SEARCH_BATCH,
+ * one step each in turn, and every step prefetches the two positions that the next step
+ * of the same search may read, so the cache misses of different searches overlap.
+ * It pays off when the vector does not fit in the cache.
+ * Arguments:
+ * - the sorted vector
+ * - the dimension of the vector
+ * - the keys to look for
+ * - the number of keys
+ * - the output vector of positions, one per key
+ */
+#define S_SEARCH_BATCH 16
+void s_lower_bound_batch_u32(const uint32_t *input, size_t dim, const uint32_t *keys, size_t nkeys, size_t *output);
+void s_lower_bound_batch_u64(const uint64_t *input, size_t dim, const uint64_t *keys, size_t nkeys, size_t *output);
+
+/* K-ary lower bound.
+ * Every step compares the key with four separators at once with SSE2 and keeps one of
+ * the five resulting parts, so it needs about log5(n) steps instead of log2(n). The last
+ * S_SEARCH_LINEAR elements are counted four at a time. Meant for small, cache-resident
+ * vectors. Without SSE2 it is the same as s_lower_bound_u32.
+ */
+#define S_SEARCH_LINEAR 16
+size_t s_lower_bound_kary_u32(const uint32_t *input, size_t dim, uint32_t key);
+
+#define s_lower_bound_typed(arr, dim, order, key) s_lower_bound((arr), (dim), sizeof(*(arr)), (order), (key))
+#define s_upper_bound_typed(arr, dim, order, key) s_upper_bound((arr), (dim), sizeof(*(arr)), (order), (key))
+#define s_equal_range_typed(arr, dim, order, key) s_equal_range((arr), (dim), sizeof(*(arr)), (order), (key))
+
+/* Key range.
+ * Finds the smallest and the largest key in a single pass, so the range of the keys is
+ * known before choosing a sorting algorithm. With dim == 0 the output is left unchanged.
+ */
+void s_key_range_u32(const uint32_t *keys, size_t dim, uint32_t *min, uint32_t *max);
+void s_key_range_u64(const uint64_t *keys, size_t dim, uint64_t *min, uint64_t *max);
+
+/* Counting Sort.
+ * Sorts elements whose keys are small integers (enums, ages, bytes...) in O(n + range):
+ * the keys are counted, the counts are turned into positions and the elements are scattered
+ * stably to those positions through a temporary buffer as large as the input.
+ * Arguments:
+ * - the vector to sort
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to a function returning the key of an element, in [0, range)
+ * - the number of possible keys, or 0 to compute it from the largest key
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_counting(void *input, size_t dim, size_t size, size_t (*key)(const void *elem), size_t range);
+
+/* Counting sort of uint32_t keys. The key range is detected first: when it spans at most
+ * S_COUNTING_MAX_RANGE values the keys are counted and rewritten in place, otherwise the
+ * vector is sorted with s_radix_u32.
+ * Arguments:
+ * - the vector to sort
+ * - the dimension of the vector
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+#define S_COUNTING_MAX_RANGE ((size_t)1 << 16)
+int64_t s_counting_u32(uint32_t *keys, size_t dim);
+
+/* Counting sort by key: same as s_radix_by_key_u32, with a single stable scatter when the
+ * key range spans at most S_COUNTING_MAX_RANGE values (it falls back to s_radix_by_key_u32 otherwise).
+ * Arguments:
+ * - the key vector to sort
+ * - the dimension of the key vector and of every value vector
+ * - the number of value vectors
+ * - for every value vector: a pointer to the vector (void *) and the size of its type (size_t)
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_counting_by_key_u32(uint32_t *keys, size_t dim, size_t nvals, ...);
+
+/* Bucket Sort of floating point numbers.
+ * Meant for values uniformly distributed between their minimum and maximum: they are
+ * scattered in 'dim' equally wide buckets, which are then sorted with insertion sort,
+ * for O(n) expected time. Uses a temporary buffer as large as the input. The values must
+ * not be NaN.
+ * Arguments:
+ * - the vector to sort
+ * - the dimension of the vector
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_bucket_f32(float *input, size_t dim);
+int64_t s_bucket_f64(double *input, size_t dim);
+
+#define s_counting_typed(arr, dim, key, range) s_counting((arr), (dim), sizeof(*(arr)), (key), (range))
+
+/* Adaptive sort.
+ * s_sort looks at its input before sorting it and dispatches to the algorithm that should
+ * be the fastest for it, so the caller does not need to know which one that is. The look
+ * is cheap: S_SORT_SAMPLE evenly spaced pairs of neighbours are compared to estimate the
+ * presortedness, and only when they all agree the whole vector is checked (stopping at the
+ * first disagreement). For integer keys the typed variants also detect the key range.
+ * The decision is available through the s_sort_plan functions, for diagnostics.
+ * s_sort is stable except when it reverses a strictly decreasing vector, where stability
+ * does not matter.
+ */
+#define S_SORT_SAMPLE 64
+
+/* Below this dimension insertion sort is used */
+#define S_SORT_INSERTION 24
+
+/* A key range up to this many times the dimension is sorted with counting sort */
+#define S_SORT_COUNTING_FACTOR 4
+
+/* With CHIBI_TRACE, sorts of at least this dimension are recorded as trace events */
+#define S_TRACE_MIN_DIM ((size_t)1 << 16)
+
+typedef enum s_algorithm_t {
+  S_ALGO_NONE,       // already sorted
+  S_ALGO_REVERSE,    // strictly decreasing, reversed in place
+  S_ALGO_INSERTION,  // s_insertion
+  S_ALGO_MERGE,      // s_merge
+  S_ALGO_COUNTING,   // counting sort (typed variants only)
+  S_ALGO_RADIX       // s_radix_u32/u64 (typed variants only)
+} s_algorithm_t;
+
+/* The decision of s_sort, together with what was observed to take it.
+ */
+typedef struct s_sort_plan_t {
+  s_algorithm_t algorithm;
+  size_t dim;
+  size_t size;          // element size in bytes, reported for diagnostics: no decision depends on it
+  size_t sampled;       // pairs of neighbours compared in the sample
+  size_t descents;      // sampled pairs ordered the wrong way
+  bool integral;        // keys are known to be integers (typed variants)
+  uint64_t key_min;     // key range, only when 'integral'
+  uint64_t key_max;
+} s_sort_plan_t;
+
+/* Returns the name of an algorithm, e.g. "merge".
+ */
+const char *s_algorithm_name(s_algorithm_t algorithm);
+
+/* Computes the decision of s_sort without sorting.
+ * Arguments:
+ * - the vector
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ */
+s_sort_plan_t s_sort_plan(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs));
+s_sort_plan_t s_sort_plan_u32(const uint32_t *keys, size_t dim);
+s_sort_plan_t s_sort_plan_u64(const uint64_t *keys, size_t dim);
+
+/* Adaptive Sort.
+ * Arguments:
+ * - the vector to sort
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_sort(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs));
+int64_t s_sort_u32(uint32_t *keys, size_t dim);
+int64_t s_sort_u64(uint64_t *keys, size_t dim);
+
+/* Adaptive sort of signed integers: the sign bit is flipped, which maps the signed order onto
+ * the unsigned one, the keys are sorted with s_sort_u32 or s_sort_u64 and the bit is restored.
+ */
+int64_t s_sort_i32(int32_t *keys, size_t dim);
+int64_t s_sort_i64(int64_t *keys, size_t dim);
+
+/* Increasing orders of the integer types. Passed to v_sort they also select the typed sorts
+ * (s_sort_u32, s_sort_u64, s_sort_i32, s_sort_i64) instead of the generic s_sort.
+ */
+bool s_less_u32(const void *lhs, const void *rhs);
+bool s_less_u64(const void *lhs, const void *rhs);
+bool s_less_i32(const void *lhs, const void *rhs);
+bool s_less_i64(const void *lhs, const void *rhs);
+
+#define s_sort_typed(arr, dim, order)      s_sort((arr), (dim), sizeof(*(arr)), (order))
+#define s_sort_plan_typed(arr, dim, order) s_sort_plan((arr), (dim), sizeof(*(arr)), (order))
+
+/* Heap Sort.
+ * In-place, O(n log n) in the worst case and O(1) extra space: a single temporary element,
+ * on the stack up to S_STACK_TEMP bytes. Not stable.
+ * Arguments:
+ * - the vector to sort
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_heap(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs));
+
+/* K-sorted Sort.
+ * Sorts a vector where every element is at most k positions away from its sorted position,
+ * in O(n log k) with a sliding heap of k + 1 elements: the first element of the window is
+ * always the next one in order. With a larger displacement the result is not sorted. Not stable.
+ * Arguments:
+ * - the vector to sort
+ * - the dimension of the vector
+ * - size of vector type
+ * - a pointer to an ordering function
+ * - the maximum displacement of an element
+ * Return:
+ * - the length of the array on success or -1 on failure
+ */
+int64_t s_ksorted(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), size_t k);
+
+#define s_heap_typed(arr, dim, order)        s_heap((arr), (dim), sizeof(*(arr)), (order))
+#define s_ksorted_typed(arr, dim, order, k)  s_ksorted((arr), (dim), sizeof(*(arr)), (order), (k))
+
+/* Integration with vectors.h and hash.h.
+ * These macros only expand to code where they are used, so sorting.h does not depend on
+ * the other headers; vectors.h (for the v_ macros) or hash.h (for hash_sort_export) must be
+ * included wherever they are used.
+ *
+ * - v_sort: sorts a vectors.h vector. The element size is inferred from the vector. Integer
+ *   vectors sorted with the matching s_less_u32, s_less_u64, s_less_i32 or s_less_i64 go to the
+ *   typed sort of their type (counting or radix sort where they pay off), every other vector
+ *   or order goes to s_sort.
+ * - v_sort_by_key: sorts a vectors.h vector of structs by one of their integer fields, with a
+ *   stable radix sort by key. Signed fields are ordered as signed numbers. Floating point
+ *   fields are not supported. If the temporary key array cannot be allocated the vector is
+ *   left unchanged.
+ * - hash_sort_export: exports the <key, value> pairs of a hash.h map straight into the 'keys'
+ *   and 'vals' arrays (with room for hash_size(map) elements each) and sorts them by key in
+ *   place. "Returns" the number of pairs, or -1 on failure.
+ */
+#define v_sort(vec, less)                                                                                \
+  (((less) == s_less_u32 && sizeof(*(vec)) == 4) ? s_sort_u32((uint32_t *)(void *)(vec), v_size(vec)) : \
+   ((less) == s_less_u64 && sizeof(*(vec)) == 8) ? s_sort_u64((uint64_t *)(void *)(vec), v_size(vec)) : \
+   ((less) == s_less_i32 && sizeof(*(vec)) == 4) ? s_sort_i32((int32_t *)(void *)(vec), v_size(vec))  : \
+   ((less) == s_less_i64 && sizeof(*(vec)) == 8) ? s_sort_i64((int64_t *)(void *)(vec), v_size(vec))  : \
+   s_sort((vec), v_size(vec), sizeof(*(vec)), (less)))
+
+#define v_sort_by_key(vec, field) do {                                                           \
+    size_t n__ = v_size(vec);                                                                    \
+    /* zero of the promoted field type, the field is not evaluated: a signed type has 0 - 1 < 0 */ \
+    bool signed__ = ((0 ? (vec)[0].field : 0) - 1) < (0 ? (vec)[0].field : 0);                  \
+    uint64_t *keys__ = (uint64_t *) s__malloc(n__ * sizeof(uint64_t));                           \
+    if (keys__ != NULL) {                                                                        \
+      for (size_t i__ = 0; i__ < n__; ++i__) {                                                   \
+        keys__[i__] = signed__ ? (uint64_t)(int64_t)(vec)[i__].field ^ 0x8000000000000000ULL     \
+                               : (uint64_t)(vec)[i__].field;                                     \
+      }                                                                                          \
+      s_radix_by_key_u64(keys__, n__, 1, (void *)(vec), sizeof(*(vec)));                         \
+      s__free(keys__, n__ * sizeof(uint64_t));                                                   \
+    }                                                                                            \
+  } while (0)
+
+#define hash_sort_export(map, keys, vals) \
+  s_radix_by_key_u64((keys), hash_export((map), (keys), (vals)), 1, (void *)(vals), sizeof(*(map)))
+
+
+#ifdef SORTING_IMPLEMENTATIONS
+
+#ifdef SORTING_STATS
+static s_stats_t s__stats = {0, 0, 0, 0};
+#define s__order(order, lhs, rhs) (s__stats.comparisons++, (order)((lhs), (rhs)))
+#define s__count_moves(n)         (s__stats.moves += (n))
+#else
+#define s__order(order, lhs, rhs) ((order)((lhs), (rhs)))
+#define s__count_moves(n)         ((void)0)
+#endif
+
+static inline void s_stats_reset(void) {
+#ifdef SORTING_STATS
+  s_stats_t zero = {0, 0, 0, 0};
+  s__stats = zero;
+#endif
+}
+
+static inline s_stats_t s_stats_get(void) {
+#ifdef SORTING_STATS
+  return s__stats;
+#else
+  s_stats_t zero = {0, 0, 0, 0};
+  return zero;
+#endif
+}
+
+// Allocator selected by s_set_allocator, NULL for the heap
+static const chibi_allocator_t *s__allocator = NULL;
+
+static inline void s_set_allocator(const chibi_allocator_t *allocator) {
+  s__allocator = allocator;
+}
+
+#ifdef S__POOL
+// Pool selected by s_set_pool, NULL to sort on the calling thread
+static pool_t *s__pool = NULL;
+
+static inline void s_set_pool(pool_t *pool) {
+  s__pool = pool;
+}
+#endif
+
+// Allocation wrappers, they keep track of the temporary memory when SORTING_STATS is defined
+static inline void *s__malloc(size_t bytes) {
+  void *ptr = chibi_alloc(s__allocator, bytes, CHIBI_DEFAULT_ALIGN);
+#ifdef SORTING_STATS
+  if (ptr != NULL) {
+    s__stats.memory += bytes;
+    if (s__stats.memory > s__stats.peak_memory) {
+      s__stats.peak_memory = s__stats.memory;
+    }
+  }
+#endif
+  return ptr;
+}
+
+static inline void *s__realloc(void *ptr, size_t old_bytes, size_t bytes) {
+  void *nptr = chibi_resize(s__allocator, ptr, old_bytes, bytes, CHIBI_DEFAULT_ALIGN);
+#ifdef SORTING_STATS
+  if (nptr != NULL) {
+    s__stats.memory += bytes - old_bytes;
+    if (s__stats.memory > s__stats.peak_memory) {
+      s__stats.peak_memory = s__stats.memory;
+    }
+  }
+#endif
+  return nptr;
+}
+
+static inline void s__free(void *ptr, size_t bytes) {
+#ifdef SORTING_STATS
+  if (ptr != NULL) {
+    s__stats.memory -= bytes;
+  }
+#endif
+  chibi_release(s__allocator, ptr, bytes);
+}
+
+/* Element move engine.
+ * Elements of 4 and 8 bytes are moved with a single word copy, elements of 16, 32 and 64
+ * bytes with SSE2 copies (all the loads come before the stores), all the other sizes with memcpy.
+ */
+static inline void s__move(char *dest, const char *source, size_t size) {
+  switch (size) {
+    case 4:
+      memcpy(dest, source, 4);
+      return;
+    case 8:
+      memcpy(dest, source, 8);
+      return;
+#ifdef S__SSE2
+    case 16:
+      _mm_storeu_si128((__m128i *) dest, _mm_loadu_si128((const __m128i *) source));
+      return;
+    case 32: {
+      __m128i x0 = _mm_loadu_si128((const __m128i *) source);
+      __m128i x1 = _mm_loadu_si128((const __m128i *)(source + 16));
+      _mm_storeu_si128((__m128i *) dest, x0);
+      _mm_storeu_si128((__m128i *)(dest + 16), x1);
+      return;
+    }
+    case 64: {
+      __m128i x0 = _mm_loadu_si128((const __m128i *) source);
+      __m128i x1 = _mm_loadu_si128((const __m128i *)(source + 16));
+      __m128i x2 = _mm_loadu_si128((const __m128i *)(source + 32));
+      __m128i x3 = _mm_loadu_si128((const __m128i *)(source + 48));
+      _mm_storeu_si128((__m128i *) dest, x0);
+      _mm_storeu_si128((__m128i *)(dest + 16), x1);
+      _mm_storeu_si128((__m128i *)(dest + 32), x2);
+      _mm_storeu_si128((__m128i *)(dest + 48), x3);
+      return;
+    }
+#endif
+    default:
+      memcpy(dest, source, size);
+      return;
+  }
+}
+
+static inline void s__copy(char *dest, const char *source, size_t dim) {
+  s__count_moves(1);
+  s__move(dest, source, dim);
+}
+
+// Returns 'stack' (a local S_STACK_TEMP bytes buffer) when 'bytes' fit in it, heap memory otherwise
+static inline char *s__temp_alloc(char *stack, size_t bytes) {
+  return (bytes <= S_STACK_TEMP) ? stack : (char *) s__malloc(bytes);
+}
+
+static inline void s__temp_free(char *stack, char *temp, size_t bytes) {
+  if (temp != stack) {
+    s__free(temp, bytes);
+  }
+}
+
+// Insertion sort core, 'key' is a temporary buffer of 'size' bytes provided by the caller
+static inline void s__insertion(char *start, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), char *key) {
+  for( size_t i = 1; i < dim; ++i) {
+      s__copy(key, start + i * size, size);
+      size_t j = i - 1;
+      while( (j != SIZE_MAX) && s__order(order, key, start + j * size) ) {
+		s__copy(start + (j + 1)*size, start + j * size, size);
+		--j;
+	  }
+      s__copy(start + (j + 1)*size, key, size);
+  }
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_insertion(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  char *start = (char *)input;
+  char stack[S_STACK_TEMP];
+  char *key = s__temp_alloc(stack, size);
+  if (key == NULL) {
+	return -1;
+  }
+  s__insertion(start, dim, size, order, key);
+
+  s__temp_free(stack, key, size);
+  return (int64_t) dim;
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_selection(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  char *start = (char *)input;
+  if (dim < 2) {
+    return (int64_t) dim;
+  }
+
+  char stack[S_STACK_TEMP];
+  char *temp = s__temp_alloc(stack, size);
+  if (temp == NULL) {
+	return -1;
+  }
+
+  for (size_t i = 0; i < dim - 1; ++i) {
+	  size_t min_idx = i;
+	  for (size_t j = i + 1; j < dim; j++) {
+		if (s__order(order, start + j * size, start + min_idx * size)) {
+			min_idx = j;
+		}
+	  }
+	  s__copy(temp, start + min_idx * size, size);
+	  s__copy(start + min_idx * size, start + i * size, size);
+	  s__copy(start + i * size, temp, size);
+
+  }
+
+  s__temp_free(stack, temp, size);
+  return (int64_t) dim;
+}
+
+// Merges the sorted runs 'a' and 'b' into 'dest'. On ties the element of 'a' comes first (stable).
+// The loop is branchless: the comparison selects the source and advances the cursors arithmetically
+static inline void s__merge_runs(char *dest, const char *a, size_t na, const char *b, size_t nb,
+                                 size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  while (na > 0 && nb > 0) {
+    size_t take_b = (size_t) s__order(order, b, a);
+    size_t take_a = take_b ^ 1;
+    s__copy(dest, take_b ? b : a, size);
+    b += take_b * size;
+    a += take_a * size;
+    nb -= take_b;
+    na -= take_a;
+    dest += size;
+  }
+  memcpy(dest, a, na * size);
+  memcpy(dest + na * size, b, nb * size);
+  s__count_moves(na + nb);
+}
+
+// Merge sort core, 'buffer' is a temporary buffer as large as the input provided by the caller
+static inline void s__merge_sort(char *start, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs),
+                                 char *buffer) {
+  if (dim < 2) {
+    return;
+  }
+
+  // the buffer is not used yet, so its first element can hold the insertion sort key
+  for (size_t lo = 0; lo < dim; lo += S_MERGE_RUN) {
+    size_t len = (dim - lo < S_MERGE_RUN) ? dim - lo : S_MERGE_RUN;
+    s__insertion(start + lo * size, len, size, order, buffer);
+  }
+
+  char *src = start;
+  char *dst = buffer;
+  for (size_t width = S_MERGE_RUN; width < dim; width *= 2) {
+    for (size_t lo = 0; lo < dim; lo += 2 * width) {
+      size_t mid = (dim - lo < width) ? dim : lo + width;
+      size_t hi  = (dim - mid < width) ? dim : mid + width;
+      s__merge_runs(dst + lo * size, src + lo * size, mid - lo, src + mid * size, hi - mid, size, order);
+    }
+    char *swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  if (src != start) {
+    memcpy(start, src, dim * size);
+    s__count_moves(dim);
+  }
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_merge(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  if (dim < 2) {
+    return (int64_t) dim;
+  }
+
+  char *buffer = (char *) s__malloc(dim * size);
+  if (buffer == NULL) {
+    return -1;
+  }
+  s__merge_sort((char *) input, dim, size, order, buffer);
+  s__free(buffer, dim * size);
+  return (int64_t) dim;
+}
+
+/* Loser tree (tournament tree) over k sorted sources.
+ * heads[i] points to the current element of the i-th source, or is NULL when the source
+ * is exhausted. The leaves are the sources; every internal node keeps the loser of the match
+ * played there, and nodes[0] keeps the overall winner. After the winner's head is advanced,
+ * s__losers_replay restores the tree with one comparison per level (log2(k) in total).
+ * Ties are won by the source with the lower index, so merging is stable.
+ */
+typedef struct s__losers_t {
+  size_t k;
+  size_t *nodes;
+  const char **heads;
+  bool (*order)(const void *lhs, const void *rhs);
+} s__losers_t;
+
+// Returns true if source 'a' wins the match against source 'b'
+static inline bool s__losers_beats(const s__losers_t *t, size_t a, size_t b) {
+  const char *x = t->heads[a];
+  const char *y = t->heads[b];
+  if (y == NULL) {
+    return x != NULL || a < b;
+  }
+  if (x == NULL) {
+    return false;
+  }
+  return (a < b) ? !s__order(t->order, y, x) : s__order(t->order, x, y);
+}
+
+// Allocates the nodes and plays the initial tournament. Returns false on allocation failure
+static inline bool s__losers_build(s__losers_t *t, size_t k, const char **heads,
+                                   bool (*order)(const void *lhs, const void *rhs)) {
+  t->k = k;
+  t->heads = heads;
+  t->order = order;
+  t->nodes = (size_t *) s__malloc(3 * k * sizeof(size_t));
+  if (t->nodes == NULL) {
+    return false;
+  }
+
+  // winners of every match, with the leaves stored at [k, 2k)
+  size_t *winners = t->nodes + k;
+  for (size_t i = 0; i < k; ++i) {
+    winners[k + i] = i;
+  }
+  for (size_t n = k - 1; n >= 1; --n) {
+    size_t l = winners[2 * n];
+    size_t r = winners[2 * n + 1];
+    if (s__losers_beats(t, l, r)) {
+      winners[n] = l;
+      t->nodes[n] = r;
+    } else {
+      winners[n] = r;
+      t->nodes[n] = l;
+    }
+  }
+  t->nodes[0] = (k > 1) ? winners[1] : 0;
+  return true;
+}
+
+// Replays the matches on the path from the previous winner's leaf to the root
+static inline void s__losers_replay(s__losers_t *t) {
+  size_t w = t->nodes[0];
+  for (size_t n = (w + t->k) / 2; n >= 1; n /= 2) {
+    if (s__losers_beats(t, t->nodes[n], w)) {
+      size_t swap = t->nodes[n];
+      t->nodes[n] = w;
+      w = swap;
+    }
+  }
+  t->nodes[0] = w;
+}
+
+static inline void s__losers_free(s__losers_t *t) {
+  s__free(t->nodes, 3 * t->k * sizeof(size_t));
+}
+
+// A sorted run stored in a temporary file, read back through a buffer during the merge
+typedef struct s__run_t {
+  FILE *file;
+  char *buffer;
+  size_t capacity;  // buffer capacity in records
+  size_t len;       // records currently in the buffer
+  size_t pos;       // next record to be consumed
+} s__run_t;
+
+// Refills the run buffer. Returns a pointer to the first record, or NULL at the end of the run
+static inline const char *s__run_fill(s__run_t *run, size_t size) {
+  run->len = fread(run->buffer, size, run->capacity, run->file);
+  run->pos = 0;
+  return (run->len > 0) ? run->buffer : NULL;
+}
+
+// Merges 'count' runs into 'out', using 'buffer_bytes' of buffer for each input and for the output
+static inline bool s__external_merge(s__run_t *runs, size_t count, FILE *out, size_t size,
+                                     bool (*order)(const void *lhs, const void *rhs), size_t buffer_bytes) {
+  size_t capacity = buffer_bytes / size;
+  if (capacity == 0) {
+    capacity = 1;
+  }
+
+  bool ok = false;
+  size_t outlen = 0;
+  char *outbuf;
+  char *memory = (char *) s__malloc((count + 1) * capacity * size);
+  const char **heads = (const char **) s__malloc(count * sizeof(const char *));
+  s__losers_t tree;
+  tree.nodes = NULL;
+  tree.k = 0;
+  if (memory == NULL || heads == NULL) {
+    goto done;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    runs[i].buffer = memory + i * capacity * size;
+    runs[i].capacity = capacity;
+    rewind(runs[i].file);
+    heads[i] = s__run_fill(&runs[i], size);
+  }
+
+  if (!s__losers_build(&tree, count, heads, order)) {
+    goto done;
+  }
+
+  outbuf = memory + count * capacity * size;
+  for (;;) {
+    size_t w = tree.nodes[0];
+    if (heads[w] == NULL) {
+      break;
+    }
+    s__copy(outbuf + outlen * size, heads[w], size);
+    if (++outlen == capacity) {
+      if (fwrite(outbuf, size, outlen, out) != outlen) {
+        goto done;
+      }
+      outlen = 0;
+    }
+    s__run_t *run = &runs[w];
+    if (++run->pos < run->len) {
+      heads[w] += size;
+    } else {
+      heads[w] = s__run_fill(run, size);
+    }
+    s__losers_replay(&tree);
+  }
+  ok = (fwrite(outbuf, size, outlen, out) == outlen) && !ferror(out);
+
+done:
+  s__losers_free(&tree);
+  s__free(heads, count * sizeof(const char *));
+  s__free(memory, (count + 1) * capacity * size);
+  return ok;
+}
+
+// A chunk of s_external, sorted in 'nslices' slices
+typedef struct s__chunk_t {
+  char *data;
+  char *temp;  // as large as the chunk
+  size_t dim;
+  size_t size;
+  size_t nslices;
+  bool (*order)(const void *lhs, const void *rhs);
+} s__chunk_t;
+
+// First record of the i-th of 'nslices' slices of 'dim' records
+#define s__slice_start(dim, nslices, i) ((size_t)(((uint64_t)(dim) * (i)) / (nslices)))
+
+static inline void s__chunk_sort_slices(void *ctx, size_t lo, size_t hi) {
+  s__chunk_t *chunk = (s__chunk_t *) ctx;
+  for (size_t i = lo; i < hi; ++i) {
+    size_t start = s__slice_start(chunk->dim, chunk->nslices, i);
+    size_t end = s__slice_start(chunk->dim, chunk->nslices, i + 1);
+    s__merge_sort(chunk->data + start * chunk->size, end - start, chunk->size, chunk->order,
+                  chunk->temp + start * chunk->size);
+  }
+}
+
+// Merges the sorted slices of a chunk into its temporary buffer and writes them to 'out'
+static inline bool s__chunk_merge(const s__chunk_t *chunk, FILE *out) {
+  size_t k = chunk->nslices;
+  size_t size = chunk->size;
+  bool ok = false;
+  s__losers_t tree;
+  tree.k = k;
+  tree.nodes = NULL;
+  const char **heads = (const char **) s__malloc(2 * k * sizeof(const char *));
+  if (heads != NULL) {
+    const char **ends = heads + k;
+    for (size_t i = 0; i < k; ++i) {
+      heads[i] = chunk->data + s__slice_start(chunk->dim, k, i) * size;
+      ends[i] = chunk->data + s__slice_start(chunk->dim, k, i + 1) * size;
+    }
+    if (s__losers_build(&tree, k, heads, chunk->order)) {
+      char *dest = chunk->temp;
+      for (;;) {
+        size_t w = tree.nodes[0];
+        if (heads[w] == NULL) {
+          break;
+        }
+        s__copy(dest, heads[w], size);
+        dest += size;
+        heads[w] += size;
+        if (heads[w] == ends[w]) {
+          heads[w] = NULL;
+        }
+        s__losers_replay(&tree);
+      }
+      ok = fwrite(chunk->temp, size, chunk->dim, out) == chunk->dim;
+    }
+  }
+  s__losers_free(&tree);
+  s__free(heads, 2 * k * sizeof(const char *));
+  return ok;
+}
+
+// Sorts a chunk, in parallel slices on the pool if there is one, and writes it to 'out'
+static inline bool s__chunk_write(s__chunk_t *chunk, FILE *out) {
+  chunk->nslices = 1;
+#if defined(S__POOL) && !defined(SORTING_STATS)
+  if (s__pool != NULL) {
+    size_t useful = chunk->dim / S_EXTERNAL_MIN_SLICE;
+    chunk->nslices = (pool_workers(s__pool) < useful) ? pool_workers(s__pool) : useful;
+  }
+  if (chunk->nslices > 1) {
+    pool_parallel_for(s__pool, 0, chunk->nslices, 1, s__chunk_sort_slices, chunk);
+    return s__chunk_merge(chunk, out);
+  }
+  chunk->nslices = 1;
+#endif
+  s__chunk_sort_slices(chunk, 0, 1);
+  return fwrite(chunk->data, chunk->size, chunk->dim, out) == chunk->dim;
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_external(const char *in_path, const char *out_path, size_t size,
+                   bool (*order)(const void *lhs, const void *rhs), size_t budget) {
+  if (budget == 0) {
+    budget = S_EXTERNAL_DEFAULT_BUDGET;
+  }
+
+  // every chunk needs an equally large buffer for the merge sort
+  size_t chunk = budget / (2 * size);
+  if (chunk == 0) {
+    return -1;
+  }
+
+  int64_t total = -1;
+  int64_t records = 0;
+  size_t fanin;
+  size_t count = 0;
+  size_t runs_cap = 16;
+  s__run_t *runs = (s__run_t *) s__malloc(runs_cap * sizeof(s__run_t));
+  char *data = (char *) s__malloc(2 * chunk * size);
+  s__chunk_t sorter;
+  FILE *in = fopen(in_path, "rb");
+  FILE *out = NULL;
+  if (runs == NULL || data == NULL || in == NULL) {
+    goto done;
+  }
+  sorter.temp = data + chunk * size;
+  sorter.size = size;
+  sorter.order = order;
+
+  // Phase 1: sort memory-sized chunks into temporary run files
+  for (;;) {
+    size_t bytes = fread(data, 1, chunk * size, in);
+    if (bytes % size != 0 || ferror(in)) {
+      goto done;
+    }
+    size_t n = bytes / size;
+    if (n == 0) {
+      break;
+    }
+    if (count == runs_cap) {
+      s__run_t *grown = (s__run_t *) s__realloc(runs, runs_cap * sizeof(s__run_t), 2 * runs_cap * sizeof(s__run_t));
+      if (grown == NULL) {
+        goto done;
+      }
+      runs = grown;
+      runs_cap *= 2;
+    }
+    runs[count].file = tmpfile();
+    if (runs[count].file == NULL) {
+      goto done;
+    }
+    ++count;
+    sorter.data = data;
+    sorter.dim = n;
+    if (!s__chunk_write(&sorter, runs[count - 1].file) || fflush(runs[count - 1].file) != 0) {
+      goto done;
+    }
+    records += (int64_t) n;
+    if (n < chunk) {
+      break;
+    }
+  }
+  fclose(in);
+  in = NULL;
+  s__free(data, 2 * chunk * size);
+  data = NULL;
+
+  // Phase 2: merge the runs, in several passes if there are too many of them
+  fanin = budget / S_EXTERNAL_MIN_BUFFER;
+  if (fanin > S_EXTERNAL_MAX_FANIN) {
+    fanin = S_EXTERNAL_MAX_FANIN;
+  }
+  if (fanin < 2) {
+    fanin = 2;
+  }
+
+  while (count > fanin) {
+    size_t merged = 0;
+    for (size_t lo = 0; lo < count; lo += fanin) {
+      size_t k = (count - lo < fanin) ? count - lo : fanin;
+      FILE *run = tmpfile();
+      if (run == NULL) {
+        // the runs at [merged, lo) are closed, the ones at [lo, count) are still open
+        for (size_t i = lo; i < count; ++i) {
+          runs[merged++].file = runs[i].file;
+        }
+        count = merged;
+        goto done;
+      }
+      bool ok = s__external_merge(runs + lo, k, run, size, order, budget / (k + 1));
+      for (size_t i = lo; i < lo + k; ++i) {
+        fclose(runs[i].file);
+        runs[i].file = NULL;
+      }
+      runs[merged++].file = run;
+      if (!ok || fflush(run) != 0) {
+        // the remaining runs of this pass are still open at [lo + k, count)
+        for (size_t i = lo + k; i < count; ++i) {
+          runs[merged++].file = runs[i].file;
+        }
+        count = merged;
+        goto done;
+      }
+    }
+    count = merged;
+  }
+
+  out = fopen(out_path, "wb");
+  if (out == NULL) {
+    goto done;
+  }
+  if (count == 0 || s__external_merge(runs, count, out, size, order, budget / (count + 1))) {
+    total = records;
+  }
+
+done:
+  if (out != NULL && fclose(out) != 0) {
+    total = -1;
+  }
+  if (in != NULL) {
+    fclose(in);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    fclose(runs[i].file);
+  }
+  s__free(data, 2 * chunk * size);
+  s__free(runs, runs_cap * sizeof(s__run_t));
+  return total;
+}
+
+// Swaps two elements through 'temp'
+static inline void s__swap(char *a, char *b, size_t size, char *temp) {
+  s__copy(temp, a, size);
+  s__copy(a, b, size);
+  s__copy(b, temp, size);
+}
+
+/* Binary heap helpers. The heap is a "max-heap" with respect to the ordering function:
+ * no child is ordered before its parent, so the root is the last element in order.
+ */
+
+// Moves the element at 'root' down until the heap property holds for the first 'n' elements
+static inline void s__sift_down(char *heap, size_t root, size_t n, size_t size,
+                                bool (*order)(const void *lhs, const void *rhs), char *temp) {
+  s__copy(temp, heap + root * size, size);
+  for (;;) {
+    size_t child = 2 * root + 1;
+    if (child >= n) {
+      break;
+    }
+    if (child + 1 < n && s__order(order, heap + child * size, heap + (child + 1) * size)) {
+      ++child;
+    }
+    if (!s__order(order, temp, heap + child * size)) {
+      break;
+    }
+    s__copy(heap + root * size, heap + child * size, size);
+    root = child;
+  }
+  s__copy(heap + root * size, temp, size);
+}
+
+// Moves the element at 'i' up until the heap property holds
+static inline void s__sift_up(char *heap, size_t i, size_t size,
+                              bool (*order)(const void *lhs, const void *rhs), char *temp) {
+  s__copy(temp, heap + i * size, size);
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!s__order(order, heap + parent * size, temp)) {
+      break;
+    }
+    s__copy(heap + i * size, heap + parent * size, size);
+    i = parent;
+  }
+  s__copy(heap + i * size, temp, size);
+}
+
+static inline void s__make_heap(char *heap, size_t n, size_t size,
+                                bool (*order)(const void *lhs, const void *rhs), char *temp) {
+  for (size_t i = n / 2; i > 0; --i) {
+    s__sift_down(heap, i - 1, n, size, order, temp);
+  }
+}
+
+// Sorts a heap of 'n' elements by repeatedly moving the root to the end
+static inline void s__sort_heap(char *heap, size_t n, size_t size,
+                                bool (*order)(const void *lhs, const void *rhs), char *temp) {
+  for (size_t end = n; end > 1; --end) {
+    s__swap(heap, heap + (end - 1) * size, size, temp);
+    s__sift_down(heap, 0, end - 1, size, order, temp);
+  }
+}
+
+// Heap selection: moves the k first elements to the front, in order. 'temp' holds one element
+static inline void s__partial_sort(char *start, size_t dim, size_t size, size_t k,
+                                   bool (*order)(const void *lhs, const void *rhs), char *temp) {
+  s__make_heap(start, k, size, order, temp);
+  for (size_t i = k; i < dim; ++i) {
+    if (s__order(order, start + i * size, start)) {
+      s__swap(start, start + i * size, size, temp);
+      s__sift_down(start, 0, k, size, order, temp);
+    }
+  }
+  s__sort_heap(start, k, size, order, temp);
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_partial_sort(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), size_t k) {
+  char *start = (char *)input;
+  if (k > dim) {
+    k = dim;
+  }
+  if (k == 0) {
+    return (int64_t) dim;
+  }
+
+  char stack[S_STACK_TEMP];
+  char *temp = s__temp_alloc(stack, size);
+  if (temp == NULL) {
+    return -1;
+  }
+  s__partial_sort(start, dim, size, k, order, temp);
+
+  s__temp_free(stack, temp, size);
+  return (int64_t) dim;
+}
+
+// Below this length introselect finishes with insertion sort
+#define S__SELECT_SMALL 16
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_nth_element(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), size_t nth) {
+  char *start = (char *)input;
+  if (nth >= dim) {
+    return -1;
+  }
+
+  // one element for swaps and one for the pivot
+  char stack[S_STACK_TEMP];
+  char *temp = s__temp_alloc(stack, 2 * size);
+  if (temp == NULL) {
+    return -1;
+  }
+  char *pivot = temp + size;
+
+  size_t lo = 0;
+  size_t hi = dim;
+  size_t depth = 0;
+  for (size_t n = dim; n > 1; n >>= 1) {
+    depth += 2;
+  }
+
+  while (hi - lo > S__SELECT_SMALL) {
+    if (depth-- == 0) {
+      // too many unbalanced partitions: select the remaining range with a heap
+      s__partial_sort(start + lo * size, hi - lo, size, nth - lo + 1, order, temp);
+      s__temp_free(stack, temp, 2 * size);
+      return (int64_t) dim;
+    }
+
+    // median of three: afterwards a[lo] <= a[mid] <= a[hi - 1], which act as sentinels
+    char *a = start + lo * size;
+    char *m = start + (lo + (hi - lo) / 2) * size;
+    char *b = start + (hi - 1) * size;
+    if (s__order(order, m, a)) s__swap(m, a, size, temp);
+    if (s__order(order, b, m)) s__swap(b, m, size, temp);
+    if (s__order(order, m, a)) s__swap(m, a, size, temp);
+    s__copy(pivot, m, size);
+
+    // Hoare partition: [lo, j] is not ordered after the pivot, (j, hi) is not ordered before it
+    size_t i = lo;
+    size_t j = hi - 1;
+    for (;;) {
+      while (s__order(order, start + i * size, pivot)) ++i;
+      while (s__order(order, pivot, start + j * size)) --j;
+      if (i >= j) {
+        break;
+      }
+      s__swap(start + i * size, start + j * size, size, temp);
+      ++i;
+      --j;
+    }
+
+    if (nth <= j) {
+      hi = j + 1;
+    } else {
+      lo = j + 1;
+    }
+  }
+
+  s__insertion(start + lo * size, hi - lo, size, order, temp);
+
+  s__temp_free(stack, temp, 2 * size);
+  return (int64_t) dim;
+}
+
+s_topk_t *s_topk_new(size_t k, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  s_topk_t *topk = (s_topk_t *) s__malloc(sizeof(s_topk_t) + (k + 1) * size);
+  if (topk == NULL) {
+    return NULL;
+  }
+  topk->k = k;
+  topk->size = size;
+  topk->len = 0;
+  topk->order = order;
+  topk->data = (char *)(topk + 1);
+  topk->temp = topk->data + k * size;
+  return topk;
+}
+
+void s_topk_push(s_topk_t *topk, const void *elem) {
+  size_t size = topk->size;
+  if (topk->len < topk->k) {
+    s__copy(topk->data + topk->len * size, (const char *) elem, size);
+    s__sift_up(topk->data, topk->len, size, topk->order, topk->temp);
+    topk->len++;
+  } else if (topk->k > 0 && s__order(topk->order, elem, topk->data)) {
+    s__copy(topk->data, (const char *) elem, size);
+    s__sift_down(topk->data, 0, topk->len, size, topk->order, topk->temp);
+  }
+}
+
+size_t s_topk_sorted(const s_topk_t *topk, void *output) {
+  memcpy(output, topk->data, topk->len * topk->size);
+  s__count_moves(topk->len);
+  s__sort_heap((char *)output, topk->len, topk->size, topk->order, topk->temp);
+  return topk->len;
+}
+
+void s_topk_free(s_topk_t *topk) {
+  if (topk != NULL) {
+    s__free(topk, sizeof(s_topk_t) + (topk->k + 1) * topk->size);
+  }
+}
+
+int64_t s_merge_2(const void *a, size_t na, const void *b, size_t nb, void *output, size_t size,
+                  bool (*order)(const void *lhs, const void *rhs)) {
+  s__merge_runs((char *)output, (const char *)a, na, (const char *)b, nb, size, order);
+  return (int64_t)(na + nb);
+}
+
+struct s_merger_t {
+  size_t size;
+  s__losers_t tree;
+  const char **heads;  // current element of each span, NULL when exhausted
+  const char **ends;   // one past the last element of each span
+};
+
+s_merger_t *s_merger_new(const s_span_t *spans, size_t k, size_t size,
+                         bool (*order)(const void *lhs, const void *rhs)) {
+  // an empty span list behaves like a single empty span
+  size_t n = (k > 0) ? k : 1;
+  s_merger_t *merger = (s_merger_t *) s__malloc(sizeof(s_merger_t) + 2 * n * sizeof(const char *));
+  if (merger == NULL) {
+    return NULL;
+  }
+  merger->size = size;
+  merger->heads = (const char **)(merger + 1);
+  merger->ends = merger->heads + n;
+  merger->heads[0] = NULL;
+  for (size_t i = 0; i < k; ++i) {
+    merger->heads[i] = (spans[i].dim > 0) ? (const char *) spans[i].data : NULL;
+    merger->ends[i] = (const char *) spans[i].data + spans[i].dim * size;
+  }
+  if (!s__losers_build(&merger->tree, n, merger->heads, order)) {
+    s__free(merger, sizeof(s_merger_t) + 2 * n * sizeof(const char *));
+    return NULL;
+  }
+  return merger;
+}
+
+const void *s_merger_next(s_merger_t *merger) {
+  size_t w = merger->tree.nodes[0];
+  const char *next = merger->heads[w];
+  if (next == NULL) {
+    return NULL;
+  }
+  merger->heads[w] = (next + merger->size < merger->ends[w]) ? next + merger->size : NULL;
+  s__losers_replay(&merger->tree);
+  return next;
+}
+
+size_t s_merger_pull(s_merger_t *merger, void *output, size_t max) {
+  char *dest = (char *)output;
+  size_t n = 0;
+  const void *next;
+  while (n < max && (next = s_merger_next(merger)) != NULL) {
+    s__copy(dest + n * merger->size, (const char *) next, merger->size);
+    ++n;
+  }
+  return n;
+}
+
+void s_merger_free(s_merger_t *merger) {
+  if (merger != NULL) {
+    s__losers_free(&merger->tree);
+    s__free(merger, sizeof(s_merger_t) + 2 * merger->tree.k * sizeof(const char *));
+  }
+}
+
+int64_t s_merge_k(const s_span_t *spans, size_t k, void *output, size_t size,
+                  bool (*order)(const void *lhs, const void *rhs)) {
+  size_t total = 0;
+  for (size_t i = 0; i < k; ++i) {
+    total += spans[i].dim;
+  }
+
+  if (k == 1) {
+    memcpy(output, spans[0].data, total * size);
+    s__count_moves(total);
+    return (int64_t) total;
+  }
+  if (k == 2) {
+    return s_merge_2(spans[0].data, spans[0].dim, spans[1].data, spans[1].dim, output, size, order);
+  }
+
+  s_merger_t *merger = s_merger_new(spans, k, size, order);
+  if (merger == NULL) {
+    return -1;
+  }
+  s_merger_pull(merger, output, total);
+  s_merger_free(merger);
+  return (int64_t) total;
+}
+
+// Pending partition of a string sort: [lo, hi) share their first 'depth' bytes
+typedef struct s__strframe_t {
+  size_t lo;
+  size_t hi;
+  size_t depth;
+} s__strframe_t;
+
+typedef struct s__strstack_t {
+  s__strframe_t *frames;
+  size_t len;
+  size_t cap;
+} s__strstack_t;
+
+static inline bool s__strstack_push(s__strstack_t *stack, size_t lo, size_t hi, size_t depth) {
+  if (hi - lo < 2) {
+    return true;
+  }
+  if (stack->len == stack->cap) {
+    size_t cap = (stack->cap > 0) ? 2 * stack->cap : 64;
+    s__strframe_t *frames = (s__strframe_t *) s__realloc(stack->frames, stack->cap * sizeof(s__strframe_t),
+                                                         cap * sizeof(s__strframe_t));
+    if (frames == NULL) {
+      return false;
+    }
+    stack->frames = frames;
+    stack->cap = cap;
+  }
+  s__strframe_t frame = {lo, hi, depth};
+  stack->frames[stack->len++] = frame;
+  return true;
+}
+
+// Key of a string at depth 'd': 0 past the end of the string, byte + 1 otherwise
+static inline int s__pstr_at(const s_pstr_t *str, size_t d) {
+  return (d < str->len) ? (unsigned char) str->data[d] + 1 : 0;
+}
+
+// Compares two strings that share their first 'd' bytes
+static inline bool s__pstr_less(const s_pstr_t *a, const s_pstr_t *b, size_t d) {
+  size_t la = a->len - d;
+  size_t lb = b->len - d;
+  int c = memcmp(a->data + d, b->data + d, (la < lb) ? la : lb);
+  return c < 0 || (c == 0 && la < lb);
+}
+
+static inline void s__pstr_insertion(s_pstr_t *strs, size_t dim, size_t d) {
+  for (size_t i = 1; i < dim; ++i) {
+    s_pstr_t key = strs[i];
+    size_t j = i;
+    while (j > 0 && s__pstr_less(&key, &strs[j - 1], d)) {
+      strs[j] = strs[j - 1];
+      --j;
+    }
+    strs[j] = key;
+    s__count_moves(i - j + 1);
+  }
+}
+
+static inline void s__pstr_swap(s_pstr_t *a, s_pstr_t *b) {
+  s_pstr_t temp = *a;
+  *a = *b;
+  *b = temp;
+  s__count_moves(3);
+}
+
+int64_t s_pstrs_mkqs(s_pstr_t *strs, size_t dim) {
+  s__strstack_t stack = {NULL, 0, 0};
+  if (!s__strstack_push(&stack, 0, dim, 0)) {
+    return -1;
+  }
+
+  while (stack.len > 0) {
+    s__strframe_t frame = stack.frames[--stack.len];
+    s_pstr_t *a = strs + frame.lo;
+    size_t n = frame.hi - frame.lo;
+    size_t d = frame.depth;
+    if (n < S_STRING_SMALL) {
+      s__pstr_insertion(a, n, d);
+      continue;
+    }
+
+    // median of three keys as the pivot
+    int x = s__pstr_at(&a[0], d);
+    int y = s__pstr_at(&a[n / 2], d);
+    int z = s__pstr_at(&a[n - 1], d);
+    int v = (x < y) ? ((y < z) ? y : (x < z) ? z : x) : ((x < z) ? x : (y < z) ? z : y);
+
+    // three-way partition: [0, lt) < v, [lt, gt) == v, [gt, n) > v
+    size_t lt = 0;
+    size_t i = 0;
+    size_t gt = n;
+    while (i < gt) {
+      int c = s__pstr_at(&a[i], d);
+      if (c < v) {
+        s__pstr_swap(&a[lt++], &a[i++]);
+      } else if (c > v) {
+        s__pstr_swap(&a[i], &a[--gt]);
+      } else {
+        ++i;
+      }
+    }
+
+    // strings equal up to their end (v == 0) are already in their final position
+    if (!s__strstack_push(&stack, frame.lo, frame.lo + lt, d) ||
+        !s__strstack_push(&stack, frame.lo + gt, frame.hi, d) ||
+        (v != 0 && !s__strstack_push(&stack, frame.lo + lt, frame.lo + gt, d + 1))) {
+      s__free(stack.frames, stack.cap * sizeof(s__strframe_t));
+      return -1;
+    }
+  }
+
+  s__free(stack.frames, stack.cap * sizeof(s__strframe_t));
+  return (int64_t) dim;
+}
+
+// String with the cache of its key bytes [depth - depth % 8, depth - depth % 8 + 8), big endian
+typedef struct s__stritem_t {
+  uint64_t cache;
+  s_pstr_t str;
+} s__stritem_t;
+
+static inline void s__stritem_fill(s__stritem_t *item, size_t d) {
+  uint64_t cache = 0;
+  size_t len = (item->str.len > d) ? item->str.len - d : 0;
+  if (len > 8) {
+    len = 8;
+  }
+  for (size_t i = 0; i < len; ++i) {
+    cache |= (uint64_t)(unsigned char) item->str.data[d + i] << (56 - 8 * i);
+  }
+  item->cache = cache;
+}
+
+static inline int s__stritem_at(const s__stritem_t *item, size_t d) {
+  return (d < item->str.len) ? (int)((item->cache >> (56 - 8 * (d % 8))) & 0xFF) + 1 : 0;
+}
+
+// MSD radix sort of the items, 'temp' holds 'dim' items
+static inline bool s__stritem_msd(s__stritem_t *items, s__stritem_t *temp, size_t dim) {
+  s__strstack_t stack = {NULL, 0, 0};
+  if (!s__strstack_push(&stack, 0, dim, 0)) {
+    return false;
+  }
+
+  while (stack.len > 0) {
+    s__strframe_t frame = stack.frames[--stack.len];
+    s__stritem_t *a = items + frame.lo;
+    size_t n = frame.hi - frame.lo;
+    size_t d = frame.depth;
+    if (n < S_STRING_SMALL) {
+      for (size_t i = 1; i < n; ++i) {
+        s__stritem_t key = a[i];
+        size_t j = i;
+        while (j > 0 && s__pstr_less(&key.str, &a[j - 1].str, d)) {
+          a[j] = a[j - 1];
+          --j;
+        }
+        a[j] = key;
+        s__count_moves(i - j + 1);
+      }
+      continue;
+    }
+
+    if (d % 8 == 0) {
+      for (size_t i = 0; i < n; ++i) {
+        s__stritem_fill(&a[i], d);
+      }
+    }
+
+    size_t count[257] = {0};
+    for (size_t i = 0; i < n; ++i) {
+      count[s__stritem_at(&a[i], d)]++;
+    }
+
+    // a single bucket needs no scatter
+    int single = -1;
+    for (int b = 0; b < 257; ++b) {
+      if (count[b] == n) {
+        single = b;
+        break;
+      }
+    }
+    if (single == 0) {
+      continue;
+    }
+    if (single > 0) {
+      if (!s__strstack_push(&stack, frame.lo, frame.hi, d + 1)) {
+        s__free(stack.frames, stack.cap * sizeof(s__strframe_t));
+        return false;
+      }
+      continue;
+    }
+
+    size_t offset[257];
+    size_t sum = 0;
+    for (int b = 0; b < 257; ++b) {
+      offset[b] = sum;
+      sum += count[b];
+    }
+    for (size_t i = 0; i < n; ++i) {
+      temp[offset[s__stritem_at(&a[i], d)]++] = a[i];
+    }
+    memcpy(a, temp, n * sizeof(s__stritem_t));
+    s__count_moves(2 * n);
+
+    // bucket 0 holds the strings that end here, they are all equal
+    size_t lo = frame.lo + count[0];
+    for (int b = 1; b < 257; ++b) {
+      if (!s__strstack_push(&stack, lo, lo + count[b], d + 1)) {
+        s__free(stack.frames, stack.cap * sizeof(s__strframe_t));
+        return false;
+      }
+      lo += count[b];
+    }
+  }
+
+  s__free(stack.frames, stack.cap * sizeof(s__strframe_t));
+  return true;
+}
+
+int64_t s_pstrs_msd(s_pstr_t *strs, size_t dim) {
+  s__stritem_t *items = (s__stritem_t *) s__malloc(2 * dim * sizeof(s__stritem_t));
+  if (items == NULL) {
+    return (dim == 0) ? 0 : -1;
+  }
+  for (size_t i = 0; i < dim; ++i) {
+    items[i].str = strs[i];
+  }
+  bool ok = s__stritem_msd(items, items + dim, dim);
+  if (ok) {
+    for (size_t i = 0; i < dim; ++i) {
+      strs[i] = items[i].str;
+    }
+  }
+  s__free(items, 2 * dim * sizeof(s__stritem_t));
+  return ok ? (int64_t) dim : -1;
+}
+
+int64_t s_strings_mkqs(char **strs, size_t dim) {
+  s_pstr_t *views = (s_pstr_t *) s__malloc(dim * sizeof(s_pstr_t));
+  if (views == NULL) {
+    return (dim == 0) ? 0 : -1;
+  }
+  for (size_t i = 0; i < dim; ++i) {
+    views[i].data = strs[i];
+    views[i].len = strlen(strs[i]);
+  }
+  int64_t ret = s_pstrs_mkqs(views, dim);
+  if (ret != -1) {
+    for (size_t i = 0; i < dim; ++i) {
+      strs[i] = (char *) views[i].data;
+    }
+  }
+  s__free(views, dim * sizeof(s_pstr_t));
+  return ret;
+}
+
+int64_t s_strings_msd(char **strs, size_t dim) {
+  s__stritem_t *items = (s__stritem_t *) s__malloc(2 * dim * sizeof(s__stritem_t));
+  if (items == NULL) {
+    return (dim == 0) ? 0 : -1;
+  }
+  for (size_t i = 0; i < dim; ++i) {
+    items[i].str.data = strs[i];
+    items[i].str.len = strlen(strs[i]);
+  }
+  bool ok = s__stritem_msd(items, items + dim, dim);
+  if (ok) {
+    for (size_t i = 0; i < dim; ++i) {
+      strs[i] = (char *) items[i].str.data;
+    }
+  }
+  s__free(items, 2 * dim * sizeof(s__stritem_t));
+  return ok ? (int64_t) dim : -1;
+}
+
+size_t s_pstrs_from_table(const void *table, size_t dim, s_pstr_t *strs) {
+  const char *p = (const char *) table;
+  for (size_t i = 0; i < dim; ++i) {
+    uint32_t len;
+    memcpy(&len, p, sizeof(uint32_t));
+    strs[i].data = p + sizeof(uint32_t);
+    strs[i].len = len;
+    p += sizeof(uint32_t) + len;
+  }
+  return (size_t)(p - (const char *) table);
+}
+
+// Reads the unsigned key of 'kbytes' bytes (4 or 8) at the start of a record
+static inline uint64_t s__radix_key(const char *record, size_t kbytes) {
+  if (kbytes == sizeof(uint32_t)) {
+    uint32_t key;
+    memcpy(&key, record, sizeof(uint32_t));
+    return key;
+  }
+  uint64_t key;
+  memcpy(&key, record, sizeof(uint64_t));
+  return key;
+}
+
+// LSD radix sort of 'dim' records of 'rsize' bytes, on the unsigned key of 'kbytes' bytes at the
+// start of every record. 'temp' holds 'dim' records. Returns the buffer holding the sorted records
+static inline char *s__radix(char *records, char *temp, size_t dim, size_t rsize, size_t kbytes) {
+  size_t count[8][256];
+  memset(count, 0, sizeof(count));
+  for (size_t i = 0; i < dim; ++i) {
+    uint64_t key = s__radix_key(records + i * rsize, kbytes);
+    for (size_t b = 0; b < kbytes; ++b) {
+      count[b][(key >> (8 * b)) & 0xFF]++;
+    }
+  }
+
+  uint64_t first = s__radix_key(records, kbytes);
+  char *src = records;
+  char *dst = temp;
+  for (size_t b = 0; b < kbytes; ++b) {
+    // every key has the same byte: the pass would not move anything
+    if (count[b][(first >> (8 * b)) & 0xFF] == dim) {
+      continue;
+    }
+    size_t sum = 0;
+    for (size_t v = 0; v < 256; ++v) {
+      size_t c = count[b][v];
+      count[b][v] = sum;
+      sum += c;
+    }
+    for (size_t i = 0; i < dim; ++i) {
+      const char *rec = src + i * rsize;
+      size_t digit = (s__radix_key(rec, kbytes) >> (8 * b)) & 0xFF;
+      s__move(dst + count[b][digit]++ * rsize, rec, rsize);
+    }
+    s__count_moves(dim);
+    char *swap = src;
+    src = dst;
+    dst = swap;
+  }
+  return src;
+}
+
+static inline int64_t s__radix_keys(void *keys, size_t dim, size_t kbytes) {
+  if (dim < 2) {
+    return (int64_t) dim;
+  }
+  char *temp = (char *) s__malloc(dim * kbytes);
+  if (temp == NULL) {
+    return -1;
+  }
+  char *sorted = s__radix((char *) keys, temp, dim, kbytes, kbytes);
+  if (sorted != (char *) keys) {
+    memcpy(keys, sorted, dim * kbytes);
+    s__count_moves(dim);
+  }
+  s__free(temp, dim * kbytes);
+  return (int64_t) dim;
+}
+
+int64_t s_radix_u32(uint32_t *keys, size_t dim) {
+  PROF_BEGIN(s_radix_u32);
+  int64_t result = s__radix_keys(keys, dim, sizeof(uint32_t));
+  PROF_END(s_radix_u32);
+  return result;
+}
+
+int64_t s_radix_u64(uint64_t *keys, size_t dim) {
+  PROF_BEGIN(s_radix_u64);
+  int64_t result = s__radix_keys(keys, dim, sizeof(uint64_t));
+  PROF_END(s_radix_u64);
+  return result;
+}
+
+// Size of the largest element type of the value vectors in 'args'
+static inline size_t s__values_max_size(size_t nvals, va_list args) {
+  va_list sizes;
+  va_copy(sizes, args);
+  size_t max_size = 0;
+  for (size_t v = 0; v < nvals; ++v) {
+    (void) va_arg(sizes, void *);
+    size_t size = va_arg(sizes, size_t);
+    max_size = (size > max_size) ? size : max_size;
+  }
+  va_end(sizes);
+  return max_size;
+}
+
+// Gathers every value vector in 'args' through 'perm': position i receives the element at position perm[i].
+// 'temp' holds 'dim' elements of the largest value type; it is allocated by the caller before the keys
+// are reordered, so that a failed allocation leaves keys and values untouched
+static inline void s__permute_values(const size_t *perm, size_t dim, size_t nvals, va_list args, char *temp) {
+  for (size_t v = 0; v < nvals; ++v) {
+    char *values = (char *) va_arg(args, void *);
+    size_t size = va_arg(args, size_t);
+    for (size_t i = 0; i < dim; ++i) {
+      s__move(temp + i * size, values + perm[i] * size, size);
+    }
+    memcpy(values, temp, dim * size);
+    s__count_moves(2 * dim);
+  }
+}
+
+// <key, position> pair sorted by the radix sort by key
+typedef struct s__radix_pair_t {
+  uint64_t key;
+  size_t idx;
+} s__radix_pair_t;
+
+// Radix sorts the keys and stores in 'perm' the original position of every sorted key
+static inline bool s__radix_permutation(void *keys, size_t dim, size_t kbytes, size_t *perm) {
+  s__radix_pair_t *pairs = (s__radix_pair_t *) s__malloc(2 * dim * sizeof(s__radix_pair_t));
+  if (pairs == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < dim; ++i) {
+    pairs[i].key = s__radix_key((const char *) keys + i * kbytes, kbytes);
+    pairs[i].idx = i;
+  }
+  s__radix_pair_t *sorted = (s__radix_pair_t *) s__radix((char *) pairs, (char *)(pairs + dim), dim,
+                                                         sizeof(s__radix_pair_t), kbytes);
+  for (size_t i = 0; i < dim; ++i) {
+    perm[i] = sorted[i].idx;
+    if (kbytes == sizeof(uint32_t)) {
+      ((uint32_t *) keys)[i] = (uint32_t) sorted[i].key;
+    } else {
+      ((uint64_t *) keys)[i] = sorted[i].key;
+    }
+  }
+  s__free(pairs, 2 * dim * sizeof(s__radix_pair_t));
+  return true;
+}
+
+static inline int64_t s__radix_by_key(void *keys, size_t dim, size_t kbytes, size_t nvals, va_list args) {
+  if (dim == 0) {
+    return 0;
+  }
+  size_t vbytes = dim * s__values_max_size(nvals, args);
+  size_t *perm = (size_t *) s__malloc(dim * sizeof(size_t));
+  char *temp = (char *) s__malloc(vbytes);
+  int64_t ret = -1;
+  if (perm != NULL && (temp != NULL || vbytes == 0) && s__radix_permutation(keys, dim, kbytes, perm)) {
+    s__permute_values(perm, dim, nvals, args, temp);
+    ret = (int64_t) dim;
+  }
+  s__free(temp, vbytes);
+  s__free(perm, dim * sizeof(size_t));
+  return ret;
+}
+
+int64_t s_radix_by_key_u32(uint32_t *keys, size_t dim, size_t nvals, ...) {
+  va_list args;
+  va_start(args, nvals);
+  int64_t ret = s__radix_by_key(keys, dim, sizeof(uint32_t), nvals, args);
+  va_end(args);
+  return ret;
+}
+
+int64_t s_radix_by_key_u64(uint64_t *keys, size_t dim, size_t nvals, ...) {
+  va_list args;
+  va_start(args, nvals);
+  int64_t ret = s__radix_by_key(keys, dim, sizeof(uint64_t), nvals, args);
+  va_end(args);
+  return ret;
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_sort_by_key(void *keys, size_t dim, size_t key_size, bool (*order)(const void *lhs, const void *rhs),
+                      size_t nvals, ...) {
+  // records made of the key followed by its original position, so 'order' can be applied to them directly
+  size_t offset = (key_size + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+  size_t rsize = offset + sizeof(size_t);
+  va_list args;
+  va_start(args, nvals);
+  size_t vbytes = dim * s__values_max_size(nvals, args);
+  char *records = (char *) s__malloc(dim * rsize);
+  size_t *perm = (size_t *) s__malloc(dim * sizeof(size_t));
+  char *temp = (char *) s__malloc(vbytes);
+  int64_t ret = -1;
+  if (records == NULL || perm == NULL || (temp == NULL && vbytes != 0)) {
+    ret = (dim == 0) ? 0 : -1;
+    goto done;
+  }
+
+  for (size_t i = 0; i < dim; ++i) {
+    memcpy(records + i * rsize, (const char *) keys + i * key_size, key_size);
+    memcpy(records + i * rsize + offset, &i, sizeof(size_t));
+  }
+  if (s_merge(records, dim, rsize, order) == -1) {
+    goto done;
+  }
+  for (size_t i = 0; i < dim; ++i) {
+    memcpy((char *) keys + i * key_size, records + i * rsize, key_size);
+    memcpy(&perm[i], records + i * rsize + offset, sizeof(size_t));
+  }
+  s__count_moves(2 * dim);
+  s__permute_values(perm, dim, nvals, args, temp);
+  ret = (int64_t) dim;
+
+done:
+  va_end(args);
+  s__free(temp, vbytes);
+  s__free(perm, dim * sizeof(size_t));
+  s__free(records, dim * rsize);
+  return ret;
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_unique(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  char *start = (char *)input;
+  if (dim == 0) {
+    return 0;
+  }
+  size_t len = 1;
+  for (size_t i = 1; i < dim; ++i) {
+    // the vector is sorted, so the last kept element is equal to the current one unless it is ordered before it
+    if (s__order(order, start + (len - 1) * size, start + i * size)) {
+      if (len != i) {
+        s__copy(start + len * size, start + i * size, size);
+      }
+      ++len;
+    }
+  }
+  return (int64_t) len;
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_groups(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs),
+                 size_t *bounds) {
+  const char *start = (const char *)input;
+  size_t count = 0;
+  for (size_t i = 0; i < dim; ++i) {
+    if (i == 0 || s__order(order, start + (i - 1) * size, start + i * size)) {
+      bounds[count++] = i;
+    }
+  }
+  bounds[count] = dim;
+  return (int64_t) count;
+}
+
+size_t s_unique_u32(uint32_t *input, size_t dim) {
+  if (dim == 0) {
+    return 0;
+  }
+  size_t len = 1;
+  size_t i = 1;
+#ifdef S__SSE2
+  for (; i + 4 <= dim; i += 4) {
+    __m128i cur  = _mm_loadu_si128((const __m128i *)(input + i));
+    __m128i prev = _mm_loadu_si128((const __m128i *)(input + i - 1));
+    int equal = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(cur, prev)));
+    if (equal == 0) {
+      // no duplicates in the block. 'len' <= 'i' and the block was loaded before storing
+      _mm_storeu_si128((__m128i *)(input + len), cur);
+      len += 4;
+    } else if (equal != 0xF) {
+      uint32_t block[4];
+      _mm_storeu_si128((__m128i *) block, cur);
+      for (int k = 0; k < 4; ++k) {
+        if (!(equal & (1 << k))) {
+          input[len++] = block[k];
+        }
+      }
+    }
+  }
+#endif
+  for (; i < dim; ++i) {
+    if (input[i] != input[i - 1]) {
+      input[len++] = input[i];
+    }
+  }
+  return len;
+}
+
+size_t s_groups_u32(const uint32_t *input, size_t dim, size_t *bounds) {
+  size_t count = 0;
+  size_t i = 1;
+  if (dim > 0) {
+    bounds[count++] = 0;
+  }
+#ifdef S__SSE2
+  for (; i + 4 <= dim; i += 4) {
+    __m128i cur  = _mm_loadu_si128((const __m128i *)(input + i));
+    __m128i prev = _mm_loadu_si128((const __m128i *)(input + i - 1));
+    int start = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(cur, prev))) & 0xF;
+    while (start != 0) {
+      int k = (start & 1) ? 0 : (start & 2) ? 1 : (start & 4) ? 2 : 3;
+      bounds[count++] = i + (size_t) k;
+      start &= start - 1;
+    }
+  }
+#endif
+  for (; i < dim; ++i) {
+    if (input[i] != input[i - 1]) {
+      bounds[count++] = i;
+    }
+  }
+  bounds[count] = dim;
+  return count;
+}
+
+// Returns the first position in [lo, n) whose element is not less than 'key', searching
+// at exponentially growing distances from 'lo' and then with a binary search
+static inline size_t s__gallop_u32(const uint32_t *arr, size_t lo, size_t n, uint32_t key) {
+  size_t step = 1;
+  size_t hi = lo;
+  while (hi < n && arr[hi] < key) {
+    lo = hi + 1;
+    hi += step;
+    step *= 2;
+  }
+  if (hi > n) {
+    hi = n;
+  }
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (arr[mid] < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+#ifdef S__SSE2
+// Mask of the four elements of 'va' that appear in 'vb'
+static inline int s__match4_u32(__m128i va, __m128i vb) {
+  __m128i m = _mm_cmpeq_epi32(va, vb);
+  m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+  m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+  m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+  return _mm_movemask_ps(_mm_castsi128_ps(m));
+}
+#endif
+
+size_t s_intersect_u32(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *output) {
+  size_t len = 0;
+  size_t i = 0;
+  size_t j = 0;
+
+  if (na > nb) {
+    const uint32_t *swap = a;
+    a = b;
+    b = swap;
+    size_t nswap = na;
+    na = nb;
+    nb = nswap;
+  }
+
+  if (na * S_GALLOP_RATIO < nb) {
+    for (; i < na; ++i) {
+      j = s__gallop_u32(b, j, nb, a[i]);
+      if (j == nb) {
+        break;
+      }
+      output[len] = a[i];
+      len += (b[j] == a[i]);
+    }
+    return len;
+  }
+
+#ifdef S__SSE2
+  // all-pairs comparison of four elements of each input, then the block with the lower maximum advances
+  while (i + 4 <= na && j + 4 <= nb) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+    int match = s__match4_u32(va, vb);
+    for (int k = 0; k < 4; ++k) {
+      output[len] = a[i + (size_t) k];
+      len += (match >> k) & 1;
+    }
+    uint32_t amax = a[i + 3];
+    uint32_t bmax = b[j + 3];
+    i += (amax <= bmax) ? 4 : 0;
+    j += (bmax <= amax) ? 4 : 0;
+  }
+#endif
+  while (i < na && j < nb) {
+    uint32_t x = a[i];
+    uint32_t y = b[j];
+    output[len] = x;
+    len += (x == y);
+    i += (x <= y);
+    j += (y <= x);
+  }
+  return len;
+}
+
+size_t s_union_u32(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *output) {
+  size_t len = 0;
+  size_t i = 0;
+  size_t j = 0;
+
+  if (na * S__RUN_RATIO < nb || nb * S__RUN_RATIO < na) {
+    // copy the runs of the longer input between the elements of the shorter one. Beyond
+    // S_GALLOP_RATIO the runs are found by galloping; below it they are short, and they are
+    // copied while scanning them (the branches are predictable)
+    const uint32_t *s = (na < nb) ? a : b;
+    const uint32_t *l = (na < nb) ? b : a;
+    size_t ns = (na < nb) ? na : nb;
+    size_t nl = (na < nb) ? nb : na;
+    bool gallop = ns * S_GALLOP_RATIO < nl;
+    for (; i < ns; ++i) {
+      size_t p = j;
+      if (gallop) {
+        p = s__gallop_u32(l, j, nl, s[i]);
+        memcpy(output + len, l + j, (p - j) * sizeof(uint32_t));
+        len += p - j;
+      } else {
+        while (p < nl && l[p] < s[i]) {
+          output[len++] = l[p++];
+        }
+      }
+      output[len++] = s[i];
+      j = (p < nl && l[p] == s[i]) ? p + 1 : p;
+    }
+    memcpy(output + len, l + j, (nl - j) * sizeof(uint32_t));
+    return len + (nl - j);
+  }
+
+  while (i < na && j < nb) {
+    uint32_t x = a[i];
+    uint32_t y = b[j];
+    output[len++] = (x <= y) ? x : y;
+    i += (x <= y);
+    j += (y <= x);
+  }
+  memcpy(output + len, a + i, (na - i) * sizeof(uint32_t));
+  len += na - i;
+  memcpy(output + len, b + j, (nb - j) * sizeof(uint32_t));
+  return len + (nb - j);
+}
+
+size_t s_difference_u32(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *output) {
+  size_t len = 0;
+  size_t i = 0;
+  size_t j = 0;
+
+  if (na * S_GALLOP_RATIO < nb) {
+    for (; i < na; ++i) {
+      j = s__gallop_u32(b, j, nb, a[i]);
+      output[len] = a[i];
+      len += (j == nb || b[j] != a[i]);
+    }
+    return len;
+  }
+  if (nb * S_GALLOP_RATIO < na) {
+    // copy the runs of 'a' between the elements of 'b', skipping the ones that match
+    for (; j < nb; ++j) {
+      size_t p = s__gallop_u32(a, i, na, b[j]);
+      memcpy(output + len, a + i, (p - i) * sizeof(uint32_t));
+      len += p - i;
+      i = (p < na && a[p] == b[j]) ? p + 1 : p;
+    }
+    memcpy(output + len, a + i, (na - i) * sizeof(uint32_t));
+    return len + (na - i);
+  }
+
+#ifdef S__SSE2
+  // a block of 'a' is written only when it is retired, after it has been compared with
+  // every block of 'b' that could contain its elements
+  int matched = 0;
+  while (i + 4 <= na && j + 4 <= nb) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+    matched |= s__match4_u32(va, vb);
+    uint32_t amax = a[i + 3];
+    uint32_t bmax = b[j + 3];
+    if (amax <= bmax) {
+      for (int k = 0; k < 4; ++k) {
+        output[len] = a[i + (size_t) k];
+        len += !((matched >> k) & 1);
+      }
+      matched = 0;
+      i += 4;
+    }
+    j += (bmax <= amax) ? 4 : 0;
+  }
+  // the last compared block of 'a' was not retired and some of its elements matched blocks of 'b'
+  // that are behind j: finish it here. Its unmatched elements are not in b[0, j)
+  if (matched != 0) {
+    for (int k = 0; k < 4; ++k) {
+      uint32_t x = a[i + (size_t) k];
+      if ((matched >> k) & 1) {
+        continue;
+      }
+      while (j < nb && b[j] < x) {
+        ++j;
+      }
+      output[len] = x;
+      len += (j == nb || b[j] != x);
+    }
+    i += 4;
+  }
+#endif
+  while (i < na && j < nb) {
+    uint32_t x = a[i];
+    uint32_t y = b[j];
+    output[len] = x;
+    len += (x < y);
+    i += (x <= y);
+    j += (y <= x);
+  }
+  memcpy(output + len, a + i, (na - i) * sizeof(uint32_t));
+  return len + (na - i);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define s__prefetch(ptr) __builtin_prefetch((ptr))
+#elif defined(S__SSE2)
+#define s__prefetch(ptr) _mm_prefetch((const char *)(ptr), _MM_HINT_T0)
+#else
+#define s__prefetch(ptr) ((void)(ptr))
+#endif
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+size_t s_lower_bound(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), const void *key) {
+  const char *base = (const char *)input;
+  if (dim == 0) {
+    return 0;
+  }
+  // invariant: the result is in [base, base + n]
+  size_t n = dim;
+  while (n > 1) {
+    size_t half = n / 2;
+    base += s__order(order, base + half * size, key) * half * size;
+    n -= half;
+  }
+  base += s__order(order, base, key) * size;
+  return (size_t)(base - (const char *)input) / size;
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+size_t s_upper_bound(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), const void *key) {
+  const char *base = (const char *)input;
+  if (dim == 0) {
+    return 0;
+  }
+  size_t n = dim;
+  while (n > 1) {
+    size_t half = n / 2;
+    base += !s__order(order, key, base + half * size) * half * size;
+    n -= half;
+  }
+  base += !s__order(order, key, base) * size;
+  return (size_t)(base - (const char *)input) / size;
+}
+
+s_range_t s_equal_range(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), const void *key) {
+  s_range_t range;
+  range.first = s_lower_bound(input, dim, size, order, key);
+  range.last = range.first + s_upper_bound((const char *)input + range.first * size, dim - range.first, size, order, key);
+  return range;
+}
+
+// Range in bytes beyond which the typed searches prefetch the next step
+#define S__PREFETCH_BYTES (32 * 1024)
+
+// Typed branchless searches; 'upper' selects the upper bound
+#define s__bound_body(input, dim, key, upper) do {             \
+    if ((dim) == 0) {                                          \
+      return 0;                                                \
+    }                                                          \
+    size_t lo = 0;                                             \
+    size_t n = (dim);                                          \
+    /* while the range is larger than the L1 cache, prefetch  \
+       both positions that the next step may read */           \
+    while (n * sizeof(*(input)) > S__PREFETCH_BYTES) {         \
+      size_t half = n / 2;                                     \
+      s__prefetch(&(input)[lo + (n - half) / 2]);              \
+      s__prefetch(&(input)[lo + half + (n - half) / 2]);       \
+      bool right = (upper) ? !((key) < (input)[lo + half])     \
+                           : ((input)[lo + half] < (key));     \
+      lo += right ? half : 0;                                  \
+      n -= half;                                               \
+    }                                                          \
+    while (n > 1) {                                            \
+      size_t half = n / 2;                                     \
+      bool right = (upper) ? !((key) < (input)[lo + half])     \
+                           : ((input)[lo + half] < (key));     \
+      lo += right ? half : 0;                                  \
+      n -= half;                                               \
+    }                                                          \
+    return lo + ((upper) ? !((key) < (input)[lo])              \
+                         : ((input)[lo] < (key)));             \
+  } while (0)
+
+size_t s_lower_bound_u32(const uint32_t *input, size_t dim, uint32_t key) {
+  s__bound_body(input, dim, key, false);
+}
+
+size_t s_upper_bound_u32(const uint32_t *input, size_t dim, uint32_t key) {
+  s__bound_body(input, dim, key, true);
+}
+
+s_range_t s_equal_range_u32(const uint32_t *input, size_t dim, uint32_t key) {
+  s_range_t range;
+  range.first = s_lower_bound_u32(input, dim, key);
+  range.last = range.first + s_upper_bound_u32(input + range.first, dim - range.first, key);
+  return range;
+}
+
+size_t s_lower_bound_u64(const uint64_t *input, size_t dim, uint64_t key) {
+  s__bound_body(input, dim, key, false);
+}
+
+size_t s_upper_bound_u64(const uint64_t *input, size_t dim, uint64_t key) {
+  s__bound_body(input, dim, key, true);
+}
+
+s_range_t s_equal_range_u64(const uint64_t *input, size_t dim, uint64_t key) {
+  s_range_t range;
+  range.first = s_lower_bound_u64(input, dim, key);
+  range.last = range.first + s_upper_bound_u64(input + range.first, dim - range.first, key);
+  return range;
+}
+
+// All the searches of a batch take the same number of steps, since it only depends on 'dim'
+#define s__bound_batch_body(input, dim, keys, nkeys, output) do {                      \
+    size_t lo[S_SEARCH_BATCH];                                                         \
+    for (size_t start = 0; start < (nkeys); start += S_SEARCH_BATCH) {                 \
+      size_t batch = ((nkeys) - start < S_SEARCH_BATCH) ? (nkeys) - start : S_SEARCH_BATCH; \
+      if ((dim) == 0) {                                                                \
+        for (size_t q = 0; q < batch; ++q) {                                           \
+          (output)[start + q] = 0;                                                     \
+        }                                                                              \
+        continue;                                                                      \
+      }                                                                                \
+      for (size_t q = 0; q < batch; ++q) {                                             \
+        lo[q] = 0;                                                                     \
+      }                                                                                \
+      size_t n = (dim);                                                                \
+      while (n > 1) {                                                                  \
+        size_t half = n / 2;                                                           \
+        size_t next = (n - half) / 2;                                                  \
+        for (size_t q = 0; q < batch; ++q) {                                           \
+          s__prefetch(&(input)[lo[q] + next]);                                         \
+          s__prefetch(&(input)[lo[q] + half + next]);                                  \
+          lo[q] += ((input)[lo[q] + half] < (keys)[start + q]) ? half : 0;             \
+        }                                                                              \
+        n -= half;                                                                     \
+      }                                                                                \
+      for (size_t q = 0; q < batch; ++q) {                                             \
+        (output)[start + q] = lo[q] + ((input)[lo[q]] < (keys)[start + q]);            \
+      }                                                                                \
+    }                                                                                  \
+  } while (0)
+
+void s_lower_bound_batch_u32(const uint32_t *input, size_t dim, const uint32_t *keys, size_t nkeys, size_t *output) {
+  s__bound_batch_body(input, dim, keys, nkeys, output);
+}
+
+void s_lower_bound_batch_u64(const uint64_t *input, size_t dim, const uint64_t *keys, size_t nkeys, size_t *output) {
+  s__bound_batch_body(input, dim, keys, nkeys, output);
+}
+
+size_t s_lower_bound_kary_u32(const uint32_t *input, size_t dim, uint32_t key) {
+#ifdef S__SSE2
+  // SSE2 only has signed compares: flipping the sign bit of both sides makes them unsigned
+  const __m128i sign = _mm_set1_epi32((int) 0x80000000u);
+  const __m128i vkey = _mm_xor_si128(_mm_set1_epi32((int) key), sign);
+  size_t lo = 0;
+  size_t n = dim;
+  while (n > S_SEARCH_LINEAR) {
+    // four separators split [lo, lo + n) in five parts, the first four 'step' elements long
+    size_t step = n / 5;
+    __m128i seps = _mm_set_epi32((int) input[lo + 4 * step - 1], (int) input[lo + 3 * step - 1],
+                                 (int) input[lo + 2 * step - 1], (int) input[lo + step - 1]);
+    int less = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(_mm_xor_si128(seps, sign), vkey)));
+    // the separators are sorted, so 'less' is a run of low bits
+    size_t count = (size_t)((less & 1) + ((less >> 1) & 1) + ((less >> 2) & 1) + ((less >> 3) & 1));
+    lo += count * step;
+    n = (count == 4) ? n - 4 * step : step;
+  }
+  size_t i = 0;
+  size_t count = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(input + lo + i)), sign);
+    int less = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, vkey)));
+    count += (size_t)((less & 1) + ((less >> 1) & 1) + ((less >> 2) & 1) + ((less >> 3) & 1));
+  }
+  for (; i < n; ++i) {
+    count += (input[lo + i] < key);
+  }
+  return lo + count;
+#else
+  return s_lower_bound_u32(input, dim, key);
+#endif
+}
+
+#define s__key_range_body(keys, dim, min, max) do {   \
+    if ((dim) == 0) {                                 \
+      return;                                         \
+    }                                                 \
+    *(min) = (keys)[0];                               \
+    *(max) = (keys)[0];                               \
+    for (size_t i = 1; i < (dim); ++i) {              \
+      *(min) = ((keys)[i] < *(min)) ? (keys)[i] : *(min); \
+      *(max) = ((keys)[i] > *(max)) ? (keys)[i] : *(max); \
+    }                                                 \
+  } while (0)
+
+void s_key_range_u32(const uint32_t *keys, size_t dim, uint32_t *min, uint32_t *max) {
+  s__key_range_body(keys, dim, min, max);
+}
+
+void s_key_range_u64(const uint64_t *keys, size_t dim, uint64_t *min, uint64_t *max) {
+  s__key_range_body(keys, dim, min, max);
+}
+
+int64_t s_counting(void *input, size_t dim, size_t size, size_t (*key)(const void *elem), size_t range) {
+  char *start = (char *)input;
+  if (dim < 2) {
+    return (int64_t) dim;
+  }
+  if (range == 0) {
+    for (size_t i = 0; i < dim; ++i) {
+      size_t k = key(start + i * size);
+      range = (k >= range) ? k + 1 : range;
+    }
+  }
+
+  size_t *count = (size_t *) s__malloc(range * sizeof(size_t));
+  char *temp = (char *) s__malloc(dim * size);
+  int64_t ret = -1;
+  if (count == NULL || temp == NULL) {
+    goto done;
+  }
+
+  memset(count, 0, range * sizeof(size_t));
+  for (size_t i = 0; i < dim; ++i) {
+    count[key(start + i * size)]++;
+  }
+  {
+    size_t sum = 0;
+    for (size_t k = 0; k < range; ++k) {
+      size_t c = count[k];
+      count[k] = sum;
+      sum += c;
+    }
+  }
+  for (size_t i = 0; i < dim; ++i) {
+    s__move(temp + count[key(start + i * size)]++ * size, start + i * size, size);
+  }
+  memcpy(start, temp, dim * size);
+  s__count_moves(2 * dim);
+  ret = (int64_t) dim;
+
+done:
+  s__free(temp, dim * size);
+  s__free(count, range * sizeof(size_t));
+  return ret;
+}
+
+// Counts the keys, all in [min, min + range), and rewrites them in order: they carry no payload
+#define s__counting_keys_body(type, keys, dim, min, range) do {              \
+    size_t *count = (size_t *) s__malloc((range) * sizeof(size_t));          \
+    if (count == NULL) {                                                     \
+      return -1;                                                             \
+    }                                                                        \
+    memset(count, 0, (range) * sizeof(size_t));                              \
+    for (size_t i = 0; i < (dim); ++i) {                                     \
+      count[(keys)[i] - (min)]++;                                            \
+    }                                                                        \
+    size_t i = 0;                                                            \
+    for (size_t k = 0; k < (range); ++k) {                                   \
+      for (size_t c = count[k]; c > 0; --c) {                                \
+        (keys)[i++] = (min) + (type) k;                                      \
+      }                                                                      \
+    }                                                                        \
+    s__count_moves(dim);                                                     \
+    s__free(count, (range) * sizeof(size_t));                                \
+    return (int64_t)(dim);                                                   \
+  } while (0)
+
+static inline int64_t s__counting_u32(uint32_t *keys, size_t dim, uint32_t min, size_t range) {
+  s__counting_keys_body(uint32_t, keys, dim, min, range);
+}
+
+static inline int64_t s__counting_u64(uint64_t *keys, size_t dim, uint64_t min, size_t range) {
+  s__counting_keys_body(uint64_t, keys, dim, min, range);
+}
+
+int64_t s_counting_u32(uint32_t *keys, size_t dim) {
+  if (dim < 2) {
+    return (int64_t) dim;
+  }
+  uint32_t min, max;
+  s_key_range_u32(keys, dim, &min, &max);
+  size_t range = (size_t)(max - min) + 1;
+  if (range > S_COUNTING_MAX_RANGE) {
+    return s_radix_u32(keys, dim);
+  }
+  return s__counting_u32(keys, dim, min, range);
+}
+
+int64_t s_counting_by_key_u32(uint32_t *keys, size_t dim, size_t nvals, ...) {
+  va_list args;
+  va_start(args, nvals);
+  uint32_t min = 0, max = 0;
+  s_key_range_u32(keys, dim, &min, &max);
+  size_t range = (size_t)(max - min) + 1;
+  if (range > S_COUNTING_MAX_RANGE) {
+    int64_t ret = s__radix_by_key(keys, dim, sizeof(uint32_t), nvals, args);
+    va_end(args);
+    return ret;
+  }
+
+  int64_t ret = -1;
+  size_t vbytes = dim * s__values_max_size(nvals, args);
+  size_t *count = (size_t *) s__malloc(range * sizeof(size_t));
+  size_t *perm = (size_t *) s__malloc(dim * sizeof(size_t));
+  char *temp = (char *) s__malloc(vbytes);
+  if (count != NULL && (perm != NULL || dim == 0) && (temp != NULL || vbytes == 0)) {
+    memset(count, 0, range * sizeof(size_t));
+    for (size_t i = 0; i < dim; ++i) {
+      count[keys[i] - min]++;
+    }
+    size_t sum = 0;
+    for (size_t k = 0; k < range; ++k) {
+      size_t c = count[k];
+      count[k] = sum;
+      sum += c;
+    }
+    // stable scatter of the positions, then the keys are rewritten and the values gathered
+    for (size_t i = 0; i < dim; ++i) {
+      perm[count[keys[i] - min]++] = i;
+    }
+    size_t i = 0;
+    for (size_t k = 0; k < range; ++k) {
+      size_t end = count[k];
+      for (; i < end; ++i) {
+        keys[i] = min + (uint32_t) k;
+      }
+    }
+    s__permute_values(perm, dim, nvals, args, temp);
+    ret = (int64_t) dim;
+  }
+  s__free(temp, vbytes);
+  s__free(perm, dim * sizeof(size_t));
+  s__free(count, range * sizeof(size_t));
+  va_end(args);
+  return ret;
+}
+
+static inline bool s__less_f32(const void *lhs, const void *rhs) {
+  return *(const float *) lhs < *(const float *) rhs;
+}
+
+static inline bool s__less_f64(const void *lhs, const void *rhs) {
+  return *(const double *) lhs < *(const double *) rhs;
+}
+
+#define s__bucket_body(type, input, dim, less) do {                                  \
+    if ((dim) < 2) {                                                                 \
+      return (int64_t)(dim);                                                         \
+    }                                                                                \
+    type min = (input)[0];                                                           \
+    type max = (input)[0];                                                           \
+    for (size_t i = 1; i < (dim); ++i) {                                             \
+      min = ((input)[i] < min) ? (input)[i] : min;                                   \
+      max = ((input)[i] > max) ? (input)[i] : max;                                   \
+    }                                                                                \
+    double width = (double) max - (double) min;                                      \
+    if (width == 0.0) {                                                              \
+      return (int64_t)(dim);                                                         \
+    }                                                                                \
+    /* the range overflows: fall back to a comparison sort */                        \
+    if (width > 1.0e308) {                                                           \
+      return s_merge((input), (dim), sizeof(type), (less));                          \
+    }                                                                                \
+    double scale = (double)(dim) / width;                                            \
+    size_t *count = (size_t *) s__malloc(((dim) + 1) * sizeof(size_t));              \
+    type *temp = (type *) s__malloc((dim) * sizeof(type));                           \
+    if (count == NULL || temp == NULL) {                                             \
+      s__free(temp, (dim) * sizeof(type));                                           \
+      s__free(count, ((dim) + 1) * sizeof(size_t));                                  \
+      return -1;                                                                     \
+    }                                                                                \
+    memset(count, 0, ((dim) + 1) * sizeof(size_t));                                 \
+    for (size_t i = 0; i < (dim); ++i) {                                             \
+      size_t b = (size_t)(((double)(input)[i] - (double) min) * scale);              \
+      count[(b < (dim)) ? b : (dim) - 1]++;                                          \
+    }                                                                                \
+    size_t sum = 0;                                                                  \
+    for (size_t b = 0; b <= (dim); ++b) {                                            \
+      size_t c = count[b];                                                           \
+      count[b] = sum;                                                                \
+      sum += c;                                                                      \
+    }                                                                                \
+    for (size_t i = 0; i < (dim); ++i) {                                             \
+      size_t b = (size_t)(((double)(input)[i] - (double) min) * scale);              \
+      temp[count[(b < (dim)) ? b : (dim) - 1]++] = (input)[i];                       \
+    }                                                                                \
+    /* after the scatter count[b] is the end of bucket b */                          \
+    size_t lo = 0;                                                                   \
+    for (size_t b = 0; b < (dim); ++b) {                                             \
+      for (size_t i = lo + 1; i < count[b]; ++i) {                                   \
+        type x = temp[i];                                                            \
+        size_t j = i;                                                                \
+        while (j > lo && x < temp[j - 1]) {                                          \
+          temp[j] = temp[j - 1];                                                     \
+          --j;                                                                       \
+        }                                                                            \
+        temp[j] = x;                                                                 \
+      }                                                                              \
+      lo = count[b];                                                                 \
+    }                                                                                \
+    memcpy((input), temp, (dim) * sizeof(type));                                     \
+    s__count_moves(2 * (dim));                                                       \
+    s__free(temp, (dim) * sizeof(type));                                             \
+    s__free(count, ((dim) + 1) * sizeof(size_t));                                    \
+    return (int64_t)(dim);                                                           \
+  } while (0)
+
+int64_t s_bucket_f32(float *input, size_t dim) {
+  s__bucket_body(float, input, dim, s__less_f32);
+}
+
+int64_t s_bucket_f64(double *input, size_t dim) {
+  s__bucket_body(double, input, dim, s__less_f64);
+}
+
+const char *s_algorithm_name(s_algorithm_t algorithm) {
+  switch (algorithm) {
+    case S_ALGO_NONE:      return "none";
+    case S_ALGO_REVERSE:   return "reverse";
+    case S_ALGO_INSERTION: return "insertion";
+    case S_ALGO_MERGE:     return "merge";
+    case S_ALGO_COUNTING:  return "counting";
+    case S_ALGO_RADIX:     return "radix";
+  }
+  return "unknown";
+}
+
+// Samples the presortedness and decides among the comparison based algorithms
+static inline void s__sort_plan_order(s_sort_plan_t *plan, const char *start, size_t dim, size_t size,
+                                      bool (*order)(const void *lhs, const void *rhs)) {
+  plan->sampled = (dim - 1 < S_SORT_SAMPLE) ? dim - 1 : S_SORT_SAMPLE;
+  size_t ascents = 0;
+  for (size_t s = 0; s < plan->sampled; ++s) {
+    size_t i = s * (dim - 1) / plan->sampled;
+    const char *a = start + i * size;
+    plan->descents += s__order(order, a + size, a);
+    ascents += s__order(order, a, a + size);
+  }
+
+  if (plan->descents == 0) {
+    size_t i = 1;
+    while (i < dim && !s__order(order, start + i * size, start + (i - 1) * size)) {
+      ++i;
+    }
+    if (i == dim) {
+      plan->algorithm = S_ALGO_NONE;
+      return;
+    }
+  } else if (plan->descents == plan->sampled && ascents == 0) {
+    size_t i = 1;
+    while (i < dim && s__order(order, start + i * size, start + (i - 1) * size)) {
+      ++i;
+    }
+    if (i == dim) {
+      plan->algorithm = S_ALGO_REVERSE;
+      return;
+    }
+  }
+  plan->algorithm = (dim < S_SORT_INSERTION) ? S_ALGO_INSERTION : S_ALGO_MERGE;
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+s_sort_plan_t s_sort_plan(const void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  s_sort_plan_t plan;
+  memset(&plan, 0, sizeof(plan));
+  plan.algorithm = S_ALGO_NONE;
+  plan.dim = dim;
+  plan.size = size;
+  if (dim >= 2) {
+    s__sort_plan_order(&plan, (const char *)input, dim, size, order);
+  }
+  return plan;
+}
+
+static inline bool s__less_u32(const void *lhs, const void *rhs) {
+  return *(const uint32_t *) lhs < *(const uint32_t *) rhs;
+}
+
+static inline bool s__less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+// Integer keys: counting sort for small ranges, radix sort for large vectors
+static inline void s__sort_plan_integral(s_sort_plan_t *plan, const void *keys, bool (*less)(const void *lhs, const void *rhs)) {
+  plan->integral = true;
+  if (plan->dim < 2) {
+    return;
+  }
+  s__sort_plan_order(plan, (const char *) keys, plan->dim, plan->size, less);
+  if (plan->algorithm != S_ALGO_MERGE) {
+    return;
+  }
+  uint64_t range = plan->key_max - plan->key_min;
+  if (range < (uint64_t) plan->dim * S_SORT_COUNTING_FACTOR && range < S_COUNTING_MAX_RANGE) {
+    plan->algorithm = S_ALGO_COUNTING;
+  } else {
+    plan->algorithm = S_ALGO_RADIX;
+  }
+}
+
+s_sort_plan_t s_sort_plan_u32(const uint32_t *keys, size_t dim) {
+  s_sort_plan_t plan;
+  memset(&plan, 0, sizeof(plan));
+  plan.algorithm = S_ALGO_NONE;
+  plan.dim = dim;
+  plan.size = sizeof(uint32_t);
+  uint32_t min = 0, max = 0;
+  s_key_range_u32(keys, dim, &min, &max);
+  plan.key_min = min;
+  plan.key_max = max;
+  s__sort_plan_integral(&plan, keys, s__less_u32);
+  return plan;
+}
+
+s_sort_plan_t s_sort_plan_u64(const uint64_t *keys, size_t dim) {
+  s_sort_plan_t plan;
+  memset(&plan, 0, sizeof(plan));
+  plan.algorithm = S_ALGO_NONE;
+  plan.dim = dim;
+  plan.size = sizeof(uint64_t);
+  s_key_range_u64(keys, dim, &plan.key_min, &plan.key_max);
+  s__sort_plan_integral(&plan, keys, s__less_u64);
+  return plan;
+}
+
+// Reverses a vector in place
+static inline int64_t s__reverse(char *start, size_t dim, size_t size) {
+  char stack[S_STACK_TEMP];
+  char *temp = s__temp_alloc(stack, size);
+  if (temp == NULL) {
+    return -1;
+  }
+  for (size_t i = 0, j = dim - 1; i < j; ++i, --j) {
+    s__swap(start + i * size, start + j * size, size, temp);
+  }
+  s__temp_free(stack, temp, size);
+  return (int64_t) dim;
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_sort(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  PROF_BEGIN(s_sort);
+  TRACE_BEGIN_IF(s_sort, dim >= S_TRACE_MIN_DIM);
+  s_sort_plan_t plan = s_sort_plan(input, dim, size, order);
+  int64_t result;
+  switch (plan.algorithm) {
+    case S_ALGO_REVERSE:   result = s__reverse((char *)input, dim, size); break;
+    case S_ALGO_INSERTION: result = s_insertion(input, dim, size, order); break;
+    case S_ALGO_MERGE:     result = s_merge(input, dim, size, order); break;
+    default:               result = (int64_t) dim; break;
+  }
+  TRACE_END(s_sort);
+  PROF_END(s_sort);
+  return result;
+}
+
+int64_t s_sort_u32(uint32_t *keys, size_t dim) {
+  PROF_BEGIN(s_sort_u32);
+  TRACE_BEGIN_IF(s_sort_u32, dim >= S_TRACE_MIN_DIM);
+  s_sort_plan_t plan = s_sort_plan_u32(keys, dim);
+  int64_t result;
+  switch (plan.algorithm) {
+    case S_ALGO_REVERSE:   result = s__reverse((char *) keys, dim, sizeof(uint32_t)); break;
+    case S_ALGO_INSERTION: result = s_insertion(keys, dim, sizeof(uint32_t), s__less_u32); break;
+    case S_ALGO_COUNTING:  result = s__counting_u32(keys, dim, (uint32_t) plan.key_min, (size_t)(plan.key_max - plan.key_min) + 1); break;
+    case S_ALGO_RADIX:     result = s_radix_u32(keys, dim); break;
+    default:               result = (int64_t) dim; break;
+  }
+  TRACE_END(s_sort_u32);
+  PROF_END(s_sort_u32);
+  return result;
+}
+
+int64_t s_sort_u64(uint64_t *keys, size_t dim) {
+  PROF_BEGIN(s_sort_u64);
+  TRACE_BEGIN_IF(s_sort_u64, dim >= S_TRACE_MIN_DIM);
+  s_sort_plan_t plan = s_sort_plan_u64(keys, dim);
+  int64_t result;
+  switch (plan.algorithm) {
+    case S_ALGO_REVERSE:   result = s__reverse((char *) keys, dim, sizeof(uint64_t)); break;
+    case S_ALGO_INSERTION: result = s_insertion(keys, dim, sizeof(uint64_t), s__less_u64); break;
+    case S_ALGO_COUNTING:  result = s__counting_u64(keys, dim, plan.key_min, (size_t)(plan.key_max - plan.key_min) + 1); break;
+    case S_ALGO_RADIX:     result = s_radix_u64(keys, dim); break;
+    default:               result = (int64_t) dim; break;
+  }
+  TRACE_END(s_sort_u64);
+  PROF_END(s_sort_u64);
+  return result;
+}
+
+int64_t s_sort_i32(int32_t *keys, size_t dim) {
+  uint32_t *ukeys = (uint32_t *) keys;
+  for (size_t i = 0; i < dim; ++i) {
+    ukeys[i] ^= 0x80000000u;
+  }
+  int64_t result = s_sort_u32(ukeys, dim);
+  for (size_t i = 0; i < dim; ++i) {
+    ukeys[i] ^= 0x80000000u;
+  }
+  return result;
+}
+
+int64_t s_sort_i64(int64_t *keys, size_t dim) {
+  uint64_t *ukeys = (uint64_t *) keys;
+  for (size_t i = 0; i < dim; ++i) {
+    ukeys[i] ^= 0x8000000000000000ULL;
+  }
+  int64_t result = s_sort_u64(ukeys, dim);
+  for (size_t i = 0; i < dim; ++i) {
+    ukeys[i] ^= 0x8000000000000000ULL;
+  }
+  return result;
+}
+
+bool s_less_u32(const void *lhs, const void *rhs) {
+  return *(const uint32_t *) lhs < *(const uint32_t *) rhs;
+}
+
+bool s_less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+bool s_less_i32(const void *lhs, const void *rhs) {
+  return *(const int32_t *) lhs < *(const int32_t *) rhs;
+}
+
+bool s_less_i64(const void *lhs, const void *rhs) {
+  return *(const int64_t *) lhs < *(const int64_t *) rhs;
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_heap(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs)) {
+  char *start = (char *)input;
+  char stack[S_STACK_TEMP];
+  char *temp = s__temp_alloc(stack, size);
+  if (temp == NULL) {
+    return -1;
+  }
+  s__make_heap(start, dim, size, order, temp);
+  s__sort_heap(start, dim, size, order, temp);
+
+  s__temp_free(stack, temp, size);
+  return (int64_t) dim;
+}
+
+// Like s__sift_down, for a heap whose root is the first element in order
+static inline void s__sift_down_min(char *heap, size_t root, size_t n, size_t size,
+                                    bool (*order)(const void *lhs, const void *rhs), char *temp) {
+  s__copy(temp, heap + root * size, size);
+  for (;;) {
+    size_t child = 2 * root + 1;
+    if (child >= n) {
+      break;
+    }
+    if (child + 1 < n && s__order(order, heap + (child + 1) * size, heap + child * size)) {
+      ++child;
+    }
+    if (!s__order(order, heap + child * size, temp)) {
+      break;
+    }
+    s__copy(heap + root * size, heap + child * size, size);
+    root = child;
+  }
+  s__copy(heap + root * size, temp, size);
+}
+
+// for increasing order, lhs < rhs. For decreasing order rhs < lhs
+int64_t s_ksorted(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs), size_t k) {
+  char *start = (char *)input;
+  if (dim < 2) {
+    return (int64_t) dim;
+  }
+  size_t window = (k < dim - 1) ? k + 1 : dim;
+
+  // the window plus one temporary element
+  char *heap = (char *) s__malloc((window + 1) * size);
+  if (heap == NULL) {
+    return -1;
+  }
+  char *temp = heap + window * size;
+
+  memcpy(heap, start, window * size);
+  s__count_moves(window);
+  for (size_t i = window / 2; i > 0; --i) {
+    s__sift_down_min(heap, i - 1, window, size, order, temp);
+  }
 
+  // position i has been read before it is written: the window always starts past it
+  size_t len = window;
+  for (size_t i = 0; i < dim; ++i) {
+    s__copy(start + i * size, heap, size);
+    size_t next = i + window;
+    if (next < dim) {
+      s__copy(heap, start + next * size, size);
+    } else {
+      --len;
+      s__copy(heap, heap + len * size, size);
+    }
+    s__sift_down_min(heap, 0, len, size, order, temp);
   }
 
-  free(temp);
+  s__free(heap, (window + 1) * size);
   return (int64_t) dim;
 }
 
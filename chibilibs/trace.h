@@ -0,0 +1,283 @@
+/* trace.h - Low-overhead trace events with Chrome trace export
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * prof.h sums the time of a region over all its calls; this library keeps every call instead, with
+ * its timestamps, so that a single slow request can be explained: which resize or which sort it
+ * was waiting for, and on which thread.
+ *
+ * - TRACE_BEGIN(name) / TRACE_END(name) record a begin and an end event. 'name' is an identifier,
+ *   like for PROF_BEGIN. TRACE_BEGIN_IF(name, condition) records the pair only when the condition
+ *   holds (for example only for sorts of many elements).
+ * - every thread writes its events into its own ring buffer of TRACE_RING_SIZE events. The ring
+ *   is single producer (the thread) and single consumer (trace_export), so recording an event is a
+ *   time stamp counter read (prof_ticks) and a few stores, without locks or atomic
+ *   read-modify-writes.
+ * - when a ring is full new events are dropped and counted (trace_dropped). A begin event is only
+ *   recorded if the ring also has room for the end events of all the regions still open on the
+ *   thread, so an end event is never lost once its begin was recorded.
+ * - trace_export drains the rings and writes the events in the Chrome trace event format (JSON),
+ *   which can be opened in chrome://tracing or https://ui.perfetto.dev. It can be called while
+ *   other threads are recording; events recorded meanwhile go to the next export. A region still
+ *   open on a thread, and every event of that thread after its begin, also wait for the next
+ *   export, so that every export is well nested. They keep their room in the ring meanwhile: a
+ *   region that stays open for a long time makes the thread drop its new regions once the ring
+ *   is full.
+ *
+ * hash.h, vectors.h and sorting.h record their resizes, reallocations and long sorts (entries
+ * hash_resize, v_double_capacity, s_sort, s_sort_u32 and s_sort_u64).
+ *
+ * The macros compile to nothing unless CHIBI_TRACE is defined before including this file. Like
+ * prof.h, the rings are per translation unit.
+ */
+
+#ifndef CHIBI_TRACE_H
+#define CHIBI_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "prof.h"
+
+#ifdef CHIBI_TRACE
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Events per thread ring buffer (a power of two) */
+#define TRACE_RING_SIZE 8192
+
+/* Writes the recorded events in the Chrome trace event format and removes them from the rings,
+ * up to the first region of every thread that is still open.
+ * Return:
+ * - the number of events written
+ */
+static inline size_t trace_export(FILE *out);
+
+/* Returns the number of events dropped because a ring was full.
+ */
+static inline uint64_t trace_dropped(void);
+
+#ifdef CHIBI_TRACE
+
+#define TRACE_BEGIN_IF(name, condition) bool trace__on_##name = (condition) && trace__begin(#name)
+#define TRACE_BEGIN(name) TRACE_BEGIN_IF(name, true)
+#define TRACE_END(name) do {               \
+    if (trace__on_##name) {                \
+      trace__end(#name);                   \
+    }                                      \
+  } while (0)
+
+#else
+
+#define TRACE_BEGIN_IF(name, condition) ((void) 0)
+#define TRACE_BEGIN(name) ((void) 0)
+#define TRACE_END(name) ((void) 0)
+
+#endif
+
+#ifdef CHIBI_TRACE
+
+#ifdef __cplusplus
+#define TRACE__THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define TRACE__THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE__THREAD_LOCAL _Thread_local
+#endif
+
+#ifdef _WIN32
+static SRWLOCK trace__lock = SRWLOCK_INIT;
+#define trace__lock_acquire() AcquireSRWLockExclusive(&trace__lock)
+#define trace__lock_release() ReleaseSRWLockExclusive(&trace__lock)
+#else
+static pthread_mutex_t trace__lock = PTHREAD_MUTEX_INITIALIZER;
+#define trace__lock_acquire() pthread_mutex_lock(&trace__lock)
+#define trace__lock_release() pthread_mutex_unlock(&trace__lock)
+#endif
+
+// The indices of the ring are shared between its thread and trace_export
+#if defined(_MSC_VER) && !defined(__clang__)
+// volatile accesses have acquire/release semantics with MSVC (/volatile:ms, the default on x86 and x64)
+#define trace__load_acquire(p) (*(volatile const uint64_t *)(p))
+#define trace__store_release(p, v) (*(volatile uint64_t *)(p) = (v))
+#else
+#define trace__load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define trace__store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+typedef struct trace__event_t {
+  const char *name;
+  prof_ticks_t ticks;
+  char phase;  // 'B' or 'E'
+} trace__event_t;
+
+// Ring buffer of one thread
+typedef struct trace__ring_t {
+  trace__event_t events[TRACE_RING_SIZE];
+  uint64_t head;             // next event to write, written by the thread
+  uint64_t tail;             // next event to read, written by trace_export
+  uint64_t open;             // regions begun and not yet ended, read only by the thread
+  uint64_t dropped;
+  int tid;
+  struct trace__ring_t *next;
+} trace__ring_t;
+
+static trace__ring_t *trace__rings = NULL;
+static int trace__nrings = 0;
+static prof_ticks_t trace__origin = 0;
+static TRACE__THREAD_LOCAL trace__ring_t *trace__self = NULL;
+
+// Returns the ring of the calling thread, registering it on first use
+static inline trace__ring_t *trace__ring(void) {
+  trace__ring_t *self = trace__self;
+  if (self == NULL) {
+    self = (trace__ring_t *) calloc(1, sizeof(trace__ring_t));
+    if (self == NULL) {
+      return NULL;
+    }
+    trace__lock_acquire();
+    if (trace__rings == NULL) {
+      trace__origin = prof_ticks();
+    }
+    self->tid = ++trace__nrings;
+    self->next = trace__rings;
+    trace__rings = self;
+    trace__lock_release();
+    trace__self = self;
+  }
+  return self;
+}
+
+static inline bool trace__begin(const char *name) {
+  trace__ring_t *ring = trace__ring();
+  if (ring == NULL) {
+    return false;
+  }
+  uint64_t head = ring->head;
+  uint64_t used = head - trace__load_acquire(&ring->tail);
+  // room for this event, its end and the ends of the open regions
+  if (TRACE_RING_SIZE - used < ring->open + 2) {
+    trace__store_release(&ring->dropped, ring->dropped + 1);
+    return false;
+  }
+  trace__event_t *event = &ring->events[head & (TRACE_RING_SIZE - 1)];
+  event->name = name;
+  event->phase = 'B';
+  event->ticks = prof_ticks();
+  ring->open++;
+  trace__store_release(&ring->head, head + 1);
+  return true;
+}
+
+static inline void trace__end(const char *name) {
+  prof_ticks_t ticks = prof_ticks_end();
+  trace__ring_t *ring = trace__self;
+  uint64_t head = ring->head;
+  trace__event_t *event = &ring->events[head & (TRACE_RING_SIZE - 1)];
+  event->name = name;
+  event->phase = 'E';
+  event->ticks = ticks;
+  ring->open--;
+  trace__store_release(&ring->head, head + 1);
+}
+
+static inline size_t trace_export(FILE *out) {
+  double us_per_tick = 1e6 / prof_ticks_per_second();
+  size_t written = 0;
+  trace__lock_acquire();
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for (trace__ring_t *ring = trace__rings; ring != NULL; ring = ring->next) {
+    uint64_t tail = ring->tail;
+    uint64_t head = trace__load_acquire(&ring->head);
+    // the ring starts at depth 0 and ends after the last region that is closed at every depth
+    uint64_t stop = tail;
+    uint64_t depth = 0;
+    for (uint64_t i = tail; i != head; ++i) {
+      depth = (ring->events[i & (TRACE_RING_SIZE - 1)].phase == 'B') ? depth + 1 : depth - 1;
+      if (depth == 0) {
+        stop = i + 1;
+      }
+    }
+    for (; tail != stop; ++tail) {
+      const trace__event_t *event = &ring->events[tail & (TRACE_RING_SIZE - 1)];
+      // events taken before the origin was set (on another thread) are clamped to it
+      double ts = (event->ticks > trace__origin) ? (double)(event->ticks - trace__origin) * us_per_tick : 0.0;
+      fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+              (written > 0) ? "," : "", event->name, event->phase, ts, ring->tid);
+      ++written;
+    }
+    trace__store_release(&ring->tail, tail);
+  }
+  fprintf(out, "\n]}\n");
+  trace__lock_release();
+  return written;
+}
+
+static inline uint64_t trace_dropped(void) {
+  uint64_t dropped = 0;
+  trace__lock_acquire();
+  for (trace__ring_t *ring = trace__rings; ring != NULL; ring = ring->next) {
+    // read while the thread may be writing it: the count can be slightly behind
+    dropped += trace__load_acquire(&ring->dropped);
+  }
+  trace__lock_release();
+  return dropped;
+}
+
+#else
+
+static inline size_t trace_export(FILE *out) {
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[]}\n");
+  return 0;
+}
+
+static inline uint64_t trace_dropped(void) {
+  return 0;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
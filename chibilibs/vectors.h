@@ -15,6 +15,7 @@
  * struct {
  *     size_t capacity;
  *     size_t size;
+ *     const chibi_allocator_t *allocator;
  * }
  *
  * The approach of storing metadata before the data array has two key advantages:
@@ -26,7 +27,17 @@
  * 2. It allows the user to access and modify the vector elements using the same syntax as
  *    regular arrays, e.g. "vec[i]".
  *
+ * Memory comes from the allocator given to v_init_with (allocator.h), for example an arena
+ * (arena.h), or from the heap for vectors created implicitly by v_push_back or v_insert.
+ *
+ * When CHIBI_PROFILE is defined, the reallocations, v_shrink_to_fit, v_insert and v_remove are timed
+ * with prof.h and the calls of v_push_back are counted (entries v_double_capacity, v_shrink_to_fit,
+ * v_insert, v_remove and v_push_back of prof_report). When CHIBI_TRACE is defined, every reallocation
+ * is also recorded as a trace event (trace.h). With CHIBI_PROFILE_HIST the report also shows the p50,
+ * p99 and p99.9 latency of the timed operations (hist.h).
+ *
  * Public Macros (to be used by the user):
+ * - v_init_with: allocates an empty vector whose memory comes from a given allocator.
  * - v_free: frees the vector.
  * - v_capacity: returns the capacity of the vector, which is the maximum number of elements
  *   the vector can hold without needing to reallocate memory.
@@ -42,7 +53,8 @@
  * - v_shrink_to_fit: shrinks the vector's capacity to fit its current size.
  *
  * Private Macros (should not be used directly by the user, unless they really want to):
- * - v__alloc: performs the initial allocation.
+ * - v__alloc: performs the initial allocation from the heap.
+ * - v__alloc_with: performs the initial allocation from a given allocator.
  * - v__double_capacity: reallocates memory, doubling the vector's capacity.
  * - v__get_metadata: returns a pointer to the vector's metadata.
  */
@@ -51,6 +63,9 @@
 #define CHIBI_VECTORS_H
 
 #include <stdlib.h>
+#include "allocator.h"
+#include "prof.h"
+#include "trace.h"
 
 #define V_START_CAPACITY 8
 
@@ -63,12 +78,20 @@
 /* This struct holds vector metadata:
  * capacity: maximum number of elements the vector can hold without needing to reallocate memory
  * size: number of elements currently held by the vector
+ * allocator: where the memory comes from (NULL for the heap)
+ * The padding keeps the size of the metadata a multiple of 16, so that the elements keep the
+ * alignment of the allocation.
 */
 typedef struct v__metadata_t {
     size_t capacity;
     size_t size;
+    const chibi_allocator_t *allocator;
+    size_t padding;
 } v__metadata_t;
 
+// Size in bytes of the allocation of a vector with the given capacity
+#define v__bytes(vec, capacity) (sizeof(v__metadata_t) + sizeof(*(vec)) * (capacity))
+
 /* Returns a pointer to the vector's metadata. The pointer is of type (v_info *).
  * (Should not be used directly by the user)
 */
@@ -77,23 +100,41 @@ typedef struct v__metadata_t {
 /* Performs the initial allocation, allocating enough space for the vector's metadata (v_info)
  * and for V_START_CAPACITY (8) elements of the desired type. This function does not infer the
  * data type; it simply uses the size of the type to allocate the correct amount of memory.
- * In case of malloc failure, the vector is left unchanged
+ * The allocator is stored in the metadata and used for all the following reallocations.
+ * In case of allocation failure, the vector is left unchanged
  * (Should not be used directly by the user)
 */
-#define v__alloc(vec) do {                                                                                          \
+#define v__alloc_with(vec, alloc) do {                                                                              \
     if ((vec) == NULL) {                                                                                            \
-      v__metadata_t *metadata = (v__metadata_t *) malloc(sizeof(v__metadata_t) + sizeof(*(vec)) * V_START_CAPACITY);\
+      const chibi_allocator_t *allocator__ = (alloc);                                                               \
+      v__metadata_t *metadata = (v__metadata_t *) chibi_alloc(allocator__, v__bytes(vec, V_START_CAPACITY),         \
+                                                              CHIBI_DEFAULT_ALIGN);                                 \
       if (metadata != NULL) {                                                                                       \
         metadata->capacity = V_START_CAPACITY;                                                                      \
         metadata->size = 0;                                                                                         \
+        metadata->allocator = allocator__;                                                                          \
         (vec) = v__cast(vec, (metadata + 1));                                                                       \
       }                                                                                                             \
     }                                                                                                               \
   } while (0)                                                                                                       \
 
+#define v__alloc(vec) v__alloc_with(vec, NULL)
+
+/* Allocates an empty vector whose memory comes from 'allocator' (a const chibi_allocator_t *,
+ * NULL for the heap). The vector must be NULL. The allocator must outlive the vector.
+*/
+#define v_init_with(vec, allocator) v__alloc_with(vec, allocator)
+
 /* Frees the allocated memory and sets the vector pointer to NULL
 */
-#define v_free(vec) free(v__get_metadata(vec))
+#define v_free(vec) do {                                                                               \
+    if ((vec) != NULL) {                                                                               \
+      v__metadata_t *metadata = v__get_metadata(vec);                                                  \
+      chibi_release(metadata->allocator, (void *) metadata, v__bytes(vec, metadata->capacity));        \
+      (vec) = NULL;                                                                                    \
+    }                                                                                                  \
+  } while (0)                                                                                          \
+
 
 /* Returns the vector's capacity as a size_t
 */
@@ -109,12 +150,19 @@ typedef struct v__metadata_t {
  * (Should not be used directly by the user)
 */
 #define v__double_capacity(vec) do {                                                                    \
-    size_t new_capacity = sizeof(v__metadata_t) + sizeof(*(vec)) * v_capacity(vec) * 2;                 \
-    v__metadata_t *metadata = (v__metadata_t *) realloc( (void *) v__get_metadata(vec), new_capacity);  \
+    PROF_BEGIN(v_double_capacity);                                                                      \
+    TRACE_BEGIN(v_double_capacity);                                                                     \
+    v__metadata_t *old_metadata = v__get_metadata(vec);                                                 \
+    v__metadata_t *metadata = (v__metadata_t *) chibi_resize(old_metadata->allocator, (void *) old_metadata, \
+                                                             v__bytes(vec, old_metadata->capacity),     \
+                                                             v__bytes(vec, old_metadata->capacity * 2), \
+                                                             CHIBI_DEFAULT_ALIGN);                      \
     if (metadata != NULL) {                                                                             \
       metadata->capacity *= 2;                                                                          \
       (vec) = v__cast(vec, (metadata + 1));                                                             \
     }                                                                                                   \
+    TRACE_END(v_double_capacity);                                                                       \
+    PROF_END(v_double_capacity);                                                                        \
   } while (0)                                                                                           \
 
 /* Adds an element to the back of the vector. If the vector is not allocated (vec == NULL),
@@ -123,6 +171,7 @@ typedef struct v__metadata_t {
  * not be added.
 */
 #define v_push_back(vec, val) do {                \
+  PROF_COUNT(v_push_back, 1);                     \
   v__alloc(vec);                                  \
   if (v_capacity(vec) - v_size(vec) == 0) {       \
     v__double_capacity(vec);                      \
@@ -143,12 +192,17 @@ typedef struct v__metadata_t {
  * Does not check whether vec is NULL.
 */
 #define v_shrink_to_fit(vec) do {                                                                               \
-    size_t shrink_capacity = sizeof(v__metadata_t) + v_size(vec) * sizeof(*(vec));                              \
-    v__metadata_t *metadata = (v__metadata_t *) realloc((void *) v__get_metadata(vec), shrink_capacity);        \
+    PROF_BEGIN(v_shrink_to_fit);                                                                                \
+    v__metadata_t *old_metadata = v__get_metadata(vec);                                                         \
+    v__metadata_t *metadata = (v__metadata_t *) chibi_resize(old_metadata->allocator, (void *) old_metadata,    \
+                                                             v__bytes(vec, old_metadata->capacity),             \
+                                                             v__bytes(vec, old_metadata->size),                 \
+                                                             CHIBI_DEFAULT_ALIGN);                              \
     if (metadata != NULL) {                                                                                     \
         metadata->capacity = metadata->size;                                                                    \
         (vec) = v__cast(vec, (metadata + 1));                                                                   \
     }                                                                                                           \
+    PROF_END(v_shrink_to_fit);                                                                                  \
   } while (0)                                                                                                   \
 
 /* Inserts an element at a specified index.
@@ -158,6 +212,7 @@ typedef struct v__metadata_t {
  * Does not check whether vec is NULL or whether the index is in range.
 */
 #define v_insert(vec, i, val) do {                             \
+    PROF_BEGIN(v_insert);                                      \
     v__alloc(vec);                                             \
     if (v_capacity(vec) - v_size(vec) == 0) {                  \
       v__double_capacity(vec);                                 \
@@ -167,16 +222,19 @@ typedef struct v__metadata_t {
     }                                                          \
     (vec)[i] = (val);                                          \
     v__get_metadata(vec)->size++;                              \
+    PROF_END(v_insert);                                        \
   } while (0)                                                  \
 
 /* Removes an element from a specified index.
  * Does not check whether vec is NULL or whether the index is in range.
 */
 #define v_remove(vec, i) do {                              \
+    PROF_BEGIN(v_remove);                                  \
     for(size_t j = i + 1; j < v_size(vec); j++) {          \
       (vec)[j - 1] = (vec)[j];                             \
     }                                                      \
     v__get_metadata(vec)->size--;                          \
+    PROF_END(v_remove);                                    \
   } while (0)                                              \
 
 /* Removes the first element of the vector.
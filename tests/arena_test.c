@@ -0,0 +1,158 @@
+/* arena_test.c - Tests of arena.h and of the allocator interface of allocator.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Every allocation of the arena is filled with a pattern and checked later, so that overlapping
+ * allocations are detected. The containers (vectors.h, hash.h, sorting.h) are then run on an
+ * arena and compared with the same operations on the heap.
+ */
+
+#include "arena.h"
+#include "vectors.h"
+#include "hash.h"
+#include "sorting.h"
+#include "test.h"
+
+static void test_alloc(void) {
+  arena_t arena;
+  arena_init(&arena, 1024);
+  enum { N = 2000 };
+  unsigned char *blocks[N];
+  size_t sizes[N];
+  uint64_t state = 47;
+  for (size_t i = 0; i < N; ++i) {
+    sizes[i] = (size_t)(test_rand(&state) % 3000);
+    size_t align = (size_t) 1 << (test_rand(&state) % 8);
+    blocks[i] = (unsigned char *) arena_alloc(&arena, sizes[i], align);
+    TEST_CHECK(blocks[i] != NULL);
+    TEST_CHECK(((uintptr_t) blocks[i] & (align - 1)) == 0);
+    memset(blocks[i], (int)(i & 0xFF), sizes[i]);
+  }
+  bool ok = true;
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t b = 0; b < sizes[i]; ++b) {
+      ok = ok && blocks[i][b] == (unsigned char)(i & 0xFF);
+    }
+  }
+  TEST_CHECK(ok);
+  arena_free(&arena);
+}
+
+static void test_resize(void) {
+  arena_t arena;
+  arena_init(&arena, 4096);
+  char *a = (char *) arena_alloc(&arena, 100, 16);
+  memset(a, 'a', 100);
+  // the last allocation grows in place
+  char *grown = (char *) arena_resize(&arena, a, 100, 1000, 16);
+  TEST_CHECK(grown == a);
+  char *b = (char *) arena_alloc(&arena, 10, 16);
+  memset(b, 'b', 10);
+  // any other allocation is copied
+  char *moved = (char *) arena_resize(&arena, a, 1000, 2000, 16);
+  TEST_CHECK(moved != a);
+  bool ok = true;
+  for (size_t i = 0; i < 100; ++i) {
+    ok = ok && moved[i] == 'a';
+  }
+  for (size_t i = 0; i < 10; ++i) {
+    ok = ok && b[i] == 'b';
+  }
+  TEST_CHECK(ok);
+  arena_free(&arena);
+}
+
+static void test_marks(void) {
+  arena_t arena;
+  arena_init(&arena, 256);
+  void *first = arena_alloc(&arena, 64, 8);
+  arena_mark_t mark = arena_save(&arena);
+  void *second = arena_alloc(&arena, 64, 8);
+  for (int i = 0; i < 100; ++i) {
+    TEST_CHECK(arena_alloc(&arena, 200, 8) != NULL);
+  }
+  arena_restore(&arena, mark);
+  // the space after the mark is given again
+  TEST_CHECK(arena_alloc(&arena, 64, 8) == second);
+  arena_reset(&arena);
+  TEST_CHECK(arena_alloc(&arena, 64, 8) == first);
+  arena_free(&arena);
+}
+
+static bool less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+// Runs the same operations on containers of the heap and of the arena and compares them
+static void test_containers(void) {
+  arena_t arena;
+  arena_init(&arena, 0);
+  const chibi_allocator_t *allocator = arena_allocator(&arena);
+  for (int request = 0; request < 5; ++request) {
+    uint64_t *heap_vec = NULL;
+    uint64_t *arena_vec = NULL;
+    v_init_with(heap_vec, NULL);
+    v_init_with(arena_vec, allocator);
+    uint32_t *heap_map = NULL;
+    uint32_t *arena_map = NULL;
+    hash_init_with(heap_map, NULL);
+    hash_init_with(arena_map, allocator);
+    uint64_t state = 53 + (uint64_t) request;
+    for (uint32_t i = 0; i < 5000; ++i) {
+      uint64_t key = test_rand(&state) % 10000;
+      v_push_back(heap_vec, key);
+      v_push_back(arena_vec, key);
+      hash_put(heap_map, key, i);
+      hash_put(arena_map, key, i);
+    }
+    TEST_CHECK_EQ(v_size(heap_vec), v_size(arena_vec));
+    TEST_CHECK(memcmp(heap_vec, arena_vec, v_size(heap_vec) * sizeof(uint64_t)) == 0);
+    TEST_CHECK_EQ(hash_size(heap_map), hash_size(arena_map));
+
+    s_set_allocator(allocator);
+    TEST_CHECK_EQ(s_merge(arena_vec, v_size(arena_vec), sizeof(uint64_t), less_u64), 5000);
+    s_set_allocator(NULL);
+    TEST_CHECK_EQ(s_merge(heap_vec, v_size(heap_vec), sizeof(uint64_t), less_u64), 5000);
+    TEST_CHECK(memcmp(heap_vec, arena_vec, v_size(heap_vec) * sizeof(uint64_t)) == 0);
+
+    v_free(heap_vec);
+    hash_free(heap_map);
+    // everything of the request goes at once
+    arena_reset(&arena);
+  }
+  arena_free(&arena);
+}
+
+int main(void) {
+  TEST_RUN(test_alloc);
+  TEST_RUN(test_resize);
+  TEST_RUN(test_marks);
+  TEST_RUN(test_containers);
+  return TEST_END("arena_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,282 @@
+/* art_test.c - Tests of art.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Checks that random puts and deletes over a pool of byte strings, with long shared prefixes and
+ * keys that are prefixes of other keys, leave lookups, the ordered iteration and prefix queries
+ * matching the live keys sorted by memcmp, on the heap and on an arena; that art_free gives back
+ * every block taken from a counting allocator; and that big-endian integer keys iterate in
+ * numerical order and delete once.
+ */
+
+#include "art.h"
+#include "test.h"
+
+enum { POOL = 3000, MAX_LEN = 40 };
+
+typedef struct pool_key_t {
+  uint8_t bytes[MAX_LEN];
+  size_t len;
+} pool_key_t;
+
+static int key_cmp(const void *lhs, const void *rhs) {
+  const pool_key_t *a = (const pool_key_t *) lhs;
+  const pool_key_t *b = (const pool_key_t *) rhs;
+  int c = memcmp(a->bytes, b->bytes, (a->len < b->len) ? a->len : b->len);
+  return (c != 0) ? c : (a->len > b->len) - (a->len < b->len);
+}
+
+// Fills the pool with distinct keys, sorted
+static void make_pool(pool_key_t *pool) {
+  uint64_t state = 89;
+  size_t n = 0;
+  while (n < POOL) {
+    pool_key_t key;
+    uint64_t shape = test_rand(&state) % 4;
+    if (shape == 0 && n > 0) {
+      // a prefix of a key already in the pool
+      key = pool[test_rand(&state) % n];
+      key.len = (size_t)(test_rand(&state) % (key.len + 1));
+    } else {
+      // a long common head (longer than ART_MAX_PREFIX) then bytes of a small alphabet
+      key.len = (size_t)(test_rand(&state) % MAX_LEN);
+      size_t head = (shape == 1) ? ART_MAX_PREFIX + 6 : 0;
+      for (size_t i = 0; i < key.len; ++i) {
+        key.bytes[i] = (i < head) ? (uint8_t) 'h' : (uint8_t)("abc\0\xff"[test_rand(&state) % 5]);
+      }
+    }
+    bool duplicate = false;
+    for (size_t i = 0; i < n && !duplicate; ++i) {
+      duplicate = key_cmp(&pool[i], &key) == 0;
+    }
+    if (!duplicate) {
+      pool[n++] = key;
+    }
+  }
+  qsort(pool, POOL, sizeof(pool_key_t), key_cmp);
+}
+
+typedef struct visit_t {
+  const pool_key_t *pool;
+  const bool *present;
+  const uint64_t *values;
+  size_t next;  // index in the pool of the next expected key
+  size_t stop;  // index in the pool after the last expected key
+  bool ok;
+} visit_t;
+
+static bool visit_key(void *ctx, const uint8_t *key, size_t len, void *value) {
+  visit_t *v = (visit_t *) ctx;
+  while (v->next < v->stop && !v->present[v->next]) {
+    ++v->next;
+  }
+  if (v->next >= v->stop) {
+    v->ok = false;
+    return false;
+  }
+  const pool_key_t *expected = &v->pool[v->next++];
+  v->ok = v->ok && expected->len == len && memcmp(expected->bytes, key, len) == 0 &&
+          *(const uint64_t *) value == v->values[expected - v->pool];
+  return true;
+}
+
+static void check_queries(const art_t *art, const pool_key_t *pool, const bool *present, const uint64_t *values,
+                          uint64_t *state) {
+  size_t count = 0;
+  for (size_t i = 0; i < POOL; ++i) {
+    const uint64_t *value = (const uint64_t *) art_get(art, pool[i].bytes, pool[i].len);
+    TEST_CHECK((value != NULL) == present[i]);
+    TEST_CHECK(value == NULL || *value == values[i]);
+    count += present[i];
+  }
+  TEST_CHECK_EQ(art_size(art), count);
+
+  visit_t all = {pool, present, values, 0, POOL, true};
+  TEST_CHECK_EQ(art_iterate(art, visit_key, &all), count);
+  TEST_CHECK(all.ok);
+
+  for (int q = 0; q < 50; ++q) {
+    // a prefix of a pool key: the keys with that prefix are a contiguous range of the sorted pool
+    const pool_key_t *base = &pool[test_rand(state) % POOL];
+    size_t len = (size_t)(test_rand(state) % (base->len + 1));
+    pool_key_t prefix = *base;
+    prefix.len = len;
+    size_t first = 0;
+    while (first < POOL && key_cmp(&pool[first], &prefix) < 0) {
+      ++first;
+    }
+    size_t last = first;
+    size_t expected = 0;
+    while (last < POOL && pool[last].len >= len && memcmp(pool[last].bytes, prefix.bytes, len) == 0) {
+      expected += present[last];
+      ++last;
+    }
+    visit_t range = {pool, present, values, first, last, true};
+    TEST_CHECK_EQ(art_prefix(art, prefix.bytes, len, visit_key, &range), expected);
+    TEST_CHECK(range.ok);
+  }
+}
+
+static void check_art(const chibi_allocator_t *allocator) {
+  pool_key_t *pool = (pool_key_t *) malloc(POOL * sizeof(pool_key_t));
+  bool *present = (bool *) calloc(POOL, sizeof(bool));
+  uint64_t *values = (uint64_t *) calloc(POOL, sizeof(uint64_t));
+  make_pool(pool);
+  art_t *art = art_new_with(sizeof(uint64_t), allocator);
+  TEST_CHECK(art != NULL);
+  uint64_t state = 97;
+  size_t count = 0;
+  for (int round = 0; round < 16; ++round) {
+    // alternate growing and shrinking phases, so that nodes grow and shrink between layouts
+    int put_percent = (round % 4 < 2) ? 75 : 25;
+    for (int op = 0; op < 3000; ++op) {
+      size_t i = (size_t)(test_rand(&state) % POOL);
+      if ((int)(test_rand(&state) % 100) < put_percent) {
+        uint64_t value = test_rand(&state);
+        count += !present[i];
+        present[i] = true;
+        values[i] = value;
+        TEST_CHECK_EQ(art_put(art, pool[i].bytes, pool[i].len, &value), count);
+      } else {
+        TEST_CHECK(art_del(art, pool[i].bytes, pool[i].len) == present[i]);
+        count -= present[i];
+        present[i] = false;
+      }
+    }
+    check_queries(art, pool, present, values, &state);
+  }
+  art_free(art);
+  free(pool);
+  free(present);
+  free(values);
+}
+
+typedef struct u64_order_t {
+  uint64_t last;
+  size_t visited;
+  bool ok;
+} u64_order_t;
+
+static bool visit_u64(void *ctx, const uint8_t *key, size_t len, void *value) {
+  u64_order_t *order = (u64_order_t *) ctx;
+  uint64_t k = 0;
+  for (size_t i = 0; i < len; ++i) {
+    k = (k << 8) | key[i];
+  }
+  (void) value;
+  order->ok = order->ok && len == 8 && (order->visited == 0 || k > order->last);
+  order->last = k;
+  ++order->visited;
+  return true;
+}
+
+static void test_u64(void) {
+  art_t *art = art_new_typed(uint32_t);
+  uint64_t state = 101;
+  uint64_t keys[2000];
+  for (uint32_t i = 0; i < 2000; ++i) {
+    keys[i] = (i % 2) ? test_rand(&state) : i;
+    TEST_CHECK_EQ(art_put_u64(art, keys[i], &i), i + 1);
+  }
+  for (uint32_t i = 0; i < 2000; ++i) {
+    TEST_CHECK(*(uint32_t *) art_get_u64(art, keys[i]) == i);
+  }
+  // big-endian keys iterate in numerical order
+  u64_order_t order = {0, 0, true};
+  TEST_CHECK_EQ(art_iterate(art, visit_u64, &order), 2000);
+  TEST_CHECK(order.ok);
+  for (uint32_t i = 0; i < 2000; i += 2) {
+    TEST_CHECK(art_del_u64(art, keys[i]));
+    TEST_CHECK(!art_del_u64(art, keys[i]));
+  }
+  TEST_CHECK_EQ(art_size(art), 1000);
+  art_free(art);
+}
+
+static void test_heap(void) {
+  check_art(NULL);
+}
+
+static void test_arena(void) {
+  arena_t arena;
+  arena_init(&arena, 0);
+  check_art(arena_allocator(&arena));
+  arena_free(&arena);
+}
+
+// Allocator that counts the live blocks and their bytes
+typedef struct counting_t {
+  chibi_allocator_t base;
+  long long blocks;
+  long long bytes;
+} counting_t;
+
+static void *counting_alloc(void *ctx, size_t bytes, size_t align) {
+  counting_t *c = (counting_t *) ctx;
+  ++c->blocks;
+  c->bytes += (long long) bytes;
+  return chibi_alloc(NULL, bytes, align);
+}
+
+static void *counting_resize(void *ctx, void *ptr, size_t old_bytes, size_t bytes, size_t align) {
+  counting_t *c = (counting_t *) ctx;
+  c->bytes += (long long) bytes - (long long) old_bytes;
+  return chibi_resize(NULL, ptr, old_bytes, bytes, align);
+}
+
+static void counting_release(void *ctx, void *ptr, size_t bytes) {
+  counting_t *c = (counting_t *) ctx;
+  if (ptr != NULL) {
+    --c->blocks;
+    c->bytes -= (long long) bytes;
+  }
+  chibi_release(NULL, ptr, bytes);
+}
+
+static void test_allocator(void) {
+  counting_t c;
+  c.base.alloc = counting_alloc;
+  c.base.resize = counting_resize;
+  c.base.release = counting_release;
+  c.base.ctx = &c;
+  c.blocks = 0;
+  c.bytes = 0;
+  check_art(&c.base);
+  // every leaf, node and the tree went back with their sizes
+  TEST_CHECK_EQ(c.blocks, 0);
+  TEST_CHECK_EQ(c.bytes, 0);
+}
+
+int main(void) {
+  TEST_RUN(test_heap);
+  TEST_RUN(test_arena);
+  TEST_RUN(test_allocator);
+  TEST_RUN(test_u64);
+  return TEST_END("art_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
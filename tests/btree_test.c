@@ -0,0 +1,314 @@
+/* btree_test.c - Tests of btree.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Checks that random puts and deletes over a small key range leave lookups, ordered iteration and
+ * seeks matching a plain array of the live keys; that bulk loads with repeated keys keep the last
+ * value of each and iterate like a qsort of the pairs; that the node search agrees with a scalar
+ * count on keys that differ only in the high or sign bits of either 32-bit half; and that a load
+ * whose allocator fails partway leaks nothing.
+ */
+
+#include "btree.h"
+#include "arena.h"
+#include "test.h"
+
+// Key range of the model: small, so that puts hit existing keys and deletes hit present ones
+#define RANGE 5000
+
+static void check_tree(const btree_t *tree, const bool *present, const uint64_t *values) {
+  size_t count = 0;
+  for (uint64_t k = 0; k < RANGE; ++k) {
+    const uint64_t *value = (const uint64_t *) btree_get(tree, k);
+    TEST_CHECK((value != NULL) == present[k]);
+    TEST_CHECK(value == NULL || *value == values[k]);
+    count += present[k];
+  }
+  TEST_CHECK_EQ(btree_size(tree), count);
+
+  // full iteration in key order
+  btree_iter_t it = btree_begin(tree);
+  uint64_t key;
+  void *value;
+  uint64_t expected = 0;
+  size_t visited = 0;
+  while (btree_next(&it, &key, &value)) {
+    while (expected < RANGE && !present[expected]) {
+      ++expected;
+    }
+    TEST_CHECK_EQ(key, expected);
+    TEST_CHECK_EQ(*(uint64_t *) value, values[key]);
+    ++expected;
+    ++visited;
+  }
+  TEST_CHECK_EQ(visited, count);
+}
+
+static void check_seeks(const btree_t *tree, const bool *present, uint64_t *state) {
+  for (int q = 0; q < 200; ++q) {
+    uint64_t lo = test_rand(state) % (RANGE + 10);
+    uint64_t hi = lo + test_rand(state) % 100;
+    btree_iter_t it = btree_seek(tree, lo);
+    uint64_t expected = lo;
+    uint64_t key;
+    while (btree_next(&it, &key, NULL) && key < hi) {
+      while (expected < RANGE && !present[expected]) {
+        ++expected;
+      }
+      TEST_CHECK_EQ(key, expected);
+      ++expected;
+    }
+    while (expected < hi && expected < RANGE && !present[expected]) {
+      ++expected;
+    }
+    TEST_CHECK(expected >= hi || expected >= RANGE);
+  }
+}
+
+static void check_random_ops(const chibi_allocator_t *allocator) {
+  bool *present = (bool *) calloc(RANGE, sizeof(bool));
+  uint64_t *values = (uint64_t *) calloc(RANGE, sizeof(uint64_t));
+  btree_t *tree = btree_new_with(sizeof(uint64_t), allocator);
+  TEST_CHECK(tree != NULL);
+  uint64_t state = 71;
+  size_t count = 0;
+  for (int round = 0; round < 20; ++round) {
+    // alternate growing and shrinking phases, so that nodes split and merge
+    int put_percent = (round % 4 < 2) ? 75 : 25;
+    for (int op = 0; op < 4000; ++op) {
+      uint64_t key = test_rand(&state) % RANGE;
+      if ((int)(test_rand(&state) % 100) < put_percent) {
+        uint64_t value = test_rand(&state);
+        count += !present[key];
+        present[key] = true;
+        values[key] = value;
+        TEST_CHECK_EQ(btree_put(tree, key, &value), count);
+      } else {
+        TEST_CHECK(btree_del(tree, key) == present[key]);
+        count -= present[key];
+        present[key] = false;
+      }
+    }
+    check_tree(tree, present, values);
+    check_seeks(tree, present, &state);
+  }
+  // empty the tree completely
+  for (uint64_t k = 0; k < RANGE; ++k) {
+    TEST_CHECK(btree_del(tree, k) == present[k]);
+    present[k] = false;
+  }
+  check_tree(tree, present, values);
+  btree_free(tree);
+  free(present);
+  free(values);
+}
+
+typedef struct pair_t {
+  uint64_t key;
+  uint64_t value;
+  size_t index;
+} pair_t;
+
+static int pair_cmp(const void *lhs, const void *rhs) {
+  const pair_t *a = (const pair_t *) lhs;
+  const pair_t *b = (const pair_t *) rhs;
+  if (a->key != b->key) {
+    return (a->key > b->key) - (a->key < b->key);
+  }
+  return (a->index > b->index) - (a->index < b->index);
+}
+
+static void check_load(const chibi_allocator_t *allocator) {
+  static const size_t dims[] = {1, 2, BTREE_KEYS, BTREE_KEYS + 1, 1000, 100000};
+  uint64_t state = 73;
+  for (size_t d = 0; d < sizeof(dims) / sizeof(dims[0]); ++d) {
+    size_t n = dims[d];
+    for (int sorted = 0; sorted < 2; ++sorted) {
+      uint64_t *keys = (uint64_t *) malloc(n * sizeof(uint64_t));
+      uint64_t *vals = (uint64_t *) malloc(n * sizeof(uint64_t));
+      pair_t *pairs = (pair_t *) malloc(n * sizeof(pair_t));
+      for (size_t i = 0; i < n; ++i) {
+        // about one key in three repeats
+        keys[i] = sorted ? i / 3 * 7 : test_rand(&state) % (n - n / 3 + 1) * 0x9E3779B97F4A7C15ULL;
+        vals[i] = test_rand(&state);
+        pairs[i].key = keys[i];
+        pairs[i].value = vals[i];
+        pairs[i].index = i;
+      }
+      qsort(pairs, n, sizeof(pair_t), pair_cmp);
+
+      btree_t *tree = btree_load_with(sizeof(uint64_t), keys, vals, n, allocator);
+      TEST_CHECK(tree != NULL);
+      btree_iter_t it = btree_begin(tree);
+      uint64_t key = 0;
+      void *value = NULL;
+      size_t unique = 0;
+      for (size_t i = 0; i < n; ++i) {
+        // the last value of a key wins
+        if (i + 1 < n && pairs[i + 1].key == pairs[i].key) {
+          continue;
+        }
+        TEST_CHECK(btree_next(&it, &key, &value));
+        TEST_CHECK(key == pairs[i].key);
+        TEST_CHECK(*(uint64_t *) value == pairs[i].value);
+        TEST_CHECK(*(uint64_t *) btree_get(tree, pairs[i].key) == pairs[i].value);
+        ++unique;
+      }
+      TEST_CHECK(!btree_next(&it, &key, &value));
+      TEST_CHECK_EQ(btree_size(tree), unique);
+
+      // the loaded tree stays updatable
+      uint64_t extra = 1;
+      size_t added = btree_get(tree, 1) == NULL;
+      TEST_CHECK_EQ(btree_put(tree, 1, &extra), unique + added);
+      TEST_CHECK(btree_del(tree, 1));
+      TEST_CHECK_EQ(btree_size(tree), unique + added - 1);
+      btree_free(tree);
+      free(keys);
+      free(vals);
+      free(pairs);
+    }
+  }
+}
+
+// The node search compares 64-bit keys as unsigned, whichever SIMD path it was built with
+static void test_count_less(void) {
+  static const uint64_t edges[] = {0,
+                                   1,
+                                   0x7FFFFFFFULL,
+                                   0x80000000ULL,
+                                   0xFFFFFFFFULL,
+                                   0x100000000ULL,
+                                   0x7FFFFFFF00000000ULL,
+                                   0x7FFFFFFFFFFFFFFFULL,
+                                   0x8000000000000000ULL,
+                                   0x80000000FFFFFFFFULL,
+                                   0xFFFFFFFF00000000ULL,
+                                   UINT64_MAX};
+  enum { EDGES = sizeof(edges) / sizeof(edges[0]) };
+  uint64_t state = 83;
+  for (int round = 0; round < 2000; ++round) {
+    uint64_t keys[BTREE_KEYS];
+    uint32_t nkeys = (uint32_t) (test_rand(&state) % (BTREE_KEYS + 1));
+    // a sorted run of edge values and random values
+    for (uint32_t i = 0; i < BTREE_KEYS; ++i) {
+      keys[i] = (test_rand(&state) & 1) ? edges[test_rand(&state) % EDGES] : test_rand(&state);
+    }
+    for (uint32_t i = 1; i < nkeys; ++i) {
+      for (uint32_t j = i; j > 0 && keys[j - 1] > keys[j]; --j) {
+        uint64_t tmp = keys[j];
+        keys[j] = keys[j - 1];
+        keys[j - 1] = tmp;
+      }
+    }
+    for (uint32_t e = 0; e < EDGES + nkeys; ++e) {
+      uint64_t key = (e < EDGES) ? edges[e] : keys[e - EDGES];
+      uint32_t expected = 0;
+      while (expected < nkeys && keys[expected] < key) {
+        ++expected;
+      }
+      TEST_CHECK_EQ(btree__count_less(keys, nkeys, key), expected);
+    }
+  }
+}
+
+static void test_heap(void) {
+  check_random_ops(NULL);
+  check_load(NULL);
+}
+
+static void test_arena(void) {
+  arena_t arena;
+  arena_init(&arena, 0);
+  check_random_ops(arena_allocator(&arena));
+  check_load(arena_allocator(&arena));
+  arena_free(&arena);
+}
+
+// Allocator that fails after 'budget' allocations, to exercise the failure paths of the load
+typedef struct failing_t {
+  chibi_allocator_t base;
+  int budget;
+  int live;
+} failing_t;
+
+static void *failing_alloc(void *ctx, size_t bytes, size_t align) {
+  failing_t *f = (failing_t *) ctx;
+  if (f->budget-- <= 0) {
+    return NULL;
+  }
+  ++f->live;
+  return chibi_alloc(NULL, bytes, align);
+}
+
+static void *failing_resize(void *ctx, void *ptr, size_t old_bytes, size_t new_bytes, size_t align) {
+  (void) ctx;
+  return chibi_resize(NULL, ptr, old_bytes, new_bytes, align);
+}
+
+static void failing_release(void *ctx, void *ptr, size_t bytes) {
+  failing_t *f = (failing_t *) ctx;
+  f->live -= ptr != NULL;
+  chibi_release(NULL, ptr, bytes);
+}
+
+static void test_load_failure(void) {
+  enum { N = 5000 };
+  uint64_t keys[N];
+  uint64_t vals[N];
+  for (int budget = 0; budget < 2000; budget += 7) {
+    uint64_t state = 79;
+    for (size_t i = 0; i < N; ++i) {
+      keys[i] = test_rand(&state);
+      vals[i] = keys[i] ^ 1;
+    }
+    failing_t f;
+    f.base.ctx = &f;
+    f.base.alloc = failing_alloc;
+    f.base.resize = failing_resize;
+    f.base.release = failing_release;
+    f.budget = budget;
+    f.live = 0;
+    btree_t *tree = btree_load_with(sizeof(uint64_t), keys, vals, N, &f.base);
+    if (tree != NULL) {
+      TEST_CHECK_EQ(btree_size(tree), N);
+      btree_free(tree);
+    }
+    // nothing leaks and nothing is released twice, whether the load succeeded or not
+    TEST_CHECK_EQ(f.live, 0);
+  }
+}
+
+int main(void) {
+  TEST_RUN(test_count_less);
+  TEST_RUN(test_heap);
+  TEST_RUN(test_arena);
+  TEST_RUN(test_load_failure);
+  return TEST_END("btree_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,207 @@
+/* cuckoo_test.c - Tests of cuckoo.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Checks that random puts, gets and deletes, on sets and on values of several sizes, on the heap
+ * and on an arena, keep every key in one of its two buckets under the right tag or in the stash,
+ * with the right value and count; that a table reaches a load above 90% before it doubles, uses
+ * its stash, and keeps that layout and the remaining keys when half of them are deleted; and
+ * that, for these seeds, inserts up to the size given to cuckoo_reserve do not resize the table.
+ */
+
+#include "cuckoo.h"
+#include "arena.h"
+#include "test.h"
+
+// The keys of the universe: 0, UINT64_MAX and multiples of an odd constant
+static uint64_t key_of(size_t k) {
+  return (k == 0) ? 0 : (k == 1) ? UINT64_MAX : (uint64_t) k * 0x9E3779B97F4A7C15ull;
+}
+
+static void fill_value(char *value, size_t val_size, size_t k, uint64_t version) {
+  for (size_t b = 0; b < val_size; ++b) {
+    value[b] = (char)(k * 31 + version * 7 + b);
+  }
+}
+
+// Checks that every key is where a lookup looks for it
+static bool check_layout(const cuckoo_t *cuckoo) {
+  size_t count = cuckoo->nstash;
+  for (size_t slot = 0; slot < cuckoo->nbuckets * CUCKOO_SLOTS; ++slot) {
+    if (cuckoo->tags[slot] == 0) {
+      continue;
+    }
+    uint64_t hash = cuckoo__hash(cuckoo->keys[slot]);
+    size_t bucket = slot / CUCKOO_SLOTS;
+    if (cuckoo->tags[slot] != cuckoo__tag(hash) ||
+        (bucket != cuckoo__bucket1(cuckoo, hash) && bucket != cuckoo__bucket2(cuckoo, hash))) {
+      return false;
+    }
+    ++count;
+  }
+  return count == cuckoo_size(cuckoo) && cuckoo->nstash <= CUCKOO_STASH;
+}
+
+static void check_random(size_t val_size, const chibi_allocator_t *allocator) {
+  enum { UNIVERSE = 20000, OPS = 200000 };
+  cuckoo_t *cuckoo = cuckoo_new_with(val_size, allocator);
+  TEST_CHECK(cuckoo != NULL);
+  uint64_t *versions = (uint64_t *) calloc(UNIVERSE, sizeof(uint64_t));  // 0 when absent
+  char value[64];
+  char expected[64];
+  uint64_t state = 11 + val_size;
+  size_t count = 0;
+  bool ok = true;
+  for (size_t op = 1; op <= OPS; ++op) {
+    size_t k = (size_t)(test_rand(&state) % UNIVERSE);
+    uint64_t key = key_of(k);
+    switch (test_rand(&state) % 4) {
+      case 0:
+      case 1:
+        fill_value(value, val_size, k, op);
+        count += versions[k] == 0;
+        versions[k] = op;
+        ok = ok && cuckoo_put(cuckoo, key, value) == (int64_t) count;
+        break;
+      case 2:
+        ok = ok && cuckoo_del(cuckoo, key) == (versions[k] != 0);
+        count -= versions[k] != 0;
+        versions[k] = 0;
+        break;
+      default: {
+        const char *found = (const char *) cuckoo_get(cuckoo, key);
+        ok = ok && (found != NULL) == (versions[k] != 0);
+        if (found != NULL && versions[k] != 0) {
+          fill_value(expected, val_size, k, versions[k]);
+          ok = ok && memcmp(found, expected, val_size) == 0;
+        }
+        break;
+      }
+    }
+    if (op % 20000 == 0) {
+      TEST_CHECK(check_layout(cuckoo));
+      for (size_t u = 0; u < UNIVERSE; ++u) {
+        ok = ok && (cuckoo_get(cuckoo, key_of(u)) != NULL) == (versions[u] != 0);
+      }
+    }
+  }
+  TEST_CHECK(ok);
+  TEST_CHECK_EQ(cuckoo_size(cuckoo), count);
+  cuckoo_free(cuckoo);
+  free(versions);
+}
+
+static void test_random(void) {
+  check_random(0, NULL);
+  check_random(sizeof(uint64_t), NULL);
+  check_random(24, NULL);
+}
+
+static void test_arena(void) {
+  arena_t arena;
+  arena_init(&arena, 0);
+  check_random(sizeof(uint64_t), arena_allocator(&arena));
+  arena_free(&arena);
+}
+
+// Fills the table up to the insert that makes it grow, then deletes half of the keys, which moves
+// the stashed keys back into the buckets
+static void test_high_load(void) {
+  cuckoo_t *cuckoo = cuckoo_new_typed(uint64_t);
+  TEST_CHECK(cuckoo != NULL);
+  uint64_t state = 17;
+  uint64_t *keys = (uint64_t *) malloc((1 << 20) * sizeof(uint64_t));
+  size_t n = 0;
+  size_t stashed = 0;
+  double load = 0.0;
+  for (int grows = 0; grows < 12; ) {
+    size_t nbuckets = cuckoo->nbuckets;
+    keys[n] = test_rand(&state);
+    TEST_CHECK_EQ(cuckoo_put(cuckoo, keys[n], &keys[n]), n + 1);
+    ++n;
+    stashed = (cuckoo->nstash > stashed) ? cuckoo->nstash : stashed;
+    if (cuckoo->nbuckets != nbuckets) {
+      // the load just before the insert that did not fit
+      load = (double)(n - 1) / (double)(nbuckets * CUCKOO_SLOTS);
+      TEST_CHECK(nbuckets < 64 || load > 0.9);
+      ++grows;
+    }
+  }
+  TEST_CHECK(stashed > 0);
+  TEST_CHECK(check_layout(cuckoo));
+  for (size_t i = 0; i < n; i += 2) {
+    TEST_CHECK(cuckoo_del(cuckoo, keys[i]));
+    TEST_CHECK(!cuckoo_del(cuckoo, keys[i]));
+  }
+  TEST_CHECK(check_layout(cuckoo));
+  bool ok = true;
+  for (size_t i = 0; i < n; ++i) {
+    const uint64_t *value = (const uint64_t *) cuckoo_get(cuckoo, keys[i]);
+    ok = ok && ((i % 2 == 0) ? value == NULL : value != NULL && *value == keys[i]);
+  }
+  TEST_CHECK(ok);
+  TEST_CHECK_EQ(cuckoo_size(cuckoo), n / 2);
+  cuckoo_free(cuckoo);
+  free(keys);
+}
+
+// Inserts within the reserved size do not resize the table: a resize is possible, but rare at the
+// reserved load, and does not happen with these seeds
+static void test_reserve(void) {
+  static const size_t counts[] = {1, 100, 5000, 100000};
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+    cuckoo_t *cuckoo = cuckoo_new(0);
+    TEST_CHECK(cuckoo != NULL);
+    TEST_CHECK(cuckoo_reserve(cuckoo, counts[c]));
+    size_t nbuckets = cuckoo->nbuckets;
+    TEST_CHECK(nbuckets * CUCKOO_SLOTS >= counts[c]);
+    uint64_t state = 23 + c;
+    for (size_t i = 0; i < counts[c]; ++i) {
+      // a set: the value is not read
+      uint64_t key = test_rand(&state);
+      TEST_CHECK(cuckoo_put(cuckoo, key, &key) > 0);
+    }
+    TEST_CHECK_EQ(cuckoo->nbuckets, nbuckets);
+    // reserving less than the current size keeps the table
+    TEST_CHECK(cuckoo_reserve(cuckoo, counts[c] / 2));
+    TEST_CHECK_EQ(cuckoo->nbuckets, nbuckets);
+    TEST_CHECK(check_layout(cuckoo));
+    cuckoo_free(cuckoo);
+  }
+  TEST_CHECK_EQ(cuckoo_size((cuckoo_t *) NULL), 0);
+  cuckoo_free(NULL);
+}
+
+int main(void) {
+  TEST_RUN(test_random);
+  TEST_RUN(test_arena);
+  TEST_RUN(test_high_load);
+  TEST_RUN(test_reserve);
+  return TEST_END("cuckoo_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,176 @@
+/* external_test.c - Tests of s_external (sorting.h)
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * The budgets go from a single chunk down to two records, so that s_external writes one run, many
+ * runs merged in one pass, or more runs than S_EXTERNAL_MAX_FANIN, merged in several passes. The
+ * output file must hold the same bytes as the records sorted in memory: the payload of a record is
+ * a function of its key, so the expected file is unique even with repeated keys. Input and output
+ * may be the same path. On a pool with three workers, chunks split into several slices of
+ * S_EXTERNAL_MIN_SLICE records must give the same file. An empty file gives an empty output; a
+ * file whose length is not a multiple of the record size, a budget below two records and a
+ * missing input make s_external return -1.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#include "sorting.h"
+#include "test.h"
+
+static bool record_less(const void *lhs, const void *rhs) {
+  uint32_t a;
+  uint32_t b;
+  memcpy(&a, lhs, 4);
+  memcpy(&b, rhs, 4);
+  return a < b;
+}
+
+static int record_cmp(const void *lhs, const void *rhs) {
+  return record_less(rhs, lhs) - record_less(lhs, rhs);
+}
+
+// Creates an empty temporary file and writes its path to 'path'
+static bool temp_path(char *path) {
+  const char *dir = getenv("TMPDIR");
+  snprintf(path, 256, "%s/chibi_external_XXXXXX", (dir != NULL) ? dir : "/tmp");
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+static bool write_file(const char *path, const void *data, size_t bytes) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    return false;
+  }
+  bool ok = fwrite(data, 1, bytes, f) == bytes;
+  return fclose(f) == 0 && ok;
+}
+
+// Reads a file of exactly 'bytes' bytes
+static bool read_file(const char *path, void *data, size_t bytes) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return false;
+  }
+  bool ok = fread(data, 1, bytes, f) == bytes && fgetc(f) == EOF;
+  fclose(f);
+  return ok;
+}
+
+static void check_external(size_t n, size_t size, size_t budget, uint64_t range, bool in_place) {
+  char in_path[256];
+  char out_path[256];
+  TEST_CHECK(temp_path(in_path));
+  if (in_place) {
+    strcpy(out_path, in_path);
+  } else {
+    TEST_CHECK(temp_path(out_path));
+  }
+  char *records = (char *) malloc(n * size + 1);
+  char *output = (char *) malloc(n * size + 1);
+  uint64_t state = 113 + n + size;
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t key = (uint32_t)(test_rand(&state) % range);
+    char *rec = records + i * size;
+    memcpy(rec, &key, 4);
+    for (size_t b = 4; b < size; ++b) {
+      rec[b] = (char)(key * 31 + b);
+    }
+  }
+  TEST_CHECK(write_file(in_path, records, n * size));
+  qsort(records, n, size, record_cmp);
+
+  TEST_CHECK_EQ(s_external(in_path, out_path, size, record_less, budget), n);
+  TEST_CHECK(read_file(out_path, output, n * size));
+  TEST_CHECK(n == 0 || memcmp(output, records, n * size) == 0);
+  remove(in_path);
+  if (!in_place) {
+    remove(out_path);
+  }
+  free(records);
+  free(output);
+}
+
+static void test_budgets(void) {
+  // one chunk, several runs merged in one pass, and more runs than a pass can merge
+  check_external(1000, 8, 0, UINT32_MAX, false);
+  check_external(100000, 8, 64 << 10, UINT32_MAX, false);
+  check_external(100000, 24, 2 << 20, 1000, false);
+  check_external(30000, 64, 4096, 50, false);
+  check_external(7, 12, 12 * 2, UINT32_MAX, false);
+}
+
+static void test_in_place(void) {
+  check_external(50000, 16, 100000, UINT32_MAX, true);
+}
+
+static void test_empty(void) {
+  check_external(0, 8, 0, 1, false);
+}
+
+static void test_pool(void) {
+  pool_t *pool = pool_new(3);
+  TEST_CHECK(pool != NULL);
+  s_set_pool(pool);
+  // chunks of several slices of S_EXTERNAL_MIN_SLICE records
+  check_external(200000, 8, 4 << 20, UINT32_MAX, false);
+  check_external(100000, 32, 1 << 20, 100, false);
+  s_set_pool(NULL);
+  pool_free(pool);
+}
+
+static void test_errors(void) {
+  char in_path[256];
+  char out_path[256];
+  TEST_CHECK(temp_path(in_path));
+  TEST_CHECK(temp_path(out_path));
+  // the length is not a multiple of the record size
+  char bytes[10] = {0};
+  TEST_CHECK(write_file(in_path, bytes, sizeof(bytes)));
+  TEST_CHECK_EQ(s_external(in_path, out_path, 4, record_less, 0), -1);
+  // a budget smaller than two records
+  TEST_CHECK_EQ(s_external(in_path, out_path, 10, record_less, 10), -1);
+  remove(in_path);
+  // a missing input
+  TEST_CHECK_EQ(s_external(in_path, out_path, 4, record_less, 0), -1);
+  remove(out_path);
+}
+
+int main(void) {
+  TEST_RUN(test_budgets);
+  TEST_RUN(test_in_place);
+  TEST_RUN(test_empty);
+  TEST_RUN(test_pool);
+  TEST_RUN(test_errors);
+  return TEST_END("external_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
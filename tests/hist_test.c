@@ -0,0 +1,189 @@
+/* hist_test.c - Tests of hist.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Small, uniform, log-uniform (up to 2^64) and spiky latency-like values are recorded, from one
+ * to 100000 of them. Every percentile from 0 to 100 must be at or above the value of the same rank
+ * in a sorted copy and at most 2^-HIST_SUB_BITS above it; count, min, max and mean must be exact.
+ * Every value must fall in the bucket whose bounds contain it, including the powers of two and
+ * UINT64_MAX. Merging partial histograms must give the counts of recording everything into one,
+ * hist_record_n must match repeated hist_record, and zero occurrences must not move min and max.
+ */
+
+#include "hist.h"
+#include "sorting.h"
+#include "test.h"
+
+typedef enum dist_t { DIST_SMALL, DIST_UNIFORM, DIST_LOG, DIST_SPIKES, DISTS } dist_t;
+
+static uint64_t draw(dist_t dist, uint64_t *state) {
+  uint64_t r = test_rand(state);
+  switch (dist) {
+    case DIST_SMALL:
+      return r % 100;
+    case DIST_UNIFORM:
+      return r % 1000000;
+    case DIST_LOG:
+      // every power of two up to 2^63 equally likely
+      return r >> (test_rand(state) % 64);
+    default:
+      // latencies: mostly fast, a few very slow
+      return (r % 1000 == 0) ? 1000000 + r % 50000000 : 50 + r % 20;
+  }
+}
+
+// Value of the given rank (1 to n) of a percentile, as hist_percentile defines it
+static uint64_t exact_percentile(const uint64_t *sorted, size_t n, double percentile) {
+  if (percentile <= 0.0) {
+    return sorted[0];
+  }
+  double rank = percentile / 100.0 * (double) n;
+  uint64_t target = (rank >= (double) n) ? n : (uint64_t) rank;
+  if ((double) target < rank || target == 0) {
+    ++target;
+  }
+  return sorted[target - 1];
+}
+
+static void test_percentiles(void) {
+  static const double percentiles[] = {0.0, 1.0, 25.0, 50.0, 90.0, 99.0, 99.9, 99.99, 100.0};
+  static const size_t dims[] = {1, 2, 10, 1000, 100000};
+  hist_t *hist = (hist_t *) malloc(sizeof(hist_t));
+  for (int dist = 0; dist < DISTS; ++dist) {
+    for (size_t d = 0; d < sizeof(dims) / sizeof(dims[0]); ++d) {
+      size_t n = dims[d];
+      uint64_t *values = (uint64_t *) malloc(n * sizeof(uint64_t));
+      uint64_t state = 29 + n + (uint64_t) dist;
+      double sum = 0.0;
+      hist_init(hist);
+      for (size_t i = 0; i < n; ++i) {
+        values[i] = draw((dist_t) dist, &state);
+        hist_record(hist, values[i]);
+        sum += (double) values[i];
+      }
+      s_sort_u64(values, n);
+      TEST_CHECK_EQ(hist_count(hist), n);
+      TEST_CHECK(hist->min == values[0] && hist->max == values[n - 1]);
+      double mean = hist_mean(hist);
+      TEST_CHECK(mean >= (sum / (double) n) * (1.0 - 1e-9) && mean <= (sum / (double) n) * (1.0 + 1e-9));
+      bool ok = true;
+      for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); ++p) {
+        uint64_t exact = exact_percentile(values, n, percentiles[p]);
+        uint64_t value = hist_percentile(hist, percentiles[p]);
+        ok = ok && value >= exact && value - exact <= (exact >> HIST_SUB_BITS) && value <= hist->max;
+      }
+      TEST_CHECK(ok);
+      free(values);
+    }
+  }
+  free(hist);
+}
+
+static void test_buckets(void) {
+  static const uint64_t edges[] = {0, 1, HIST__SUB_COUNT - 1, HIST__SUB_COUNT, HIST__SUB_COUNT + 1,
+                                   2 * HIST__SUB_COUNT - 1, 2 * HIST__SUB_COUNT, (uint64_t) 1 << 40,
+                                   ((uint64_t) 1 << 40) - 1, UINT64_MAX - 1, UINT64_MAX};
+  bool ok = true;
+  for (size_t e = 0; e < sizeof(edges) / sizeof(edges[0]); ++e) {
+    size_t index = hist__index(edges[e]);
+    ok = ok && index < HIST_BUCKETS && hist__upper(index) >= edges[e];
+    ok = ok && (index == 0 || hist__upper(index - 1) < edges[e]);
+  }
+  uint64_t state = 31;
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t value = test_rand(&state) >> (test_rand(&state) % 64);
+    size_t index = hist__index(value);
+    ok = ok && hist__upper(index) >= value && (index == 0 || hist__upper(index - 1) < value);
+  }
+  // the buckets are contiguous and increasing, the last one ends at UINT64_MAX
+  for (size_t i = 0; i < HIST_BUCKETS; ++i) {
+    ok = ok && hist__index(hist__upper(i)) == i;
+    ok = ok && (i == 0 || hist__index(hist__upper(i - 1) + 1) == i);
+  }
+  ok = ok && hist__upper(HIST_BUCKETS - 1) == UINT64_MAX;
+  TEST_CHECK(ok);
+}
+
+static void test_merge(void) {
+  hist_t *parts[3];
+  hist_t *all = (hist_t *) malloc(sizeof(hist_t));
+  hist_t *merged = (hist_t *) malloc(sizeof(hist_t));
+  hist_init(all);
+  hist_init(merged);
+  uint64_t state = 37;
+  for (int p = 0; p < 3; ++p) {
+    parts[p] = (hist_t *) malloc(sizeof(hist_t));
+    hist_init(parts[p]);
+    // the last part stays empty
+    for (int i = 0; i < ((p < 2) ? 5000 : 0); ++i) {
+      uint64_t value = draw((dist_t)(p % DISTS), &state);
+      hist_record(parts[p], value);
+      hist_record(all, value);
+    }
+    hist_merge(merged, parts[p]);
+  }
+  TEST_CHECK(memcmp(merged->counts, all->counts, sizeof(all->counts)) == 0);
+  TEST_CHECK(merged->total == all->total && merged->min == all->min && merged->max == all->max);
+  TEST_CHECK_EQ(hist_percentile(merged, 99.0), hist_percentile(all, 99.0));
+  for (int p = 0; p < 3; ++p) {
+    free(parts[p]);
+  }
+
+  // hist_record_n is n calls of hist_record
+  hist_init(all);
+  hist_init(merged);
+  for (int i = 0; i < 100; ++i) {
+    uint64_t value = draw(DIST_LOG, &state);
+    uint64_t n = test_rand(&state) % 5;
+    hist_record_n(merged, value, n);
+    for (uint64_t k = 0; k < n; ++k) {
+      hist_record(all, value);
+    }
+  }
+  TEST_CHECK(memcmp(merged->counts, all->counts, sizeof(all->counts)) == 0);
+  TEST_CHECK(merged->total == all->total && merged->min == all->min && merged->max == all->max);
+  // recording no occurrence does not move the extremes
+  hist_record_n(merged, 0, 0);
+  hist_record_n(merged, UINT64_MAX, 0);
+  TEST_CHECK(merged->min == all->min && merged->max == all->max);
+
+  // an empty histogram
+  hist_init(all);
+  TEST_CHECK_EQ(hist_percentile(all, 50.0), 0);
+  TEST_CHECK(hist_mean(all) == 0.0);
+  free(merged);
+  free(all);
+}
+
+int main(void) {
+  TEST_RUN(test_percentiles);
+  TEST_RUN(test_buckets);
+  TEST_RUN(test_merge);
+  return TEST_END("hist_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
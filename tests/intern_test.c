@@ -0,0 +1,168 @@
+/* intern_test.c - Tests of intern.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Checks that strings with repeats, shared prefixes and '\0' bytes get IDs in order of first
+ * appearance, that a repeat gets its first ID back, and that every ID maps back to its bytes; and
+ * that threads interning overlapping strings while the index grows agree on a single ID for each,
+ * with no data race reported when the test is built with -fsanitize=thread.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "intern.h"
+#include "test.h"
+
+enum { MAX_LEN = 24, THREADS = 4, SHARED = 4000 };
+
+typedef struct string_t {
+  char bytes[MAX_LEN];
+  size_t len;
+} string_t;
+
+static void make_string(string_t *s, uint64_t *state, uint64_t range) {
+  uint64_t n = test_rand(state) % range;
+  s->len = (size_t)(n % MAX_LEN);
+  for (size_t i = 0; i < s->len; ++i) {
+    // a small alphabet, with '\0' bytes, so that strings share prefixes
+    s->bytes[i] = "ab\0c"[(n >> (2 * (i % 16))) & 3];
+  }
+}
+
+static bool same(const string_t *s, const char *str, size_t len) {
+  return s->len == len && memcmp(s->bytes, str, len) == 0;
+}
+
+static void test_model(void) {
+  enum { N = 30000 };
+  intern_t *intern = intern_new();
+  TEST_CHECK(intern != NULL);
+  string_t *model = (string_t *) malloc(N * sizeof(string_t));
+  size_t distinct = 0;
+  uint64_t state = 107;
+  for (int i = 0; i < N; ++i) {
+    string_t s;
+    make_string(&s, &state, 6000);
+    size_t expected = 0;
+    while (expected < distinct && !same(&model[expected], s.bytes, s.len)) {
+      ++expected;
+    }
+    TEST_CHECK_EQ(intern_find(intern, s.bytes, s.len), (expected < distinct) ? (long long) expected : INTERN_NONE);
+    if (expected == distinct) {
+      model[distinct++] = s;
+    }
+    TEST_CHECK_EQ(intern_put(intern, s.bytes, s.len), expected);
+    TEST_CHECK_EQ(intern_count(intern), distinct);
+  }
+  for (size_t id = 0; id < distinct; ++id) {
+    size_t len;
+    const char *str = intern_str(intern, (uint32_t) id, &len);
+    TEST_CHECK(same(&model[id], str, len));
+    TEST_CHECK(str[len] == '\0');
+    TEST_CHECK_EQ(intern_find(intern, model[id].bytes, model[id].len), id);
+  }
+  TEST_CHECK_EQ(intern_put_cstr(intern, ""), intern_find(intern, "", 0));
+  intern_free(intern);
+  free(model);
+}
+
+typedef struct worker_t {
+  intern_t *intern;
+  uint64_t seed;
+  uint32_t ids[SHARED];  // ID of every shared string, as seen by this thread
+} worker_t;
+
+// The i-th shared string: distinct for distinct i
+static size_t shared_string(char *bytes, size_t i) {
+  return (size_t) snprintf(bytes, MAX_LEN, "s%zu", i);
+}
+
+static void *worker(void *arg) {
+  worker_t *w = (worker_t *) arg;
+  uint64_t state = w->seed;
+  // the shared strings in an order of this thread, mixed with lookups of random ones
+  for (size_t k = 0; k < SHARED; ++k) {
+    size_t i = (k * 7919 + (size_t) w->seed) % SHARED;
+    char bytes[MAX_LEN];
+    size_t len = shared_string(bytes, i);
+    w->ids[i] = intern_put(w->intern, bytes, len);
+
+    char other[MAX_LEN];
+    size_t other_len = shared_string(other, (size_t)(test_rand(&state) % SHARED));
+    uint32_t id = intern_find(w->intern, other, other_len);
+    if (id != INTERN_NONE) {
+      size_t found_len;
+      const char *found = intern_str(w->intern, id, &found_len);
+      if (found_len != other_len || memcmp(found, other, other_len) != 0) {
+        w->ids[i] = INTERN_NONE;
+      }
+    }
+  }
+  return NULL;
+}
+
+static void test_threads(void) {
+  intern_t *intern = intern_new();
+  worker_t *workers = (worker_t *) malloc(THREADS * sizeof(worker_t));
+  pthread_t threads[THREADS];
+  for (int t = 0; t < THREADS; ++t) {
+    workers[t].intern = intern;
+    workers[t].seed = 109 + (uint64_t) t * 1000;
+    TEST_CHECK(pthread_create(&threads[t], NULL, worker, &workers[t]) == 0);
+  }
+  for (int t = 0; t < THREADS; ++t) {
+    pthread_join(threads[t], NULL);
+  }
+  TEST_CHECK_EQ(intern_count(intern), SHARED);
+  bool *seen = (bool *) calloc(SHARED, sizeof(bool));
+  for (size_t i = 0; i < SHARED; ++i) {
+    uint32_t id = workers[0].ids[i];
+    TEST_CHECK(id < SHARED);
+    for (int t = 1; t < THREADS; ++t) {
+      TEST_CHECK_EQ(workers[t].ids[i], id);
+    }
+    if (id < SHARED) {
+      TEST_CHECK(!seen[id]);
+      seen[id] = true;
+      char bytes[MAX_LEN];
+      size_t len = shared_string(bytes, i);
+      size_t found_len;
+      const char *found = intern_str(intern, id, &found_len);
+      TEST_CHECK(found_len == len && memcmp(found, bytes, len) == 0);
+    }
+  }
+  free(seen);
+  free(workers);
+  intern_free(intern);
+}
+
+int main(void) {
+  TEST_RUN(test_model);
+  TEST_RUN(test_threads);
+  return TEST_END("intern_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,138 @@
+/* lsm_test.c - Tests of lsm.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Batches of random inserts over a few thousand keys, some followed by lsm_flush, are also kept
+ * in a plain array. After every batch lsm_export must equal the stable sort of the array, so
+ * equal keys stay in insertion order across the buffer and the levels. lsm_find must return the
+ * most recent insert of a key, lsm_count its occurrences, and lsm_range the sorted span between
+ * two keys, for present and absent keys. The same inserts run on a container whose memory comes
+ * from an arena (lsm_new_with), which must give the same results.
+ */
+
+#include "lsm.h"
+#include "arena.h"
+#include "test.h"
+
+typedef struct entry_t {
+  uint32_t key;
+  uint32_t seq;  // insertion number, to check that equal keys keep their insertion order
+} entry_t;
+
+static bool entry_less(const void *lhs, const void *rhs) {
+  return ((const entry_t *) lhs)->key < ((const entry_t *) rhs)->key;
+}
+
+static int entry_cmp(const void *lhs, const void *rhs) {
+  const entry_t *a = (const entry_t *) lhs;
+  const entry_t *b = (const entry_t *) rhs;
+  if (a->key != b->key) {
+    return (a->key > b->key) - (a->key < b->key);
+  }
+  return (a->seq > b->seq) - (a->seq < b->seq);
+}
+
+static void check_lsm(const chibi_allocator_t *allocator) {
+  enum { N = 20000, RANGE = 3000 };
+  lsm_t *lsm = lsm_new_with_typed(entry_t, entry_less, allocator);
+  TEST_CHECK(lsm != NULL);
+  entry_t *model = (entry_t *) malloc(N * sizeof(entry_t));
+  entry_t *sorted = (entry_t *) malloc(N * sizeof(entry_t));
+  entry_t *output = (entry_t *) malloc(N * sizeof(entry_t));
+  uint64_t state = 43;
+  size_t n = 0;
+  while (n < N) {
+    size_t batch = 1 + (size_t)(test_rand(&state) % 700);
+    for (size_t b = 0; b < batch && n < N; ++b, ++n) {
+      entry_t entry = {(uint32_t)(test_rand(&state) % RANGE), (uint32_t) n};
+      model[n] = entry;
+      TEST_CHECK_EQ(lsm_insert(lsm, &entry), n + 1);
+    }
+    if (test_rand(&state) % 4 == 0) {
+      TEST_CHECK_EQ(lsm_flush(lsm), n);
+    }
+    TEST_CHECK_EQ(lsm_size(lsm), n);
+
+    memcpy(sorted, model, n * sizeof(entry_t));
+    qsort(sorted, n, sizeof(entry_t), entry_cmp);
+    TEST_CHECK_EQ(lsm_export(lsm, output), n);
+    TEST_CHECK(memcmp(output, sorted, n * sizeof(entry_t)) == 0);
+
+    for (int q = 0; q < 20; ++q) {
+      entry_t key = {(uint32_t)(test_rand(&state) % (RANGE + 10)), 0};
+      size_t count = 0;
+      uint32_t latest = 0;
+      for (size_t i = 0; i < n; ++i) {
+        if (model[i].key == key.key) {
+          ++count;
+          latest = model[i].seq;
+        }
+      }
+      entry_t found;
+      TEST_CHECK(lsm_find(lsm, &key, &found) == (count > 0));
+      TEST_CHECK(count == 0 || (found.key == key.key && found.seq == latest));
+      TEST_CHECK_EQ(lsm_count(lsm, &key), count);
+
+      entry_t lo = {(uint32_t)(test_rand(&state) % RANGE), 0};
+      entry_t hi = {lo.key + (uint32_t)(test_rand(&state) % 200), 0};
+      size_t first = 0;
+      while (first < n && sorted[first].key < lo.key) {
+        ++first;
+      }
+      size_t last = first;
+      while (last < n && sorted[last].key < hi.key) {
+        ++last;
+      }
+      TEST_CHECK_EQ(lsm_range(lsm, &lo, &hi, NULL), last - first);
+      TEST_CHECK_EQ(lsm_range(lsm, &lo, &hi, output), last - first);
+      TEST_CHECK(last == first || memcmp(output, sorted + first, (last - first) * sizeof(entry_t)) == 0);
+    }
+  }
+  lsm_free(lsm);
+  free(model);
+  free(sorted);
+  free(output);
+}
+
+static void test_heap(void) {
+  check_lsm(NULL);
+}
+
+static void test_arena(void) {
+  arena_t arena;
+  arena_init(&arena, 0);
+  check_lsm(arena_allocator(&arena));
+  arena_free(&arena);
+}
+
+int main(void) {
+  TEST_RUN(test_heap);
+  TEST_RUN(test_arena);
+  return TEST_END("lsm_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
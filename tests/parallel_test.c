@@ -0,0 +1,158 @@
+/* parallel_test.c - Tests of parallel.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * par_exclusive_scan_u64 must return the running sums of a sequential loop and their total, both
+ * into a separate output and in place. par_partition must produce the stable partition built by
+ * two sequential passes and return the number of elements that satisfy the predicate, for a
+ * predicate with and without a context. Both run on 0, 1 and 4 threads, on inputs from empty to
+ * more than PAR_MIN_BLOCK elements per thread, and again on a pool of four workers (par_set_pool).
+ * par_partition_with must give the same partition with its temporary buffer taken from an arena.
+ */
+
+#include "parallel.h"
+#include "arena.h"
+#include "test.h"
+
+static const size_t dims[] = {0, 1, 100, 16384, 50000, 200001};
+#define NDIMS (sizeof(dims) / sizeof(dims[0]))
+
+static void check_scan(size_t nthreads) {
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    uint64_t state = 3 + n;
+    uint64_t *input = (uint64_t *) malloc((n + 1) * sizeof(uint64_t));
+    uint64_t *output = (uint64_t *) malloc((n + 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < n; ++i) {
+      input[i] = test_rand(&state) % 1000;
+    }
+    uint64_t total = par_exclusive_scan_u64(input, output, n, nthreads);
+    uint64_t sum = 0;
+    bool ok = true;
+    for (size_t i = 0; i < n; ++i) {
+      ok = ok && output[i] == sum;
+      sum += input[i];
+    }
+    TEST_CHECK(ok);
+    TEST_CHECK(total == sum);
+    // in place
+    TEST_CHECK(par_exclusive_scan_u64(input, input, n, nthreads) == sum);
+    TEST_CHECK(n == 0 || memcmp(input, output, n * sizeof(uint64_t)) == 0);
+    free(input);
+    free(output);
+  }
+}
+
+typedef struct item_t {
+  uint32_t key;
+  uint32_t pos;
+  uint64_t pad;
+} item_t;
+
+static bool is_even(const void *elem, void *ctx) {
+  (void) ctx;
+  return (((const item_t *) elem)->key & 1) == 0;
+}
+
+static bool below(const void *elem, void *ctx) {
+  return ((const item_t *) elem)->key < *(const uint32_t *) ctx;
+}
+
+static void check_partition(size_t nthreads, const chibi_allocator_t *allocator) {
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    uint64_t state = 5 + n;
+    item_t *input = (item_t *) malloc((n + 1) * sizeof(item_t));
+    item_t *ref = (item_t *) malloc((n + 1) * sizeof(item_t));
+    for (size_t i = 0; i < n; ++i) {
+      input[i].key = (uint32_t) test_rand(&state);
+      input[i].pos = (uint32_t) i;
+      input[i].pad = ~(uint64_t) i;
+    }
+    for (int p = 0; p < 2; ++p) {
+      uint32_t bound = UINT32_MAX / 3;
+      bool (*pred)(const void *elem, void *ctx) = (p == 0) ? is_even : below;
+      // stable partition: the elements that satisfy the predicate, then the others, in order
+      size_t nref = 0;
+      for (size_t i = 0; i < n; ++i) {
+        if (pred(&input[i], &bound)) {
+          ref[nref++] = input[i];
+        }
+      }
+      size_t trues = nref;
+      for (size_t i = 0; i < n; ++i) {
+        if (!pred(&input[i], &bound)) {
+          ref[nref++] = input[i];
+        }
+      }
+      int64_t result = par_partition_with(input, n, sizeof(item_t), pred, &bound, nthreads, allocator);
+      TEST_CHECK_EQ(result, trues);
+      TEST_CHECK(n == 0 || memcmp(input, ref, n * sizeof(item_t)) == 0);
+    }
+    free(input);
+    free(ref);
+  }
+}
+
+static void test_scan(void) {
+  check_scan(0);
+  check_scan(1);
+  check_scan(4);
+}
+
+static void test_partition(void) {
+  check_partition(0, NULL);
+  check_partition(1, NULL);
+  check_partition(4, NULL);
+}
+
+static void test_partition_arena(void) {
+  arena_t arena;
+  arena_init(&arena, 0);
+  check_partition(4, arena_allocator(&arena));
+  arena_free(&arena);
+}
+
+static void test_pool(void) {
+  pool_t *pool = pool_new(4);
+  TEST_CHECK(pool != NULL);
+  par_set_pool(pool);
+  check_scan(0);
+  check_partition(0, NULL);
+  par_set_pool(NULL);
+  pool_free(pool);
+}
+
+int main(void) {
+  TEST_RUN(test_scan);
+  TEST_RUN(test_partition);
+  TEST_RUN(test_partition_arena);
+  TEST_RUN(test_pool);
+  return TEST_END("parallel_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,81 @@
+/* perfctr_test.c - Tests of perfctr.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * perfctr.h is included after the system headers of test.h and built with -std=c11, where
+ * <unistd.h> does not declare syscall(), so the header must compile in any include order. The
+ * counters may be unavailable (containers, virtual machines): the tests then check that they read
+ * as zero.
+ */
+
+#include "test.h"
+#include "perfctr.h"
+
+static void test_region(void) {
+  perfctr_t pc;
+  int opened = perfctr_open(&pc);
+  TEST_CHECK(opened >= 0 && opened <= PERFCTR_EVENTS);
+  int available = 0;
+  for (int e = 0; e < PERFCTR_EVENTS; ++e) {
+    available += perfctr_available(&pc, (perfctr_event_t) e);
+  }
+  TEST_CHECK_EQ(available, opened);
+
+  volatile uint64_t sum = 0;
+  perfctr_start(&pc);
+  for (uint64_t i = 0; i < 1000000; ++i) {
+    sum += i;
+  }
+  perfctr_stop(&pc);
+  TEST_CHECK(sum == 499999500000ULL);
+
+  for (int e = 0; e < PERFCTR_EVENTS; ++e) {
+    if (!perfctr_available(&pc, (perfctr_event_t) e)) {
+      TEST_CHECK_EQ(perfctr_value(&pc, (perfctr_event_t) e), 0);
+    }
+  }
+  if (perfctr_available(&pc, PERFCTR_INSTRUCTIONS)) {
+    TEST_CHECK(perfctr_value(&pc, PERFCTR_INSTRUCTIONS) >= 1000000);
+  }
+  perfctr_close(&pc);
+  for (int e = 0; e < PERFCTR_EVENTS; ++e) {
+    TEST_CHECK(!perfctr_available(&pc, (perfctr_event_t) e));
+  }
+}
+
+static void test_names(void) {
+  TEST_CHECK(strcmp(perfctr_name(PERFCTR_CYCLES), "cycles") == 0);
+  TEST_CHECK(strcmp(perfctr_name(PERFCTR_EVENTS), "unknown") == 0);
+}
+
+int main(void) {
+  TEST_RUN(test_region);
+  TEST_RUN(test_names);
+  return TEST_END("perfctr_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,316 @@
+/* pool_test.c - Tests of pool.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * pool_parallel_for must visit every index of the range exactly once, in subranges no longer
+ * than the grain, including empty ranges and grains of 0 and larger than the range. Fibonacci by
+ * fork/join and a nested row/column loop must give the sequential results. A task spawning more
+ * children than POOL_DEQUE_SIZE must still run all of them, loops started by several threads
+ * that are not workers must not interfere, a pool whose workers all went to sleep must wake up
+ * for new work, and pool_wait must sleep, not spin, while its task runs on another thread.
+ */
+
+#include "pool.h"
+#include "test.h"
+
+typedef struct visit_t {
+  uint8_t *hits;
+  size_t grain;
+  int too_long;
+} visit_t;
+
+static void visit(void *ctx, size_t lo, size_t hi) {
+  visit_t *v = (visit_t *) ctx;
+  if (hi <= lo || hi - lo > v->grain) {
+    __atomic_store_n(&v->too_long, 1, __ATOMIC_RELAXED);
+  }
+  for (size_t i = lo; i < hi; ++i) {
+    __atomic_fetch_add(&v->hits[i], 1, __ATOMIC_RELAXED);
+  }
+}
+
+static void check_parallel_for(pool_t *pool) {
+  static const size_t ranges[][2] = {{0, 0}, {9, 3}, {5, 6}, {0, 1000}, {17, 100000}};
+  static const size_t grains[] = {0, 1, 7, 1000, 1 << 20};
+  for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); ++r) {
+    size_t begin = ranges[r][0];
+    size_t end = ranges[r][1];
+    for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); ++g) {
+      uint8_t *hits = (uint8_t *) calloc(end + 1, 1);
+      visit_t v = {hits, (grains[g] > 0) ? grains[g] : 1, 0};
+      pool_parallel_for(pool, begin, end, grains[g], visit, &v);
+      bool ok = true;
+      for (size_t i = 0; i <= end; ++i) {
+        ok = ok && hits[i] == (i >= begin && i < end);
+      }
+      TEST_CHECK(ok);
+      TEST_CHECK(v.too_long == 0);
+      free(hits);
+    }
+  }
+}
+
+static void test_parallel_for(void) {
+  static const size_t workers[] = {1, 3, 8};
+  for (size_t w = 0; w < sizeof(workers) / sizeof(workers[0]); ++w) {
+    pool_t *pool = pool_new(workers[w]);
+    TEST_CHECK(pool != NULL);
+    TEST_CHECK_EQ(pool_workers(pool), workers[w]);
+    check_parallel_for(pool);
+    pool_free(pool);
+  }
+}
+
+// Fork/join Fibonacci: every call above n = 1 spawns one half and runs the other
+typedef struct fib_t {
+  pool_t *pool;
+  unsigned n;
+  uint64_t result;
+} fib_t;
+
+static uint64_t fib_seq(unsigned n) {
+  return (n < 2) ? n : fib_seq(n - 1) + fib_seq(n - 2);
+}
+
+static void fib_task(void *arg) {
+  fib_t *f = (fib_t *) arg;
+  if (f->n < 2) {
+    f->result = f->n;
+    return;
+  }
+  fib_t left = {f->pool, f->n - 1, 0};
+  fib_t right = {f->pool, f->n - 2, 0};
+  pool_task_t task;
+  pool_spawn(f->pool, &task, fib_task, &left);
+  fib_task(&right);
+  pool_wait(f->pool, &task);
+  f->result = left.result + right.result;
+}
+
+static void test_fork_join(void) {
+  pool_t *pool = pool_new(4);
+  TEST_CHECK(pool != NULL);
+  for (unsigned n = 0; n <= 22; n += 11) {
+    fib_t root = {pool, n, 0};
+    pool_task_t task;
+    pool_spawn(pool, &task, fib_task, &root);
+    pool_wait(pool, &task);
+    TEST_CHECK_EQ(root.result, fib_seq(n));
+  }
+  pool_free(pool);
+}
+
+// Nested loops: every row of a matrix is summed by an inner parallel loop
+typedef struct matrix_t {
+  pool_t *pool;
+  const uint64_t *cells;
+  size_t cols;
+  uint64_t *sums;
+} matrix_t;
+
+typedef struct row_t {
+  const uint64_t *cells;
+  uint64_t sum;
+} row_t;
+
+static void sum_cols(void *ctx, size_t lo, size_t hi) {
+  row_t *row = (row_t *) ctx;
+  uint64_t sum = 0;
+  for (size_t c = lo; c < hi; ++c) {
+    sum += row->cells[c];
+  }
+  __atomic_fetch_add(&row->sum, sum, __ATOMIC_RELAXED);
+}
+
+static void sum_rows(void *ctx, size_t lo, size_t hi) {
+  matrix_t *m = (matrix_t *) ctx;
+  for (size_t r = lo; r < hi; ++r) {
+    row_t row = {m->cells + r * m->cols, 0};
+    pool_parallel_for(m->pool, 0, m->cols, 16, sum_cols, &row);
+    m->sums[r] = row.sum;
+  }
+}
+
+static void test_nested(void) {
+  enum { ROWS = 64, COLS = 1000 };
+  pool_t *pool = pool_new(4);
+  TEST_CHECK(pool != NULL);
+  uint64_t *cells = (uint64_t *) malloc(ROWS * COLS * sizeof(uint64_t));
+  uint64_t sums[ROWS];
+  uint64_t state = 7;
+  for (size_t i = 0; i < ROWS * COLS; ++i) {
+    cells[i] = test_rand(&state) % 1000;
+  }
+  matrix_t m = {pool, cells, COLS, sums};
+  pool_parallel_for(pool, 0, ROWS, 1, sum_rows, &m);
+  bool ok = true;
+  for (size_t r = 0; r < ROWS; ++r) {
+    uint64_t sum = 0;
+    for (size_t c = 0; c < COLS; ++c) {
+      sum += cells[r * COLS + c];
+    }
+    ok = ok && sums[r] == sum;
+  }
+  TEST_CHECK(ok);
+  free(cells);
+  pool_free(pool);
+}
+
+// A task that spawns more children than a deque holds: the overflow runs immediately
+typedef struct burst_t {
+  pool_t *pool;
+  size_t children;
+  pool_task_t *tasks;
+  int counter;
+} burst_t;
+
+static void burst_child(void *arg) {
+  __atomic_fetch_add(&((burst_t *) arg)->counter, 1, __ATOMIC_RELAXED);
+}
+
+static void burst_task(void *arg) {
+  burst_t *b = (burst_t *) arg;
+  for (size_t i = 0; i < b->children; ++i) {
+    pool_spawn(b->pool, &b->tasks[i], burst_child, b);
+  }
+  for (size_t i = b->children; i-- > 0; ) {
+    pool_wait(b->pool, &b->tasks[i]);
+  }
+}
+
+static void test_full_deque(void) {
+  pool_t *pool = pool_new(2);
+  TEST_CHECK(pool != NULL);
+  burst_t b = {pool, POOL_DEQUE_SIZE + 100, NULL, 0};
+  b.tasks = (pool_task_t *) malloc(b.children * sizeof(pool_task_t));
+  pool_task_t task;
+  pool_spawn(pool, &task, burst_task, &b);
+  pool_wait(pool, &task);
+  TEST_CHECK_EQ(b.counter, b.children);
+  free(b.tasks);
+  pool_free(pool);
+}
+
+// Loops started at the same time by threads that are not workers
+typedef struct caller_t {
+  pool_t *pool;
+  int ok;
+} caller_t;
+
+static void *caller_main(void *arg) {
+  caller_t *caller = (caller_t *) arg;
+  enum { N = 50000 };
+  uint8_t *hits = (uint8_t *) calloc(N, 1);
+  visit_t v = {hits, 100, 0};
+  pool_parallel_for(caller->pool, 0, N, 100, visit, &v);
+  caller->ok = v.too_long == 0;
+  for (size_t i = 0; i < N; ++i) {
+    caller->ok = caller->ok && hits[i] == 1;
+  }
+  free(hits);
+  return NULL;
+}
+
+static void test_external_threads(void) {
+  enum { CALLERS = 4 };
+  pool_t *pool = pool_new(3);
+  TEST_CHECK(pool != NULL);
+  pthread_t threads[CALLERS];
+  caller_t callers[CALLERS];
+  for (size_t i = 0; i < CALLERS; ++i) {
+    callers[i].pool = pool;
+    callers[i].ok = 0;
+    TEST_CHECK(pthread_create(&threads[i], NULL, caller_main, &callers[i]) == 0);
+  }
+  for (size_t i = 0; i < CALLERS; ++i) {
+    pthread_join(threads[i], NULL);
+    TEST_CHECK(callers[i].ok);
+  }
+  pool_free(pool);
+}
+
+// The workers of an idle pool go to sleep and must wake up for new work
+static void test_sleep(void) {
+  pool_t *pool = pool_new(0);
+  TEST_CHECK(pool != NULL);
+  TEST_CHECK(pool_workers(pool) >= 1);
+  for (int round = 0; round < 3; ++round) {
+    size_t spins = 0;
+    while (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST) < (int) pool_workers(pool) && spins < 10000000) {
+      sched_yield();
+      ++spins;
+    }
+    TEST_CHECK_EQ(__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST), pool_workers(pool));
+    check_parallel_for(pool);
+  }
+  pool_free(pool);
+  pool_free(NULL);
+}
+
+// The task returns only once its waiter sleeps in pool_wait, or after a bounded number of rounds
+typedef struct gate_t {
+  pool_t *pool;
+  int saw_waiter;
+} gate_t;
+
+static void gate_task(void *arg) {
+  gate_t *gate = (gate_t *) arg;
+  for (size_t spins = 0; spins < 10000000; ++spins) {
+    if (__atomic_load_n(&gate->pool->waiters, __ATOMIC_SEQ_CST) > 0) {
+      gate->saw_waiter = 1;
+      return;
+    }
+    sched_yield();
+  }
+}
+
+static void test_wait_sleep(void) {
+  pool_t *pool = pool_new(1);
+  TEST_CHECK(pool != NULL);
+  for (int round = 0; round < 3; ++round) {
+    gate_t gate = {pool, 0};
+    pool_task_t task;
+    pool_spawn(pool, &task, gate_task, &gate);
+    pool_wait(pool, &task);
+    TEST_CHECK(gate.saw_waiter);
+    TEST_CHECK_EQ(__atomic_load_n(&pool->waiters, __ATOMIC_SEQ_CST), 0);
+  }
+  pool_free(pool);
+}
+
+int main(void) {
+  TEST_RUN(test_parallel_for);
+  TEST_RUN(test_fork_join);
+  TEST_RUN(test_nested);
+  TEST_RUN(test_full_deque);
+  TEST_RUN(test_external_threads);
+  TEST_RUN(test_sleep);
+  TEST_RUN(test_wait_sleep);
+  return TEST_END("pool_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
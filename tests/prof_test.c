@@ -0,0 +1,96 @@
+/* prof_test.c - Tests of prof.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * Several threads enter the same instrumented call sites for the first time at once: the entries
+ * must be registered once and the totals must add up to the calls of all the threads. Built
+ * with -fsanitize=thread, the test also checks that the lazy registration of the call sites is
+ * free of data races.
+ */
+
+// pthread_barrier_t is POSIX, not part of -std=c11
+#define _POSIX_C_SOURCE 200809L
+#define CHIBI_PROFILE
+#include "prof.h"
+#include "test.h"
+#include <pthread.h>
+
+enum { THREADS = 8, CALLS = 10000 };
+
+static pthread_barrier_t start_barrier;
+
+static void timed(uint64_t *sink) {
+  PROF_BEGIN(timed_region);
+  *sink += 1;
+  PROF_END(timed_region);
+  PROF_COUNT(counted_items, 3);
+}
+
+static void *worker(void *arg) {
+  uint64_t *sink = (uint64_t *) arg;
+  pthread_barrier_wait(&start_barrier);
+  for (int i = 0; i < CALLS; ++i) {
+    timed(sink);
+  }
+  return NULL;
+}
+
+static void test_threads(void) {
+  pthread_t threads[THREADS];
+  uint64_t sinks[THREADS] = {0};
+  pthread_barrier_init(&start_barrier, NULL, THREADS);
+  for (int t = 0; t < THREADS; ++t) {
+    TEST_CHECK(pthread_create(&threads[t], NULL, worker, &sinks[t]) == 0);
+  }
+  for (int t = 0; t < THREADS; ++t) {
+    pthread_join(threads[t], NULL);
+  }
+  pthread_barrier_destroy(&start_barrier);
+
+  prof_entry_t region = prof_get("timed_region");
+  prof_entry_t counter = prof_get("counted_items");
+  TEST_CHECK_EQ(region.count, (uint64_t) THREADS * CALLS);
+  TEST_CHECK_EQ(counter.count, (uint64_t) THREADS * CALLS * 3);
+  TEST_CHECK(region.max <= region.ticks);
+  TEST_CHECK_EQ(prof_get("missing").count, 0);
+}
+
+static void test_reset(void) {
+  uint64_t sink = 0;
+  prof_reset();
+  timed(&sink);
+  TEST_CHECK_EQ(prof_get("timed_region").count, 1);
+  TEST_CHECK_EQ(prof_get("counted_items").count, 3);
+}
+
+int main(void) {
+  TEST_RUN(test_threads);
+  TEST_RUN(test_reset);
+  return TEST_END("prof_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
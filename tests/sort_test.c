@@ -0,0 +1,1322 @@
+/* sort_test.c - Tests of sorting.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * The generic sorts run on records with random, sorted, reverse and few distinct keys, for sizes
+ * from 0 to 20000. They must order the keys as qsort does, keep every record, and the stable ones
+ * (insertion and merge sort) must also keep records with equal keys in input order. s_nth_element
+ * must put the element of rank nth in its place, with no greater element before it and no smaller
+ * one after it; s_partial_sort must sort the first k elements. A streaming top-k is read after
+ * many prefixes of a stream and must hold copies of the k least records pushed so far. s_merge_2,
+ * s_merge_k and the pull-based merger, read one element or a batch at a time, must return the
+ * stable sort of the concatenated runs, from single runs to more than a thousand. The string sorts
+ * must agree with qsort and strcmp (memcmp and the length for the s_pstr_t views) on sets with
+ * long shared prefixes, duplicates, empty strings and bytes above 0x7F, and only permute the
+ * pointers or views they are given. A sort by key must carry every value vector along with its
+ * key, stably. unique and the group boundaries are compared with a pass over the runs of equal
+ * keys, and the set operations with a plain merge, for lengths in both skewed directions. Every
+ * search (generic, typed, batched, k-ary) must return the bounds a linear scan finds, for present
+ * keys, absent keys, keys beyond both ends and keys around the sign bit. The counting, bucket and
+ * radix sorts run on full-range keys, on keys far from zero and on key ranges on both sides of
+ * S_COUNTING_MAX_RANGE. The adaptive sort must choose the expected algorithm on inputs whose best
+ * algorithm is known. Every generic sort also runs on elements of 1 to S_STACK_TEMP + 44 bytes,
+ * which covers the sizes the move engine special-cases and temporaries too large for the stack.
+ * s_ksorted runs on inputs where no record is more than k positions away, with windows shorter and
+ * longer than the input, in both orders. v_sort must pick the right typed sort for every integer
+ * type and respect any other order; hash_sort_export must return the keys in order with their
+ * values. A sort by key that runs out of memory must leave its keys and values untouched.
+ */
+
+#include "sorting.h"
+#include "vectors.h"
+#include "hash.h"
+#include "test.h"
+#include <stdarg.h>
+
+// Record with a key and its original position, to check stability
+typedef struct rec_t {
+  uint64_t key;
+  uint64_t pos;
+  uint64_t pad;
+} rec_t;
+
+static bool rec_less(const void *lhs, const void *rhs) {
+  return ((const rec_t *) lhs)->key < ((const rec_t *) rhs)->key;
+}
+
+// Orders by key then position: the output of a stable sort
+static int rec_cmp_stable(const void *lhs, const void *rhs) {
+  const rec_t *a = (const rec_t *) lhs;
+  const rec_t *b = (const rec_t *) rhs;
+  if (a->key != b->key) {
+    return (a->key > b->key) - (a->key < b->key);
+  }
+  return (a->pos > b->pos) - (a->pos < b->pos);
+}
+
+static int cmp_u32(const void *lhs, const void *rhs) {
+  uint32_t a = *(const uint32_t *) lhs;
+  uint32_t b = *(const uint32_t *) rhs;
+  return (a > b) - (a < b);
+}
+
+static int cmp_u64(const void *lhs, const void *rhs) {
+  uint64_t a = *(const uint64_t *) lhs;
+  uint64_t b = *(const uint64_t *) rhs;
+  return (a > b) - (a < b);
+}
+
+static int cmp_f64(const void *lhs, const void *rhs) {
+  double a = *(const double *) lhs;
+  double b = *(const double *) rhs;
+  return (a > b) - (a < b);
+}
+
+static bool less_u64(const void *lhs, const void *rhs) {
+  return *(const uint64_t *) lhs < *(const uint64_t *) rhs;
+}
+
+static const size_t dims[] = {0, 1, 2, 3, 7, 16, 31, 64, 100, 257, 1000, 4099, 20000};
+#define NDIMS (sizeof(dims) / sizeof(dims[0]))
+
+/* Shapes of the inputs: random keys over a range, sorted, reverse, few distinct keys */
+enum { SHAPE_RANDOM, SHAPE_SORTED, SHAPE_REVERSE, SHAPE_FEW, SHAPES };
+
+static uint64_t make_key(int shape, size_t i, size_t n, uint64_t *state, uint64_t mask) {
+  switch (shape) {
+    case SHAPE_SORTED:
+      return i;
+    case SHAPE_REVERSE:
+      return n - i;
+    case SHAPE_FEW:
+      return test_rand(state) % 5;
+    default:
+      return test_rand(state) & mask;
+  }
+}
+
+static void fill_recs(rec_t *recs, size_t n, int shape, uint64_t seed) {
+  uint64_t state = seed;
+  for (size_t i = 0; i < n; ++i) {
+    recs[i].key = make_key(shape, i, n, &state, UINT64_MAX);
+    recs[i].pos = i;
+    recs[i].pad = ~i;
+  }
+}
+
+static rec_t make_rec(size_t i, uint64_t *state) {
+  rec_t rec = {test_rand(state) % 50, i, ~(uint64_t) i};
+  return rec;
+}
+
+typedef int64_t (*generic_sort_t)(void *input, size_t dim, size_t size, bool (*order)(const void *lhs, const void *rhs));
+
+static void check_generic(generic_sort_t sort, bool stable, size_t max_n) {
+  for (size_t d = 0; d < NDIMS && dims[d] <= max_n; ++d) {
+    size_t n = dims[d];
+    for (int shape = 0; shape < SHAPES; ++shape) {
+      rec_t *input = (rec_t *) malloc((n + 1) * sizeof(rec_t));
+      rec_t *ref = (rec_t *) malloc((n + 1) * sizeof(rec_t));
+      fill_recs(input, n, shape, 1000 + n * SHAPES + (uint64_t) shape);
+      memcpy(ref, input, n * sizeof(rec_t));
+      qsort(ref, n, sizeof(rec_t), rec_cmp_stable);
+      TEST_CHECK_EQ(sort(input, n, sizeof(rec_t), rec_less), n);
+      bool keys_ok = true;
+      bool recs_ok = true;
+      for (size_t i = 0; i < n; ++i) {
+        keys_ok = keys_ok && input[i].key == ref[i].key;
+        recs_ok = recs_ok && memcmp(&input[i], &ref[i], sizeof(rec_t)) == 0;
+      }
+      TEST_CHECK(keys_ok);
+      if (stable) {
+        TEST_CHECK(recs_ok);
+      }
+      // every record is still there, whatever the order of equal keys
+      qsort(input, n, sizeof(rec_t), rec_cmp_stable);
+      TEST_CHECK(n == 0 || memcmp(input, ref, n * sizeof(rec_t)) == 0);
+      free(input);
+      free(ref);
+    }
+  }
+}
+
+static void test_insertion(void) { check_generic(s_insertion, true, 4099); }
+static void test_selection(void) { check_generic(s_selection, false, 4099); }
+static void test_merge(void) { check_generic(s_merge, true, SIZE_MAX); }
+static void test_heap(void) { check_generic(s_heap, false, SIZE_MAX); }
+// s_sort only gives up stability on strictly decreasing vectors, which have no equal keys
+static void test_sort(void) { check_generic(s_sort, true, SIZE_MAX); }
+
+static void test_selection_algorithms(void) {
+  for (size_t d = 1; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    uint64_t state = 17 + n;
+    uint64_t *keys = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *ref = (uint64_t *) malloc(n * sizeof(uint64_t));
+    for (size_t i = 0; i < n; ++i) {
+      ref[i] = test_rand(&state) % (n + 1);
+    }
+    uint64_t *sorted = (uint64_t *) malloc(n * sizeof(uint64_t));
+    memcpy(sorted, ref, n * sizeof(uint64_t));
+    qsort(sorted, n, sizeof(uint64_t), cmp_u64);
+
+    size_t nth = (size_t)(test_rand(&state) % n);
+    memcpy(keys, ref, n * sizeof(uint64_t));
+    TEST_CHECK_EQ(s_nth_element(keys, n, sizeof(uint64_t), less_u64, nth), n);
+    TEST_CHECK_EQ(keys[nth], sorted[nth]);
+    bool ok = true;
+    for (size_t i = 0; i < n; ++i) {
+      ok = ok && ((i < nth) ? keys[i] <= keys[nth] : keys[i] >= keys[nth]);
+    }
+    TEST_CHECK(ok);
+
+    size_t k = nth + 1;
+    memcpy(keys, ref, n * sizeof(uint64_t));
+    TEST_CHECK_EQ(s_partial_sort(keys, n, sizeof(uint64_t), less_u64, k), n);
+    TEST_CHECK(memcmp(keys, sorted, k * sizeof(uint64_t)) == 0);
+
+    // a k-sorted input: sorted, then every element moved by at most 'k' positions
+    size_t disp = 1 + (size_t)(test_rand(&state) % 8);
+    memcpy(keys, sorted, n * sizeof(uint64_t));
+    for (size_t i = 0; i + disp < n; i += disp + 1) {
+      uint64_t tmp = keys[i];
+      keys[i] = keys[i + disp];
+      keys[i + disp] = tmp;
+    }
+    TEST_CHECK_EQ(s_ksorted(keys, n, sizeof(uint64_t), less_u64, disp), n);
+    TEST_CHECK(memcmp(keys, sorted, n * sizeof(uint64_t)) == 0);
+
+    free(keys);
+    free(ref);
+    free(sorted);
+  }
+}
+
+// nth_element and partial_sort on every shape, with records: the positions must keep the records
+static void test_selection_shapes(void) {
+  for (size_t d = 1; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    for (int shape = 0; shape < SHAPES; ++shape) {
+      rec_t *input = (rec_t *) malloc(n * sizeof(rec_t));
+      rec_t *keys = (rec_t *) malloc(n * sizeof(rec_t));
+      rec_t *ref = (rec_t *) malloc(n * sizeof(rec_t));
+      fill_recs(input, n, shape, 21 + n * SHAPES + (uint64_t) shape);
+      memcpy(ref, input, n * sizeof(rec_t));
+      qsort(ref, n, sizeof(rec_t), rec_cmp_stable);
+      uint64_t state = n + (uint64_t) shape;
+      size_t nths[3] = {0, n - 1, (size_t)(test_rand(&state) % n)};
+      for (int t = 0; t < 3; ++t) {
+        size_t nth = nths[t];
+        memcpy(keys, input, n * sizeof(rec_t));
+        TEST_CHECK_EQ(s_nth_element(keys, n, sizeof(rec_t), rec_less, nth), n);
+        TEST_CHECK_EQ(keys[nth].key, ref[nth].key);
+        bool ok = true;
+        for (size_t i = 0; i < n; ++i) {
+          ok = ok && ((i < nth) ? keys[i].key <= keys[nth].key : keys[i].key >= keys[nth].key);
+        }
+        TEST_CHECK(ok);
+        qsort(keys, n, sizeof(rec_t), rec_cmp_stable);
+        TEST_CHECK(memcmp(keys, ref, n * sizeof(rec_t)) == 0);
+
+        size_t k = nth + 1;
+        memcpy(keys, input, n * sizeof(rec_t));
+        TEST_CHECK_EQ(s_partial_sort(keys, n, sizeof(rec_t), rec_less, k), n);
+        ok = true;
+        for (size_t i = 0; i < k; ++i) {
+          ok = ok && keys[i].key == ref[i].key;
+        }
+        TEST_CHECK(ok);
+        qsort(keys, n, sizeof(rec_t), rec_cmp_stable);
+        TEST_CHECK(memcmp(keys, ref, n * sizeof(rec_t)) == 0);
+      }
+      free(input);
+      free(keys);
+      free(ref);
+    }
+  }
+}
+
+// The streaming top-k against a sort of the prefix pushed so far
+static void test_topk(void) {
+  static const size_t ks[] = {1, 2, 10, 100, 5000};
+  for (size_t ki = 0; ki < sizeof(ks) / sizeof(ks[0]); ++ki) {
+    size_t k = ks[ki];
+    enum { N = 3000 };
+    uint64_t state = 23 + k;
+    rec_t *stream = (rec_t *) malloc(N * sizeof(rec_t));
+    rec_t *ref = (rec_t *) malloc(N * sizeof(rec_t));
+    rec_t *output = (rec_t *) malloc(N * sizeof(rec_t));
+    for (size_t i = 0; i < N; ++i) {
+      stream[i] = make_rec(i, &state);
+    }
+    s_topk_t *topk = s_topk_new_typed(rec_t, k, rec_less);
+    TEST_CHECK(topk != NULL);
+    TEST_CHECK_EQ(s_topk_sorted(topk, output), 0);
+    for (size_t i = 0; i < N; ++i) {
+      s_topk_push(topk, &stream[i]);
+      if (i % 337 != 0 && i != N - 1) {
+        continue;
+      }
+      size_t pushed = i + 1;
+      size_t expected = (pushed < k) ? pushed : k;
+      memcpy(ref, stream, pushed * sizeof(rec_t));
+      qsort(ref, pushed, sizeof(rec_t), rec_cmp_stable);
+      TEST_CHECK_EQ(s_topk_sorted(topk, output), expected);
+      bool ok = true;
+      for (size_t j = 0; j < expected; ++j) {
+        // the keys of the k first, each a copy of a pushed record
+        ok = ok && output[j].key == ref[j].key && output[j].pos < pushed &&
+             memcmp(&output[j], &stream[output[j].pos], sizeof(rec_t)) == 0;
+      }
+      TEST_CHECK(ok);
+    }
+    s_topk_free(topk);
+    free(stream);
+    free(ref);
+    free(output);
+  }
+}
+
+static void test_merges(void) {
+  uint64_t state = 19;
+  for (int round = 0; round < 50; ++round) {
+    // a few merges of more runs than a loser tree of one cache line
+    size_t k = (round % 10 == 9) ? 1000 + (size_t)(test_rand(&state) % 100) : 1 + (size_t)(test_rand(&state) % 40);
+    s_span_t *spans = (s_span_t *) malloc(k * sizeof(s_span_t));
+    rec_t **runs = (rec_t **) malloc(k * sizeof(rec_t *));
+    size_t total = 0;
+    for (size_t r = 0; r < k; ++r) {
+      size_t n = (size_t)(test_rand(&state) % 200);
+      runs[r] = (rec_t *) malloc((n + 1) * sizeof(rec_t));
+      for (size_t i = 0; i < n; ++i) {
+        runs[r][i].key = test_rand(&state) % 50;
+        runs[r][i].pos = total + i;
+        runs[r][i].pad = r;
+      }
+      qsort(runs[r], n, sizeof(rec_t), rec_cmp_stable);
+      spans[r].data = runs[r];
+      spans[r].dim = n;
+      total += n;
+    }
+    rec_t *ref = (rec_t *) malloc((total + 1) * sizeof(rec_t));
+    rec_t *out = (rec_t *) malloc((total + 1) * sizeof(rec_t));
+    size_t at = 0;
+    for (size_t r = 0; r < k; ++r) {
+      memcpy(ref + at, runs[r], spans[r].dim * sizeof(rec_t));
+      at += spans[r].dim;
+    }
+    // the positions grow with the run index, so the stable merge is the stable sort
+    qsort(ref, total, sizeof(rec_t), rec_cmp_stable);
+    TEST_CHECK_EQ(s_merge_k(spans, k, out, sizeof(rec_t), rec_less), total);
+    TEST_CHECK(total == 0 || memcmp(out, ref, total * sizeof(rec_t)) == 0);
+
+    // the pull-based merger, alternating single elements and batches of random sizes
+    memset(out, 0, (total + 1) * sizeof(rec_t));
+    s_merger_t *merger = s_merger_new(spans, k, sizeof(rec_t), rec_less);
+    TEST_CHECK(merger != NULL);
+    size_t pulled = 0;
+    bool ok = true;
+    while (pulled < total) {
+      if (test_rand(&state) % 2 == 0) {
+        const rec_t *next = (const rec_t *) s_merger_next(merger);
+        ok = ok && next != NULL && memcmp(next, &ref[pulled], sizeof(rec_t)) == 0;
+        ++pulled;
+      } else {
+        size_t max = 1 + (size_t)(test_rand(&state) % 100);
+        size_t got = s_merger_pull(merger, out + pulled, max);
+        ok = ok && got == ((total - pulled < max) ? total - pulled : max) &&
+             memcmp(out + pulled, ref + pulled, got * sizeof(rec_t)) == 0;
+        pulled += got;
+      }
+      if (!ok) {
+        break;
+      }
+    }
+    TEST_CHECK(ok);
+    TEST_CHECK(s_merger_next(merger) == NULL);
+    TEST_CHECK_EQ(s_merger_pull(merger, out, 10), 0);
+    s_merger_free(merger);
+
+    if (k >= 2) {
+      size_t n01 = spans[0].dim + spans[1].dim;
+      TEST_CHECK_EQ(s_merge_2(runs[0], spans[0].dim, runs[1], spans[1].dim, out, sizeof(rec_t), rec_less), n01);
+      memcpy(ref, runs[0], spans[0].dim * sizeof(rec_t));
+      memcpy(ref + spans[0].dim, runs[1], spans[1].dim * sizeof(rec_t));
+      qsort(ref, n01, sizeof(rec_t), rec_cmp_stable);
+      TEST_CHECK(n01 == 0 || memcmp(out, ref, n01 * sizeof(rec_t)) == 0);
+    }
+    for (size_t r = 0; r < k; ++r) {
+      free(runs[r]);
+    }
+    free(runs);
+    free(spans);
+    free(ref);
+    free(out);
+  }
+}
+
+// Shapes of the string sets
+enum { STR_RANDOM, STR_PREFIX, STR_FEW, STR_HIGH, STR_SHAPES };
+
+// Writes the string 'i' of a shape into 'buf' (at least 96 bytes) and returns its length.
+// Only STR_HIGH with 'zeros' set puts zero bytes inside the string
+static size_t make_str(char *buf, int shape, bool zeros, uint64_t *state) {
+  size_t len = 0;
+  switch (shape) {
+    case STR_PREFIX: {
+      // a long shared head, then a short tail: the keys differ around the 8-byte cache boundaries
+      static const char head[] = "https://www.example.com/static/img/";
+      size_t cut = test_rand(state) % sizeof(head);
+      memcpy(buf, head, cut);
+      len = cut;
+      size_t tail = test_rand(state) % 20;
+      for (size_t j = 0; j < tail; ++j) {
+        buf[len++] = (char) ('a' + test_rand(state) % 3);
+      }
+      break;
+    }
+    case STR_FEW:
+      len = (size_t) snprintf(buf, 96, "key-%u", (unsigned)(test_rand(state) % 7));
+      break;
+    case STR_HIGH:
+      len = test_rand(state) % 24;
+      for (size_t j = 0; j < len; ++j) {
+        static const unsigned char bytes[] = {0x00, 0x01, 0x7F, 0x80, 0xFF, 'a'};
+        unsigned char c = bytes[test_rand(state) % sizeof(bytes)];
+        buf[j] = (char) ((c == 0 && !zeros) ? 0x80 : c);
+      }
+      break;
+    default:
+      len = test_rand(state) % 30;
+      for (size_t j = 0; j < len; ++j) {
+        buf[j] = (char) ('a' + test_rand(state) % 26);
+      }
+      break;
+  }
+  buf[len] = '\0';
+  return len;
+}
+
+static int cmp_str(const void *lhs, const void *rhs) {
+  return strcmp(*(char *const *) lhs, *(char *const *) rhs);
+}
+
+// Orders pointers by address
+static int cmp_ptr(const void *lhs, const void *rhs) {
+  uintptr_t a = (uintptr_t) *(char *const *) lhs;
+  uintptr_t b = (uintptr_t) *(char *const *) rhs;
+  return (a > b) - (a < b);
+}
+
+static int cmp_pstr(const void *lhs, const void *rhs) {
+  const s_pstr_t *a = (const s_pstr_t *) lhs;
+  const s_pstr_t *b = (const s_pstr_t *) rhs;
+  size_t len = (a->len < b->len) ? a->len : b->len;
+  int c = (len == 0) ? 0 : memcmp(a->data, b->data, len);
+  if (c != 0) {
+    return c;
+  }
+  return (a->len > b->len) - (a->len < b->len);
+}
+
+static void test_strings(void) {
+  int64_t (*const sorts[])(char **strs, size_t dim) = {s_strings_mkqs, s_strings_msd};
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    for (int shape = 0; shape < STR_SHAPES; ++shape) {
+      char *pool = (char *) malloc(n * 96 + 1);
+      char **input = (char **) malloc((n + 1) * sizeof(char *));
+      char **ref = (char **) malloc((n + 1) * sizeof(char *));
+      char **work = (char **) malloc((n + 1) * sizeof(char *));
+      uint64_t state = 3000 + n * STR_SHAPES + (uint64_t) shape;
+      for (size_t i = 0; i < n; ++i) {
+        input[i] = pool + i * 96;
+        make_str(input[i], shape, false, &state);
+      }
+      memcpy(ref, input, n * sizeof(char *));
+      qsort(ref, n, sizeof(char *), cmp_str);
+      for (size_t a = 0; a < sizeof(sorts) / sizeof(sorts[0]); ++a) {
+        memcpy(work, input, n * sizeof(char *));
+        TEST_CHECK_EQ(sorts[a](work, n), n);
+        bool ok = true;
+        for (size_t i = 0; i < n; ++i) {
+          ok = ok && strcmp(work[i], ref[i]) == 0;
+        }
+        TEST_CHECK(ok);
+        // the output is a permutation of the input, whose pointers are in address order
+        qsort(work, n, sizeof(char *), cmp_ptr);
+        TEST_CHECK(n == 0 || memcmp(work, input, n * sizeof(char *)) == 0);
+      }
+      free(work);
+      free(ref);
+      free(input);
+      free(pool);
+    }
+  }
+}
+
+static void test_pstrs(void) {
+  int64_t (*const sorts[])(s_pstr_t *strs, size_t dim) = {s_pstrs_mkqs, s_pstrs_msd};
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    for (int shape = 0; shape < STR_SHAPES; ++shape) {
+      // a length-prefixed table of the strings, zero bytes included
+      char *table = (char *) malloc(n * (sizeof(uint32_t) + 96) + 1);
+      s_pstr_t *input = (s_pstr_t *) malloc((n + 1) * sizeof(s_pstr_t));
+      s_pstr_t *ref = (s_pstr_t *) malloc((n + 1) * sizeof(s_pstr_t));
+      s_pstr_t *work = (s_pstr_t *) malloc((n + 1) * sizeof(s_pstr_t));
+      uint64_t state = 4000 + n * STR_SHAPES + (uint64_t) shape;
+      size_t bytes = 0;
+      for (size_t i = 0; i < n; ++i) {
+        char buf[96];
+        uint32_t len = (uint32_t) make_str(buf, shape, true, &state);
+        memcpy(table + bytes, &len, sizeof(uint32_t));
+        memcpy(table + bytes + sizeof(uint32_t), buf, len);
+        bytes += sizeof(uint32_t) + len;
+      }
+      TEST_CHECK_EQ(s_pstrs_from_table(table, n, input), bytes);
+      memcpy(ref, input, n * sizeof(s_pstr_t));
+      qsort(ref, n, sizeof(s_pstr_t), cmp_pstr);
+      for (size_t a = 0; a < sizeof(sorts) / sizeof(sorts[0]); ++a) {
+        memcpy(work, input, n * sizeof(s_pstr_t));
+        TEST_CHECK_EQ(sorts[a](work, n), n);
+        bool ok = true;
+        for (size_t i = 0; i < n; ++i) {
+          ok = ok && cmp_pstr(&work[i], &ref[i]) == 0;
+        }
+        TEST_CHECK(ok);
+        // the views still point into the table
+        bool inside = true;
+        for (size_t i = 0; i < n; ++i) {
+          inside = inside && work[i].data >= table && work[i].data + work[i].len <= table + bytes;
+        }
+        TEST_CHECK(inside);
+      }
+      free(work);
+      free(ref);
+      free(input);
+      free(table);
+    }
+  }
+}
+
+static bool less_u32(const void *lhs, const void *rhs) {
+  return *(const uint32_t *) lhs < *(const uint32_t *) rhs;
+}
+
+typedef int64_t (*by_key_u32_t)(uint32_t *keys, size_t dim, size_t nvals, ...);
+
+static int64_t sort_by_key_u32(uint32_t *keys, size_t dim, size_t nvals, ...) {
+  // s_sort_by_key with the value vectors of the tests: a uint64_t and a uint16_t vector
+  va_list args;
+  va_start(args, nvals);
+  void *pos = va_arg(args, void *);
+  size_t pos_size = va_arg(args, size_t);
+  void *tag = va_arg(args, void *);
+  size_t tag_size = va_arg(args, size_t);
+  va_end(args);
+  return s_sort_by_key(keys, dim, sizeof(uint32_t), less_u32, nvals, pos, pos_size, tag, tag_size);
+}
+
+// Checks a sort by key of 'keys' (a copy of 'orig') with the original positions and a tag as values
+static void check_by_key(by_key_u32_t sort, uint32_t mask) {
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    uint64_t state = 23 + n;
+    uint32_t *orig = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+    uint32_t *keys = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+    uint64_t *pos = (uint64_t *) malloc((n + 1) * sizeof(uint64_t));
+    uint16_t *tag = (uint16_t *) malloc((n + 1) * sizeof(uint16_t));
+    for (size_t i = 0; i < n; ++i) {
+      orig[i] = keys[i] = (uint32_t) test_rand(&state) & mask;
+      pos[i] = i;
+      tag[i] = (uint16_t)(orig[i] * 7 + 1);
+    }
+    TEST_CHECK_EQ(sort(keys, n, 2, pos, sizeof(uint64_t), tag, sizeof(uint16_t)), n);
+    bool ok = true;
+    for (size_t i = 0; i < n; ++i) {
+      ok = ok && orig[pos[i]] == keys[i] && tag[i] == (uint16_t)(keys[i] * 7 + 1);
+      // sorted, and stable: equal keys keep their original order
+      ok = ok && (i == 0 || keys[i - 1] < keys[i] || (keys[i - 1] == keys[i] && pos[i - 1] < pos[i]));
+    }
+    TEST_CHECK(ok);
+    free(orig);
+    free(keys);
+    free(pos);
+    free(tag);
+  }
+}
+
+static void test_by_key(void) {
+  check_by_key(s_radix_by_key_u32, UINT32_MAX);
+  check_by_key(s_counting_by_key_u32, 0xFF);
+  check_by_key(s_counting_by_key_u32, UINT32_MAX);
+  check_by_key(sort_by_key_u32, 0xFF);
+}
+
+// Fills 'arr' with 'n' sorted keys below 'range'; with 'strict' set, removes the duplicates and
+// returns the new length
+static size_t fill_sorted_u32(uint32_t *arr, size_t n, uint32_t range, bool strict, uint64_t *state) {
+  for (size_t i = 0; i < n; ++i) {
+    arr[i] = (uint32_t)(test_rand(state) % range);
+  }
+  qsort(arr, n, sizeof(uint32_t), cmp_u32);
+  if (!strict || n == 0) {
+    return n;
+  }
+  size_t len = 1;
+  for (size_t i = 1; i < n; ++i) {
+    if (arr[i] != arr[len - 1]) {
+      arr[len++] = arr[i];
+    }
+  }
+  return len;
+}
+
+static void test_unique_groups(void) {
+  uint64_t state = 53;
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    for (uint32_t range = 2; range <= (1u << 20); range *= 32) {
+      uint32_t *input = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+      uint32_t *work = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+      size_t *bounds = (size_t *) malloc((n + 1) * sizeof(size_t));
+      size_t *ref_bounds = (size_t *) malloc((n + 1) * sizeof(size_t));
+      uint32_t *ref = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+      fill_sorted_u32(input, n, range, false, &state);
+
+      // the model: the first element of every run of equal keys
+      size_t groups = 0;
+      for (size_t i = 0; i < n; ++i) {
+        if (i == 0 || input[i] != input[i - 1]) {
+          ref[groups] = input[i];
+          ref_bounds[groups++] = i;
+        }
+      }
+      ref_bounds[groups] = n;
+
+      memcpy(work, input, n * sizeof(uint32_t));
+      TEST_CHECK_EQ(s_unique_u32(work, n), groups);
+      TEST_CHECK(groups == 0 || memcmp(work, ref, groups * sizeof(uint32_t)) == 0);
+      memcpy(work, input, n * sizeof(uint32_t));
+      TEST_CHECK_EQ(s_unique_typed(work, n, less_u32), groups);
+      TEST_CHECK(groups == 0 || memcmp(work, ref, groups * sizeof(uint32_t)) == 0);
+
+      TEST_CHECK_EQ(s_groups_u32(input, n, bounds), groups);
+      TEST_CHECK(memcmp(bounds, ref_bounds, (groups + 1) * sizeof(size_t)) == 0);
+      memset(bounds, 0xFF, (n + 1) * sizeof(size_t));
+      TEST_CHECK_EQ(s_groups_typed(input, n, less_u32, bounds), groups);
+      TEST_CHECK(memcmp(bounds, ref_bounds, (groups + 1) * sizeof(size_t)) == 0);
+      free(ref);
+      free(ref_bounds);
+      free(bounds);
+      free(work);
+      free(input);
+    }
+  }
+}
+
+static void test_set_operations(void) {
+  // the lengths cover similar inputs and both skewed directions (beyond S_GALLOP_RATIO)
+  static const size_t lens[] = {0, 1, 3, 4, 5, 17, 100, 1000, 5000, 60000};
+  uint64_t state = 59;
+  for (size_t x = 0; x < sizeof(lens) / sizeof(lens[0]); ++x) {
+    for (size_t y = 0; y < sizeof(lens) / sizeof(lens[0]); ++y) {
+      for (uint32_t range = 64; range <= (1u << 24); range *= 64) {
+        uint32_t *a = (uint32_t *) malloc((lens[x] + 1) * sizeof(uint32_t));
+        uint32_t *b = (uint32_t *) malloc((lens[y] + 1) * sizeof(uint32_t));
+        size_t na = fill_sorted_u32(a, lens[x], range, true, &state);
+        size_t nb = fill_sorted_u32(b, lens[y], range, true, &state);
+        uint32_t *out = (uint32_t *) malloc((na + nb + 1) * sizeof(uint32_t));
+        uint32_t *ref_and = (uint32_t *) malloc((na + nb + 1) * sizeof(uint32_t));
+        uint32_t *ref_or = (uint32_t *) malloc((na + nb + 1) * sizeof(uint32_t));
+        uint32_t *ref_diff = (uint32_t *) malloc((na + 1) * sizeof(uint32_t));
+
+        // the model: a plain merge of the two inputs
+        size_t n_and = 0;
+        size_t n_or = 0;
+        size_t n_diff = 0;
+        size_t i = 0;
+        size_t j = 0;
+        while (i < na || j < nb) {
+          if (j == nb || (i < na && a[i] < b[j])) {
+            ref_diff[n_diff++] = a[i];
+            ref_or[n_or++] = a[i++];
+          } else if (i == na || b[j] < a[i]) {
+            ref_or[n_or++] = b[j++];
+          } else {
+            ref_and[n_and++] = a[i];
+            ref_or[n_or++] = a[i];
+            ++i;
+            ++j;
+          }
+        }
+
+        TEST_CHECK_EQ(s_intersect_u32(a, na, b, nb, out), n_and);
+        TEST_CHECK(n_and == 0 || memcmp(out, ref_and, n_and * sizeof(uint32_t)) == 0);
+        TEST_CHECK_EQ(s_intersect_u32(b, nb, a, na, out), n_and);
+        TEST_CHECK(n_and == 0 || memcmp(out, ref_and, n_and * sizeof(uint32_t)) == 0);
+        TEST_CHECK_EQ(s_union_u32(a, na, b, nb, out), n_or);
+        TEST_CHECK(n_or == 0 || memcmp(out, ref_or, n_or * sizeof(uint32_t)) == 0);
+        TEST_CHECK_EQ(s_union_u32(b, nb, a, na, out), n_or);
+        TEST_CHECK(n_or == 0 || memcmp(out, ref_or, n_or * sizeof(uint32_t)) == 0);
+        TEST_CHECK_EQ(s_difference_u32(a, na, b, nb, out), n_diff);
+        TEST_CHECK(n_diff == 0 || memcmp(out, ref_diff, n_diff * sizeof(uint32_t)) == 0);
+        // a set with itself
+        TEST_CHECK_EQ(s_intersect_u32(a, na, a, na, out), na);
+        TEST_CHECK_EQ(s_difference_u32(a, na, a, na, out), 0);
+        free(ref_diff);
+        free(ref_or);
+        free(ref_and);
+        free(out);
+        free(b);
+        free(a);
+      }
+    }
+  }
+}
+
+// Linear lower and upper bound: the model of the searches
+static s_range_t linear_range_u64(const uint64_t *arr, size_t n, uint64_t key) {
+  s_range_t range = {0, 0};
+  while (range.first < n && arr[range.first] < key) {
+    ++range.first;
+  }
+  range.last = range.first;
+  while (range.last < n && arr[range.last] == key) {
+    ++range.last;
+  }
+  return range;
+}
+
+static void test_search(void) {
+  uint64_t state = 61;
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    // spread (few duplicates) and clustered (long runs of equal keys) vectors, and vectors of
+    // keys around the sign bit, where the k-ary search flips the sign for its signed compares
+    for (int kind = 0; kind < 3; ++kind) {
+      uint64_t *a64 = (uint64_t *) malloc((n + 1) * sizeof(uint64_t));
+      uint32_t *a32 = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+      uint64_t base = (kind == 2) ? 0x80000000u - n : 10;
+      uint64_t range = (kind == 1) ? 8 : 3 * n + 1;
+      for (size_t i = 0; i < n; ++i) {
+        a64[i] = base + test_rand(&state) % range;
+      }
+      qsort(a64, n, sizeof(uint64_t), cmp_u64);
+      for (size_t i = 0; i < n; ++i) {
+        a32[i] = (uint32_t) a64[i];
+      }
+
+      size_t nkeys = 1037;
+      uint64_t *k64 = (uint64_t *) malloc(nkeys * sizeof(uint64_t));
+      uint32_t *k32 = (uint32_t *) malloc(nkeys * sizeof(uint32_t));
+      size_t *out = (size_t *) malloc(nkeys * sizeof(size_t));
+      for (size_t q = 0; q < nkeys; ++q) {
+        // present keys, random keys in the range, and the extremes
+        uint64_t key = (q % 2 == 0 && n > 0) ? a64[test_rand(&state) % n] : base + test_rand(&state) % (range + 2);
+        if (q % 17 == 0) {
+          key = (q % 34 == 0) ? 0 : UINT32_MAX;
+        }
+        k64[q] = key;
+        k32[q] = (uint32_t) key;
+      }
+
+      bool ok = true;
+      for (size_t q = 0; q < nkeys; ++q) {
+        s_range_t ref = linear_range_u64(a64, n, k64[q]);
+        s_range_t r64 = s_equal_range_u64(a64, n, k64[q]);
+        s_range_t r32 = s_equal_range_u32(a32, n, k32[q]);
+        s_range_t rg = s_equal_range_typed(a64, n, less_u64, &k64[q]);
+        ok = ok && r64.first == ref.first && r64.last == ref.last;
+        ok = ok && r32.first == ref.first && r32.last == ref.last;
+        ok = ok && rg.first == ref.first && rg.last == ref.last;
+        ok = ok && s_lower_bound_u64(a64, n, k64[q]) == ref.first && s_upper_bound_u64(a64, n, k64[q]) == ref.last;
+        ok = ok && s_lower_bound_u32(a32, n, k32[q]) == ref.first && s_upper_bound_u32(a32, n, k32[q]) == ref.last;
+        ok = ok && s_lower_bound_typed(a64, n, less_u64, &k64[q]) == ref.first;
+        ok = ok && s_upper_bound_typed(a64, n, less_u64, &k64[q]) == ref.last;
+        ok = ok && s_lower_bound_kary_u32(a32, n, k32[q]) == ref.first;
+      }
+      TEST_CHECK(ok);
+
+      // the batches, with a last partial batch
+      bool batch_ok = true;
+      s_lower_bound_batch_u32(a32, n, k32, nkeys, out);
+      for (size_t q = 0; q < nkeys; ++q) {
+        batch_ok = batch_ok && out[q] == linear_range_u64(a64, n, k64[q]).first;
+      }
+      s_lower_bound_batch_u64(a64, n, k64, nkeys, out);
+      for (size_t q = 0; q < nkeys; ++q) {
+        batch_ok = batch_ok && out[q] == linear_range_u64(a64, n, k64[q]).first;
+      }
+      TEST_CHECK(batch_ok);
+      free(out);
+      free(k32);
+      free(k64);
+      free(a32);
+      free(a64);
+    }
+  }
+}
+
+static void test_typed_u32(void) {
+  int64_t (*sorts[])(uint32_t *keys, size_t dim) = {s_radix_u32, s_counting_u32, s_sort_u32};
+  // full range, a range small enough for counting sort, few keys
+  const uint64_t masks[] = {UINT32_MAX, 0xFFF, 3};
+  for (size_t s = 0; s < sizeof(sorts) / sizeof(sorts[0]); ++s) {
+    for (size_t d = 0; d < NDIMS; ++d) {
+      for (int shape = 0; shape < SHAPES; ++shape) {
+        for (size_t m = 0; m < sizeof(masks) / sizeof(masks[0]); ++m) {
+          size_t n = dims[d];
+          uint64_t state = 7 + n + (uint64_t) shape * 31 + m;
+          uint32_t *keys = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+          uint32_t *ref = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+          for (size_t i = 0; i < n; ++i) {
+            keys[i] = (uint32_t)(make_key(shape, i, n, &state, masks[m]) & masks[m]);
+          }
+          memcpy(ref, keys, n * sizeof(uint32_t));
+          qsort(ref, n, sizeof(uint32_t), cmp_u32);
+          TEST_CHECK_EQ(sorts[s](keys, n), n);
+          TEST_CHECK(n == 0 || memcmp(keys, ref, n * sizeof(uint32_t)) == 0);
+          free(keys);
+          free(ref);
+        }
+      }
+    }
+  }
+}
+
+static void test_typed_u64(void) {
+  int64_t (*sorts[])(uint64_t *keys, size_t dim) = {s_radix_u64, s_sort_u64};
+  for (size_t s = 0; s < sizeof(sorts) / sizeof(sorts[0]); ++s) {
+    for (size_t d = 0; d < NDIMS; ++d) {
+      for (int shape = 0; shape < SHAPES; ++shape) {
+        size_t n = dims[d];
+        uint64_t state = 11 + n + (uint64_t) shape * 31;
+        uint64_t *keys = (uint64_t *) malloc((n + 1) * sizeof(uint64_t));
+        uint64_t *ref = (uint64_t *) malloc((n + 1) * sizeof(uint64_t));
+        for (size_t i = 0; i < n; ++i) {
+          keys[i] = make_key(shape, i, n, &state, UINT64_MAX);
+        }
+        memcpy(ref, keys, n * sizeof(uint64_t));
+        qsort(ref, n, sizeof(uint64_t), cmp_u64);
+        TEST_CHECK_EQ(sorts[s](keys, n), n);
+        TEST_CHECK(n == 0 || memcmp(keys, ref, n * sizeof(uint64_t)) == 0);
+        free(keys);
+        free(ref);
+      }
+    }
+  }
+}
+
+static void test_bucket(void) {
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    uint64_t state = 13 + n;
+    double *values = (double *) malloc((n + 1) * sizeof(double));
+    double *ref = (double *) malloc((n + 1) * sizeof(double));
+    float *values32 = (float *) malloc((n + 1) * sizeof(float));
+    for (size_t i = 0; i < n; ++i) {
+      values[i] = (double)(int64_t)(test_rand(&state) % 2000001) / 1000.0 - 1000.0;
+      values32[i] = (float) values[i];
+    }
+    memcpy(ref, values, n * sizeof(double));
+    qsort(ref, n, sizeof(double), cmp_f64);
+    TEST_CHECK_EQ(s_bucket_f64(values, n), n);
+    TEST_CHECK(n == 0 || memcmp(values, ref, n * sizeof(double)) == 0);
+    TEST_CHECK_EQ(s_bucket_f32(values32, n), n);
+    bool ok = true;
+    for (size_t i = 0; i < n; ++i) {
+      ok = ok && values32[i] == (float) ref[i];
+    }
+    TEST_CHECK(ok);
+    free(values);
+    free(ref);
+    free(values32);
+  }
+}
+
+static size_t rec_key(const void *elem) {
+  return (size_t)((const rec_t *) elem)->key;
+}
+
+static void test_counting(void) {
+  // generic counting sort, stable, with the range given and detected (0)
+  const size_t ranges[] = {1, 7, 300, 70000};
+  for (size_t d = 0; d < NDIMS; ++d) {
+    for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); ++r) {
+      size_t n = dims[d];
+      uint64_t state = 17 + n + r;
+      rec_t *recs = (rec_t *) malloc((n + 1) * sizeof(rec_t));
+      rec_t *ref = (rec_t *) malloc((n + 1) * sizeof(rec_t));
+      for (size_t i = 0; i < n; ++i) {
+        recs[i].key = test_rand(&state) % ranges[r];
+        recs[i].pos = i;
+        recs[i].pad = ~i;
+      }
+      memcpy(ref, recs, n * sizeof(rec_t));
+      qsort(ref, n, sizeof(rec_t), rec_cmp_stable);
+      TEST_CHECK_EQ(s_counting_typed(recs, n, rec_key, (r % 2 == 0) ? ranges[r] : 0), n);
+      TEST_CHECK(n == 0 || memcmp(recs, ref, n * sizeof(rec_t)) == 0);
+      free(recs);
+      free(ref);
+    }
+  }
+
+  // keys far from 0, with ranges on both sides of S_COUNTING_MAX_RANGE
+  const uint32_t bases[] = {0, 1000000000u, UINT32_MAX - S_COUNTING_MAX_RANGE + 1};
+  const size_t spans[] = {1, 2, 256, S_COUNTING_MAX_RANGE, S_COUNTING_MAX_RANGE + 1};
+  for (size_t b = 0; b < sizeof(bases) / sizeof(bases[0]); ++b) {
+    for (size_t sp = 0; sp < sizeof(spans) / sizeof(spans[0]); ++sp) {
+      size_t n = 5000;
+      uint64_t state = 19 + b * 7 + sp;
+      uint32_t *keys = (uint32_t *) malloc(n * sizeof(uint32_t));
+      uint32_t *ref = (uint32_t *) malloc(n * sizeof(uint32_t));
+      uint32_t base = (spans[sp] > S_COUNTING_MAX_RANGE && b == 2) ? bases[b] - 1 : bases[b];
+      for (size_t i = 0; i < n; ++i) {
+        keys[i] = base + (uint32_t)(test_rand(&state) % spans[sp]);
+      }
+      // the extremes of the span are present
+      keys[0] = base;
+      keys[n - 1] = base + (uint32_t)(spans[sp] - 1);
+      uint32_t min = 1, max = 0;
+      s_key_range_u32(keys, n, &min, &max);
+      TEST_CHECK_EQ(min, base);
+      TEST_CHECK_EQ(max, base + (uint32_t)(spans[sp] - 1));
+      memcpy(ref, keys, n * sizeof(uint32_t));
+      qsort(ref, n, sizeof(uint32_t), cmp_u32);
+      TEST_CHECK_EQ(s_counting_u32(keys, n), n);
+      TEST_CHECK(memcmp(keys, ref, n * sizeof(uint32_t)) == 0);
+      free(keys);
+      free(ref);
+    }
+  }
+
+  // the range of uint64_t keys, and an empty vector leaves the output unchanged
+  uint64_t keys64[] = {5, UINT64_MAX, 0, 77};
+  uint64_t min64 = 1, max64 = 1;
+  s_key_range_u64(keys64, 4, &min64, &max64);
+  TEST_CHECK(min64 == 0 && max64 == UINT64_MAX);
+  min64 = 3;
+  max64 = 4;
+  s_key_range_u64(keys64, 0, &min64, &max64);
+  TEST_CHECK(min64 == 3 && max64 == 4);
+}
+
+static void test_sort_plan(void) {
+  enum { N = 5000 };
+  uint32_t *keys = (uint32_t *) malloc(N * sizeof(uint32_t));
+  uint64_t *keys64 = (uint64_t *) malloc(N * sizeof(uint64_t));
+  rec_t *recs = (rec_t *) malloc(N * sizeof(rec_t));
+  uint64_t state = 23;
+
+  // sorted, strictly decreasing, decreasing with ties (not reversed: it would break stability)
+  for (size_t i = 0; i < N; ++i) {
+    keys[i] = (uint32_t)(10 * i);
+  }
+  s_sort_plan_t plan = s_sort_plan_u32(keys, N);
+  TEST_CHECK_EQ(plan.algorithm, S_ALGO_NONE);
+  TEST_CHECK(plan.integral && plan.dim == N && plan.size == sizeof(uint32_t));
+  TEST_CHECK(plan.key_min == 0 && plan.key_max == 10 * (N - 1));
+  TEST_CHECK(plan.sampled == S_SORT_SAMPLE && plan.descents == 0);
+  for (size_t i = 0; i < N; ++i) {
+    recs[i].key = N - i;
+    recs[i].pos = i;
+  }
+  plan = s_sort_plan_typed(recs, N, rec_less);
+  TEST_CHECK_EQ(plan.algorithm, S_ALGO_REVERSE);
+  TEST_CHECK(!plan.integral && plan.size == sizeof(rec_t) && plan.descents == plan.sampled);
+  for (size_t i = 0; i < N; ++i) {
+    recs[i].key = (N - i) / 2;
+  }
+  TEST_CHECK_EQ(s_sort_plan_typed(recs, N, rec_less).algorithm, S_ALGO_MERGE);
+  TEST_CHECK_EQ(s_sort_typed(recs, N, rec_less), N);
+  bool stable = true;
+  for (size_t i = 1; i < N; ++i) {
+    stable = stable && rec_cmp_stable(&recs[i - 1], &recs[i]) < 0;
+  }
+  TEST_CHECK(stable);
+
+  // sorted except for the last element: the sample agrees, the full check does not
+  for (size_t i = 0; i < N; ++i) {
+    keys64[i] = i;
+  }
+  keys64[N - 1] = 0;
+  plan = s_sort_plan_u64(keys64, N);
+  TEST_CHECK(plan.descents == 0 && plan.algorithm == S_ALGO_COUNTING);
+
+  // small vectors, small and large key ranges
+  for (size_t i = 0; i < N; ++i) {
+    keys[i] = 1000000 + (uint32_t)(test_rand(&state) % 100);
+    keys64[i] = test_rand(&state);
+  }
+  TEST_CHECK_EQ(s_sort_plan_u32(keys, S_SORT_INSERTION - 1).algorithm, S_ALGO_INSERTION);
+  TEST_CHECK_EQ(s_sort_plan_u32(keys, N).algorithm, S_ALGO_COUNTING);
+  TEST_CHECK_EQ(s_sort_plan_u64(keys64, N).algorithm, S_ALGO_RADIX);
+  keys[0] = 0;
+  TEST_CHECK_EQ(s_sort_plan_u32(keys, N).algorithm, S_ALGO_RADIX);
+  fill_recs(recs, N, SHAPE_RANDOM, 29);
+  TEST_CHECK_EQ(s_sort_plan_typed(recs, N, rec_less).algorithm, S_ALGO_MERGE);
+
+  // every plan leads to a sorted vector
+  TEST_CHECK_EQ(s_sort_u32(keys, N), N);
+  TEST_CHECK_EQ(s_sort_u64(keys64, N), N);
+  bool sorted = true;
+  for (size_t i = 1; i < N; ++i) {
+    sorted = sorted && keys[i - 1] <= keys[i] && keys64[i - 1] <= keys64[i];
+  }
+  TEST_CHECK(sorted);
+
+  // the trivial dimensions, and the names
+  TEST_CHECK_EQ(s_sort_plan_u32(keys, 0).algorithm, S_ALGO_NONE);
+  TEST_CHECK_EQ(s_sort_plan_typed(recs, 1, rec_less).algorithm, S_ALGO_NONE);
+  TEST_CHECK(strcmp(s_algorithm_name(S_ALGO_NONE), "none") == 0);
+  TEST_CHECK(strcmp(s_algorithm_name(S_ALGO_REVERSE), "reverse") == 0);
+  TEST_CHECK(strcmp(s_algorithm_name(S_ALGO_INSERTION), "insertion") == 0);
+  TEST_CHECK(strcmp(s_algorithm_name(S_ALGO_MERGE), "merge") == 0);
+  TEST_CHECK(strcmp(s_algorithm_name(S_ALGO_COUNTING), "counting") == 0);
+  TEST_CHECK(strcmp(s_algorithm_name(S_ALGO_RADIX), "radix") == 0);
+  free(recs);
+  free(keys64);
+  free(keys);
+}
+
+// Elements of elem_size bytes: a key byte, then the original position as two big-endian bytes
+static size_t elem_size;
+
+static bool less_first_byte(const void *lhs, const void *rhs) {
+  return *(const uint8_t *) lhs < *(const uint8_t *) rhs;
+}
+
+static int cmp_elem_stable(const void *lhs, const void *rhs) {
+  return memcmp(lhs, rhs, (elem_size < 3) ? elem_size : 3);
+}
+
+// Every generic sort on every size the move engine special-cases, the sizes around them, and
+// sizes above S_STACK_TEMP whose temporaries come from the heap
+static void test_element_sizes(void) {
+  static const size_t sizes[] = {1, 3, 4, 8, 12, 16, 24, 32, 48, 64, 100, S_STACK_TEMP, S_STACK_TEMP + 44};
+  static const generic_sort_t sorts[] = {s_insertion, s_selection, s_merge, s_heap, s_sort};
+  static const bool stable[] = {true, false, true, false, true};
+  static const size_t ns[] = {2, 17, 300, 2000};
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    elem_size = sizes[s];
+    for (size_t k = 0; k < sizeof(ns) / sizeof(ns[0]); ++k) {
+      size_t n = ns[k];
+      uint8_t *input = (uint8_t *) malloc(n * elem_size);
+      uint8_t *work = (uint8_t *) malloc(n * elem_size);
+      uint8_t *ref = (uint8_t *) malloc(n * elem_size);
+      uint64_t state = 7000 + n + elem_size;
+      for (size_t i = 0; i < n; ++i) {
+        uint8_t *elem = input + i * elem_size;
+        elem[0] = (uint8_t)(test_rand(&state) % 16);
+        for (size_t b = 1; b < elem_size; ++b) {
+          elem[b] = (b <= 2) ? (uint8_t)(i >> (8 * (2 - b))) : (uint8_t)(i * 31 + b);
+        }
+      }
+      memcpy(ref, input, n * elem_size);
+      qsort(ref, n, elem_size, cmp_elem_stable);
+      for (size_t a = 0; a < sizeof(sorts) / sizeof(sorts[0]); ++a) {
+        memcpy(work, input, n * elem_size);
+        TEST_CHECK_EQ(sorts[a](work, n, elem_size, less_first_byte), n);
+        if (!stable[a] || elem_size < 3) {
+          bool keys_ok = true;
+          for (size_t i = 1; i < n; ++i) {
+            keys_ok = keys_ok && work[(i - 1) * elem_size] <= work[i * elem_size];
+          }
+          TEST_CHECK(keys_ok);
+          qsort(work, n, elem_size, cmp_elem_stable);
+        }
+        // the stable order, or every element intact whatever the order of equal keys
+        TEST_CHECK(memcmp(work, ref, n * elem_size) == 0);
+      }
+      free(ref);
+      free(work);
+      free(input);
+    }
+  }
+}
+
+static bool rec_greater(const void *lhs, const void *rhs) {
+  return ((const rec_t *) lhs)->key > ((const rec_t *) rhs)->key;
+}
+
+// s_ksorted on inputs where every record is at most k positions from its place, for windows
+// shorter than, equal to and longer than the vector, in both orders; s_heap_typed on the same
+static void test_ksorted(void) {
+  static const size_t ks[] = {0, 1, 2, 7, 64, 1000, 5000};
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    rec_t *input = (rec_t *) malloc((n + 1) * sizeof(rec_t));
+    rec_t *work = (rec_t *) malloc((n + 1) * sizeof(rec_t));
+    uint64_t *order = (uint64_t *) malloc((n + 1) * sizeof(uint64_t));
+    for (size_t ki = 0; ki < sizeof(ks) / sizeof(ks[0]); ++ki) {
+      size_t k = ks[ki];
+      // record i moves to the rank of i + a random offset in [0, k]: at most k positions
+      uint64_t state = 300 + n + k;
+      for (size_t i = 0; i < n; ++i) {
+        order[i] = ((uint64_t)(i + test_rand(&state) % (k + 1)) << 32) | (uint64_t) i;
+      }
+      qsort(order, n, sizeof(uint64_t), cmp_u64);
+      for (size_t i = 0; i < n; ++i) {
+        input[i].key = order[i] & UINT32_MAX;
+        input[i].pos = i;
+        input[i].pad = ~input[i].key;
+      }
+
+      memcpy(work, input, n * sizeof(rec_t));
+      TEST_CHECK_EQ(s_ksorted_typed(work, n, rec_less, k), n);
+      bool ok = true;
+      for (size_t i = 0; i < n; ++i) {
+        ok = ok && work[i].key == i && work[i].pad == ~(uint64_t) i;
+      }
+      TEST_CHECK(ok);
+
+      // the reversed input is k-sorted for the decreasing order
+      for (size_t i = 0; i < n; ++i) {
+        work[i] = input[n - 1 - i];
+      }
+      TEST_CHECK_EQ(s_ksorted(work, n, sizeof(rec_t), rec_greater, k), n);
+      ok = true;
+      for (size_t i = 0; i < n; ++i) {
+        ok = ok && work[i].key == n - 1 - i && work[i].pad == ~(uint64_t)(n - 1 - i);
+      }
+      TEST_CHECK(ok);
+
+      memcpy(work, input, n * sizeof(rec_t));
+      TEST_CHECK_EQ(s_heap_typed(work, n, rec_greater), n);
+      ok = true;
+      for (size_t i = 0; i < n; ++i) {
+        ok = ok && work[i].key == n - 1 - i && work[i].pad == ~(uint64_t)(n - 1 - i);
+      }
+      TEST_CHECK(ok);
+    }
+    free(order);
+    free(work);
+    free(input);
+  }
+}
+
+static int cmp_i32(const void *lhs, const void *rhs) {
+  int32_t a = *(const int32_t *) lhs;
+  int32_t b = *(const int32_t *) rhs;
+  return (a > b) - (a < b);
+}
+
+static int cmp_i64(const void *lhs, const void *rhs) {
+  int64_t a = *(const int64_t *) lhs;
+  int64_t b = *(const int64_t *) rhs;
+  return (a > b) - (a < b);
+}
+
+static bool greater_u32(const void *lhs, const void *rhs) {
+  return *(const uint32_t *) lhs > *(const uint32_t *) rhs;
+}
+
+// Sorts a vector of every integer type with v_sort and compares it with qsort
+#define CHECK_V_SORT(type, less, cmp, gen) do {                   \
+    type *vec = NULL;                                             \
+    type *ref = (type *) malloc((n + 1) * sizeof(type));          \
+    v_init_with(vec, NULL);                                       \
+    for (size_t i = 0; i < n; ++i) {                              \
+      type value = (type)(gen);                                   \
+      v_push_back(vec, value);                                    \
+      ref[i] = value;                                             \
+    }                                                             \
+    qsort(ref, n, sizeof(type), cmp);                             \
+    TEST_CHECK_EQ(v_sort(vec, less), n);                          \
+    TEST_CHECK(n == 0 || memcmp(vec, ref, n * sizeof(type)) == 0); \
+    v_free(vec);                                                  \
+    free(ref);                                                    \
+  } while (0)
+
+static void test_v_sort(void) {
+  for (size_t d = 0; d < NDIMS; ++d) {
+    size_t n = dims[d];
+    uint64_t state = 31 + n;
+    CHECK_V_SORT(uint32_t, s_less_u32, cmp_u32, test_rand(&state));
+    CHECK_V_SORT(uint32_t, s_less_u32, cmp_u32, test_rand(&state) % 100);
+    CHECK_V_SORT(uint64_t, s_less_u64, cmp_u64, test_rand(&state));
+    CHECK_V_SORT(int32_t, s_less_i32, cmp_i32, test_rand(&state));
+    CHECK_V_SORT(int32_t, s_less_i32, cmp_i32, (int64_t)(test_rand(&state) % 200) - 100);
+    CHECK_V_SORT(int64_t, s_less_i64, cmp_i64, test_rand(&state));
+    // any other order goes to s_sort
+    CHECK_V_SORT(rec_t, rec_less, rec_cmp_stable, make_rec(i, &state));
+    CHECK_V_SORT(uint64_t, less_u64, cmp_u64, test_rand(&state));
+  }
+  // the typed sort is only selected by its own order: a decreasing order must not be ignored
+  uint32_t *vec = NULL;
+  v_init_with(vec, NULL);
+  for (uint32_t i = 0; i < 100; ++i) {
+    v_push_back(vec, i);
+  }
+  TEST_CHECK_EQ(v_sort(vec, greater_u32), 100);
+  bool ok = true;
+  for (uint32_t i = 0; i < 100; ++i) {
+    ok = ok && vec[i] == 99 - i;
+  }
+  TEST_CHECK(ok);
+  v_free(vec);
+}
+
+typedef struct item_t {
+  int32_t score;
+  uint32_t id;
+} item_t;
+
+static void test_v_sort_by_key(void) {
+  item_t *vec = NULL;
+  v_init_with(vec, NULL);
+  uint64_t state = 37;
+  for (uint32_t i = 0; i < 5000; ++i) {
+    item_t item = {(int32_t)(test_rand(&state) % 1000) - 500, i};
+    v_push_back(vec, item);
+  }
+  v_sort_by_key(vec, score);
+  bool ok = true;
+  for (size_t i = 1; i < v_size(vec); ++i) {
+    // signed order, stable
+    ok = ok && (vec[i - 1].score < vec[i].score || (vec[i - 1].score == vec[i].score && vec[i - 1].id < vec[i].id));
+  }
+  TEST_CHECK(ok);
+  TEST_CHECK_EQ(v_size(vec), 5000);
+  v_free(vec);
+}
+
+static void test_hash_sort_export(void) {
+  uint32_t *map = NULL;
+  hash_init_with(map, NULL);
+  uint64_t state = 41;
+  uint64_t *ref = (uint64_t *) malloc(3000 * sizeof(uint64_t));
+  for (size_t i = 0; i < 3000; ++i) {
+    ref[i] = test_rand(&state);
+    hash_put(map, ref[i], (uint32_t)(ref[i] >> 7));
+  }
+  qsort(ref, 3000, sizeof(uint64_t), cmp_u64);
+  uint64_t *keys = (uint64_t *) malloc(hash_size(map) * sizeof(uint64_t));
+  uint32_t *vals = (uint32_t *) malloc(hash_size(map) * sizeof(uint32_t));
+  TEST_CHECK_EQ(hash_sort_export(map, keys, vals), 3000);
+  bool ok = true;
+  for (size_t i = 0; i < 3000; ++i) {
+    ok = ok && keys[i] == ref[i] && vals[i] == (uint32_t)(ref[i] >> 7);
+  }
+  TEST_CHECK(ok);
+  free(keys);
+  free(vals);
+  free(ref);
+  hash_free(map);
+}
+
+// Allocator that fails from the allocation number 'fail_at' on
+static int alloc_count = 0;
+static int alloc_fail_at = 0;
+
+static void *failing_alloc(void *ctx, size_t bytes, size_t align) {
+  (void) ctx;
+  (void) align;
+  return (alloc_count++ >= alloc_fail_at) ? NULL : malloc(bytes);
+}
+
+static void *failing_resize(void *ctx, void *ptr, size_t old_bytes, size_t bytes, size_t align) {
+  (void) ctx;
+  (void) old_bytes;
+  (void) align;
+  return (alloc_count++ >= alloc_fail_at) ? NULL : realloc(ptr, bytes);
+}
+
+static void failing_release(void *ctx, void *ptr, size_t bytes) {
+  (void) ctx;
+  (void) bytes;
+  free(ptr);
+}
+
+static void test_by_key_failure(void) {
+  static const chibi_allocator_t failing = {failing_alloc, failing_resize, failing_release, NULL};
+  by_key_u32_t sorts[] = {s_radix_by_key_u32, s_counting_by_key_u32, sort_by_key_u32};
+  enum { N = 1000 };
+  uint32_t keys[N], orig[N];
+  uint64_t pos[N];
+  uint16_t tag[N];
+  s_set_allocator(&failing);
+  for (size_t s = 0; s < sizeof(sorts) / sizeof(sorts[0]); ++s) {
+    for (int fail_at = 0; fail_at < 8; ++fail_at) {
+      uint64_t state = 29 + (uint64_t) fail_at;
+      for (size_t i = 0; i < N; ++i) {
+        orig[i] = keys[i] = (uint32_t) test_rand(&state) & 0xFFF;
+        pos[i] = i;
+        tag[i] = (uint16_t) i;
+      }
+      alloc_count = 0;
+      alloc_fail_at = fail_at;
+      int64_t ret = sorts[s](keys, N, 2, pos, sizeof(uint64_t), tag, sizeof(uint16_t));
+      bool ok = true;
+      for (size_t i = 0; i < N; ++i) {
+        if (ret == -1) {
+          // a failure leaves keys and values untouched
+          ok = ok && keys[i] == orig[i] && pos[i] == i && tag[i] == (uint16_t) i;
+        } else {
+          ok = ok && orig[pos[i]] == keys[i] && tag[i] == (uint16_t) pos[i];
+        }
+      }
+      TEST_CHECK(ret == -1 || ret == N);
+      TEST_CHECK(ok);
+    }
+  }
+  s_set_allocator(NULL);
+}
+
+int main(void) {
+  TEST_RUN(test_insertion);
+  TEST_RUN(test_selection);
+  TEST_RUN(test_merge);
+  TEST_RUN(test_heap);
+  TEST_RUN(test_sort);
+  TEST_RUN(test_selection_algorithms);
+  TEST_RUN(test_selection_shapes);
+  TEST_RUN(test_topk);
+  TEST_RUN(test_merges);
+  TEST_RUN(test_strings);
+  TEST_RUN(test_pstrs);
+  TEST_RUN(test_by_key);
+  TEST_RUN(test_unique_groups);
+  TEST_RUN(test_set_operations);
+  TEST_RUN(test_search);
+  TEST_RUN(test_typed_u32);
+  TEST_RUN(test_typed_u64);
+  TEST_RUN(test_bucket);
+  TEST_RUN(test_counting);
+  TEST_RUN(test_sort_plan);
+  TEST_RUN(test_element_sizes);
+  TEST_RUN(test_ksorted);
+  TEST_RUN(test_v_sort);
+  TEST_RUN(test_v_sort_by_key);
+  TEST_RUN(test_hash_sort_export);
+  TEST_RUN(test_by_key_failure);
+  return TEST_END("sort_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,93 @@
+/* test.h - Shared helpers of the chibilibs tests
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * A test program is a main that calls TEST_RUN on functions of type void (void). A failed check
+ * prints the file, the line and the failed expression and marks the current test as failed; the
+ * test goes on, so that a run reports every failure. TEST_END prints a summary and returns the
+ * exit status of the program. The inputs come from test_rand (splitmix64) with fixed seeds, so
+ * failures can be reproduced.
+ */
+
+#ifndef CHIBI_TEST_H
+#define CHIBI_TEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int test__failures = 0;
+static int test__failed_tests = 0;
+static int test__tests = 0;
+
+#define TEST_CHECK(expr)                                                          \
+  do {                                                                            \
+    if (!(expr)) {                                                                \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);    \
+      ++test__failures;                                                           \
+    }                                                                             \
+  } while (0)
+
+#define TEST_CHECK_EQ(lhs, rhs)                                                   \
+  do {                                                                            \
+    long long test__lhs = (long long)(lhs);                                       \
+    long long test__rhs = (long long)(rhs);                                       \
+    if (test__lhs != test__rhs) {                                                 \
+      fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, \
+              __LINE__, #lhs, #rhs, test__lhs, test__rhs);                        \
+      ++test__failures;                                                           \
+    }                                                                             \
+  } while (0)
+
+#define TEST_RUN(fn)                                         \
+  do {                                                       \
+    int test__before = test__failures;                       \
+    fn();                                                    \
+    ++test__tests;                                           \
+    if (test__failures != test__before) {                    \
+      ++test__failed_tests;                                  \
+      fprintf(stderr, "FAIL %s\n", #fn);                     \
+    }                                                        \
+  } while (0)
+
+#define TEST_END(name)                                                                  \
+  (printf("%s: %d tests, %d failed\n", (name), test__tests, test__failed_tests),        \
+   (test__failed_tests == 0) ? 0 : 1)
+
+/* Random numbers: splitmix64 */
+static inline uint64_t test_rand(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+#endif
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,264 @@
+/* trace_test.c - Tests of trace.h
+ * Part of the chibilibs project (https://github.com/nadrojpeg/chibilibs)
+ *
+ * Copyright (c) 2025 Paolo Giordano
+ * Licensed under the MIT License. See the LICENSE at the end of this file for details.
+ *
+ * The exported traces are parsed back and compared with the regions recorded, the reference
+ * model: the number of events, their names, begin and end events well nested on every thread,
+ * timestamps that never go backwards on a thread, and no event exported twice. A full ring must
+ * drop whole regions and never the end of a region whose begin was recorded, also while other
+ * threads record and the main thread exports. An export while a region is open must stop before
+ * its begin and leave it to the next export.
+ */
+
+#define CHIBI_TRACE
+#include "trace.h"
+#include "test.h"
+#include <pthread.h>
+
+#define MAX_THREADS 8
+#define MAX_DEPTH 64
+
+// Counts of a parsed trace
+typedef struct parsed_t {
+  size_t events;
+  bool ok;  // valid lines, well nested, ordered timestamps
+} parsed_t;
+
+// Parses a trace written by trace_export
+static parsed_t parse(FILE *file) {
+  parsed_t parsed;
+  memset(&parsed, 0, sizeof(parsed));
+  parsed.ok = true;
+  char stacks[MAX_THREADS + 1][MAX_DEPTH][32];
+  size_t depth[MAX_THREADS + 1] = {0};
+  double last_ts[MAX_THREADS + 1] = {0};
+  char line[256];
+  rewind(file);
+  parsed.ok = fgets(line, sizeof(line), file) != NULL &&
+              strcmp(line, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n") == 0;
+  bool closed = false;
+  while (parsed.ok && fgets(line, sizeof(line), file) != NULL) {
+    if (strcmp(line, "]}\n") == 0) {
+      closed = true;
+      continue;
+    }
+    char name[32];
+    char phase;
+    double ts;
+    int tid;
+    if (closed || sscanf(line, "{\"name\":\"%31[^\"]\",\"ph\":\"%c\",\"ts\":%lf,\"pid\":1,\"tid\":%d}", name,
+                         &phase, &ts, &tid) != 4 || tid < 1 || tid > MAX_THREADS || ts < last_ts[tid]) {
+      parsed.ok = false;
+      break;
+    }
+    last_ts[tid] = ts;
+    ++parsed.events;
+    if (phase == 'B') {
+      parsed.ok = depth[tid] < MAX_DEPTH;
+      if (parsed.ok) {
+        strcpy(stacks[tid][depth[tid]++], name);
+      }
+    } else {
+      parsed.ok = phase == 'E' && depth[tid] > 0 && strcmp(stacks[tid][--depth[tid]], name) == 0;
+    }
+  }
+  for (int t = 0; t <= MAX_THREADS; ++t) {
+    parsed.ok = parsed.ok && depth[t] == 0;
+  }
+  parsed.ok = parsed.ok && closed;
+  return parsed;
+}
+
+// Exports the recorded events into a temporary file and parses them
+static size_t export_parsed(parsed_t *parsed) {
+  FILE *file = tmpfile();
+  if (file == NULL) {
+    parsed->ok = false;
+    return 0;
+  }
+  size_t written = trace_export(file);
+  *parsed = parse(file);
+  fclose(file);
+  return written;
+}
+
+static void leaf(void) {
+  TRACE_BEGIN(leaf);
+  TRACE_END(leaf);
+}
+
+static void nested(int depth) {
+  TRACE_BEGIN(nested);
+  if (depth > 0) {
+    nested(depth - 1);
+  }
+  leaf();
+  TRACE_END(nested);
+}
+
+static void test_export(void) {
+  parsed_t parsed;
+  // regions left over by another test, if any, go first
+  export_parsed(&parsed);
+
+  nested(5);
+  for (int i = 0; i < 100; ++i) {
+    TRACE_BEGIN_IF(filtered, i % 10 == 0);
+    leaf();
+    TRACE_END(filtered);
+  }
+  uint64_t dropped = trace_dropped();
+  size_t written = export_parsed(&parsed);
+  // 6 nested and 6 leaf regions, then 10 filtered and 100 leaf regions
+  TEST_CHECK_EQ(written, 2 * (6 + 6 + 10 + 100));
+  TEST_CHECK(parsed.ok);
+  TEST_CHECK_EQ(parsed.events, written);
+  TEST_CHECK_EQ(trace_dropped(), dropped);
+
+  // the events were removed by the export
+  TEST_CHECK_EQ(export_parsed(&parsed), 0);
+  TEST_CHECK(parsed.ok);
+  TEST_CHECK_EQ(parsed.events, 0);
+}
+
+// Fills the ring while regions are open: whole regions are dropped, the open ones still end
+static void test_full_ring(void) {
+  parsed_t parsed;
+  export_parsed(&parsed);
+  uint64_t dropped = trace_dropped();
+
+  TRACE_BEGIN(outer);
+  TRACE_BEGIN(middle);
+  size_t regions = TRACE_RING_SIZE;
+  for (size_t i = 0; i < regions; ++i) {
+    leaf();
+  }
+  TRACE_END(middle);
+  TRACE_END(outer);
+
+  uint64_t lost = trace_dropped() - dropped;
+  TEST_CHECK(lost > 0);
+  size_t written = export_parsed(&parsed);
+  TEST_CHECK_EQ(written, 2 * (2 + regions - lost));
+  TEST_CHECK(written <= TRACE_RING_SIZE);
+  TEST_CHECK(parsed.ok);
+  TEST_CHECK_EQ(parsed.events, written);
+
+  // the ring is usable again after the export
+  leaf();
+  TEST_CHECK_EQ(export_parsed(&parsed), 2);
+  TEST_CHECK(parsed.ok);
+}
+
+// Exports with a region still open on the thread keep it, and what follows, for the next export
+static void test_open_region(void) {
+  parsed_t parsed;
+  export_parsed(&parsed);
+
+  TRACE_BEGIN(outer);
+  leaf();
+  TEST_CHECK_EQ(export_parsed(&parsed), 0);
+  TEST_CHECK(parsed.ok);
+  TRACE_END(outer);
+  TEST_CHECK_EQ(export_parsed(&parsed), 4);
+  TEST_CHECK(parsed.ok);
+
+  leaf();
+  TRACE_BEGIN(open);
+  leaf();
+  TEST_CHECK_EQ(export_parsed(&parsed), 2);
+  TEST_CHECK(parsed.ok);
+  leaf();
+  TRACE_END(open);
+  leaf();
+  TEST_CHECK_EQ(export_parsed(&parsed), 8);
+  TEST_CHECK(parsed.ok);
+}
+
+// Threads record while the main thread exports
+typedef struct recorder_t {
+  size_t regions;
+  int done;
+} recorder_t;
+
+static void *recorder_main(void *arg) {
+  recorder_t *recorder = (recorder_t *) arg;
+  for (size_t i = 0; i < recorder->regions; ++i) {
+    nested((int)(i % 3));
+  }
+  __atomic_store_n(&recorder->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void test_threads(void) {
+  enum { THREADS = 4, REGIONS = 20000 };
+  parsed_t parsed;
+  export_parsed(&parsed);
+  uint64_t dropped = trace_dropped();
+
+  pthread_t threads[THREADS];
+  recorder_t recorders[THREADS];
+  for (int t = 0; t < THREADS; ++t) {
+    recorders[t].regions = REGIONS;
+    recorders[t].done = 0;
+    TEST_CHECK(pthread_create(&threads[t], NULL, recorder_main, &recorders[t]) == 0);
+  }
+  // nested(d) records d + 1 nested and d + 1 leaf regions
+  size_t expected = 0;
+  for (size_t i = 0; i < REGIONS; ++i) {
+    expected += 2 * ((i % 3) + 1);
+  }
+  expected *= THREADS;
+  size_t exported = 0;
+  bool running = true;
+  while (running) {
+    running = false;
+    for (int t = 0; t < THREADS; ++t) {
+      running = running || !__atomic_load_n(&recorders[t].done, __ATOMIC_ACQUIRE);
+    }
+    size_t written = export_parsed(&parsed);
+    TEST_CHECK(parsed.ok);
+    TEST_CHECK_EQ(parsed.events, written);
+    exported += written;
+  }
+  for (int t = 0; t < THREADS; ++t) {
+    pthread_join(threads[t], NULL);
+  }
+  // every region is exported once or dropped as a whole
+  TEST_CHECK(exported % 2 == 0);
+  TEST_CHECK_EQ(exported / 2 + (trace_dropped() - dropped), expected);
+}
+
+int main(void) {
+  TEST_RUN(test_export);
+  TEST_RUN(test_full_ring);
+  TEST_RUN(test_open_region);
+  TEST_RUN(test_threads);
+  return TEST_END("trace_test");
+}
+
+/*
+MIT License
+
+Copyright (c) 2025 Paolo Giordano
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/